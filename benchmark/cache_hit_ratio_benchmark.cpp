@@ -0,0 +1,115 @@
+/**
+ * @file cache_hit_ratio_benchmark.cpp
+ * @author sheep (ysj1173886760@gmail.com)
+ * @brief
+ * Hit ratio of cache policies on skewed graph traces. point reads pick
+ * vertices by zipf distribution, and analytics passes scan all vertices
+ * periodically.
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+#include <gflags/gflags.h>
+
+#include "cache/lru_cache.h"
+#include "cache/s3fifo_cache.h"
+#include "common/logger.h"
+
+DEFINE_int64(vertex_num, 1000000, "");
+DEFINE_int64(cache_size, 100000, "number of vertices that could be cached");
+DEFINE_double(zipf_theta, 0.99, "");
+DEFINE_int64(iterations, 10000000, "");
+DEFINE_int64(scan_interval, 500000,
+             "point reads between two scans, 0 means no scan");
+
+class ZipfGenerator {
+public:
+  ZipfGenerator(int64_t n, double theta) : cdf_(n) {
+    double sum = 0;
+    for (int64_t i = 0; i < n; i++) {
+      sum += 1.0 / std::pow(i + 1, theta);
+      cdf_[i] = sum;
+    }
+    for (auto &v : cdf_) {
+      v /= sum;
+    }
+  }
+
+  int64_t Next(std::mt19937_64 &generator) {
+    auto p = distribution_(generator);
+    return std::lower_bound(cdf_.begin(), cdf_.end(), p) - cdf_.begin();
+  }
+
+private:
+  std::vector<double> cdf_;
+  std::uniform_real_distribution<double> distribution_{0, 1};
+};
+
+struct Trace {
+  std::vector<int64_t> vertices;
+  // false for accesses of scans.
+  std::vector<bool> is_point_read;
+  size_t point_reads{0};
+};
+
+Trace MakeTrace() {
+  Trace trace;
+  ZipfGenerator zipf(FLAGS_vertex_num, FLAGS_zipf_theta);
+  std::mt19937_64 generator(0);
+  // hot vertices are scattered over the id space.
+  std::vector<int64_t> permutation(FLAGS_vertex_num);
+  for (int64_t i = 0; i < FLAGS_vertex_num; i++) {
+    permutation[i] = i;
+  }
+  std::shuffle(permutation.begin(), permutation.end(), generator);
+  for (int64_t i = 0; i < FLAGS_iterations; i++) {
+    if (FLAGS_scan_interval != 0 && i % FLAGS_scan_interval == 0 && i != 0) {
+      for (int64_t v = 0; v < FLAGS_vertex_num; v++) {
+        trace.vertices.push_back(v);
+        trace.is_point_read.push_back(false);
+      }
+    }
+    trace.vertices.push_back(permutation[zipf.Next(generator)]);
+    trace.is_point_read.push_back(true);
+    trace.point_reads += 1;
+  }
+  return trace;
+}
+
+void Run(const std::string &name, arcanedb::cache::Cache *cache,
+         const Trace &trace) {
+  auto deleter = [](const std::string_view &, void *) {};
+  size_t hits = 0;
+  size_t point_hits = 0;
+  for (size_t i = 0; i < trace.vertices.size(); i++) {
+    auto key = std::to_string(trace.vertices[i]);
+    auto handle = cache->Lookup(key);
+    if (handle) {
+      hits += 1;
+      point_hits += trace.is_point_read[i];
+      continue;
+    }
+    cache->Insert(key, reinterpret_cast<void *>(1), 1, deleter);
+  }
+  ARCANEDB_INFO("{} hit ratio {:.4f}, point read hit ratio {:.4f}", name,
+                static_cast<double>(hits) / trace.vertices.size(),
+                static_cast<double>(point_hits) / trace.point_reads);
+}
+
+int main(int argc, char *argv[]) {
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  auto trace = MakeTrace();
+  auto lru = arcanedb::cache::NewLRUCache(FLAGS_cache_size);
+  Run("lru", lru.get(), trace);
+  auto s3fifo = arcanedb::cache::NewS3FifoCache(FLAGS_cache_size);
+  Run("s3fifo", s3fifo.get(), trace);
+  return 0;
+}
@@ -0,0 +1,80 @@
+/**
+ * @file cache_lookup_benchmark.cpp
+ * @author sheep (ysj1173886760@gmail.com)
+ * @brief
+ * Throughput of concurrent cache hits, which is the fast path of
+ * BufferPool::GetPage.
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <gflags/gflags.h>
+
+#include "cache/clock_cache.h"
+#include "cache/lru_cache.h"
+#include "cache/s3fifo_cache.h"
+#include "common/logger.h"
+
+DEFINE_int64(key_num, 100000, "");
+DEFINE_int64(thread_num, 16, "");
+DEFINE_int64(lookups_per_thread, 2000000, "");
+DEFINE_int64(shard_bits, 8, "");
+DEFINE_int64(hot_key_num, 0,
+             "lookups only touch the first hot_key_num keys if it's not 0");
+
+void Run(const std::string &name, arcanedb::cache::Cache *cache) {
+  auto deleter = [](const std::string_view &, void *) {};
+  std::vector<std::string> keys;
+  for (int64_t i = 0; i < FLAGS_key_num; i++) {
+    keys.push_back("page" + std::to_string(i));
+    cache->Insert(keys.back(), reinterpret_cast<void *>(1), 1, deleter);
+  }
+  auto range = FLAGS_hot_key_num == 0 ? FLAGS_key_num : FLAGS_hot_key_num;
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (int64_t i = 0; i < FLAGS_thread_num; i++) {
+    threads.emplace_back([&, i]() {
+      std::mt19937_64 generator(i);
+      std::uniform_int_distribution<int64_t> distribution(0, range - 1);
+      for (int64_t j = 0; j < FLAGS_lookups_per_thread; j++) {
+        auto handle = cache->Lookup(keys[distribution(generator)]);
+        if (!handle) {
+          ARCANEDB_WARN("unexpected cache miss");
+        }
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+                     std::chrono::steady_clock::now() - start)
+                     .count();
+  ARCANEDB_INFO("{} lookups {:.2f} Mops/s", name,
+                static_cast<double>(FLAGS_thread_num *
+                                    FLAGS_lookups_per_thread) /
+                    elapsed);
+}
+
+int main(int argc, char *argv[]) {
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  // every key fits in cache, so that only hits are measured. capacity has
+  // headroom since keys are not evenly distributed among shards.
+  auto capacity = FLAGS_key_num * 2;
+  auto lru = arcanedb::cache::NewLRUCache(capacity, FLAGS_shard_bits);
+  Run("lru", lru.get());
+  auto s3fifo = arcanedb::cache::NewS3FifoCache(capacity, FLAGS_shard_bits);
+  Run("s3fifo", s3fifo.get());
+  auto clock = arcanedb::cache::NewClockCache(capacity, FLAGS_shard_bits);
+  Run("clock", clock.get());
+  return 0;
+}
@@ -27,6 +27,8 @@ Status Btree::SetRow(const property::Row &row, const Options &opts) noexcept {
     NOTIMPLEMENTED();
     break;
   }
+  default:
+    UNREACHABLE();
   }
   return s;
 }
@@ -44,6 +46,8 @@ Status Btree::DeleteRow(property::SortKeysRef sort_key,
     NOTIMPLEMENTED();
     break;
   }
+  default:
+    UNREACHABLE();
   }
   return s;
 }
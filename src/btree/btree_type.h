@@ -77,6 +77,8 @@ using RangeScanRowView = util::Views<RowRef, RowOwner>;
 enum class PageType : uint8_t {
   InternalPage,
   LeafPage,
+  // page shared by many small subtables, see btree::PackedPage.
+  PackedPage,
 };
 
 } // namespace btree
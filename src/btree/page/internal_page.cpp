@@ -11,6 +11,8 @@
 
 #include "btree/page/internal_page.h"
 #include "butil/macros.h"
+#include "util/codec/buf_reader.h"
+#include "util/codec/buf_writer.h"
 #include <algorithm>
 #include <iterator>
 
@@ -61,6 +63,113 @@ InternalRows::Split(const Options &opts, property::SortKeysRef old_sort_key,
   return Status::Ok();
 }
 
+Status InternalRows::ReplaceChildren(
+    const Options &opts, const std::vector<PageIdView> &old_page_ids,
+    std::vector<InternalRow> new_internal_rows) noexcept {
+  CHECK(!old_page_ids.empty() && !new_internal_rows.empty());
+  auto it =
+      std::find_if(rows_.begin(), rows_.end(), [&](const InternalRow &row) {
+        return row.page_id == old_page_ids[0];
+      });
+  if (it == rows_.end() ||
+      static_cast<size_t>(rows_.end() - it) < old_page_ids.size()) {
+    return Status::NotFound();
+  }
+  for (size_t i = 1; i < old_page_ids.size(); i++) {
+    if ((it + i)->page_id != old_page_ids[i]) {
+      return Status::NotFound();
+    }
+  }
+  // use the original lower bound
+  new_internal_rows[0].sort_key = it->sort_key;
+  it = rows_.erase(it, it + old_page_ids.size());
+  rows_.insert(it, std::make_move_iterator(new_internal_rows.begin()),
+               std::make_move_iterator(new_internal_rows.end()));
+  return Status::Ok();
+}
+
+size_t InternalRows::FindChild(property::SortKeysRef sort_key,
+                               bool before) const noexcept {
+  DCHECK(!rows_.empty());
+  if (before && sort_key.empty()) {
+    return rows_.size() - 1;
+  }
+  std::vector<InternalRow>::const_iterator iter;
+  if (before) {
+    iter = std::lower_bound(
+        rows_.begin(), rows_.end(), sort_key,
+        [](const InternalRow &row, property::SortKeysRef sk) {
+          return row.sort_key < sk;
+        });
+  } else {
+    iter = std::upper_bound(
+        rows_.begin(), rows_.end(), sort_key,
+        [](property::SortKeysRef sk, const InternalRow &row) {
+          return sk < row.sort_key;
+        });
+  }
+  // check due to the fact that rows_.begin() is smallest sort key
+  CHECK(iter != rows_.begin());
+  return iter - rows_.begin() - 1;
+}
+
+std::string InternalRows::Serialize(log_store::LsnType lsn) const noexcept {
+  util::BufWriter writer;
+  writer.WriteBytes(kInternalPageMagic);
+  writer.WriteBytes(lsn);
+  writer.WriteBytes(static_cast<uint32_t>(rows_.size()));
+  auto write_string = [&](std::string_view str) {
+    writer.WriteBytes(static_cast<uint16_t>(str.size()));
+    writer.WriteBytes(str);
+  };
+  for (const auto &row : rows_) {
+    write_string(row.sort_key.as_slice());
+    write_string(row.page_id);
+  }
+  return writer.Detach();
+}
+
+bool InternalRows::IsInternalImage(std::string_view data) noexcept {
+  uint64_t magic;
+  util::BufReader reader(data);
+  return reader.ReadBytes(&magic) && magic == kInternalPageMagic;
+}
+
+Status InternalRows::Deserialize(std::string_view data,
+                                 std::vector<InternalRow> *rows,
+                                 log_store::LsnType *lsn) noexcept {
+  util::BufReader reader(data);
+  uint64_t magic;
+  uint32_t count;
+  if (!reader.ReadBytes(&magic) || magic != kInternalPageMagic ||
+      !reader.ReadBytes(lsn) || !reader.ReadBytes(&count)) {
+    return Status::Err();
+  }
+  auto read_string = [&](std::string_view *str) {
+    uint16_t length;
+    return reader.ReadBytes(&length) && reader.ReadPiece(str, length);
+  };
+  rows->reserve(rows->size() + count);
+  for (uint32_t i = 0; i < count; i++) {
+    std::string_view sort_key;
+    std::string_view page_id;
+    if (!read_string(&sort_key) || !read_string(&page_id)) {
+      return Status::Err();
+    }
+    rows->push_back(InternalRow{.sort_key = property::SortKeys(sort_key),
+                                .page_id = PageIdType(page_id)});
+  }
+  return Status::Ok();
+}
+
+size_t InternalRows::GetTotalCharge() const noexcept {
+  size_t charge = sizeof(InternalRows) + rows_.capacity() * sizeof(InternalRow);
+  for (const auto &row : rows_) {
+    charge += row.sort_key.as_slice().size() + row.page_id.size();
+  }
+  return charge;
+}
+
 bool InternalRows::TEST_SortKeyAscending() const noexcept {
   if (rows_.size() == 1) {
     return true;
@@ -98,6 +207,24 @@ InternalPage::Split(const Options &opts, property::SortKeysRef old_sort_key,
   return s;
 }
 
+Status InternalPage::ReplaceChildren(
+    const Options &opts, const std::vector<PageIdView> &old_page_ids,
+    std::vector<InternalRow> new_internal_rows) noexcept {
+  Status s;
+  {
+    auto mutable_ptr = data_.GetMutablePtr();
+    s = mutable_ptr->ReplaceChildren(opts, old_page_ids,
+                                     std::move(new_internal_rows));
+  }
+  data_.Promote();
+  return s;
+}
+
+void InternalPage::Overwrite(std::vector<InternalRow> rows) noexcept {
+  data_.GetMutablePtr()->rows_ = std::move(rows);
+  data_.Promote();
+}
+
 bool InternalPage::TEST_SortKeyAscending() noexcept {
   return data_.GetImmutablePtr()->TEST_SortKeyAscending();
 }
@@ -14,9 +14,11 @@
 #include "common/options.h"
 #include "common/status.h"
 #include "common/type.h"
+#include "log_store/log_store.h"
 #include "property/sort_key/sort_key.h"
 #include "util/cow.h"
 #include "util/view.h"
+#include <limits>
 
 namespace arcanedb {
 namespace btree {
@@ -45,9 +47,75 @@ public:
   Status Split(const Options &opts, property::SortKeysRef old_sort_key,
                std::vector<InternalRow> new_internal_rows) noexcept;
 
+  /**
+   * @brief
+   * Replace adjacent children with new_internal_rows, corresponding to btree
+   * split and merge operation. lower bound of the first old child is kept.
+   * @param opts
+   * @param old_page_ids
+   * @param new_internal_rows
+   * @return Status: NotFound if old children are not adjacent entries.
+   */
+  Status ReplaceChildren(const Options &opts,
+                         const std::vector<PageIdView> &old_page_ids,
+                         std::vector<InternalRow> new_internal_rows) noexcept;
+
+  /**
+   * @brief
+   * Find the child which contains sort_key. when before is true, find the
+   * child containing the largest key which is less than sort_key instead,
+   * and empty sort_key means the last child.
+   * @param sort_key
+   * @param before
+   * @return size_t index of the child
+   */
+  size_t FindChild(property::SortKeysRef sort_key, bool before) const
+      noexcept;
+
+  const InternalRow &GetRow(size_t idx) const noexcept { return rows_[idx]; }
+
+  size_t GetSize() const noexcept { return rows_.size(); }
+
+  const std::vector<InternalRow> &GetRows() const noexcept { return rows_; }
+
+  // memory used by rows, used as the charge in buffer pool.
+  size_t GetTotalCharge() const noexcept;
+
+  /**
+   * @brief
+   * Format:
+   * | magic 8byte | lsn 8byte | count 4byte | sort_key1 | page_id1 | ...
+   * sort_key & page_id format:
+   * | length 2byte | string varlen |
+   * magic takes the place of lsn in leaf page image, so that page type could
+   * be told from the image.
+   * @param lsn
+   * @return std::string
+   */
+  std::string Serialize(log_store::LsnType lsn) const noexcept;
+
+  static bool IsInternalImage(std::string_view data) noexcept;
+
+  /**
+   * @brief
+   * Deserialize rows from internal page image, rows are appended.
+   * @param data
+   * @param rows
+   * @param lsn
+   * @return Status
+   */
+  static Status Deserialize(std::string_view data,
+                            std::vector<InternalRow> *rows,
+                            log_store::LsnType *lsn) noexcept;
+
   bool TEST_SortKeyAscending() const noexcept;
 
 private:
+  static constexpr uint64_t kInternalPageMagic =
+      std::numeric_limits<uint64_t>::max();
+
+  friend class InternalPage;
+
   std::vector<InternalRow> rows_;
 };
 
@@ -80,6 +148,35 @@ public:
   Status Split(const Options &opts, property::SortKeysRef old_sort_key,
                std::vector<InternalRow> new_internal_rows) noexcept;
 
+  /**
+   * @brief
+   * Replace adjacent children with new_internal_rows.
+   * @param opts
+   * @param old_page_ids
+   * @param new_internal_rows
+   * @return Status
+   */
+  Status ReplaceChildren(const Options &opts,
+                         const std::vector<PageIdView> &old_page_ids,
+                         std::vector<InternalRow> new_internal_rows) noexcept;
+
+  /**
+   * @brief
+   * Overwrite the entire internal page.
+   * @param rows
+   */
+  void Overwrite(std::vector<InternalRow> rows) noexcept;
+
+  /**
+   * @brief
+   * Get an immutable snapshot of internal rows, rows won't be modified by
+   * SMO afterward.
+   * @return std::shared_ptr<const InternalRows>
+   */
+  std::shared_ptr<const InternalRows> GetRows() const noexcept {
+    return data_.GetImmutablePtr();
+  }
+
   bool TEST_SortKeyAscending() noexcept;
 
 private:
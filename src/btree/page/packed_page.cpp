@@ -0,0 +1,281 @@
+/**
+ * @file packed_page.cpp
+ * @author sheep (ysj1173886760@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "btree/page/packed_page.h"
+#include "butil/hash.h"
+#include "common/config.h"
+#include "common/logger.h"
+#include "util/codec/buf_reader.h"
+#include "util/codec/buf_writer.h"
+
+namespace arcanedb {
+namespace btree {
+
+namespace {
+
+// subtable keys couldn't contain '#', see TxnContextOCC::AcquireLock_.
+constexpr std::string_view kPackedPagePrefix = "#packed";
+constexpr char kLeafIdDelimiter = '/';
+
+} // namespace
+
+size_t PackedPage::GetPackedPageBucket(std::string_view table_key) noexcept {
+  return butil::Hash(table_key.data(), table_key.size()) %
+         common::Config::kPackedPageNum;
+}
+
+std::string PackedPage::GetPackedPageId(size_t bucket) noexcept {
+  return fmt::format("{}{}", kPackedPagePrefix, bucket);
+}
+
+bool PackedPage::IsPackedPageId(std::string_view page_id) noexcept {
+  return page_id.substr(0, kPackedPagePrefix.size()) == kPackedPagePrefix;
+}
+
+bool PackedPage::ParseLeafId(std::string_view page_id,
+                             std::string_view *packed_page_id,
+                             std::string_view *table_key) noexcept {
+  if (!IsPackedPageId(page_id)) {
+    return false;
+  }
+  auto pos = page_id.find(kLeafIdDelimiter);
+  if (pos == std::string_view::npos) {
+    return false;
+  }
+  *packed_page_id = page_id.substr(0, pos);
+  *table_key = page_id.substr(pos + 1);
+  return true;
+}
+
+std::string PackedPage::MakeLeafId_(std::string_view table_key) const
+    noexcept {
+  std::string leaf_id = page_id_;
+  leaf_id.push_back(kLeafIdDelimiter);
+  leaf_id.append(table_key);
+  return leaf_id;
+}
+
+uint64_t PackedPage::PromotedHash_(std::string_view table_key) noexcept {
+  // the second hash is derived by rotating the first one.
+  uint32_t h = butil::Hash(table_key.data(), table_key.size());
+  uint32_t delta = (h >> 17) | (h << 15);
+  return (static_cast<uint64_t>(delta) << 32) | h;
+}
+
+std::shared_ptr<VersionedBwTreePage>
+PackedPage::GetLeaf(std::string_view table_key, bool create,
+                    bool *promoted) noexcept {
+  ArcanedbLockGuard<ArcanedbLock> guard(mu_);
+  *promoted = false;
+  auto it = leaves_.find(table_key);
+  if (it != leaves_.end()) {
+    return it->second.leaf;
+  }
+  if (promoted_filter_.MayContainHash(PromotedHash_(table_key))) {
+    *promoted = true;
+    return nullptr;
+  }
+  if (!create) {
+    return nullptr;
+  }
+  auto leaf = std::make_shared<VersionedBwTreePage>(MakeLeafId_(table_key),
+                                                    /*packed=*/true);
+  auto charge = leaf->GetTotalCharge();
+  total_charge_ += charge;
+  leaves_.emplace(table_key,
+                  LeafEntry{.leaf = leaf, .charge = charge, .dirty = true});
+  return leaf;
+}
+
+size_t PackedPage::UpdateLeafCharge(std::string_view table_key) noexcept {
+  ArcanedbLockGuard<ArcanedbLock> guard(mu_);
+  auto it = leaves_.find(table_key);
+  if (it != leaves_.end()) {
+    auto charge = it->second.leaf->GetTotalCharge();
+    total_charge_ = total_charge_ - it->second.charge + charge;
+    it->second.charge = charge;
+    it->second.dirty = true;
+  }
+  return total_charge_;
+}
+
+size_t PackedPage::Promote(std::string_view table_key) noexcept {
+  ArcanedbLockGuard<ArcanedbLock> guard(mu_);
+  auto it = leaves_.find(table_key);
+  if (it != leaves_.end()) {
+    total_charge_ -= it->second.charge;
+    it->second.leaf->Truncate();
+    leaves_.erase(it);
+  }
+  promoted_filter_.AddHash(PromotedHash_(table_key));
+  promoted_since_flush_.emplace_back(table_key);
+  return total_charge_;
+}
+
+size_t PackedPage::GetTotalCharge() const noexcept {
+  ArcanedbLockGuard<ArcanedbLock> guard(mu_);
+  return total_charge_;
+}
+
+std::string PackedPage::Serialize(log_store::LsnType lsn,
+                                  bool *is_delta) noexcept {
+  // leaf images are taken outside of mu_.
+  struct LeafRef {
+    std::string table_key;
+    std::shared_ptr<VersionedBwTreePage> leaf;
+    bool dirty;
+  };
+  std::vector<LeafRef> leaves;
+  std::vector<std::string> promoted;
+  std::string filter;
+  {
+    ArcanedbLockGuard<ArcanedbLock> guard(mu_);
+    *is_delta =
+        !flush_whole_ && delta_num_ < common::Config::kPackedPageMaxDeltaNum;
+    if (*is_delta) {
+      delta_num_ += 1;
+      promoted.swap(promoted_since_flush_);
+    } else {
+      delta_num_ = 0;
+      flush_whole_ = false;
+      promoted_since_flush_.clear();
+    }
+    leaves.reserve(leaves_.size());
+    for (auto &[table_key, entry] : leaves_) {
+      // leaves written after this are flushed again by the next flush.
+      leaves.push_back(LeafRef{
+          .table_key = table_key, .leaf = entry.leaf, .dirty = entry.dirty});
+      entry.dirty = false;
+    }
+    filter = promoted_filter_.GetData();
+  }
+
+  util::BufWriter writer;
+  writer.WriteBytes(kPackedPageMagic);
+  writer.WriteBytes(lsn);
+  writer.WriteBytes(static_cast<uint8_t>(*is_delta));
+  auto count_pos = writer.Offset();
+  writer.Reserve(sizeof(uint32_t));
+  uint32_t count = 0;
+  for (const auto &[table_key, leaf, dirty] : leaves) {
+    // clean leaf is flushed only if intents of committed txns are written
+    // back, see VersionedBwTreePage::GetPageSnapshot.
+    if (*is_delta && !dirty && !leaf->WriteBackIntents()) {
+      continue;
+    }
+    if (leaf->GetChain() == nullptr) {
+      continue;
+    }
+    auto image = leaf->GetPageSnapshot()->Serialize();
+    writer.WriteBytes(static_cast<uint16_t>(table_key.size()));
+    writer.WriteBytes(table_key);
+    writer.WriteBytes(static_cast<uint32_t>(image.size()));
+    writer.WriteBytes(image);
+    count += 1;
+  }
+  writer.WriteBytesAtPos(count_pos, count);
+  writer.WriteBytes(static_cast<uint32_t>(promoted.size()));
+  for (const auto &table_key : promoted) {
+    writer.WriteBytes(static_cast<uint16_t>(table_key.size()));
+    writer.WriteBytes(table_key);
+  }
+  writer.WriteBytes(static_cast<uint32_t>(filter.size()));
+  writer.WriteBytes(filter);
+  return writer.Detach();
+}
+
+void PackedPage::OnFlushFailed() noexcept {
+  ArcanedbLockGuard<ArcanedbLock> guard(mu_);
+  flush_whole_ = true;
+}
+
+bool PackedPage::IsPackedImage(std::string_view data) noexcept {
+  uint64_t magic;
+  util::BufReader reader(data);
+  return reader.ReadBytes(&magic) && magic == kPackedPageMagic;
+}
+
+Status PackedPage::Deserialize(std::string_view data) noexcept {
+  util::BufReader reader(data);
+  uint64_t magic;
+  log_store::LsnType lsn;
+  uint8_t is_delta;
+  uint32_t count;
+  if (!reader.ReadBytes(&magic) || magic != kPackedPageMagic ||
+      !reader.ReadBytes(&lsn) || !reader.ReadBytes(&is_delta) ||
+      !reader.ReadBytes(&count)) {
+    return Status::Err();
+  }
+  auto read_key = [&](std::string_view *table_key) {
+    uint16_t length;
+    return reader.ReadBytes(&length) && reader.ReadPiece(table_key, length);
+  };
+  ArcanedbLockGuard<ArcanedbLock> guard(mu_);
+  // page is flushed as delta until the whole page is flushed again.
+  flush_whole_ = false;
+  delta_num_ = is_delta ? delta_num_ + 1 : 0;
+  for (uint32_t i = 0; i < count; i++) {
+    std::string_view table_key;
+    std::string_view image;
+    uint32_t length;
+    if (!read_key(&table_key) || !reader.ReadBytes(&length) ||
+        !reader.ReadPiece(&image, length)) {
+      return Status::Err();
+    }
+    auto leaf = std::make_shared<VersionedBwTreePage>(MakeLeafId_(table_key),
+                                                    /*packed=*/true);
+    auto s = leaf->Deserialize(image);
+    if (!s.ok()) {
+      return s;
+    }
+    // leaf in delta replaces the older one.
+    auto it = leaves_.find(table_key);
+    if (it != leaves_.end()) {
+      total_charge_ -= it->second.charge;
+      leaves_.erase(it);
+    }
+    auto charge = leaf->GetTotalCharge();
+    total_charge_ += charge;
+    leaves_.emplace(table_key, LeafEntry{.leaf = std::move(leaf),
+                                         .charge = charge,
+                                         .dirty = false});
+  }
+  if (!reader.ReadBytes(&count)) {
+    return Status::Err();
+  }
+  for (uint32_t i = 0; i < count; i++) {
+    std::string_view table_key;
+    if (!read_key(&table_key)) {
+      return Status::Err();
+    }
+    auto it = leaves_.find(table_key);
+    if (it != leaves_.end()) {
+      total_charge_ -= it->second.charge;
+      leaves_.erase(it);
+    }
+  }
+  // filter only grows, so the newest one covers the older ones.
+  uint32_t length;
+  std::string_view filter;
+  if (!reader.ReadBytes(&length) || !reader.ReadPiece(&filter, length) ||
+      !promoted_filter_.SetData(filter)) {
+    return Status::Err();
+  }
+  return Status::Ok();
+}
+
+size_t PackedPage::TEST_GetLeafCount() const noexcept {
+  ArcanedbLockGuard<ArcanedbLock> guard(mu_);
+  return leaves_.size();
+}
+
+} // namespace btree
+} // namespace arcanedb
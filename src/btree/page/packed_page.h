@@ -0,0 +1,191 @@
+/**
+ * @file packed_page.h
+ * @author sheep (ysj1173886760@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#pragma once
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "btree/page/versioned_bwtree_page.h"
+#include "common/config.h"
+#include "common/status.h"
+#include "common/type.h"
+#include "log_store/log_store.h"
+#include "util/bloom_filter.h"
+#include <limits>
+#include <memory>
+#include <vector>
+
+namespace arcanedb {
+namespace btree {
+
+/**
+ * @brief
+ * Physical page shared by many small subtables, i.e. small-tree aggregation.
+ * Each packed subtable owns a leaf page keyed by its table key, while cache
+ * handle, flusher state, page store entry and lock table belong to the
+ * packed page and are shared by all of them. leaf page doesn't own a lock
+ * table, and its write queue is intrusive, so an idle leaf only costs the
+ * page object itself plus its delta chain.
+ * Subtable is promoted to its own page once it grows too large, and promoted
+ * table keys are remembered by a persisted bloom filter so that they are
+ * never packed again. a false positive only keeps a new subtable from being
+ * packed, since existing leaves are found before the filter is checked.
+ * Packed page is flushed as delta, i.e. only leaves written and keys
+ * promoted since last flush, and it's flushed as a whole once in a while.
+ */
+class PackedPage {
+public:
+  explicit PackedPage(std::string_view page_id) noexcept
+      : page_id_(page_id),
+        total_charge_(sizeof(PackedPage) + promoted_filter_.GetCharge()) {}
+
+  /**
+   * @brief
+   * Get id of the packed page hosting table_key. the mapping is stable
+   * across processes since it's persisted implicitly.
+   * @param table_key
+   * @return std::string
+   */
+  static std::string GetPackedPageId(std::string_view table_key) noexcept {
+    return GetPackedPageId(GetPackedPageBucket(table_key));
+  }
+
+  /**
+   * @brief
+   * Get bucket of the packed page hosting table_key, packed pages are
+   * numbered by bucket.
+   * @param table_key
+   * @return size_t
+   */
+  static size_t GetPackedPageBucket(std::string_view table_key) noexcept;
+
+  static std::string GetPackedPageId(size_t bucket) noexcept;
+
+  static bool IsPackedPageId(std::string_view page_id) noexcept;
+
+  /**
+   * @brief
+   * Parse id of leaf page packed in packed page, which is used as page id of
+   * redo logs.
+   * Format: | packed page id | / | table key |
+   * @param page_id
+   * @param packed_page_id
+   * @param table_key
+   * @return true if page_id is a packed leaf.
+   */
+  static bool ParseLeafId(std::string_view page_id,
+                          std::string_view *packed_page_id,
+                          std::string_view *table_key) noexcept;
+
+  /**
+   * @brief
+   * Get leaf page of table_key.
+   * @param table_key
+   * @param create create the leaf if table_key has never been packed.
+   * @param promoted set when table_key has been promoted to its own page.
+   * @return std::shared_ptr<VersionedBwTreePage> nullptr if leaf doesn't
+   * exist or has been promoted.
+   */
+  std::shared_ptr<VersionedBwTreePage>
+  GetLeaf(std::string_view table_key, bool create, bool *promoted) noexcept;
+
+  /**
+   * @brief
+   * Account the charge of leaf after it's written.
+   * @param table_key
+   * @return size_t total charge of packed page.
+   */
+  size_t UpdateLeafCharge(std::string_view table_key) noexcept;
+
+  /**
+   * @brief
+   * Remove leaf of table_key after it's promoted to its own page. the frozen
+   * leaf is truncated at the same time, so that readers of the leaf move to
+   * the promoted page.
+   * @param table_key
+   * @return size_t total charge of packed page.
+   */
+  size_t Promote(std::string_view table_key) noexcept;
+
+  size_t GetTotalCharge() const noexcept;
+
+  /**
+   * @brief
+   * Serialize packed page for flush, delta only contains leaves written and
+   * keys promoted since last flush. whole page is serialized after
+   * kPackedPageMaxDeltaNum deltas, or after a failed flush.
+   * Format:
+   * | magic 8byte | lsn 8byte | is delta 1byte | leaf count 4byte |
+   * | table key | leaf image | ... | promoted count 4byte | table key | ...
+   * | promoted filter length 4byte | promoted filter varlen |
+   * table key format: | length 2byte | string varlen |
+   * leaf image format: | length 4byte | image varlen |
+   * empty leaves are not serialized.
+   * @param lsn
+   * @param[out] is_delta whether image should be prepended as delta.
+   * @return std::string
+   */
+  std::string Serialize(log_store::LsnType lsn, bool *is_delta) noexcept;
+
+  /**
+   * @brief
+   * Called when flush of the last image failed, leaves in it might be missing
+   * from the store, so that whole page is serialized by the next flush.
+   */
+  void OnFlushFailed() noexcept;
+
+  static bool IsPackedImage(std::string_view data) noexcept;
+
+  /**
+   * @brief
+   * Deserialize the base image, and the deltas following it in order.
+   * @param data
+   * @return Status
+   */
+  Status Deserialize(std::string_view data) noexcept;
+
+  size_t TEST_GetLeafCount() const noexcept;
+
+private:
+  static constexpr uint64_t kPackedPageMagic =
+      std::numeric_limits<uint64_t>::max() - 1;
+
+  std::string MakeLeafId_(std::string_view table_key) const noexcept;
+
+  // hash of table key in promoted filter, which is stable across processes.
+  static uint64_t PromotedHash_(std::string_view table_key) noexcept;
+
+  struct LeafEntry {
+    std::shared_ptr<VersionedBwTreePage> leaf;
+    // charge that has been accounted into total_charge_.
+    size_t charge;
+    // written since last flush.
+    bool dirty;
+  };
+
+  const std::string page_id_;
+  mutable ArcanedbLock mu_;
+  // following fields are guarded by mu_.
+  absl::flat_hash_map<std::string, LeafEntry> leaves_;
+  util::BloomFilter promoted_filter_{
+      common::Config::kPackedPromotedFilterKeyNum,
+      common::Config::kPackedPromotedFilterBitsPerKey};
+  // keys promoted since last flush, their leaves are dropped by the delta.
+  std::vector<std::string> promoted_since_flush_;
+  // deltas flushed since the whole page is flushed.
+  size_t delta_num_{0};
+  // page that has never been flushed is flushed as a whole.
+  bool flush_whole_{true};
+  size_t total_charge_;
+};
+
+} // namespace btree
+} // namespace arcanedb
@@ -11,6 +11,9 @@ public:
 
   virtual log_store::LsnType GetLSN() noexcept = 0;
 
+  // delta snapshot is prepended to the page instead of replacing it.
+  virtual bool IsDelta() noexcept { return false; }
+
   virtual ~PageSnapshot() noexcept {}
 };
 
@@ -13,6 +13,7 @@
 
 #include "btree/btree_type.h"
 #include "btree/page/internal_page.h"
+#include "btree/page/packed_page.h"
 #include "btree/page/page_snapshot.h"
 #include "btree/page/versioned_bwtree_page.h"
 #include "btree/write_info.h"
@@ -33,10 +34,16 @@ class VersionedBtreePage {
 public:
   /**
    * @brief
-   * Default ctor, construct leaf page.
+   * Default ctor, construct leaf page, or packed page if page id is
+   * generated by PackedPage::GetPackedPageId.
    */
   VersionedBtreePage(const std::string_view &page_id) noexcept {
     leaf_page_ = std::make_unique<VersionedBwTreePage>(page_id);
+    if (PackedPage::IsPackedPageId(page_id)) {
+      packed_page_ = std::make_unique<PackedPage>(page_id);
+      ModifyPageType(PageType::PackedPage);
+      return;
+    }
     ModifyPageType(PageType::LeafPage);
   }
 
@@ -151,16 +158,21 @@ public:
    * @param target_ts
    * @param opts
    * @param info
+   * @return Status: Ok, or Retry when page is frozen by SMO.
    */
-  void SetTs(property::SortKeysRef sort_key, TxnTs target_ts,
-             const Options &opts, WriteInfo *info) noexcept {
+  Status SetTs(property::SortKeysRef sort_key, TxnTs target_ts,
+               const Options &opts, WriteInfo *info) noexcept {
     assert(leaf_page_);
-    leaf_page_->SetTs(sort_key, target_ts, opts, info);
+    auto s = leaf_page_->SetTs(sort_key, target_ts, opts, info);
+    if (!s.ok()) {
+      return s;
+    }
     if (info->is_dirty) {
       std::lock_guard<decltype(mu_)> guard(mu_);
       TryMarkDirtyInLock_();
       UpdateAppliedLSN_(info->lsn);
     }
+    return Status::Ok();
   }
 
   /**
@@ -200,6 +212,189 @@ public:
                                  std::move(new_internal_rows));
   }
 
+  /**
+   * @brief
+   * Turn page into internal page with rows, the leaf page is kept since it
+   * owns the lock table of btree.
+   * Only modified by SMO, which is serialized by TryLockSmo of root page.
+   * @param rows
+   */
+  void InitInternal(std::vector<InternalRow> rows) noexcept {
+    if (internal_page_ == nullptr) {
+      internal_page_ = std::make_unique<InternalPage>();
+    }
+    internal_page_->Overwrite(std::move(rows));
+    // internal_page_ is published by page type.
+    ModifyPageType(PageType::InternalPage);
+  }
+
+  /**
+   * @brief
+   * Replace adjacent children with new_internal_rows.
+   * @param opts
+   * @param old_page_ids
+   * @param new_internal_rows
+   * @return Status
+   */
+  Status ReplaceChildren(const Options &opts,
+                         const std::vector<PageIdView> &old_page_ids,
+                         std::vector<InternalRow> new_internal_rows) noexcept {
+    assert(internal_page_);
+    return internal_page_->ReplaceChildren(opts, old_page_ids,
+                                           std::move(new_internal_rows));
+  }
+
+  std::shared_ptr<const InternalRows> GetInternalRows() const noexcept {
+    assert(internal_page_);
+    return internal_page_->GetRows();
+  }
+
+  /**
+   * @brief
+   * Interfaces for packed page type
+   */
+
+  PackedPage *GetPackedPage() const noexcept {
+    assert(packed_page_);
+    return packed_page_.get();
+  }
+
+  /**
+   * @brief
+   * Interfaces for SMO
+   */
+
+  /**
+   * @brief
+   * SMOs of a btree are serialized by the mutex of root page.
+   * @return std::unique_lock<bthread::Mutex> owns the lock if succeed.
+   */
+  std::unique_lock<bthread::Mutex> TryLockSmo() noexcept {
+    return std::unique_lock<bthread::Mutex>(smo_mu_, std::try_to_lock);
+  }
+
+  /**
+   * @brief
+   * Version of root page, which is bumped after SMO publishes new pages and
+   * before old pages are retired. readers validate the pages they have routed
+   * through against it like a seqlock.
+   * @return uint64_t
+   */
+  uint64_t GetSmoVersion() const noexcept {
+    return smo_version_.load(std::memory_order_acquire);
+  }
+
+  void BumpSmoVersion() noexcept {
+    smo_version_.fetch_add(1, std::memory_order_acq_rel);
+  }
+
+  /**
+   * @brief
+   * Freeze the leaf page, see VersionedBwTreePage::Freeze.
+   * Internal pages are only modified by SMO, so the image is taken directly.
+   * @param image
+   */
+  void Freeze(std::string *image) noexcept {
+    if (GetPageType() == PageType::InternalPage) {
+      *image = internal_page_->GetRows()->Serialize(log_store::kInvalidLsn);
+      return;
+    }
+    leaf_page_->Freeze(image);
+  }
+
+  /**
+   * @brief
+   * Total charge of leaf page when it failed to split, i.e. it holds a
+   * single sort key. only accessed by SMO.
+   */
+  size_t GetFailedSplitCharge() const noexcept { return failed_split_charge_; }
+
+  void SetFailedSplitCharge(size_t charge) noexcept {
+    failed_split_charge_ = charge;
+  }
+
+  void Unfreeze() noexcept {
+    assert(leaf_page_);
+    leaf_page_->Unfreeze();
+  }
+
+  bool IsFrozen() const noexcept {
+    assert(leaf_page_);
+    return leaf_page_->IsFrozen();
+  }
+
+  /**
+   * @brief
+   * Drop rows of the frozen leaf page once it's replaced by SMO.
+   */
+  void Truncate() noexcept {
+    assert(leaf_page_);
+    leaf_page_->Truncate();
+  }
+
+  bool IsTruncated() const noexcept {
+    assert(leaf_page_);
+    return leaf_page_->IsTruncated();
+  }
+
+  /**
+   * @brief
+   * Mark page as dirty after being written by SMO.
+   * @param lsn
+   */
+  void MarkDirty(log_store::LsnType lsn) noexcept {
+    std::lock_guard<decltype(mu_)> guard(mu_);
+    TryMarkDirtyInLock_();
+    UpdateAppliedLSN_(lsn);
+  }
+
+  /**
+   * @brief
+   * Mark page as retired after it's unlinked by SMO, retired page is never
+   * flushed again.
+   */
+  void Retire() noexcept {
+    std::lock_guard<decltype(mu_)> guard(mu_);
+    page_state_ = PageState::kRetired;
+  }
+
+  bool IsRetired() noexcept {
+    std::lock_guard<decltype(mu_)> guard(mu_);
+    return page_state_ == PageState::kRetired ||
+           page_state_ == PageState::kDeleted;
+  }
+
+  /**
+   * @brief
+   * Mark retired page as deleted from page store. writes of deleted page are
+   * persisted by the pages written by SMO.
+   */
+  void MarkDeleted() noexcept {
+    std::lock_guard<decltype(mu_)> guard(mu_);
+    page_state_ = PageState::kDeleted;
+    flushed_version_ = write_version_;
+  }
+
+  bool IsDeleted() noexcept {
+    std::lock_guard<decltype(mu_)> guard(mu_);
+    return page_state_ == PageState::kDeleted;
+  }
+
+  uint64_t GetWriteVersion() noexcept {
+    std::lock_guard<decltype(mu_)> guard(mu_);
+    return write_version_;
+  }
+
+  /**
+   * @brief
+   * Whether writes up to version have been flushed.
+   * @param version write version returned by GetWriteVersion.
+   */
+  bool IsFlushed(uint64_t version) noexcept {
+    std::lock_guard<decltype(mu_)> guard(mu_);
+    return flushed_version_ >= version;
+  }
+
   common::LockTable &GetLockTable() noexcept {
     assert(leaf_page_);
     return leaf_page_->GetLockTable();
@@ -211,24 +406,72 @@ public:
    * @return std::unique_ptr<PageSnapshot>
    */
   std::unique_ptr<PageSnapshot> GetPageSnapshot() noexcept {
+    auto page_type = GetPageType();
+    if (page_type == PageType::InternalPage ||
+        page_type == PageType::PackedPage) {
+      log_store::LsnType lsn;
+      {
+        std::lock_guard<decltype(mu_)> guard(mu_);
+        lsn = applied_lsn_;
+      }
+      bool is_delta = false;
+      auto bytes = page_type == PageType::InternalPage
+                       ? internal_page_->GetRows()->Serialize(lsn)
+                       : packed_page_->Serialize(lsn, &is_delta);
+      return std::make_unique<VersionedBwTreePageSnapshot>(std::move(bytes),
+                                                           lsn, is_delta);
+    }
     assert(leaf_page_);
     return leaf_page_->GetPageSnapshot();
   }
 
   /**
    * @brief
-   * Update flushed lsn.
+   * Called before taking the snapshot to flush.
+   * @return uint64_t write version that will be covered by the snapshot.
+   */
+  uint64_t BeginFlush() noexcept {
+    std::lock_guard<decltype(mu_)> guard(mu_);
+    return write_version_;
+  }
+
+  /**
+   * @brief
+   * Update flushed lsn. page becomes clean once all writes are flushed.
    * @param s Flush status
    * @param lsn flushed lsn
+   * @param version write version returned by BeginFlush.
    * @return true when page still need to flush.
    * @return false when page doesn't need to flush.
    */
-  bool FinishFlush(const Status &s, log_store::LsnType lsn) noexcept {
+  bool FinishFlush(const Status &s, log_store::LsnType lsn,
+                   uint64_t version) noexcept {
     std::lock_guard<decltype(mu_)> guard(mu_);
     if (s.ok()) {
       flushed_lsn_ = std::max(lsn, flushed_lsn_);
+      flushed_version_ = std::max(version, flushed_version_);
+    } else if (packed_page_) {
+      packed_page_->OnFlushFailed();
+    }
+    if (NeedFlush_()) {
+      return true;
     }
-    return NeedFlush_();
+    if (page_state_ == PageState::kInFlusher) {
+      page_state_ = PageState::kUnDirty;
+    }
+    return false;
+  }
+
+  /**
+   * @brief
+   * Whether page could be dropped from buffer pool, i.e. all writes have
+   * been flushed or page is retired.
+   */
+  bool IsEvictable() noexcept {
+    std::lock_guard<decltype(mu_)> guard(mu_);
+    return page_state_ == PageState::kRetired ||
+           page_state_ == PageState::kDeleted ||
+           (page_state_ == PageState::kUnDirty && !NeedFlush_());
   }
 
   /**
@@ -238,20 +481,51 @@ public:
    * @return Status
    */
   Status Deserialize(std::string_view data) noexcept {
+    if (InternalRows::IsInternalImage(data)) {
+      std::vector<InternalRow> rows;
+      log_store::LsnType lsn;
+      auto s = InternalRows::Deserialize(data, &rows, &lsn);
+      if (!s.ok()) {
+        return s;
+      }
+      InitInternal(std::move(rows));
+      return Status::Ok();
+    }
+    if (PackedPage::IsPackedImage(data)) {
+      assert(packed_page_);
+      return packed_page_->Deserialize(data);
+    }
     assert(leaf_page_);
     return leaf_page_->Deserialize(data);
   }
 
   size_t GetTotalCharge() noexcept {
+    if (GetPageType() == PageType::PackedPage) {
+      return packed_page_->GetTotalCharge();
+    }
+    if (GetPageType() == PageType::InternalPage) {
+      return sizeof(VersionedBtreePage) +
+             internal_page_->GetRows()->GetTotalCharge();
+    }
     assert(leaf_page_);
     return leaf_page_->GetTotalCharge();
   }
 
-  void RangeFilter(const Options &opts, const Filter &filter,
-                   const BtreeScanOpts &scan_opts,
-                   RangeScanRowView *views) const noexcept {
+  Status RangeFilter(const Options &opts, const Filter &filter,
+                     TxnTs read_ts, const BtreeScanOpts &scan_opts,
+                     RangeScanRowView *views) const noexcept {
+    assert(leaf_page_);
+    return leaf_page_->RangeFilter(opts, filter, read_ts, scan_opts, views);
+  }
+
+  std::shared_ptr<VersionedDeltaNode> GetChain() const noexcept {
+    assert(leaf_page_);
+    return leaf_page_->GetChain();
+  }
+
+  const VersionedBwTreePage *GetLeafPage() const noexcept {
     assert(leaf_page_);
-    return leaf_page_->RangeFilter(opts, filter, scan_opts, views);
+    return leaf_page_.get();
   }
 
   RowIterator GetRowIterator() const noexcept {
@@ -259,6 +533,27 @@ public:
     return leaf_page_->GetRowIterator();
   }
 
+  ScanCursor GetScanCursor(const Options &opts, const Filter &filter,
+                           TxnTs read_ts) const noexcept {
+    assert(leaf_page_);
+    return leaf_page_->GetScanCursor(opts, filter, read_ts);
+  }
+
+  bool TryMarkCompactionScheduled() noexcept {
+    assert(leaf_page_);
+    return leaf_page_->TryMarkCompactionScheduled();
+  }
+
+  /**
+   * @brief
+   * Compact the delta chain in background.
+   * @return true if compaction has been performed.
+   */
+  bool BackgroundCompaction() noexcept {
+    assert(leaf_page_);
+    return leaf_page_->BackgroundCompaction();
+  }
+
   /**
    * @brief
    * Test code below
@@ -288,10 +583,15 @@ private:
     kUnDirty,
     kDirty,
     kInFlusher,
+    // unlinked by SMO
+    kRetired,
+    // retired and deleted from page store
+    kDeleted,
   };
 
   // require guarded by mu
   void TryMarkDirtyInLock_() noexcept {
+    write_version_ += 1;
     if (page_state_ == PageState::kUnDirty) {
       page_state_ = PageState::kDirty;
     }
@@ -303,18 +603,30 @@ private:
   }
 
   // require guarded by mu
-  bool NeedFlush_() noexcept { return applied_lsn_ > flushed_lsn_; }
+  // write version is checked as well since lsn is absent without wal.
+  bool NeedFlush_() noexcept {
+    return applied_lsn_ > flushed_lsn_ || write_version_ > flushed_version_;
+  }
 
   // TODO(sheep): introduce Page interface
   // for different page type
   std::unique_ptr<VersionedBwTreePage> leaf_page_;
   std::unique_ptr<InternalPage> internal_page_;
+  std::unique_ptr<PackedPage> packed_page_;
   std::atomic<PageType> page_type_;
 
   bthread::Mutex mu_;
+  // only used by root page.
+  bthread::Mutex smo_mu_;
+  std::atomic<uint64_t> smo_version_{0};
+  // only used by leaf page, guarded by smo_mu_ of root page.
+  size_t failed_split_charge_{0};
   PageState page_state_{PageState::kUnDirty};              // guarded by mu_
   log_store::LsnType flushed_lsn_{log_store::kInvalidLsn}; // guarded by mu_
   log_store::LsnType applied_lsn_{log_store::kInvalidLsn}; // guarded by mu_
+  // bumped by every write.
+  uint64_t write_version_{0};   // guarded by mu_
+  uint64_t flushed_version_{0}; // guarded by mu_
 };
 
 } // namespace btree
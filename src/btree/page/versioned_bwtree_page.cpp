@@ -10,15 +10,20 @@
  */
 
 #include "btree/page/versioned_bwtree_page.h"
+#include "absl/container/flat_hash_set.h"
 #include "bthread/bthread.h"
 #include "btree/page/page_snapshot.h"
 #include "btree/page/versioned_delta_node.h"
+#include "butil/fast_rand.h"
 #include "butil/object_pool.h"
 #include "bwtree_page.h"
 #include "common/config.h"
+#include "txn/low_watermark.h"
 #include "util/monitor.h"
 #include "wal/bwtree_log_writer.h"
+#include <algorithm>
 #include <cmath>
+#include <cstring>
 #include <optional>
 
 namespace arcanedb {
@@ -26,11 +31,12 @@ namespace btree {
 
 std::shared_ptr<VersionedDeltaNode>
 VersionedBwTreePage::Compaction_(VersionedDeltaNode *current_ptr,
-                                 bool force_compaction) noexcept {
-  // write_mu_.AssertHeld();
+                                 bool force_compaction,
+                                 size_t *rewritten_rows) const noexcept {
   auto current = current_ptr->GetPrevious();
   VersionedDeltaNodeBuilder builder;
   builder.AddDeltaNode(current_ptr);
+  *rewritten_rows = current_ptr->GetSize();
   // simple stragty
   // TODO(sheep): optimize compaction stragty
   // currently write amplification is too much.
@@ -40,114 +46,475 @@ VersionedBwTreePage::Compaction_(VersionedDeltaNode *current_ptr,
               current->GetSize() ||
           force_compaction)) {
     builder.AddDeltaNode(current.get());
+    *rewritten_rows += current->GetSize();
     current = current->GetPrevious();
   }
+  // tombstones could only be dropped when there is no older delta.
+  builder.SetLowWatermark(
+      txn::LowWatermark::GetInstance()->GetCachedLowWatermark(),
+      current == nullptr);
   auto new_node = builder.GenerateDeltaNode();
   new_node->SetPrevious(current);
   return new_node;
 }
 
-void VersionedBwTreePage::MaybePerformCompaction_(
+void VersionedBwTreePage::RecordCompaction_(size_t rewritten_rows) noexcept {
+  // write_mu_.AssertHeld();
+  // rows rewritten by compaction for each row written by user, in
+  // percentage, so that amplification below 1 isn't truncated.
+  util::Monitor::GetInstance()->RecordBwTreeWriteAmplificationLatency(
+      rewritten_rows * 100 / std::max<size_t>(rows_since_compaction_, 1));
+  rows_since_compaction_ = 0;
+}
+
+bool VersionedBwTreePage::MaybePerformCompaction_(
     const Options &opts, VersionedDeltaNode *current_ptr) noexcept {
   // write_mu_.AssertHeld();
   auto total_size = current_ptr->GetTotalLength();
-  if ((!opts.disable_compaction &&
-       total_size > common::Config::kBwTreeDeltaChainLength) ||
-      opts.force_compaction) {
-    auto new_ptr = Compaction_(current_ptr, opts.force_compaction);
-    UpdatePtr_(new_ptr);
+  if ((opts.disable_compaction || total_size <= compaction_threshold_) &&
+      !opts.force_compaction) {
+    return false;
+  }
+  // leave it to background compaction, unless background compaction couldn't
+  // keep up with writers.
+  if (opts.buffer_pool != nullptr && !opts.force_compaction &&
+      total_size <= common::Config::kBwTreeHardDeltaChainLength) {
+    return true;
+  }
+  size_t rewritten_rows = 0;
+  auto new_ptr =
+      Compaction_(current_ptr, opts.force_compaction, &rewritten_rows);
+  UpdatePtr_(new_ptr);
+  ResetCharge_();
+  RecordCompaction_(rewritten_rows);
+  return false;
+}
+
+bool VersionedBwTreePage::BackgroundCompaction() noexcept {
+  // writers could schedule the next compaction from now on.
+  compaction_scheduled_.store(false, std::memory_order_release);
+  std::shared_ptr<VersionedDeltaNode> snapshot;
+  {
+    ArcanedbLockGuard<ArcanedbLock> guard(write_mu_);
+    if (ptr_ == nullptr || compacting_head_ != nullptr ||
+        ptr_->GetTotalLength() <= compaction_threshold_) {
+      return false;
+    }
+    snapshot = ptr_;
+    compacting_head_ = snapshot.get();
+  }
+
+  // merge without holding write_mu_
+  size_t rewritten_rows = 0;
+  auto new_base = Compaction_(snapshot.get(), false, &rewritten_rows);
+
+  ArcanedbLockGuard<ArcanedbLock> guard(write_mu_);
+  auto pending_set_ts = std::move(pending_set_ts_);
+  pending_set_ts_.clear();
+  compacting_head_ = nullptr;
+
+  // collect deltas prepended during the merge
+  std::vector<VersionedDeltaNode *> newer_deltas;
+  auto current_ptr = ptr_.get();
+  while (current_ptr != nullptr && current_ptr != snapshot.get()) {
+    newer_deltas.push_back(current_ptr);
+    current_ptr = current_ptr->GetPreviousPtr();
+  }
+  if (current_ptr == nullptr) {
+    // snapshot has already been compacted by writers.
+    return false;
+  }
+
+  for (const auto &set_ts : pending_set_ts) {
+    new_base->ReplaySetTs(property::SortKeysRef(set_ts.sort_key),
+                          set_ts.target_ts, set_ts.lsn, set_ts.owner_ts);
+  }
+  auto new_head = new_base;
+  if (!newer_deltas.empty()) {
+    VersionedDeltaNodeBuilder builder;
+    for (auto *delta : newer_deltas) {
+      builder.AddDeltaNode(delta);
+    }
+    new_head = builder.GenerateDeltaNode();
+    new_head->SetPrevious(new_base);
+  }
+  UpdatePtr_(std::move(new_head));
+  ResetCharge_();
+  RecordCompaction_(rewritten_rows);
+  return true;
+}
+
+void VersionedBwTreePage::ResetCharge_() noexcept {
+  // write_mu_.AssertHeld();
+  size_t charge = sizeof(VersionedBwTreePage);
+  for (auto *current = ptr_.get(); current != nullptr;
+       current = current->GetPreviousPtr()) {
+    charge += current->GetTotalCharge();
   }
+  total_charge_.store(charge, std::memory_order_relaxed);
 }
 
-void AppendLogAndSetLsn_(log_store::LogStore *log_store, WriteInfo *info,
-                         const wal::BwTreeLogWriter &log_writer) noexcept {
-  log_store::LogStore::LogResultContainer result;
-  log_store->AppendLogRecord(log_writer.GetLogRecords(), &result);
-  info->lsn = result[0].end_lsn;
+void VersionedBwTreePage::SampleRead_(size_t traversed_length,
+                                      size_t skipped_length) const noexcept {
+  if (butil::fast_rand_less_than(common::Config::kBwTreeReadSampleRate) != 0) {
+    return;
+  }
+  sampled_read_cnt_.fetch_add(1, std::memory_order_relaxed);
+  sampled_traversed_length_.fetch_add(traversed_length,
+                                      std::memory_order_relaxed);
+  util::Monitor::GetInstance()->RecordBwTreeReadAmplificationLatency(
+      traversed_length);
+  // percentage of delta nodes skipped by key filters.
+  util::Monitor::GetInstance()->RecordBwTreeDeltaSkipRateLatency(
+      skipped_length * 100 /
+      std::max<size_t>(traversed_length + skipped_length, 1));
+}
+
+void VersionedBwTreePage::MaybeAdjustCompactionThreshold_(
+    size_t write_cnt) noexcept {
+  // write_mu_.AssertHeld();
+  write_cnt_ += write_cnt;
+  rows_since_compaction_ += write_cnt;
+  size_t read_cnt = sampled_read_cnt_.load(std::memory_order_relaxed) *
+                    common::Config::kBwTreeReadSampleRate;
+  if (write_cnt_ + read_cnt < common::Config::kBwTreeAdaptiveWindow) {
+    return;
+  }
+  // read cost is measured by the delta nodes readers actually traversed,
+  // reads that are satisfied by the newest deltas won't benefit from
+  // compaction.
+  sampled_read_cnt_.store(0, std::memory_order_relaxed);
+  size_t read_cost =
+      sampled_traversed_length_.exchange(0, std::memory_order_relaxed) *
+      common::Config::kBwTreeReadSampleRate;
+  double write_ratio = static_cast<double>(write_cnt_) /
+                       static_cast<double>(write_cnt_ + read_cost);
+  compaction_threshold_ =
+      common::Config::kBwTreeMinDeltaChainLength +
+      static_cast<size_t>((common::Config::kBwTreeMaxDeltaChainLength -
+                           common::Config::kBwTreeMinDeltaChainLength) *
+                          write_ratio);
+  write_cnt_ = 0;
+  util::Monitor::GetInstance()->RecordBwTreeCompactionThresholdLatency(
+      compaction_threshold_);
 }
 
 Status VersionedBwTreePage::SetRow(const property::Row &row, TxnTs write_ts,
                                    const Options &opts,
                                    WriteInfo *info) noexcept {
+  WriteRequest request;
+  request.type = WriteRequest::Type::kSetRow;
+  request.sort_key = row.GetSortKeys();
+  request.write_ts = write_ts;
+  request.opts = &opts;
+  request.info = info;
   // make delta
-  auto delta = std::make_shared<VersionedDeltaNode>(row, write_ts);
-
+  request.delta = VersionedDeltaNode::New(row, write_ts);
   // write log
-  wal::BwTreeLogWriter log_writer;
   if (opts.log_store != nullptr) {
-    log_writer.SetRow(page_id_, opts.txn_id, write_ts, row);
+    request.log_writer.SetRow(page_id_, opts.txn_id, write_ts, row);
   }
+  return Write_(&request);
+}
 
-  ArcanedbLockGuard<ArcanedbLock> guard(write_mu_);
-  // check intent locked
-  if (opts.check_intent_locked && CheckRowLocked_(row.GetSortKeys(), opts)) {
-    return Status::TxnConflict();
+Status VersionedBwTreePage::DeleteRow(property::SortKeysRef sort_key,
+                                      TxnTs write_ts, const Options &opts,
+                                      WriteInfo *info) noexcept {
+  WriteRequest request;
+  request.type = WriteRequest::Type::kDeleteRow;
+  request.sort_key = sort_key;
+  request.write_ts = write_ts;
+  request.opts = &opts;
+  request.info = info;
+  // make delta
+  request.delta = VersionedDeltaNode::New(sort_key, write_ts);
+  // write log
+  if (opts.log_store != nullptr) {
+    request.log_writer.DeleteRow(page_id_, opts.txn_id, write_ts, sort_key);
   }
+  return Write_(&request);
+}
 
-  // append log
+Status VersionedBwTreePage::SetTs(property::SortKeysRef sort_key,
+                                  TxnTs target_ts, const Options &opts,
+                                  WriteInfo *info) noexcept {
+  WriteRequest request;
+  request.type = WriteRequest::Type::kSetTs;
+  request.sort_key = sort_key;
+  request.write_ts = target_ts;
+  request.opts = &opts;
+  request.info = info;
+  // write log
   if (opts.log_store != nullptr) {
-    AppendLogAndSetLsn_(opts.log_store, info, log_writer);
-    delta->SetLSN(info->lsn);
+    request.log_writer.SetTs(page_id_, opts.txn_id, target_ts, sort_key);
   }
-  info->is_dirty = true;
-  total_charge_ += delta->GetTotalCharge();
+  auto s = Write_(&request);
+  DCHECK(s.ok() || s.IsRetry());
+  return s;
+}
 
-  // prepend delta
-  auto current_ptr = GetPtr_();
-  delta->SetPrevious(std::move(current_ptr));
-  UpdatePtr_(delta);
+Status VersionedBwTreePage::Write_(WriteRequest *request) noexcept {
+  std::unique_lock<bthread::Mutex> lock(queue_mu_);
+  if (queue_tail_ == nullptr) {
+    queue_head_ = request;
+  } else {
+    queue_tail_->next = request;
+  }
+  queue_tail_ = request;
+  while (!request->done && request != queue_head_) {
+    request->cv.wait(lock);
+  }
+  if (request->done) {
+    // committed by other leader.
+    return request->status;
+  }
 
-  // perform compaction
-  MaybePerformCompaction_(opts, delta.get());
-  return Status::Ok();
+  // we are the leader now
+  std::vector<WriteRequest *> batch;
+  BuildBatch_(&batch);
+  lock.unlock();
+
+  {
+    ArcanedbLockGuard<ArcanedbLock> guard(write_mu_);
+    ApplyBatch_(batch);
+  }
+
+  lock.lock();
+  for (auto *committed : batch) {
+    DCHECK(committed == queue_head_);
+    // request is released by its writer once it's done.
+    queue_head_ = committed->next;
+    if (queue_head_ == nullptr) {
+      queue_tail_ = nullptr;
+    }
+    if (committed != request) {
+      committed->done = true;
+      committed->cv.notify_one();
+    }
+  }
+  // wake up the next leader
+  if (queue_head_ != nullptr) {
+    queue_head_->cv.notify_one();
+  }
+  return request->status;
 }
 
-Status VersionedBwTreePage::DeleteRow(property::SortKeysRef sort_key,
-                                      TxnTs write_ts, const Options &opts,
-                                      WriteInfo *info) noexcept {
-  // make delta
-  auto delta = std::make_shared<VersionedDeltaNode>(sort_key, write_ts);
+void VersionedBwTreePage::BuildBatch_(
+    std::vector<WriteRequest *> *batch) const noexcept {
+  const auto *leader = queue_head_;
+  absl::flat_hash_set<std::string_view> sort_keys;
+  for (auto *request = queue_head_; request != nullptr;
+       request = request->next) {
+    if (batch->size() >= common::Config::kBwTreeGroupCommitMaxBatchSize) {
+      break;
+    }
+    // writes within a group must share the same log store and compaction
+    // options.
+    if (request->opts->log_store != leader->opts->log_store ||
+        request->opts->disable_compaction !=
+            leader->opts->disable_compaction ||
+        request->opts->force_compaction != leader->opts->force_compaction) {
+      break;
+    }
+    // writes on the same row must be applied in order, so that intent check
+    // and SetTs could observe the previous write.
+    if (!sort_keys.insert(request->sort_key.as_slice()).second) {
+      break;
+    }
+    batch->push_back(request);
+  }
+}
 
-  // write log
-  wal::BwTreeLogWriter log_writer;
+void VersionedBwTreePage::ApplyBatch_(
+    const std::vector<WriteRequest *> &batch) noexcept {
+  // write_mu_.AssertHeld();
+  const auto &opts = *batch.front()->opts;
+  if (frozen_.load(std::memory_order_relaxed)) {
+    // page has been replaced by SMO, writers should retry on the new pages.
+    for (auto *request : batch) {
+      request->status = Status::Retry();
+    }
+    return;
+  }
+  std::vector<WriteRequest *> accepted;
+  accepted.reserve(batch.size());
+  log_store::LogStore::LogRecordContainer log_records;
+  for (auto *request : batch) {
+    // check intent locked
+    if (request->type != WriteRequest::Type::kSetTs &&
+        request->opts->check_intent_locked &&
+        CheckRowLocked_(request->sort_key, *request->opts)) {
+      request->status = Status::TxnConflict();
+      continue;
+    }
+    request->status = Status::Ok();
+    accepted.push_back(request);
+    if (opts.log_store != nullptr) {
+      const auto &records = request->log_writer.GetLogRecords();
+      log_records.insert(log_records.end(), records.begin(), records.end());
+    }
+  }
+  if (accepted.empty()) {
+    return;
+  }
+
+  // append log for the whole group
   if (opts.log_store != nullptr) {
-    log_writer.DeleteRow(page_id_, opts.txn_id, write_ts, sort_key);
+    log_store::LogStore::LogResultContainer result;
+    opts.log_store->AppendLogRecord(log_records, &result);
+    DCHECK(result.size() == accepted.size());
+    for (size_t i = 0; i < accepted.size(); i++) {
+      accepted[i]->info->lsn = result[i].end_lsn;
+    }
   }
 
-  ArcanedbLockGuard<ArcanedbLock> guard(write_mu_);
-  // check intent locked
-  if (opts.check_intent_locked && CheckRowLocked_(sort_key, opts)) {
-    return Status::TxnConflict();
+  std::shared_ptr<VersionedDeltaNode> delta;
+  VersionedDeltaNodeBuilder builder;
+  log_store::LsnType delta_lsn{};
+  bool has_set_ts = false;
+  std::vector<TxnTs> written_back;
+  for (auto *request : accepted) {
+    request->info->is_dirty = true;
+    request->info->wait_hash = GetWaitHash_();
+    if (request->type == WriteRequest::Type::kSetTs) {
+      ApplySetTs_(request->sort_key, request->write_ts,
+                  request->opts->owner_ts, request->info->lsn);
+      has_set_ts = true;
+      continue;
+    }
+    if (request->opts->owner_ts.has_value()) {
+      // locks of committed txn are released before its intents are written
+      // back.
+      WriteBackIntent_(request->sort_key, &written_back);
+    }
+    delta_lsn = std::max(delta_lsn, request->info->lsn);
+    if (delta == nullptr) {
+      delta = request->delta;
+      continue;
+    }
+    // merge the deltas of the group into one.
+    if (builder.GetDeltaCount() == 0) {
+      builder.AddDeltaNode(delta.get());
+    }
+    builder.AddDeltaNode(request->delta.get());
+  }
+  if (builder.GetDeltaCount() != 0) {
+    delta = builder.GenerateDeltaNode();
+  }
+  for (auto owner_ts : written_back) {
+    txn::TxnStatusTable::GetInstance()->WriteBack(owner_ts);
   }
 
-  // append log
+  if (delta == nullptr) {
+    DCHECK(has_set_ts);
+    // need to perform dummy update,
+    // so that readers afterward will see our update.
+    DummyUpdate_();
+    // wake readers blocked by the intents we just resolved.
+    util::WaitTable::GetInstance()->NotifyAll(GetWaitHash_());
+    return;
+  }
   if (opts.log_store != nullptr) {
-    AppendLogAndSetLsn_(opts.log_store, info, log_writer);
-    delta->SetLSN(info->lsn);
+    delta->SetLSN(delta_lsn);
   }
-  info->is_dirty = true;
   total_charge_ += delta->GetTotalCharge();
 
   // prepend delta
-  auto current_ptr = GetPtr_();
-  delta->SetPrevious(std::move(current_ptr));
+  delta->SetPrevious(ptr_);
   UpdatePtr_(delta);
+  if (has_set_ts) {
+    util::WaitTable::GetInstance()->NotifyAll(GetWaitHash_());
+  }
 
-  // compaction
-  MaybePerformCompaction_(opts, delta.get());
-  return Status::Ok();
+  // perform compaction
+  MaybeAdjustCompactionThreshold_(accepted.size());
+  if (MaybePerformCompaction_(opts, delta.get())) {
+    for (auto *request : accepted) {
+      request->info->need_compaction = true;
+    }
+  }
+}
+
+void VersionedBwTreePage::ApplySetTs_(property::SortKeysRef sort_key,
+                                      TxnTs target_ts,
+                                      std::optional<TxnTs> owner_ts,
+                                      log_store::LsnType lsn) noexcept {
+  // write_mu_.AssertHeld();
+  auto current_ptr = ptr_.get();
+  bool in_compaction = false;
+  while (current_ptr != nullptr) {
+    in_compaction = in_compaction || current_ptr == compacting_head_;
+    auto s = current_ptr->SetTs(sort_key, target_ts, lsn, owner_ts);
+    if (likely(s.ok())) {
+      if (unlikely(in_compaction)) {
+        // background compaction might have missed this update.
+        pending_set_ts_.emplace_back(
+            PendingSetTs{.sort_key = std::string(sort_key.as_slice()),
+                         .target_ts = target_ts,
+                         .owner_ts = owner_ts,
+                         .lsn = lsn});
+      }
+      return;
+    }
+    DCHECK(s.IsNotFound());
+    current_ptr = current_ptr->GetPreviousPtr();
+  }
+  UNREACHABLE();
+}
+
+void VersionedBwTreePage::WriteBackIntent_(property::SortKeysRef sort_key,
+                                           std::vector<TxnTs> *owners) noexcept {
+  // write_mu_.AssertHeld();
+  auto current_ptr = ptr_.get();
+  while (current_ptr != nullptr) {
+    TxnTs write_ts;
+    if (!current_ptr->MayContain(sort_key) ||
+        !current_ptr->GetNewestTs(sort_key, &write_ts)) {
+      current_ptr = current_ptr->GetPreviousPtr();
+      continue;
+    }
+    auto commit_ts = txn::TxnStatusTable::GetInstance()->Resolve(write_ts);
+    if (commit_ts != write_ts) {
+      ApplySetTs_(sort_key, commit_ts, GetTs(write_ts),
+                  log_store::kInvalidLsn);
+      owners->push_back(GetTs(write_ts));
+    }
+    return;
+  }
+}
+
+bool VersionedBwTreePage::WriteBackIntents() noexcept {
+  std::vector<TxnTs> owners;
+  {
+    ArcanedbLockGuard<ArcanedbLock> guard(write_mu_);
+    // chain of frozen page has been copied to the new pages as is.
+    if (frozen_.load(std::memory_order_relaxed)) {
+      return false;
+    }
+    auto current_ptr = ptr_.get();
+    while (current_ptr != nullptr && current_ptr != compacting_head_) {
+      current_ptr->WriteBackIntents(&owners);
+      current_ptr = current_ptr->GetPreviousPtr();
+    }
+  }
+  for (auto owner_ts : owners) {
+    txn::TxnStatusTable::GetInstance()->WriteBack(owner_ts);
+  }
+  return !owners.empty();
 }
 
 Status VersionedBwTreePage::GetRow(property::SortKeysRef sort_key,
                                    TxnTs read_ts, const Options &opts,
                                    RowView *view) const noexcept {
   while (true) {
+    auto token = PrepareWaitIntent_();
     auto s = GetRowOnce_(sort_key, read_ts, opts, view);
-    if (!s.IsRetry()) {
+    if (!s.IsRetry() || IsTruncated()) {
+      // intent of a frozen page is resolved on the new pages, which become
+      // reachable once it's truncated.
       return s;
     }
-    // sleep 20 microseconds
-    bthread_usleep(20);
+    WaitIntent_(token);
   }
   UNREACHABLE();
 }
@@ -155,76 +522,57 @@ Status VersionedBwTreePage::GetRow(property::SortKeysRef sort_key,
 Status VersionedBwTreePage::GetRowOnce_(property::SortKeysRef sort_key,
                                         TxnTs read_ts, const Options &opts,
                                         RowView *view) const noexcept {
-  auto shared_ptr = GetPtr_();
-  auto current_ptr = shared_ptr.get();
+  util::EpochManager::Guard guard;
+  auto current_ptr = GetRawPtr_();
+  auto s = Status::NotFound();
+  size_t traversed_length = 0;
+  size_t skipped_length = 0;
   // traverse the delta node
   while (current_ptr != nullptr) {
-    auto s = current_ptr->GetRow(sort_key, read_ts, opts, view);
-    if (s.ok()) {
-      return Status::Ok();
-    } else if (s.IsDeleted()) {
-      return Status::NotFound();
-    } else if (s.IsRowLocked()) {
-      return Status::Retry();
+    if (!current_ptr->MayContain(sort_key)) {
+      skipped_length += 1;
+      current_ptr = current_ptr->GetPreviousPtr();
+      continue;
     }
-    current_ptr = current_ptr->GetPrevious().get();
+    // skipped nodes cost nothing but a filter probe, so only visited nodes
+    // count towards read amplification.
+    traversed_length += 1;
+    auto res = current_ptr->GetRow(sort_key, read_ts, opts, view);
+    if (res.ok()) {
+      s = Status::Ok();
+      break;
+    } else if (res.IsDeleted()) {
+      break;
+    } else if (res.IsRowLocked()) {
+      s = Status::Retry();
+      break;
+    }
+    current_ptr = current_ptr->GetPreviousPtr();
   }
-  return Status::NotFound();
+  SampleRead_(traversed_length, skipped_length);
+  return s;
 }
 
 bool VersionedBwTreePage::CheckRowLocked_(property::SortKeysRef sort_key,
                                           const Options &opts) const noexcept {
-  RowView view;
-  auto shared_ptr = GetPtr_();
-  auto current_ptr = shared_ptr.get();
-  // read by using max ts.
-  TxnTs read_ts = kMaxTxnTs;
+  // write_mu_ is held, so chain won't be modified.
+  auto current_ptr = ptr_.get();
   // traverse the delta node
   while (current_ptr != nullptr) {
-    auto s = current_ptr->GetRow(sort_key, read_ts, opts, &view);
-    if (s.IsRowLocked()) {
-      return true;
-    } else if (s.IsDeleted() || s.ok()) {
-      return false;
+    TxnTs write_ts;
+    if (!current_ptr->MayContain(sort_key) ||
+        !current_ptr->GetNewestTs(sort_key, &write_ts) ||
+        write_ts == kAbortedTxnTs) {
+      current_ptr = current_ptr->GetPreviousPtr();
+      continue;
     }
-    current_ptr = current_ptr->GetPrevious().get();
+    // intents are not resolved here, inlined locks of committed txn are
+    // held until their intents are finalized.
+    return ShouldWaitIntent_(write_ts, opts);
   }
   return false;
 }
 
-void VersionedBwTreePage::SetTs(property::SortKeysRef sort_key, TxnTs target_ts,
-                                const Options &opts, WriteInfo *info) noexcept {
-  // write log
-  wal::BwTreeLogWriter log_writer;
-  if (opts.log_store != nullptr) {
-    log_writer.SetTs(page_id_, opts.txn_id, target_ts, sort_key);
-  }
-
-  // acquire write lock
-  ArcanedbLockGuard<ArcanedbLock> guard(write_mu_);
-  auto shared_ptr = GetPtr_();
-  auto current_ptr = shared_ptr.get();
-
-  // append log
-  if (opts.log_store != nullptr) {
-    AppendLogAndSetLsn_(opts.log_store, info, log_writer);
-  }
-  info->is_dirty = true;
-
-  while (current_ptr != nullptr) {
-    auto s = current_ptr->SetTs(sort_key, target_ts, info->lsn);
-    if (likely(s.ok())) {
-      // need to perform dummy update,
-      // so that readers afterward will see our update.
-      DummyUpdate_();
-      return;
-    }
-    DCHECK(s.IsNotFound());
-    current_ptr = current_ptr->GetPrevious().get();
-  }
-  UNREACHABLE();
-}
-
 std::string VersionedBwTreePage::TEST_DumpPage() const noexcept {
   struct BuildEntry {
     const property::Row row;
@@ -241,7 +589,7 @@ std::string VersionedBwTreePage::TEST_DumpPage() const noexcept {
           map[row.GetSortKeys()].emplace_back(BuildEntry{
               .row = row, .is_deleted = is_deleted, .write_ts = write_ts});
         });
-    current_ptr = current_ptr->GetPrevious().get();
+    current_ptr = current_ptr->GetPreviousPtr();
   }
   std::string result = "BwTreePageDump:\n";
   for (const auto &[sk, vec] : map) {
@@ -270,7 +618,7 @@ bool VersionedBwTreePage::TEST_TsDesending() const noexcept {
           map[row.GetSortKeys()].emplace_back(BuildEntry{
               .row = row, .is_deleted = is_deleted, .write_ts = write_ts});
         });
-    current_ptr = current_ptr->GetPrevious().get();
+    current_ptr = current_ptr->GetPreviousPtr();
   }
   for (const auto &[sk, vec] : map) {
     std::optional<TxnTs> last_valid_ts{std::nullopt};
@@ -299,50 +647,194 @@ bool VersionedBwTreePage::TEST_Equal(const VersionedBwTreePage &rhs) const
  * | delete bit 1byte | write_ts 4byte | row varlen |
  */
 std::unique_ptr<PageSnapshot> VersionedBwTreePage::GetPageSnapshot() noexcept {
-  struct BuildEntry {
-    const property::Row row;
-    bool is_deleted;
-    TxnTs write_ts;
-  };
-  std::map<property::SortKeysRef, std::vector<BuildEntry>> map;
+  WriteBackIntents();
   auto shared_ptr = GetPtr_();
-  auto current_ptr = shared_ptr.get();
-  // traverse the delta node
-  log_store::LsnType lsn{};
+  log_store::LsnType lsn;
+  auto bytes = SerializeChain_(shared_ptr.get(), &lsn);
+  return std::make_unique<VersionedBwTreePageSnapshot>(std::move(bytes), lsn);
+}
+
+std::string
+VersionedBwTreePage::SerializeChain_(const VersionedDeltaNode *head,
+                                     log_store::LsnType *lsn) noexcept {
+  auto current_ptr = head;
+  VersionedDeltaNodeMerger merger;
   while (current_ptr != nullptr) {
-    constexpr bool should_lock = true;
-    auto tmp_lsn = current_ptr->Traverse(
-        [&](const property::Row &row, bool is_deleted, TxnTs write_ts) {
-          map[row.GetSortKeys()].emplace_back(BuildEntry{
-              .row = row, .is_deleted = is_deleted, .write_ts = write_ts});
-        },
-        should_lock);
-    current_ptr = current_ptr->GetPrevious().get();
-    lsn = std::max(lsn, tmp_lsn);
+    merger.AddDeltaNode(current_ptr);
+    current_ptr = current_ptr->GetPreviousPtr();
   }
 
   util::BufWriter writer;
-  writer.WriteBytes(lsn);
-  auto serialize_row = [](util::BufWriter *writer, const property::Row &row,
-                          bool is_deleted, TxnTs write_ts) {
-    writer->WriteBytes(static_cast<uint8_t>(is_deleted));
-    writer->WriteBytes(write_ts);
-    writer->WriteBytes(row.as_slice());
+  // lsn will be filled after merging.
+  writer.Reserve(sizeof(log_store::LsnType));
+  // snapshot contains the whole delta chain, so tombstones could be dropped.
+  constexpr bool drop_tombstone = true;
+  VersionPruner pruner(
+      txn::LowWatermark::GetInstance()->GetCachedLowWatermark(),
+      drop_tombstone);
+  // only timestamps are modified in place, so node locks are held just for
+  // collecting versions, and row bytes are copied after releasing them.
+  struct VersionRef {
+    property::Row row;
+    bool is_deleted;
+    TxnTs write_ts;
   };
-  for (const auto &[k, vec] : map) {
-    for (const auto &entry : vec) {
-      serialize_row(&writer, entry.row, entry.is_deleted, entry.write_ts);
+  std::vector<VersionRef> versions;
+  constexpr bool should_lock = true;
+  // intents are serialized as is, so that each of them is written back
+  // exactly once, either on this page or on the pages built from the image.
+  constexpr bool resolve_intents = false;
+  *lsn = merger.Merge(
+      [&](const property::Row &row, bool is_deleted, TxnTs write_ts,
+          bool is_newest) {
+        if (pruner.ShouldKeep(is_deleted, write_ts, is_newest)) {
+          versions.push_back({row, is_deleted, write_ts});
+        }
+      },
+      should_lock, resolve_intents);
+  for (const auto &version : versions) {
+    writer.WriteBytes(static_cast<uint8_t>(version.is_deleted));
+    writer.WriteBytes(version.write_ts);
+    writer.WriteBytes(version.row.as_slice());
+  }
+  writer.WriteBytesAtPos(0, *lsn);
+  return writer.Detach();
+}
+
+void VersionedBwTreePage::Freeze(std::string *image) noexcept {
+  {
+    ArcanedbLockGuard<ArcanedbLock> guard(write_mu_);
+    frozen_.store(true, std::memory_order_release);
+    log_store::LsnType lsn;
+    *image = SerializeChain_(ptr_.get(), &lsn);
+  }
+}
+
+void VersionedBwTreePage::Unfreeze() noexcept {
+  ArcanedbLockGuard<ArcanedbLock> guard(write_mu_);
+  frozen_.store(false, std::memory_order_release);
+}
+
+void VersionedBwTreePage::Truncate() noexcept {
+  {
+    ArcanedbLockGuard<ArcanedbLock> guard(write_mu_);
+    DCHECK(IsFrozen());
+    truncated_.store(true, std::memory_order_release);
+    UpdatePtr_(nullptr);
+    ResetCharge_();
+  }
+  // readers waiting for intents should move to the new pages.
+  util::WaitTable::GetInstance()->NotifyAll(GetWaitHash_());
+}
+
+namespace {
+
+/**
+ * @brief
+ * Entries of page image, see GetPageSnapshot for the format.
+ */
+class ImageReader {
+public:
+  explicit ImageReader(std::string_view image) noexcept
+      : image_(image), offset_(sizeof(log_store::LsnType)) {}
+
+  log_store::LsnType GetLSN() const noexcept {
+    log_store::LsnType lsn;
+    memcpy(&lsn, image_.data(), sizeof(lsn));
+    return lsn;
+  }
+
+  bool Valid() const noexcept { return offset_ < image_.size(); }
+
+  size_t Offset() const noexcept { return offset_; }
+
+  property::SortKeysRef GetSortKeys() const noexcept {
+    return GetRow_().GetSortKeys();
+  }
+
+  size_t GetRowSize() const noexcept { return GetRow_().as_slice().size(); }
+
+  std::string_view GetEntry() const noexcept {
+    return image_.substr(offset_,
+                         kEntryHeaderSize + GetRow_().as_slice().size());
+  }
+
+  void Next() noexcept { offset_ += GetEntry().size(); }
+
+private:
+  static constexpr size_t kEntryHeaderSize = sizeof(uint8_t) + sizeof(TxnTs);
+
+  property::Row GetRow_() const noexcept {
+    return property::Row(image_.data() + offset_ + kEntryHeaderSize);
+  }
+
+  std::string_view image_;
+  size_t offset_;
+};
+
+} // namespace
+
+bool VersionedBwTreePage::PickSeparator(std::string_view image,
+                                        std::string *separator) noexcept {
+  ImageReader reader(image);
+  if (!reader.Valid()) {
+    return false;
+  }
+  std::string first_key(reader.GetSortKeys().as_slice());
+  std::string last_key = first_key;
+  for (; reader.Valid(); reader.Next()) {
+    auto sort_key = reader.GetSortKeys().as_slice();
+    if (sort_key == last_key) {
+      // older version of the same key
+      continue;
+    }
+    last_key = sort_key;
+    if (reader.Offset() * 2 >= image.size()) {
+      break;
     }
   }
+  if (last_key == first_key) {
+    return false;
+  }
+  // last distinct key is used if the tail is a single large row.
+  *separator = std::move(last_key);
+  return true;
+}
 
-  return std::make_unique<VersionedBwTreePageSnapshot>(writer.Detach(), lsn);
+std::vector<std::string> VersionedBwTreePage::RepartitionImages(
+    const std::vector<std::string> &images,
+    const std::vector<std::string_view> &bounds) noexcept {
+  DCHECK(!bounds.empty());
+  log_store::LsnType lsn{};
+  for (const auto &image : images) {
+    lsn = std::max(lsn, ImageReader(image).GetLSN());
+  }
+  std::vector<util::BufWriter> writers(bounds.size());
+  for (auto &writer : writers) {
+    writer.WriteBytes(lsn);
+  }
+  size_t idx = 0;
+  for (const auto &image : images) {
+    for (ImageReader reader(image); reader.Valid(); reader.Next()) {
+      auto sort_key = reader.GetSortKeys();
+      while (idx + 1 < bounds.size() &&
+             !(sort_key < property::SortKeysRef(bounds[idx + 1]))) {
+        idx += 1;
+      }
+      writers[idx].WriteBytes(reader.GetEntry());
+    }
+  }
+  std::vector<std::string> result;
+  result.reserve(writers.size());
+  for (auto &writer : writers) {
+    result.push_back(writer.Detach());
+  }
+  return result;
 }
 
 Status VersionedBwTreePage::Deserialize(std::string_view data) noexcept {
-  std::map<property::SortKeysRef,
-           std::vector<VersionedDeltaNodeBuilder::BuildEntry>>
-      map;
-
+  // rows in snapshot are already merged and sorted, so we could build the
+  // delta node with a single pass.
   util::BufReader reader(data);
   log_store::LsnType lsn;
   reader.ReadBytes(&lsn);
@@ -358,66 +850,397 @@ Status VersionedBwTreePage::Deserialize(std::string_view data) noexcept {
         .row = row, .is_deleted = (is_deleted != 0), .write_ts = write_ts};
   };
 
-  util::BufWriter writer;
-  util::BufWriter version_writer;
-  std::vector<VersionedDeltaNode::Entry> rows;
+  // size buffers to their own rows, so that node won't keep the whole
+  // snapshot as capacity.
+  size_t row_bytes = 0;
+  size_t version_bytes = 0;
+  {
+    property::SortKeysRef prev_sk;
+    for (ImageReader image(data); image.Valid(); image.Next()) {
+      auto sort_key = image.GetSortKeys();
+      if (!prev_sk.empty() && sort_key == prev_sk) {
+        version_bytes += image.GetRowSize();
+      } else {
+        row_bytes += image.GetRowSize();
+        prev_sk = sort_key;
+      }
+    }
+  }
+  util::BufWriter writer(row_bytes);
+  util::BufWriter version_writer(version_bytes);
+  VersionedDeltaNode::RowContainer rows;
   VersionedDeltaNode::VersionContainer versions;
-  bool has_version = false;
 
   property::SortKeysRef sk;
   while (reader.Remaining() != 0) {
     auto entry = deserialize_entry();
     if (!sk.empty() && entry.row.GetSortKeys() == sk) {
       // old version
-      VersionedDeltaNodeBuilder::WriteRow_(versions.back(), &version_writer,
-                                           entry);
-      has_version = true;
+      VersionedDeltaNodeBuilder::WriteRow_(versions, &version_writer, entry);
     } else {
       // newest version
       VersionedDeltaNodeBuilder::WriteRow_(rows, &writer, entry);
-      versions.push_back({});
+      versions.AddRow();
+      sk = entry.row.GetSortKeys();
     }
   }
-  if (!has_version) {
-    versions.clear();
-  }
+  versions.Finish();
 
   auto delta = std::make_shared<VersionedDeltaNode>(
       writer.Detach(), version_writer.Detach(), std::move(rows),
       std::move(versions));
+  delta->SetLSN(lsn);
+  ArcanedbLockGuard<ArcanedbLock> guard(write_mu_);
   UpdatePtr_(delta);
+  ResetCharge_();
   return Status::Ok();
 }
 
 bool VersionedBwTreePage::FinishFlush(const Status &s,
                                       log_store::LsnType lsn) noexcept {}
 
-void VersionedBwTreePage::RangeFilter(const Options &opts, const Filter &filter,
-                                      const BtreeScanOpts &scan_opts,
-                                      RangeScanRowView *views) const noexcept {
-  auto shared_ptr = GetPtr_();
-  auto current_ptr = shared_ptr.get();
-  int cnt = 0;
-  while (current_ptr) {
-    current_ptr->Traverse(
-        [&](const property::Row &row, bool is_deleted, TxnTs write_ts) {
-          if (!is_deleted) {
-            views->PushBackRef(RowRef(row));
-          }
-        });
-    current_ptr = current_ptr->GetPrevious().get();
-    cnt += 1;
+Status VersionedBwTreePage::RangeFilter(const Options &opts,
+                                        const Filter &filter, TxnTs read_ts,
+                                        const BtreeScanOpts &scan_opts,
+                                        RangeScanRowView *views) const
+    noexcept {
+  while (true) {
+    auto token = PrepareWaitIntent_();
+    auto s = RangeFilterOnce_(opts, filter, read_ts, scan_opts, views);
+    if (!s.IsRetry()) {
+      return s;
+    }
+    views->clear();
+    if (IsTruncated()) {
+      return s;
+    }
+    WaitIntent_(token);
+  }
+  UNREACHABLE();
+}
+
+Status VersionedBwTreePage::RangeFilterOnce_(
+    const Options &opts, const Filter &filter, TxnTs read_ts,
+    const BtreeScanOpts &scan_opts, RangeScanRowView *views) const noexcept {
+  DCHECK(!filter.HasPredicate() || opts.schema != nullptr);
+  util::EpochManager::Guard guard;
+  auto current_ptr = GetRawPtr_();
+  if (current_ptr == nullptr) {
+    return Status::Ok();
+  }
+  // rows are referencing the whole chain, so one owner of head is enough.
+  views->AddOwnerPointer(current_ptr->shared_from_this());
+  if (filter.limit != 0) {
+    // limit is given by caller, rows of page are bounded by rows of the
+    // delta nodes.
+    size_t row_bound = 0;
+    for (auto *node = current_ptr; node != nullptr;
+         node = node->GetPreviousPtr()) {
+      row_bound += node->GetSize();
+    }
+    views->reserve(std::min<size_t>(filter.limit, row_bound));
+  }
+  if (current_ptr->GetPreviousPtr() == nullptr) {
+    return RangeFilterSingleNode_(current_ptr, opts, filter, read_ts, views);
+  }
+  VersionedDeltaNodeMerger merger;
+  while (current_ptr != nullptr) {
+    merger.AddDeltaNode(current_ptr);
+    current_ptr = current_ptr->GetPreviousPtr();
   }
 
-  if (cnt > 1) {
-    std::sort(views->begin(), views->end(),
-              [](const RowRef &lhs, const RowRef &rhs) {
-                return lhs.GetSortKeys() < rhs.GetSortKeys();
-              });
+  DeltaScanRange range;
+  if (filter.start.has_value()) {
+    range.start = filter.start->as_ref();
   }
-  if (scan_opts.remove_duplicate) {
-    // TODO(sheep): impl me.
+  if (filter.end.has_value()) {
+    range.end = filter.end->as_ref();
   }
+  range.reverse = filter.reverse;
+
+  // versions of a sort key are visited from newest to oldest, the first
+  // visible one decides the result of this key, just like GetRow.
+  bool resolved = false;
+  bool locked = false;
+  size_t row_cnt = 0;
+  merger.Scan(range, [&](const property::Row &row, bool is_deleted,
+                         TxnTs write_ts, bool is_newest) {
+    if (is_newest) {
+      resolved = false;
+    }
+    if (resolved) {
+      return true;
+    }
+    auto visibility =
+        VersionedDeltaNode::CheckVisibility(write_ts, read_ts, opts);
+    if (visibility == VersionedDeltaNode::Visibility::kLocked) {
+      locked = true;
+      return false;
+    }
+    if (visibility == VersionedDeltaNode::Visibility::kInvisible) {
+      return true;
+    }
+    resolved = true;
+    if (is_deleted ||
+        (filter.HasPredicate() && !filter.Match(row, opts.schema))) {
+      return true;
+    }
+    views->PushBackRef(RowRef(row));
+    row_cnt += 1;
+    return filter.limit == 0 || row_cnt < filter.limit;
+  });
+  if (locked) {
+    return Status::Retry();
+  }
+  return Status::Ok();
+}
+
+Status VersionedBwTreePage::RangeFilterSingleNode_(
+    const VersionedDeltaNode *node, const Options &opts, const Filter &filter,
+    TxnTs read_ts, RangeScanRowView *views) noexcept {
+  constexpr size_t kBlockSize = 64;
+  size_t begin =
+      filter.start.has_value() ? node->LowerBound_(filter.start->as_ref()) : 0;
+  size_t end = filter.end.has_value() ? node->LowerBound_(filter.end->as_ref())
+                                      : node->GetSize();
+  size_t row_cnt = 0;
+  while (begin < end) {
+    // reverse scan consumes blocks from the back.
+    size_t count = std::min(kBlockSize, end - begin);
+    size_t block_begin = filter.reverse ? end - count : begin;
+    uint64_t locked_mask = 0;
+    uint64_t visible_mask =
+        node->GetVisibleMask(read_ts, block_begin, count, &locked_mask);
+    for (size_t j = 0; j < count; j++) {
+      size_t i = filter.reverse ? count - 1 - j : j;
+      size_t idx = block_begin + i;
+      bool visible = (visible_mask >> i) & 1;
+      if ((locked_mask >> i) & 1) {
+        auto write_ts = txn::TxnStatusTable::GetInstance()->Resolve(
+            node->write_ts_[idx].load(std::memory_order_relaxed));
+        auto visibility =
+            VersionedDeltaNode::CheckVisibility(write_ts, read_ts, opts);
+        if (visibility == VersionedDeltaNode::Visibility::kLocked) {
+          return Status::Retry();
+        }
+        visible = visibility == VersionedDeltaNode::Visibility::kVisible;
+      }
+      property::Row row;
+      bool is_deleted;
+      if (visible) {
+        is_deleted = node->GetRow(idx, &row);
+      } else {
+        const auto *version = node->FindVisibleOldVersion_(idx, read_ts);
+        if (version == nullptr) {
+          continue;
+        }
+        row = node->GetOldVersionRow_(*version);
+        is_deleted = VersionedDeltaNode::IsDeleted(version->control_bit);
+      }
+      if (is_deleted ||
+          (filter.HasPredicate() && !filter.Match(row, opts.schema))) {
+        continue;
+      }
+      views->PushBackRef(RowRef(row));
+      row_cnt += 1;
+      if (filter.limit != 0 && row_cnt >= filter.limit) {
+        return Status::Ok();
+      }
+    }
+    if (filter.reverse) {
+      end -= count;
+    } else {
+      begin += count;
+    }
+  }
+  return Status::Ok();
+}
+
+ScanCursor::ScanCursor(const VersionedBwTreePage *page, const Options &opts,
+                       const Filter &filter, TxnTs read_ts) noexcept
+    : page_(page), opts_(opts), filter_(filter), read_ts_(read_ts) {
+  DCHECK(!filter_.HasPredicate() || opts_.schema != nullptr);
+  Resume({});
+}
+
+ScanCursor::ScanCursor(LeafLocator locator, const Options &opts,
+                       const Filter &filter, TxnTs read_ts) noexcept
+    : page_(nullptr), locator_(std::move(locator)), opts_(opts),
+      filter_(filter), read_ts_(read_ts) {
+  DCHECK(!filter_.HasPredicate() || opts_.schema != nullptr);
+  Resume({});
+}
+
+void ScanCursor::Seek(property::SortKeysRef sort_key) noexcept {
+  if (IsEmpty_()) {
+    return;
+  }
+  row_cnt_ = 0;
+  Position_(sort_key.as_slice(), /*inclusive=*/true);
+  FindNext_();
+}
+
+void ScanCursor::Resume(std::string_view token) noexcept {
+  if (IsEmpty_()) {
+    return;
+  }
+  row_cnt_ = 0;
+  Position_(token, /*inclusive=*/false);
+  FindNext_();
+}
+
+void ScanCursor::ApplyResumeToken(std::string_view token,
+                                  Filter *filter) noexcept {
+  if (token.empty()) {
+    return;
+  }
+  // same as Position_ with an exclusive key.
+  if (!filter->reverse) {
+    std::string key(token);
+    key.push_back('\0');
+    if (!filter->start.has_value() || filter->start->as_slice() < key) {
+      filter->start.emplace(key);
+    }
+  } else {
+    if (!filter->end.has_value() || token < filter->end->as_slice()) {
+      filter->end.emplace(token);
+    }
+  }
+}
+
+void ScanCursor::Position_(std::string_view sort_key,
+                           bool inclusive) noexcept {
+  // copy the key first, since it might be referencing the old chain.
+  std::string key(sort_key);
+  start_ = filter_.start.has_value() ? filter_.start->as_slice() : "";
+  end_ = filter_.end.has_value() ? filter_.end->as_slice() : "";
+  if (!key.empty()) {
+    // sort keys are memcmp-comparable, key + '\0' is the smallest sort key
+    // which is greater than key.
+    if (!filter_.reverse) {
+      if (!inclusive) {
+        key.push_back('\0');
+      }
+      start_ = std::max(start_, key);
+    } else {
+      if (inclusive) {
+        key.push_back('\0');
+      }
+      end_ = end_.empty() ? key : std::min(end_, key);
+    }
+  }
+
+  if (locator_) {
+    // stream is bounded by the leaf page containing the first row.
+    auto location = filter_.reverse ? locator_(end_, /*before=*/true)
+                                    : locator_(start_, /*before=*/false);
+    page_ = location.page;
+    page_owner_ = std::move(location.owner);
+    leaf_lower_ = std::move(location.lower);
+    leaf_upper_ = std::move(location.upper);
+    // intents resolved before the token is taken are rechecked after the
+    // wait timeout.
+    wait_token_ = page_->PrepareWaitIntent_();
+    head_ = std::move(location.head);
+    start_ = std::max(start_, leaf_lower_);
+    if (!leaf_upper_.empty()) {
+      end_ = end_.empty() ? leaf_upper_ : std::min(end_, leaf_upper_);
+    }
+  } else {
+    wait_token_ = page_->PrepareWaitIntent_();
+    head_ = page_->GetPtr_();
+  }
+
+  std::vector<const VersionedDeltaNode *> nodes;
+  for (auto *current = head_.get(); current != nullptr;
+       current = current->GetPreviousPtr()) {
+    if (current->GetSize() != 0) {
+      nodes.push_back(current);
+    }
+  }
+  DeltaScanRange range;
+  if (!start_.empty()) {
+    range.start = property::SortKeysRef(start_);
+  }
+  if (!end_.empty()) {
+    range.end = property::SortKeysRef(end_);
+  }
+  range.reverse = filter_.reverse;
+  stream_.Init(nodes, range);
+}
+
+void ScanCursor::FindNext_() noexcept {
+  valid_ = false;
+  if (filter_.limit != 0 && row_cnt_ >= filter_.limit) {
+    return;
+  }
+  while (true) {
+    if (!stream_.Valid()) {
+      if (!NextLeaf_()) {
+        return;
+      }
+      continue;
+    }
+    auto sort_key = stream_.GetSortKeys();
+    bool locked = false;
+    std::optional<property::Row> found;
+    // versions of a sort key are visited from newest to oldest, the first
+    // visible one decides the result of this key.
+    auto visitor = [&](const property::Row &row, bool is_deleted,
+                       TxnTs write_ts, bool is_newest) {
+      auto visibility =
+          VersionedDeltaNode::CheckVisibility(write_ts, read_ts_, opts_);
+      if (visibility == VersionedDeltaNode::Visibility::kLocked) {
+        locked = true;
+        return false;
+      }
+      if (visibility == VersionedDeltaNode::Visibility::kInvisible) {
+        return true;
+      }
+      if (!is_deleted &&
+          (!filter_.HasPredicate() || filter_.Match(row, opts_.schema))) {
+        found = row;
+      }
+      return false;
+    };
+    stream_.VisitKey(visitor);
+    if (locked) {
+      // intent might be resolved on a newer chain, so restart from this key
+      // with a fresh chain.
+      page_->WaitIntent_(wait_token_);
+      Position_(sort_key.as_slice(), /*inclusive=*/true);
+      continue;
+    }
+    if (found.has_value()) {
+      current_row_ = *found;
+      last_sort_key_.assign(sort_key.as_slice());
+      valid_ = true;
+      row_cnt_ += 1;
+      return;
+    }
+  }
+}
+
+bool ScanCursor::NextLeaf_() noexcept {
+  if (!locator_) {
+    return false;
+  }
+  if (!filter_.reverse) {
+    if (leaf_upper_.empty() ||
+        (filter_.end.has_value() && filter_.end->as_slice() <= leaf_upper_)) {
+      return false;
+    }
+    auto key = leaf_upper_;
+    Position_(key, /*inclusive=*/true);
+  } else {
+    if (leaf_lower_.empty() || (filter_.start.has_value() &&
+                                filter_.start->as_slice() >= leaf_lower_)) {
+      return false;
+    }
+    auto key = leaf_lower_;
+    Position_(key, /*inclusive=*/false);
+  }
+  return true;
 }
 
 } // namespace btree
@@ -11,18 +11,25 @@
 
 #pragma once
 
+#include "absl/hash/hash.h"
+#include "bthread/condition_variable.h"
+#include "bthread/mutex.h"
 #include "btree/btree_type.h"
 #include "btree/page/page_snapshot.h"
 #include "btree/page/versioned_delta_node.h"
 #include "btree/write_info.h"
-#include "butil/containers/doubly_buffered_data.h"
 #include "common/btree_scan_opts.h"
+#include "common/config.h"
 #include "common/filter.h"
 #include "common/lock_table.h"
 #include "common/options.h"
 #include "common/status.h"
 #include "property/row/row.h"
+#include "util/epoch.h"
+#include "util/wait_table.h"
+#include "wal/bwtree_log_writer.h"
 #include <atomic>
+#include <functional>
 
 namespace arcanedb {
 namespace btree {
@@ -30,13 +37,20 @@ namespace btree {
 class RowIterator {
 public:
   RowIterator(std::shared_ptr<VersionedDeltaNode> delta_node) noexcept
-      : owner_(std::move(delta_node)) {
-    current_node_ = owner_.get();
-    bool deleted = current_node_->GetRow(current_idx_, &current_row_);
-    if (!deleted) {
-      return;
-    }
-    Next();
+      : RowIterator(
+            std::vector<std::shared_ptr<VersionedDeltaNode>>{delta_node}) {}
+
+  /**
+   * @brief
+   * Iterate delta chains one after another, null chain is skipped.
+   * Used to iterate all leaf pages of a multi-level btree.
+   * @param chains
+   */
+  explicit RowIterator(
+      std::vector<std::shared_ptr<VersionedDeltaNode>> chains) noexcept
+      : owners_(std::move(chains)) {
+    NextChain_();
+    FindValid_();
   }
 
   bool Valid() const noexcept { return current_node_ != nullptr; }
@@ -44,33 +58,192 @@ public:
   property::Row GetRow() const noexcept { return current_row_; }
 
   void Next() noexcept {
+    current_idx_ += 1;
+    FindValid_();
+  }
+
+private:
+  void NextChain_() noexcept {
+    current_idx_ = 0;
+    current_node_ = nullptr;
+    while (current_node_ == nullptr && next_chain_ < owners_.size()) {
+      current_node_ = owners_[next_chain_++].get();
+    }
+  }
+
+  // skip deleted rows and exhausted delta nodes.
+  void FindValid_() noexcept {
     while (current_node_ != nullptr) {
-      current_idx_ += 1;
-      if (current_idx_ == current_node_->GetSize()) {
-        current_idx_ = 0;
-        current_node_ = current_node_->GetPrevious().get();
-        if (current_node_ == nullptr) {
-          break;
+      if (current_idx_ < current_node_->GetSize()) {
+        bool deleted = current_node_->GetRow(current_idx_, &current_row_);
+        if (!deleted) {
+          return;
         }
+        current_idx_ += 1;
+        continue;
       }
-      bool deleted = current_node_->GetRow(current_idx_, &current_row_);
-      if (!deleted) {
-        break;
+      current_idx_ = 0;
+      current_node_ = current_node_->GetPreviousPtr();
+      if (current_node_ == nullptr) {
+        NextChain_();
       }
     }
   }
 
-private:
-  std::shared_ptr<VersionedDeltaNode> owner_;
+  std::vector<std::shared_ptr<VersionedDeltaNode>> owners_;
+  size_t next_chain_{};
   VersionedDeltaNode *current_node_{};
   property::Row current_row_;
-  int current_idx_{};
+  size_t current_idx_{};
+};
+
+class VersionedBwTreePage;
+
+/**
+ * @brief
+ * Pull-based cursor over a page. delta chain is merged lazily, rows are
+ * produced one at a time with the same visibility and filter semantic as
+ * RangeFilter, so memory usage is bounded by the length of delta chain instead
+ * of the number of rows.
+ * Row returned by GetRow is valid until the next call to Next/Seek/Resume.
+ * cursor must not outlive the page it is created from.
+ */
+class ScanCursor {
+public:
+  /**
+   * @brief
+   * Leaf page holding the rows around a sort key, used by cursor over a
+   * multi-level btree.
+   */
+  struct LeafLocation {
+    const VersionedBwTreePage *page;
+    // keeps page alive while cursor is scanning it.
+    std::shared_ptr<const void> owner;
+    // delta chain of page, taken while page is still reachable from root.
+    std::shared_ptr<VersionedDeltaNode> head;
+    // key range of page, empty means unbounded.
+    std::string lower;
+    std::string upper;
+  };
+
+  /**
+   * @brief
+   * Locate the leaf page containing sort_key. when before is true, locate
+   * the leaf page containing the largest key which is less than sort_key
+   * instead, and empty sort_key means the last leaf page.
+   */
+  using LeafLocator =
+      std::function<LeafLocation(std::string_view sort_key, bool before)>;
+
+  /**
+   * @brief
+   * Empty cursor which is never valid.
+   */
+  ScanCursor() = default;
+
+  ScanCursor(const VersionedBwTreePage *page, const Options &opts,
+             const Filter &filter, TxnTs read_ts) noexcept;
+
+  /**
+   * @brief
+   * Cursor over a sequence of leaf pages, the next leaf is located when the
+   * current one is exhausted.
+   * @param locator
+   * @param opts
+   * @param filter
+   * @param read_ts
+   */
+  ScanCursor(LeafLocator locator, const Options &opts, const Filter &filter,
+             TxnTs read_ts) noexcept;
+
+  /**
+   * @brief
+   * Position at the first row whose sort key is not less than sort_key,
+   * or not greater than sort_key when filter is reversed.
+   * limit of the filter is counted from here.
+   * @param sort_key
+   */
+  void Seek(property::SortKeysRef sort_key) noexcept;
+
+  /**
+   * @brief
+   * Continue the scan right after the row where resume token is taken.
+   * empty token means starting from the beginning.
+   * limit of the filter is counted from here.
+   * @param token
+   */
+  void Resume(std::string_view token) noexcept;
+
+  /**
+   * @brief
+   * Narrow the bounds of filter to the rows after the one where resume token
+   * is taken. cursor created with the narrowed filter is positioned the same
+   * as calling Resume, without positioning twice.
+   * @param token
+   * @param filter
+   */
+  static void ApplyResumeToken(std::string_view token,
+                               Filter *filter) noexcept;
+
+  bool Valid() const noexcept { return valid_; }
+
+  property::Row GetRow() const noexcept { return current_row_; }
+
+  void Next() noexcept { FindNext_(); }
+
+  /**
+   * @brief
+   * Get an opaque token to continue the scan after current row,
+   * token could be used by another cursor with the same filter.
+   * @return std::string
+   */
+  std::string GetResumeToken() const noexcept { return last_sort_key_; }
+
+private:
+  void Position_(std::string_view sort_key, bool inclusive) noexcept;
+
+  void FindNext_() noexcept;
+
+  // move to the adjacent leaf once stream_ is exhausted.
+  bool NextLeaf_() noexcept;
+
+  bool IsEmpty_() const noexcept { return page_ == nullptr && !locator_; }
+
+  const VersionedBwTreePage *page_{};
+  LeafLocator locator_;
+  std::shared_ptr<const void> page_owner_;
+  // key range of page_, empty means unbounded.
+  std::string leaf_lower_;
+  std::string leaf_upper_;
+  Options opts_;
+  Filter filter_;
+  TxnTs read_ts_{};
+  // owner of the delta chain we are scanning.
+  std::shared_ptr<VersionedDeltaNode> head_;
+  VersionedDeltaNodeStream stream_;
+  // bounds of stream_, empty means unbounded since sort key is never empty.
+  std::string start_;
+  std::string end_;
+  std::string last_sort_key_;
+  property::Row current_row_;
+  bool valid_{false};
+  size_t row_cnt_{0};
+  // taken when stream_ is positioned, used to wait for intents.
+  int32_t wait_token_{0};
 };
 
 class VersionedBwTreePage {
 public:
-  VersionedBwTreePage(const std::string_view &page_id) noexcept
-      : page_id_(page_id) {}
+  /**
+   * @brief
+   * @param page_id
+   * @param packed leaf of packed page locks on the lock table of packed page,
+   * so it doesn't own one.
+   */
+  VersionedBwTreePage(const std::string_view &page_id,
+                      bool packed = false) noexcept
+      : lock_table_(packed ? nullptr : std::make_unique<common::LockTable>()),
+        page_id_(page_id) {}
 
   std::string_view GetPageKey() const noexcept { return page_id_; }
 
@@ -109,7 +282,9 @@ public:
    * @param read_ts
    * @param opts
    * @param view
-   * @return Status
+   * @return Status: Ok when row has been found
+   *                 NotFound.
+   *                 Retry when page is frozen while waiting for an intent.
    */
   Status GetRow(property::SortKeysRef sort_key, TxnTs read_ts,
                 const Options &opts, RowView *view) const noexcept;
@@ -121,19 +296,55 @@ public:
    * @param target_ts
    * @param opts
    * @param info
+   * @return Status: Ok, or Retry when page is frozen.
    */
-  void SetTs(property::SortKeysRef sort_key, TxnTs target_ts,
-             const Options &opts, WriteInfo *info) noexcept;
+  Status SetTs(property::SortKeysRef sort_key, TxnTs target_ts,
+               const Options &opts, WriteInfo *info) noexcept;
+
+  common::LockTable &GetLockTable() noexcept {
+    assert(lock_table_);
+    return *lock_table_;
+  }
 
-  common::LockTable &GetLockTable() noexcept { return lock_table_; }
+  /**
+   * @brief
+   * Mark page as being scheduled for background compaction.
+   * @return true if page hasn't been scheduled yet.
+   */
+  bool TryMarkCompactionScheduled() noexcept {
+    return !compaction_scheduled_.exchange(true, std::memory_order_acq_rel);
+  }
+
+  /**
+   * @brief
+   * Compact the delta chain without blocking writers.
+   * Deltas are merged from a snapshot of the chain outside write_mu_, then the
+   * new base node is installed if the snapshot is still part of the chain.
+   * Since delta nodes are immutable for lock-free readers, deltas prepended
+   * during the merge are re-linked by rebuilding them on top of the new base,
+   * and SetTs applied to the snapshot during the merge are replayed on it.
+   * @return true if new base node has been installed.
+   */
+  bool BackgroundCompaction() noexcept;
 
   /**
    * @brief Get page snapshot which is used to flush page
-   * to persistent storage
+   * to persistent storage. intents of committed txns are written back before
+   * taking the snapshot, intents are serialized as is and resolved again
+   * after reloading.
    * @return std::unique_ptr<PageSnapshot>
    */
   std::unique_ptr<PageSnapshot> GetPageSnapshot() noexcept;
 
+  /**
+   * @brief
+   * Write back intents of committed txns on the whole chain, except the
+   * nodes being compacted in background, which are written back on the new
+   * base node later. page should be flushed if any intent is written back.
+   * @return true if any intent is written back.
+   */
+  bool WriteBackIntents() noexcept;
+
   /**
    * @brief
    * Update flushed lsn.
@@ -156,15 +367,111 @@ public:
     return total_charge_.load(std::memory_order_relaxed);
   }
 
-  void RangeFilter(const Options &opts, const Filter &filter,
-                   const BtreeScanOpts &scan_opts,
-                   RangeScanRowView *views) const noexcept;
+  /**
+   * @brief
+   * Range scan. delta nodes are merged on the fly, and each sort key emits
+   * at most one row, which is the newest version visible to read_ts.
+   * rows are sorted by sort key. bounds, limit, order and predicates of filter
+   * are evaluated during merging, predicates are evaluated with opts.schema.
+   * @param opts
+   * @param filter
+   * @param read_ts
+   * @param scan_opts
+   * @param views
+   */
+  Status RangeFilter(const Options &opts, const Filter &filter, TxnTs read_ts,
+                     const BtreeScanOpts &scan_opts,
+                     RangeScanRowView *views) const noexcept;
 
   RowIterator GetRowIterator() const noexcept { return RowIterator(GetPtr_()); }
 
+  /**
+   * @brief
+   * Get the head of delta chain with ownership.
+   * @return std::shared_ptr<VersionedDeltaNode>
+   */
+  std::shared_ptr<VersionedDeltaNode> GetChain() const noexcept {
+    return GetPtr_();
+  }
+
+  /**
+   * @brief
+   * Freeze the page before it is replaced by SMO. writes on a frozen page
+   * fail with Retry, so that they could be re-routed to the new pages, while
+   * readers could still read it until it's truncated, since no write could
+   * land on the new pages before that.
+   * @param image Snapshot of the whole page, in the same format as
+   * GetPageSnapshot.
+   */
+  void Freeze(std::string *image) noexcept;
+
+  /**
+   * @brief
+   * Accept writes again, when SMO is given up after freezing.
+   */
+  void Unfreeze() noexcept;
+
+  bool IsFrozen() const noexcept {
+    return frozen_.load(std::memory_order_acquire);
+  }
+
+  /**
+   * @brief
+   * Drop the delta chain of a frozen page right before new pages are
+   * published. readers that might have read the truncated chain have to check
+   * IsTruncated afterward.
+   */
+  void Truncate() noexcept;
+
+  bool IsTruncated() const noexcept {
+    return truncated_.load(std::memory_order_acquire);
+  }
+
+  /**
+   * @brief
+   * Pick the sort key which splits image into two halves by size.
+   * @param image
+   * @param separator
+   * @return false if image contains less than two sort keys.
+   */
+  static bool PickSeparator(std::string_view image,
+                            std::string *separator) noexcept;
+
+  /**
+   * @brief
+   * Repartition images of adjacent pages by sort key, i-th output contains
+   * rows in [bounds[i], bounds[i + 1]). images are ordered by sort key, and
+   * bounds[0] is ignored since rows less than bounds[1] belong to the first
+   * output.
+   * @param images
+   * @param bounds
+   * @return std::vector<std::string>
+   */
+  static std::vector<std::string>
+  RepartitionImages(const std::vector<std::string> &images,
+                    const std::vector<std::string_view> &bounds) noexcept;
+
+  /**
+   * @brief
+   * Get a cursor positioned at the first row of filter.
+   * @param opts
+   * @param filter
+   * @param read_ts
+   * @return ScanCursor
+   */
+  ScanCursor GetScanCursor(const Options &opts, const Filter &filter,
+                           TxnTs read_ts) const noexcept {
+    return ScanCursor(this, opts, filter, read_ts);
+  }
+
   size_t TEST_GetDeltaLength() const noexcept {
-    auto ptr = GetPtr_();
-    return ptr->GetTotalLength();
+    util::EpochManager::Guard guard;
+    return GetRawPtr_()->GetTotalLength();
+  }
+
+  size_t TEST_GetCompactionThreshold() const noexcept {
+    ArcanedbLockGuard<ArcanedbLock> guard(write_mu_);
+    return compaction_threshold_;
   }
 
   std::string TEST_DumpPage() const noexcept;
@@ -174,71 +481,260 @@ public:
   bool TEST_Equal(const VersionedBwTreePage &rhs) const noexcept;
 
 private:
-  using DoublyBufferedData =
-      butil::DoublyBufferedData<std::shared_ptr<VersionedDeltaNode>>;
+  friend class ScanCursor;
+
+  /**
+   * @brief
+   * Pending write waiting in the write queue.
+   * Writers on the same page are committed in group, the writer at the front
+   * of the queue is the leader, it appends log records of the whole group
+   * with a single AppendLogRecord and prepends a single delta for them.
+   */
+  struct WriteRequest {
+    enum class Type : uint8_t {
+      kSetRow,
+      kDeleteRow,
+      kSetTs,
+    };
+    Type type;
+    property::SortKeysRef sort_key;
+    TxnTs write_ts;
+    const Options *opts;
+    WriteInfo *info;
+    // single row delta, null for SetTs.
+    std::shared_ptr<VersionedDeltaNode> delta;
+    wal::BwTreeLogWriter log_writer;
+    Status status;
+    // guarded by queue_mu_
+    bool done{false};
+    WriteRequest *next{nullptr};
+    bthread::ConditionVariable cv;
+  };
+
+  /**
+   * @brief
+   * Enqueue the request and wait until it's committed by the leader.
+   * @param request
+   * @return Status
+   */
+  Status Write_(WriteRequest *request) noexcept;
+
+  /**
+   * @brief
+   * Collect requests from the front of the queue that could be committed
+   * together with the leader. requires queue_mu_ to be held.
+   * @param batch
+   */
+  void BuildBatch_(std::vector<WriteRequest *> *batch) const noexcept;
+
+  // requires write_mu_ to be held.
+  void ApplyBatch_(const std::vector<WriteRequest *> &batch) noexcept;
+
+  // requires write_mu_ to be held.
+  void ApplySetTs_(property::SortKeysRef sort_key, TxnTs target_ts,
+                   std::optional<TxnTs> owner_ts,
+                   log_store::LsnType lsn) noexcept;
+
+  /**
+   * @brief
+   * Write back the newest version of sort_key if it's an intent of committed
+   * txn, before it's overwritten, so that intents are never stacked.
+   * requires write_mu_ to be held.
+   * @param sort_key
+   * @param owners owner ts of the intent written back.
+   */
+  void WriteBackIntent_(property::SortKeysRef sort_key,
+                        std::vector<TxnTs> *owners) noexcept;
 
   std::shared_ptr<VersionedDeltaNode>
-  Compaction_(VersionedDeltaNode *current_ptr, bool force_compaction) noexcept;
+  Compaction_(VersionedDeltaNode *current_ptr, bool force_compaction,
+              size_t *rewritten_rows) const noexcept;
 
-  void MaybePerformCompaction_(const Options &opts,
+  /**
+   * @brief
+   * requires write_mu_ to be held.
+   * @param opts
+   * @param current_ptr
+   * @return true if compaction should be performed in background.
+   */
+  bool MaybePerformCompaction_(const Options &opts,
                                VersionedDeltaNode *current_ptr) noexcept;
 
+  // requires write_mu_ to be held.
+  void RecordCompaction_(size_t rewritten_rows) noexcept;
+
+  /**
+   * @brief
+   * Merge the delta chain into page image, see GetPageSnapshot for the
+   * format.
+   * @param head
+   * @param lsn max lsn of the chain.
+   * @return std::string
+   */
+  static std::string SerializeChain_(const VersionedDeltaNode *head,
+                                     log_store::LsnType *lsn) noexcept;
+
+  // re-derive total charge from the chain, since compaction and SMO shrink
+  // the page. requires write_mu_ to be held.
+  void ResetCharge_() noexcept;
+
+  /**
+   * @brief
+   * Record the length of delta chain traversed by reader.
+   * Only 1/kBwTreeReadSampleRate of the reads will be recorded,
+   * so that readers won't contend on the shared counters.
+   * @param traversed_length number of delta nodes visited by reader.
+   * @param skipped_length number of delta nodes skipped by key filters.
+   */
+  void SampleRead_(size_t traversed_length, size_t skipped_length) const
+      noexcept;
+
+  /**
+   * @brief
+   * Re-derive compaction threshold from the workload of the last window.
+   * write-hot page will keep a longer delta chain, read-hot page will perform
+   * compaction more aggressively. requires write_mu_ to be held.
+   * @param write_cnt number of rows written by this batch.
+   */
+  void MaybeAdjustCompactionThreshold_(size_t write_cnt) noexcept;
+
   Status GetRowOnce_(property::SortKeysRef sort_key, TxnTs read_ts,
                      const Options &opts, RowView *view) const noexcept;
 
+  // whether the version is an intent that we should wait for.
+  static bool ShouldWaitIntent_(TxnTs write_ts, const Options &opts) noexcept {
+    return VersionedDeltaNode::ShouldWaitIntent(write_ts, opts);
+  }
+
+  // readers blocked by intents of this page wait on this slot of wait table.
+  size_t GetWaitHash_() const noexcept {
+    return absl::Hash<const void *>()(this);
+  }
+
+  int32_t PrepareWaitIntent_() const noexcept {
+    return util::WaitTable::GetInstance()->Prepare(GetWaitHash_());
+  }
+
+  /**
+   * @brief
+   * Park until an intent of this page is resolved after token is taken.
+   * must not hold epoch guard.
+   * @param token
+   */
+  void WaitIntent_(int32_t token) const noexcept {
+    util::WaitTable::GetInstance()->Wait(
+        GetWaitHash_(), token, common::Config::kBwTreeIntentWaitTimeoutUs);
+  }
+
+  Status RangeFilterOnce_(const Options &opts, const Filter &filter,
+                          TxnTs read_ts, const BtreeScanOpts &scan_opts,
+                          RangeScanRowView *views) const noexcept;
+
+  /**
+   * @brief
+   * Range filter on a chain with only one delta node, which is the common
+   * case right after compaction. Visibility of newest versions is checked
+   * block by block over the contiguous timestamp array, without walking
+   * through the merger.
+   */
+  static Status RangeFilterSingleNode_(const VersionedDeltaNode *node,
+                                       const Options &opts,
+                                       const Filter &filter, TxnTs read_ts,
+                                       RangeScanRowView *views) noexcept;
+
   bool CheckRowLocked_(property::SortKeysRef sort_key,
                        const Options &opts) const noexcept;
 
+  /**
+   * @brief
+   * Get the head of delta chain without touching any shared cache line.
+   * requires epoch guard or write_mu_ to be held.
+   * @return VersionedDeltaNode*
+   */
+  VersionedDeltaNode *GetRawPtr_() const noexcept {
+    return head_.load(std::memory_order_acquire);
+  }
+
+  /**
+   * @brief
+   * Get the head of delta chain with ownership.
+   * Used by the long-lived readers such as iterator and flusher.
+   * @return std::shared_ptr<VersionedDeltaNode>
+   */
   std::shared_ptr<VersionedDeltaNode> GetPtr_() const noexcept {
-    // DoublyBufferedData::ScopedPtr scoped_ptr;
-    // CHECK(ptr_.Read(&scoped_ptr) == 0);
-    // return *scoped_ptr;
-    std::shared_ptr<VersionedDeltaNode> res;
-    lock_.Lock();
-    res = ptr_;
-    lock_.Unlock();
-    return res;
+    util::EpochManager::Guard guard;
+    auto *ptr = GetRawPtr_();
+    if (ptr == nullptr) {
+      return nullptr;
+    }
+    return std::static_pointer_cast<VersionedDeltaNode>(
+        ptr->shared_from_this());
   }
 
+  // requires write_mu_ to be held.
   void UpdatePtr_(std::shared_ptr<VersionedDeltaNode> new_node) noexcept {
-    // ptr_.Modify(UpdateFn_, new_node);
-    lock_.Lock();
-    ptr_ = new_node;
-    lock_.Unlock();
+    auto old_node = std::move(ptr_);
+    ptr_ = std::move(new_node);
+    head_.store(ptr_.get(), std::memory_order_release);
+    // readers might still traversing the old chain.
+    util::EpochManager::GetInstance()->Retire(std::move(old_node));
   }
 
+  // requires write_mu_ to be held.
   void DummyUpdate_() const noexcept {
-    // ptr_.Modify(DummyFn_);
-    lock_.Lock();
-    lock_.Unlock();
+    // republish the head, so that readers afterward will see our update.
+    head_.store(head_.load(std::memory_order_relaxed),
+                std::memory_order_release);
   }
 
-  static bool DummyFn_(std::shared_ptr<VersionedDeltaNode> &old_node) noexcept {
-    return true;
-  }
-
-  static bool UpdateFn_(std::shared_ptr<VersionedDeltaNode> &old_node,
-                        std::shared_ptr<VersionedDeltaNode> new_node) noexcept {
-    old_node = new_node;
-    return true;
-  }
-
-  // TODO(sheep) use group commit to optimize write performance
-  // mutable ArcanedbLock write_mu_{"VersionedBwTreePageWriteMutex"};
+  bthread::Mutex queue_mu_;
+  // intrusive write queue linked by WriteRequest::next, so that idle pages
+  // don't hold any queue storage.
+  WriteRequest *queue_head_{nullptr}; // guarded by queue_mu_
+  WriteRequest *queue_tail_{nullptr}; // guarded by queue_mu_
+  // only the leader of write queue will hold write_mu_ for writing.
   mutable ArcanedbLock write_mu_;
-  // mutable DoublyBufferedData ptr_;
-  mutable absl::base_internal::SpinLock lock_;
+  // owner of the delta chain, guarded by write_mu_.
   std::shared_ptr<VersionedDeltaNode> ptr_;
-  common::LockTable lock_table_;
+  // lock-free published head of the delta chain, readers are protected by
+  // epoch.
+  mutable std::atomic<VersionedDeltaNode *> head_{nullptr};
+  // head of the delta chain being compacted in background,
+  // null when there is no background compaction.
+  VersionedDeltaNode *compacting_head_{nullptr}; // guarded by write_mu_
+  struct PendingSetTs {
+    std::string sort_key;
+    TxnTs target_ts;
+    std::optional<TxnTs> owner_ts;
+    log_store::LsnType lsn;
+  };
+  // SetTs applied to the chain being compacted, which need to be replayed
+  // on the new base node.
+  std::vector<PendingSetTs> pending_set_ts_; // guarded by write_mu_
+  std::atomic<bool> compaction_scheduled_{false};
+  // set under write_mu_ once page is replaced by SMO.
+  std::atomic<bool> frozen_{false};
+  // set under write_mu_ before the chain is dropped, never reset.
+  std::atomic<bool> truncated_{false};
+
+  // workload statistics of current window.
+  mutable std::atomic<uint32_t> sampled_read_cnt_{0};
+  mutable std::atomic<uint32_t> sampled_traversed_length_{0};
+  // following fields are guarded by write_mu_
+  size_t write_cnt_{0};
+  size_t rows_since_compaction_{0};
+  size_t compaction_threshold_{common::Config::kBwTreeDeltaChainLength};
+
+  std::unique_ptr<common::LockTable> lock_table_;
   const std::string page_id_;
   std::atomic<size_t> total_charge_{sizeof(VersionedBwTreePage)};
 };
 
 class VersionedBwTreePageSnapshot : public PageSnapshot {
 public:
-  VersionedBwTreePageSnapshot(std::string bytes,
-                              log_store::LsnType lsn) noexcept
-      : lsn_(lsn), bytes_(std::move(bytes)) {}
+  VersionedBwTreePageSnapshot(std::string bytes, log_store::LsnType lsn,
+                              bool is_delta = false) noexcept
+      : lsn_(lsn), bytes_(std::move(bytes)), is_delta_(is_delta) {}
 
   ~VersionedBwTreePageSnapshot() noexcept override {}
 
@@ -246,9 +742,12 @@ public:
 
   log_store::LsnType GetLSN() noexcept override { return lsn_; }
 
+  bool IsDelta() noexcept override { return is_delta_; }
+
 private:
   log_store::LsnType lsn_{};
   std::string bytes_;
+  bool is_delta_;
 };
 
 } // namespace btree
@@ -10,23 +10,19 @@
  */
 
 #include "btree/page/versioned_delta_node.h"
+#include "common/config.h"
+#include <cstring>
+#include <map>
 
 namespace arcanedb {
 namespace btree {
 
 VersionedDeltaNode::VersionedDeltaNode(const property::Row &row,
                                        TxnTs ts) noexcept {
-  // copy the row
   auto slice = row.as_slice();
-  util::BufWriter writer;
-  writer.WriteBytes(slice);
-  buffer_ = writer.Detach();
-  Entry entry;
-  // offset is zero
-  entry.control_bit = 0;
-  // assign ts
-  entry.write_ts = ts;
-  rows_.push_back(entry);
+  // copy the row, exactly sized.
+  buffer_.assign(slice.data(), slice.size());
+  InitSingleRow_(buffer_.data(), /*is_deleted=*/false, ts);
 }
 
 VersionedDeltaNode::VersionedDeltaNode(property::SortKeysRef sort_key,
@@ -35,28 +31,105 @@ VersionedDeltaNode::VersionedDeltaNode(property::SortKeysRef sort_key,
   util::BufWriter writer;
   property::Row::SerializeOnlySortKey(sort_key, &writer);
   buffer_ = writer.Detach();
+  InitSingleRow_(buffer_.data(), /*is_deleted=*/true, ts);
+}
+
+void VersionedDeltaNode::InitSingleRow_(const char *row_data, bool is_deleted,
+                                        TxnTs ts) noexcept {
+  row_data_ = row_data;
   Entry entry;
   // offset is zero
   entry.control_bit = 0;
-  MarkDeleted(&entry);
-  // assign ts
-  entry.write_ts = ts;
-  rows_.push_back(entry);
+  if (is_deleted) {
+    MarkDeleted(&entry);
+  }
+  control_bits_.push_back(entry.control_bit);
+  inline_write_ts_.store(ts, std::memory_order_relaxed);
+  BuildKeyIndex_();
+}
+
+SingleRowDeltaNode::SingleRowDeltaNode(const property::Row &row,
+                                       TxnTs ts) noexcept {
+  auto slice = row.as_slice();
+  assert(slice.size() <= sizeof(inline_row_));
+  std::memcpy(inline_row_, slice.data(), slice.size());
+  InitSingleRow_(inline_row_, /*is_deleted=*/false, ts);
+}
+
+SingleRowDeltaNode::SingleRowDeltaNode(property::SortKeysRef sort_key,
+                                       TxnTs ts) noexcept {
+  assert(property::Row::GetOnlySortKeyRowSize(sort_key) <=
+         sizeof(inline_row_));
+  util::NonOwnershipBufWriter writer(inline_row_, sizeof(inline_row_));
+  property::Row::SerializeOnlySortKey(sort_key, &writer);
+  InitSingleRow_(inline_row_, /*is_deleted=*/true, ts);
+}
+
+VersionedDeltaNode::VersionedDeltaNode(std::string buffer,
+                                       std::string version_buffer,
+                                       RowContainer rows,
+                                       VersionContainer versions) noexcept
+    : buffer_(std::move(buffer)), version_buffer_(std::move(version_buffer)),
+      control_bits_(std::move(rows.control_bits)),
+      versions_(std::move(versions)) {
+  row_data_ = buffer_.data();
+  auto size = control_bits_.size();
+  if (size > 1) {
+    write_ts_holder_ = std::make_unique<std::atomic<TxnTs>[]>(size);
+    write_ts_ = write_ts_holder_.get();
+  }
+  for (size_t i = 0; i < size; i++) {
+    write_ts_[i].store(rows.write_ts[i], std::memory_order_relaxed);
+  }
+  BuildKeyIndex_();
 }
 
-void VersionedDeltaNodeBuilder::AddDeltaNode(
-    const VersionedDeltaNode *node) noexcept {
-  node->Traverse([&](const property::Row &row, bool is_deleted,
-                     TxnTs write_ts) {
-    // skip aborted version
-    if (write_ts == kAbortedTxnTs) {
+void VersionedDeltaNode::BuildKeyIndex_() noexcept {
+  if (GetSize() == 0) {
+    return;
+  }
+  min_sort_key_ = GetSortKeys_(0);
+  max_sort_key_ = GetSortKeys_(GetSize() - 1);
+  if (GetSize() >= common::Config::kBwTreeDeltaBloomMinRows) {
+    bloom_filter_ = util::BloomFilter(
+        GetSize(), common::Config::kBwTreeDeltaBloomBitsPerKey);
+    for (size_t i = 0; i < GetSize(); i++) {
+      bloom_filter_.Add(GetSortKeys_(i).as_slice());
+    }
+  }
+  if (GetSize() >= common::Config::kBwTreeDeltaPrefixMinRows) {
+    if (BuildInt64Keys_()) {
       return;
     }
-    // TODO(sheep): remove old version
-    map_[row.GetSortKeys()].emplace_back(
-        BuildEntry{.row = row, .is_deleted = is_deleted, .write_ts = write_ts});
-  });
-  delta_cnt_ += 1;
+    auto min_key = min_sort_key_.as_slice();
+    auto max_key = max_sort_key_.as_slice();
+    size_t common_prefix = 0;
+    while (common_prefix < min_key.size() && common_prefix < max_key.size() &&
+           min_key[common_prefix] == max_key[common_prefix]) {
+      common_prefix += 1;
+    }
+    prefix_offset_ = common_prefix;
+    key_prefixes_.reserve(GetSize());
+    for (size_t i = 0; i < GetSize(); i++) {
+      key_prefixes_.push_back(
+          LoadKeyPrefix_(GetSortKeys_(i).as_slice(), prefix_offset_));
+    }
+  }
+}
+
+bool VersionedDeltaNode::BuildInt64Keys_() noexcept {
+  int64_keys_.reserve(GetSize());
+  for (size_t i = 0; i < GetSize(); i++) {
+    auto key = GetSortKeys_(i).as_slice();
+    int64_t value;
+    if (key.size() != kInt64SortKeyLength || !LoadInt64Key_(key, &value)) {
+      int64_keys_.clear();
+      int64_keys_.shrink_to_fit();
+      return false;
+    }
+    int64_keys_.push_back(value);
+  }
+  return true;
 }
 
 std::shared_ptr<VersionedDeltaNode>
@@ -64,26 +137,39 @@ VersionedDeltaNodeBuilder::GenerateDeltaNode() noexcept {
   // generate rows_, buffer_, versions_, version_buffer_
   util::BufWriter writer;
   util::BufWriter version_writer;
-  std::vector<VersionedDeltaNode::Entry> rows;
+  VersionedDeltaNode::RowContainer rows;
   VersionedDeltaNode::VersionContainer versions;
-  bool has_version = false;
-  for (const auto &[sk, vec] : map_) {
-    // process newest version
-    WriteRow_(rows, &writer, vec[0]);
-    // process old version
-    // push empty
-    versions.push_back({});
-    for (int i = 1; i < vec.size(); i++) {
-      WriteRow_(versions.back(), &version_writer, vec[i]);
+  rows.reserve(row_cnt_);
+  versions.offsets.reserve(row_cnt_ + 1);
+  bool new_row = false;
+  VersionPruner pruner(low_watermark_, drop_tombstone_);
+  auto visitor = [&](const property::Row &row, bool is_deleted,
+                     TxnTs write_ts, bool is_newest) {
+    new_row = new_row || is_newest;
+    // skip aborted and invisible version
+    if (!pruner.ShouldKeep(is_deleted, write_ts, is_newest)) {
+      return;
     }
-    has_version = has_version || vec.size() > 1;
-  }
-  if (!has_version) {
-    versions.clear();
-  }
-  return std::make_shared<VersionedDeltaNode>(
+    BuildEntry entry{.row = row, .is_deleted = is_deleted, .write_ts = write_ts};
+    if (new_row) {
+      // process newest version
+      WriteRow_(rows, &writer, entry);
+      versions.AddRow();
+      new_row = false;
+      return;
+    }
+    // process old version
+    WriteRow_(versions, &version_writer, entry);
+  };
+  // intents are copied as is, they are written back on the new node.
+  auto lsn = merger_.Merge(visitor, /*should_lock=*/false,
+                           /*resolve_intents=*/false);
+  versions.Finish();
+  auto node = std::make_shared<VersionedDeltaNode>(
       writer.Detach(), version_writer.Detach(), std::move(rows),
       std::move(versions));
+  node->SetLSN(lsn);
+  return node;
 }
 
 std::string VersionedDeltaNode::TEST_DumpChain() const noexcept {
@@ -101,7 +187,7 @@ std::string VersionedDeltaNode::TEST_DumpChain() const noexcept {
           map[row.GetSortKeys()].emplace_back(BuildEntry{
               .row = row, .is_deleted = is_deleted, .write_ts = write_ts});
         });
-    current_ptr = current_ptr->GetPrevious().get();
+    current_ptr = current_ptr->GetPreviousPtr();
   }
   std::string result = "DeltaChainDump:\n";
   for (const auto &[sk, vec] : map) {
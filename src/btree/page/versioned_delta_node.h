@@ -10,15 +10,29 @@
  */
 #pragma once
 
+#include "absl/base/internal/endian.h"
+#include "absl/container/inlined_vector.h"
+#include "absl/types/span.h"
 #include "btree/btree_type.h"
+#include "common/config.h"
 #include "common/options.h"
 #include "log_store/log_store.h"
 #include "property/row/row.h"
 #include "property/sort_key/sort_key.h"
+#include "property/sort_key/sort_key_encoding.h"
+#include "txn/txn_status_table.h"
+#include "util/bloom_filter.h"
+#include "util/pool_allocator.h"
+#include <algorithm>
 #include <atomic>
+#include <cassert>
 #include <cstddef>
+#include <cstring>
+#include <limits>
 #include <memory>
+#include <optional>
 #include <string>
+#include <vector>
 
 namespace arcanedb {
 namespace btree {
@@ -30,20 +44,73 @@ class VersionedDeltaNode : public RowOwner {
     // highest bit stores whether row is deleted.
     // 31 bit stores offset
     uint32_t control_bit{};
-    // TODO(sheep): 16 entry per cache line. false sharing might hurt
-    // performance
-    std::atomic<TxnTs> write_ts{};
-
-    Entry() = default;
-    Entry(const Entry &rhs) noexcept
-        : control_bit(rhs.control_bit),
-          write_ts(rhs.write_ts.load(std::memory_order_relaxed)) {}
+    TxnTs write_ts{};
   };
 
-  static constexpr size_t kDefaultVersionChainLength = 8;
+  // single row delta, which is the most common one, keeps control bit
+  // inline.
+  using ControlBitContainer = absl::InlinedVector<uint32_t, 1>;
 
-  using VersionContainer =
-      std::vector<absl::InlinedVector<Entry, kDefaultVersionChainLength>>;
+  /**
+   * @brief
+   * Newest versions of rows, stored as structure of arrays.
+   * Used for building delta node.
+   */
+  struct RowContainer {
+    ControlBitContainer control_bits;
+    std::vector<TxnTs> write_ts;
+
+    void reserve(size_t n) noexcept {
+      control_bits.reserve(n);
+      write_ts.reserve(n);
+    }
+
+    void emplace_back(const Entry &entry) noexcept {
+      control_bits.push_back(entry.control_bit);
+      write_ts.push_back(entry.write_ts);
+    }
+  };
+
+  /**
+   * @brief
+   * Old versions of rows in CSR layout, versions of row i are
+   * entries[offsets[i], offsets[i + 1]), ordered from newest to oldest.
+   * Both arrays are empty when no row has old version.
+   * old versions are immutable, since only the newest version could be
+   * updated by SetTs.
+   */
+  struct VersionContainer {
+    std::vector<Entry> entries;
+    std::vector<uint32_t> offsets;
+
+    bool empty() const noexcept { return entries.empty(); }
+
+    // start the versions of next row.
+    void AddRow() noexcept { offsets.push_back(entries.size()); }
+
+    void emplace_back(const Entry &entry) noexcept { entries.push_back(entry); }
+
+    // close the last row, must be called after all rows are added.
+    void Finish() noexcept {
+      if (entries.empty()) {
+        offsets.clear();
+        offsets.shrink_to_fit();
+        return;
+      }
+      offsets.push_back(entries.size());
+      entries.shrink_to_fit();
+    }
+
+    absl::Span<const Entry> GetVersions(size_t idx) const noexcept {
+      return absl::MakeConstSpan(entries.data() + offsets[idx],
+                                 offsets[idx + 1] - offsets[idx]);
+    }
+
+    size_t GetCharge() const noexcept {
+      return entries.capacity() * sizeof(Entry) +
+             offsets.capacity() * sizeof(uint32_t);
+    }
+  };
 
 public:
   // ctor for insert and update
@@ -53,10 +120,24 @@ public:
   VersionedDeltaNode(property::SortKeysRef sort_key, TxnTs ts) noexcept;
 
   VersionedDeltaNode(std::string buffer, std::string version_buffer,
-                     std::vector<Entry> rows,
-                     VersionContainer versions) noexcept
-      : buffer_(std::move(buffer)), version_buffer_(std::move(version_buffer)),
-        rows_(std::move(rows)), versions_(std::move(versions)) {}
+                     RowContainer rows, VersionContainer versions) noexcept;
+
+  /**
+   * @brief
+   * Create single row delta for insert and update. node and its control
+   * block are allocated in one block from object pool, since writes are
+   * buffered as single row deltas. short rows are stored inline, see
+   * SingleRowDeltaNode.
+   * @param row
+   * @param ts
+   * @return std::shared_ptr<VersionedDeltaNode>
+   */
+  static std::shared_ptr<VersionedDeltaNode> New(const property::Row &row,
+                                                 TxnTs ts) noexcept;
+
+  // create single row delta for delete.
+  static std::shared_ptr<VersionedDeltaNode> New(property::SortKeysRef sort_key,
+                                                 TxnTs ts) noexcept;
 
   void SetPrevious(std::shared_ptr<VersionedDeltaNode> previous) noexcept {
     total_length_ = (previous == nullptr ? 0 : previous->GetTotalLength()) + 1;
@@ -67,13 +148,97 @@ public:
     return previous_;
   }
 
+  /**
+   * @brief
+   * Get previous node without touching the reference count.
+   * Caller should guarantee the liveness of the chain, i.e. by holding the
+   * epoch guard or holding a reference to the head of the chain.
+   * @return VersionedDeltaNode*
+   */
+  VersionedDeltaNode *GetPreviousPtr() const noexcept {
+    return previous_.get();
+  }
+
   bool GetRow(int idx, property::Row *row) const noexcept {
-    auto offset = GetOffset(rows_[idx].control_bit);
-    *row = property::Row(buffer_.data() + offset);
-    return IsDeleted(rows_[idx].control_bit);
+    auto offset = GetOffset(control_bits_[idx]);
+    *row = property::Row(row_data_ + offset);
+    return IsDeleted(control_bits_[idx]);
+  }
+
+  size_t GetSize() const noexcept { return control_bits_.size(); }
+
+  bool HasOldVersion() const noexcept { return !versions_.empty(); }
+
+  enum class Visibility : uint8_t {
+    kVisible,
+    kInvisible,
+    // intent of another txn, reader should wait for it.
+    kLocked,
+  };
+
+  // whether the version is an intent that reader should wait for.
+  static bool ShouldWaitIntent(TxnTs write_ts, const Options &opts) noexcept {
+    return IsLocked(write_ts) && !opts.ignore_lock &&
+           !(opts.owner_ts.has_value() && *opts.owner_ts == GetTs(write_ts));
   }
 
-  size_t GetSize() const noexcept { return rows_.size(); }
+  /**
+   * @brief
+   * Visibility of a resolved version to reader, shared by all read paths so
+   * that they won't drift.
+   * @param write_ts
+   * @param read_ts
+   * @param opts
+   * @return Visibility
+   */
+  static Visibility CheckVisibility(TxnTs write_ts, TxnTs read_ts,
+                                    const Options &opts) noexcept {
+    if (ShouldWaitIntent(write_ts, opts)) {
+      return Visibility::kLocked;
+    }
+    return IsVisible_(read_ts, write_ts) ? Visibility::kVisible
+                                         : Visibility::kInvisible;
+  }
+
+  /**
+   * @brief
+   * Check visibility of the newest versions of rows in [begin, begin + count).
+   * timestamps are stored contiguously, so the loop is branchless and could
+   * be vectorized.
+   * @param read_ts
+   * @param begin
+   * @param count no larger than 64.
+   * @param locked_mask bit i is set when row begin + i is locked.
+   * @return uint64_t bit i is set when row begin + i is visible to read_ts.
+   */
+  uint64_t GetVisibleMask(TxnTs read_ts, size_t begin, size_t count,
+                          uint64_t *locked_mask) const noexcept {
+    assert(count <= 64);
+    uint64_t visible = 0;
+    uint64_t locked = 0;
+    for (size_t i = 0; i < count; i++) {
+      TxnTs ts = write_ts_[begin + i].load(std::memory_order_relaxed);
+      visible |= static_cast<uint64_t>((ts != kAbortedTxnTs) & (read_ts >= ts))
+                 << i;
+      locked |= static_cast<uint64_t>(IsLocked(ts)) << i;
+    }
+    *locked_mask = locked;
+    return visible;
+  }
+
+  /**
+   * @brief
+   * Check the key range and bloom filter of this node.
+   * @param sort_key
+   * @return false when sort_key is definitely not in this node.
+   */
+  bool MayContain(property::SortKeysRef sort_key) const noexcept {
+    if (GetSize() == 0 || sort_key < min_sort_key_ ||
+        max_sort_key_ < sort_key) {
+      return false;
+    }
+    return bloom_filter_.MayContain(sort_key.as_slice());
+  }
 
   size_t GetTotalLength() const noexcept { return total_length_; }
 
@@ -106,22 +271,8 @@ public:
 
     // read lsn inside lock.
     lsn = lsn_.load();
-    for (size_t i = 0; i < rows_.size(); i++) {
-      {
-        auto offset = GetOffset(rows_[i].control_bit);
-        auto row = property::Row(buffer_.data() + offset);
-        visitor(row, IsDeleted(rows_[i].control_bit),
-                rows_[i].write_ts.load(std::memory_order_relaxed));
-      }
-      if (version_buffer_.empty()) {
-        continue;
-      }
-      for (const Entry &entry : versions_[i]) {
-        auto offset = GetOffset(entry.control_bit);
-        auto row = property::Row(version_buffer_.data() + offset);
-        visitor(row, IsDeleted(entry.control_bit),
-                entry.write_ts.load(std::memory_order_relaxed));
-      }
+    for (size_t i = 0; i < GetSize(); i++) {
+      TraverseRow_(i, visitor);
     }
 
     if (unlikely(should_lock)) {
@@ -142,20 +293,14 @@ public:
   Status GetRow(property::SortKeysRef sort_key, TxnTs read_ts,
                 const Options &opts, RowView *view) const noexcept {
     // first locate sort_key
-    auto it = std::lower_bound(
-        rows_.begin(), rows_.end(), sort_key,
-        [&](const Entry &entry, const property::SortKeysRef &sort_key) {
-          auto offset = GetOffset(entry.control_bit);
-          auto row = property::Row(buffer_.data() + offset);
-          return row.GetSortKeys() < sort_key;
-        });
-    if (it == rows_.end()) {
+    auto idx = LowerBound_(sort_key);
+    if (idx == GetSize()) {
       return Status::NotFound();
     }
 
-    auto &entry = *it;
-    auto offset = GetOffset(entry.control_bit);
-    auto row = property::Row(buffer_.data() + offset);
+    auto control_bit = control_bits_[idx];
+    auto offset = GetOffset(control_bit);
+    auto row = property::Row(row_data_ + offset);
     if (row.GetSortKeys() != sort_key) {
       // sk not match
       return Status::NotFound();
@@ -164,80 +309,108 @@ public:
     // only newest version can be locked
     // relaxed here is ok since we will acquire lock outside, which has the
     // acquire semantic.
-    if (auto write_ts = entry.write_ts.load(std::memory_order_relaxed);
-        IsLocked(write_ts)) {
-      if (opts.ignore_lock) {
-        // skip the intent, since we are read-only txn
-      } else if (opts.owner_ts.has_value() &&
-                 *opts.owner_ts == GetTs(write_ts)) {
-        // ignore, since we are the owner.
-      } else {
-        return Status::RowLocked();
-      }
+    auto write_ts = txn::TxnStatusTable::GetInstance()->Resolve(
+        write_ts_[idx].load(std::memory_order_relaxed));
+    auto visibility = CheckVisibility(write_ts, read_ts, opts);
+    if (visibility == Visibility::kLocked) {
+      return Status::RowLocked();
     }
 
     // try read newest version
-    if (IsVisible_(read_ts, entry.write_ts.load(std::memory_order_relaxed))) {
-      return ReadVersion_(row, entry, view);
-    }
-
-    // no old version
-    if (versions_.empty()) {
-      return Status::NotFound();
+    if (visibility == Visibility::kVisible) {
+      return ReadVersion_(row, control_bit, write_ts, view);
     }
 
     // try old versions
-    auto index = std::distance(rows_.begin(), it);
-    for (const Entry &version : versions_[index]) {
-      if (IsVisible_(read_ts, version.write_ts)) {
-        auto offset = GetOffset(version.control_bit);
-        auto row = property::Row(version_buffer_.data() + offset);
-        return ReadVersion_(row, version, view);
-      }
+    const Entry *version = FindVisibleOldVersion_(idx, read_ts);
+    if (version == nullptr) {
+      return Status::NotFound();
     }
-    return Status::NotFound();
+    return ReadVersion_(GetOldVersionRow_(*version), version->control_bit,
+                        version->write_ts, view);
   }
 
   /**
    * @brief
    * Set ts of the newest version with "sort_key" to "target_ts"
+   * the newest version is left untouched if it's not the intent of owner,
+   * since intents of committed txn might have been written back by flush
+   * or by writers, after which a new intent could be written on it.
    * @param sort_key
    * @param target_ts
    * @param lsn
+   * @param owner_ts any intent is updated when owner is not specified.
    * @return Status
    */
   Status SetTs(property::SortKeysRef sort_key, TxnTs target_ts,
-               log_store::LsnType lsn) noexcept {
-    // first locate sort_key
-    auto it = std::lower_bound(
-        rows_.begin(), rows_.end(), sort_key,
-        [&](const Entry &entry, const property::SortKeysRef &sort_key) {
-          auto offset = GetOffset(entry.control_bit);
-          auto row = property::Row(buffer_.data() + offset);
-          return row.GetSortKeys() < sort_key;
-        });
-    if (it == rows_.end()) {
+               log_store::LsnType lsn,
+               std::optional<TxnTs> owner_ts = std::nullopt) noexcept {
+    auto *ts = FindNewestTs_(sort_key);
+    if (ts == nullptr) {
       return Status::NotFound();
     }
+    if (IsIntentOf_(ts->load(std::memory_order_relaxed), owner_ts)) {
+      SetTs_(ts, target_ts, lsn);
+    }
+    return Status::Ok();
+  }
 
-    auto &entry = *it;
-    auto offset = GetOffset(entry.control_bit);
-    auto row = property::Row(buffer_.data() + offset);
-    if (row.GetSortKeys() != sort_key) {
-      // sk not match
-      return Status::NotFound();
+  /**
+   * @brief
+   * Get write ts of the newest version with sort_key, intents are not
+   * resolved.
+   * @param sort_key
+   * @param write_ts
+   * @return false if sort_key is not in this node.
+   */
+  bool GetNewestTs(property::SortKeysRef sort_key, TxnTs *write_ts) const
+      noexcept {
+    auto idx = LowerBound_(sort_key);
+    if (idx == GetSize() || GetSortKeys_(idx) != sort_key) {
+      return false;
     }
+    *write_ts = write_ts_[idx].load(std::memory_order_relaxed);
+    return true;
+  }
 
-    // must be locked
-    if (IsLocked(entry.write_ts.load(std::memory_order_relaxed))) {
-      lock_.Lock();
-      lsn_.store(lsn, std::memory_order_relaxed);
-      entry.write_ts.store(target_ts, std::memory_order_relaxed);
-      lock_.Unlock();
-      return Status::Ok();
+  /**
+   * @brief
+   * Replay SetTs on a node that is generated from a snapshot of delta chain,
+   * i.e. by background compaction. the newest version is only updated when it
+   * is still locked, since the SetTs might have been applied before taking the
+   * snapshot.
+   * @param sort_key
+   * @param target_ts
+   * @param lsn
+   * @param owner_ts
+   */
+  void ReplaySetTs(property::SortKeysRef sort_key, TxnTs target_ts,
+                   log_store::LsnType lsn,
+                   std::optional<TxnTs> owner_ts = std::nullopt) noexcept {
+    auto *ts = FindNewestTs_(sort_key);
+    if (ts != nullptr &&
+        IsIntentOf_(ts->load(std::memory_order_relaxed), owner_ts)) {
+      SetTs_(ts, target_ts, lsn);
+    }
+  }
+
+  /**
+   * @brief
+   * Write commit ts back to the newest versions that are intents of
+   * committed txns. versions are updated in place, and their lsn is left
+   * untouched since write back is not logged.
+   * @param owners owner ts of the intents that have been written back.
+   */
+  void WriteBackIntents(std::vector<TxnTs> *owners) noexcept {
+    auto *status_table = txn::TxnStatusTable::GetInstance();
+    for (size_t i = 0; i < GetSize(); i++) {
+      auto write_ts = write_ts_[i].load(std::memory_order_relaxed);
+      auto commit_ts = status_table->Resolve(write_ts);
+      if (commit_ts != write_ts) {
+        SetTs_(&write_ts_[i], commit_ts, log_store::kInvalidLsn);
+        owners->push_back(GetTs(write_ts));
+      }
     }
-    // first entry is not locked, logical error might happens
-    UNREACHABLE();
   }
 
   VersionedDeltaNode() = default;
@@ -245,13 +418,186 @@ public:
   std::string TEST_DumpChain() const noexcept;
 
   size_t GetTotalCharge() noexcept {
-    // TODO(sheep): take versions into account.
-    return buffer_.size() + version_buffer_.size() +
-           rows_.capacity() * sizeof(Entry) + sizeof(VersionedDeltaNode);
+    // row stored outside of buffer_ is the inline row of SingleRowDeltaNode.
+    size_t inline_row_size = GetSize() != 0 && row_data_ != buffer_.data()
+                                 ? common::Config::kBwTreeInlineRowSize
+                                 : 0;
+    return buffer_.size() + version_buffer_.size() + versions_.GetCharge() +
+           inline_row_size +
+           control_bits_.capacity() * sizeof(uint32_t) +
+           (write_ts_holder_ ? GetSize() * sizeof(std::atomic<TxnTs>) : 0) +
+           bloom_filter_.GetCharge() +
+           key_prefixes_.capacity() * sizeof(uint64_t) +
+           int64_keys_.capacity() * sizeof(int64_t) +
+           sizeof(VersionedDeltaNode);
   }
 
+protected:
+  /**
+   * @brief
+   * Initialize single row delta whose row is already serialized at
+   * row_data, which should outlive this node.
+   * @param row_data
+   * @param is_deleted
+   * @param ts
+   */
+  void InitSingleRow_(const char *row_data, bool is_deleted,
+                      TxnTs ts) noexcept;
+
 private:
   friend class VersionedDeltaNodeBuilder;
+  friend class VersionedDeltaNodeMerger;
+  friend class VersionedDeltaNodeStream;
+
+  // build min/max sort key, bloom filter and key prefixes (or int64 keys),
+  // must be called after rows are filled.
+  void BuildKeyIndex_() noexcept;
+
+  // decode keys into int64_keys_ if every row has a single int64 sort key.
+  bool BuildInt64Keys_() noexcept;
+
+  // load 8 bytes of key starting at offset as a big endian integer, missing
+  // bytes are filled with zero. so that order of prefixes is consistent with
+  // memcmp order of keys.
+  static uint64_t LoadKeyPrefix_(std::string_view key, size_t offset) noexcept {
+    uint64_t prefix = 0;
+    if (offset < key.size()) {
+      std::memcpy(&prefix, key.data() + offset,
+                  std::min(sizeof(uint64_t), key.size() - offset));
+    }
+    return absl::big_endian::ToHost64(prefix);
+  }
+
+  // single int64 sort key is encoded as one type byte and 8 bytes value.
+  static constexpr size_t kInt64SortKeyLength = 1 + sizeof(int64_t);
+
+  // decode the leading column of key when it is an int64.
+  static bool LoadInt64Key_(std::string_view key, int64_t *value) noexcept {
+    if (key.size() < kInt64SortKeyLength ||
+        static_cast<uint8_t>(key[0]) !=
+            static_cast<uint8_t>(property::ValueType::Int64)) {
+      return false;
+    }
+    key.remove_prefix(1);
+    property::GetComparableFixed64(&key, value);
+    return true;
+  }
+
+  // branchless lower bound over sorted array, requires size > 0.
+  template <typename T>
+  static size_t BranchlessLowerBound_(const T *data, size_t size,
+                                      T target) noexcept {
+    const T *base = data;
+    size_t len = size;
+    while (len > 1) {
+      size_t half = len / 2;
+      base = base[half] < target ? base + half : base;
+      len -= half;
+    }
+    return (base - data) + (*base < target);
+  }
+
+  size_t PrefixLowerBound_(uint64_t prefix) const noexcept {
+    return BranchlessLowerBound_(key_prefixes_.data(), key_prefixes_.size(),
+                                 prefix);
+  }
+
+  // lower bound over int64 keys, requires non-empty int keys.
+  size_t Int64LowerBound_(property::SortKeysRef sort_key,
+                          int64_t key) const noexcept {
+    if (sort_key.as_slice().size() != kInt64SortKeyLength) {
+      // every row has exactly one column, so the longer sort key sorts right
+      // after the row with the same leading column.
+      if (key == std::numeric_limits<int64_t>::max()) {
+        return GetSize();
+      }
+      key += 1;
+    }
+    return BranchlessLowerBound_(int64_keys_.data(), int64_keys_.size(), key);
+  }
+
+  property::SortKeysRef GetSortKeys_(size_t idx) const noexcept {
+    auto offset = GetOffset(control_bits_[idx]);
+    return property::Row(row_data_ + offset).GetSortKeys();
+  }
+
+  property::Row GetOldVersionRow_(const Entry &entry) const noexcept {
+    return property::Row(version_buffer_.data() + GetOffset(entry.control_bit));
+  }
+
+  // newest old version of row at idx which is visible to read_ts.
+  const Entry *FindVisibleOldVersion_(size_t idx, TxnTs read_ts) const
+      noexcept {
+    if (versions_.empty()) {
+      return nullptr;
+    }
+    for (const Entry &version : versions_.GetVersions(idx)) {
+      if (IsVisible_(read_ts, version.write_ts)) {
+        return &version;
+      }
+    }
+    return nullptr;
+  }
+
+  // index of the first row whose sort key is not less than sort_key.
+  size_t LowerBound_(property::SortKeysRef sort_key) const noexcept {
+    size_t begin = 0;
+    size_t end = GetSize();
+    int64_t key;
+    if (!int64_keys_.empty() && LoadInt64Key_(sort_key.as_slice(), &key)) {
+      return Int64LowerBound_(sort_key, key);
+    }
+    if (!key_prefixes_.empty()) {
+      if (sort_key <= min_sort_key_) {
+        return 0;
+      }
+      if (max_sort_key_ < sort_key) {
+        return GetSize();
+      }
+      // sort_key is within [min, max], so it shares the common prefix of
+      // min and max, which is skipped by key prefixes. only rows with the
+      // same key prefix need to be compared with the row body.
+      auto prefix = LoadKeyPrefix_(sort_key.as_slice(), prefix_offset_);
+      begin = PrefixLowerBound_(prefix);
+      end = prefix == std::numeric_limits<uint64_t>::max()
+                ? GetSize()
+                : PrefixLowerBound_(prefix + 1);
+    }
+    size_t len = end - begin;
+    while (len > 0) {
+      size_t half = len / 2;
+      if (GetSortKeys_(begin + half) < sort_key) {
+        begin += half + 1;
+        len -= half + 1;
+      } else {
+        len = half;
+      }
+    }
+    return begin;
+  }
+
+  // visit all versions of row at idx, from newest to oldest.
+  // intents are passed as is when resolve_intents is false.
+  template <typename Visitor>
+  void TraverseRow_(size_t idx, Visitor &visitor,
+                    bool resolve_intents = true) const noexcept {
+    {
+      auto offset = GetOffset(control_bits_[idx]);
+      auto row = property::Row(row_data_ + offset);
+      auto write_ts = write_ts_[idx].load(std::memory_order_relaxed);
+      visitor(row, IsDeleted(control_bits_[idx]),
+              resolve_intents
+                  ? txn::TxnStatusTable::GetInstance()->Resolve(write_ts)
+                  : write_ts);
+    }
+    if (version_buffer_.empty()) {
+      return;
+    }
+    for (const Entry &entry : versions_.GetVersions(idx)) {
+      visitor(GetOldVersionRow_(entry), IsDeleted(entry.control_bit),
+              entry.write_ts);
+    }
+  }
 
   inline static bool IsVisible_(TxnTs read_ts, TxnTs write_ts) noexcept {
     // aborted version is not visible
@@ -262,17 +608,46 @@ private:
   }
 
   // hope to inline
-  inline Status ReadVersion_(const property::Row &row, const Entry &entry,
-                             RowView *view) const noexcept {
-    if (IsDeleted(entry.control_bit)) {
+  inline Status ReadVersion_(const property::Row &row, uint32_t control_bit,
+                             TxnTs write_ts, RowView *view) const noexcept {
+    if (IsDeleted(control_bit)) {
       return Status::Deleted();
     }
-    view->PushBackRef(
-        RowWithTs(row, entry.write_ts.load(std::memory_order_relaxed)));
+    view->PushBackRef(RowWithTs(row, write_ts));
     view->AddOwnerPointer(shared_from_this());
     return Status::Ok();
   }
 
+  // timestamp of the newest version with sort_key.
+  std::atomic<TxnTs> *FindNewestTs_(property::SortKeysRef sort_key) noexcept {
+    // first locate sort_key
+    auto idx = LowerBound_(sort_key);
+    if (idx == GetSize()) {
+      return nullptr;
+    }
+    if (GetSortKeys_(idx) != sort_key) {
+      // sk not match
+      return nullptr;
+    }
+    return &write_ts_[idx];
+  }
+
+  static bool IsIntentOf_(TxnTs write_ts,
+                          std::optional<TxnTs> owner_ts) noexcept {
+    return IsLocked(write_ts) &&
+           (!owner_ts.has_value() || *owner_ts == GetTs(write_ts));
+  }
+
+  void SetTs_(std::atomic<TxnTs> *ts, TxnTs target_ts,
+              log_store::LsnType lsn) noexcept {
+    lock_.Lock();
+    if (lsn != log_store::kInvalidLsn) {
+      lsn_.store(lsn, std::memory_order_relaxed);
+    }
+    ts->store(target_ts, std::memory_order_relaxed);
+    lock_.Unlock();
+  }
+
   static constexpr size_t kStateOffset = 31;
   static constexpr size_t kOffsetMask = 0x7fffffff;
   static constexpr size_t kMaximumOffset = kOffsetMask;
@@ -289,11 +664,33 @@ private:
     entry->control_bit = entry->control_bit | (1 << kStateOffset);
   }
 
+  // rows of node, unless the single row is stored inline by
+  // SingleRowDeltaNode.
   std::string buffer_{};
   std::string version_buffer_{};
-  std::vector<Entry> rows_{};
+  // points to either buffer_ or the inline row of SingleRowDeltaNode.
+  const char *row_data_{};
+  // newest versions of rows, stored as structure of arrays. control bits are
+  // immutable, while timestamps might be updated by SetTs. keeping them apart
+  // prevents SetTs from invalidating cache lines that searching readers use.
+  ControlBitContainer control_bits_{};
+  std::unique_ptr<std::atomic<TxnTs>[]> write_ts_holder_{};
+  // single row node stores its timestamp inline to avoid an allocation.
+  std::atomic<TxnTs> inline_write_ts_{};
+  std::atomic<TxnTs> *write_ts_{&inline_write_ts_};
   VersionContainer versions_;
   std::shared_ptr<VersionedDeltaNode> previous_{};
+  // referencing row_data_.
+  property::SortKeysRef min_sort_key_{};
+  property::SortKeysRef max_sort_key_{};
+  util::BloomFilter bloom_filter_{};
+  // fixed-width normalized key prefixes of rows, which are the 8 bytes after
+  // the common prefix of min and max sort key.
+  std::vector<uint64_t> key_prefixes_{};
+  uint32_t prefix_offset_{};
+  // dense decoded keys when every row has a single int64 sort key, e.g.
+  // adjacency lists keyed by destination vertex. replaces key prefixes.
+  std::vector<int64_t> int64_keys_{};
   uint32_t total_length_{};
   std::atomic<log_store::LsnType> lsn_{};
   // spin lock is used to protect the atomicity of
@@ -301,19 +698,363 @@ private:
   mutable absl::base_internal::SpinLock lock_;
 };
 
+/**
+ * @brief
+ * Single row delta whose row is stored inline, so that buffered writes with
+ * short rows are built with one pooled allocation, while base and merged
+ * nodes don't pay for the inline buffer.
+ */
+class SingleRowDeltaNode : public VersionedDeltaNode {
+public:
+  // ctor for insert and update, row should fit in kInlineRowSize.
+  SingleRowDeltaNode(const property::Row &row, TxnTs ts) noexcept;
+
+  // ctor for delete, row should fit in kInlineRowSize.
+  SingleRowDeltaNode(property::SortKeysRef sort_key, TxnTs ts) noexcept;
+
+  static constexpr size_t kInlineRowSize =
+      common::Config::kBwTreeInlineRowSize;
+
+private:
+  char inline_row_[kInlineRowSize];
+};
+
+inline std::shared_ptr<VersionedDeltaNode>
+VersionedDeltaNode::New(const property::Row &row, TxnTs ts) noexcept {
+  if (row.as_slice().size() <= SingleRowDeltaNode::kInlineRowSize) {
+    return std::allocate_shared<SingleRowDeltaNode>(
+        util::PoolAllocator<SingleRowDeltaNode>(), row, ts);
+  }
+  return std::allocate_shared<VersionedDeltaNode>(
+      util::PoolAllocator<VersionedDeltaNode>(), row, ts);
+}
+
+inline std::shared_ptr<VersionedDeltaNode>
+VersionedDeltaNode::New(property::SortKeysRef sort_key, TxnTs ts) noexcept {
+  if (property::Row::GetOnlySortKeyRowSize(sort_key) <=
+      SingleRowDeltaNode::kInlineRowSize) {
+    return std::allocate_shared<SingleRowDeltaNode>(
+        util::PoolAllocator<SingleRowDeltaNode>(), sort_key, ts);
+  }
+  return std::allocate_shared<VersionedDeltaNode>(
+      util::PoolAllocator<VersionedDeltaNode>(), sort_key, ts);
+}
+
+/**
+ * @brief
+ * Range of a scan over delta nodes, sort keys are referencing the memory owned
+ * by caller.
+ */
+struct DeltaScanRange {
+  // inclusive, nullopt means unbounded.
+  std::optional<property::SortKeysRef> start{};
+  // exclusive, nullopt means unbounded.
+  std::optional<property::SortKeysRef> end{};
+  // visit sort keys in descending order. versions of the same sort key are
+  // still visited from the newest to the oldest.
+  bool reverse{false};
+};
+
+/**
+ * @brief
+ * Pull-based k-way merge over delta nodes.
+ * Rows in each delta node are already sorted by sort key, so rows of the whole
+ * chain could be streamed in sort key order with a heap of cursors, one sort
+ * key at a time. Memory usage is bounded by the number of delta nodes.
+ * Delta nodes should be passed from the newest to the oldest, so that versions
+ * with the same sort key are visited from the newest to the oldest.
+ */
+class VersionedDeltaNodeStream {
+public:
+  VersionedDeltaNodeStream() = default;
+
+  /**
+   * @brief
+   * Position the stream at the first sort key within range.
+   * @param nodes delta nodes from the newest to the oldest.
+   * @param range
+   * @param resolve_intents resolve intents of committed txns to commit ts.
+   */
+  void Init(const std::vector<const VersionedDeltaNode *> &nodes,
+            const DeltaScanRange &range,
+            bool resolve_intents = true) noexcept {
+    reverse_ = range.reverse;
+    resolve_intents_ = resolve_intents;
+    heap_.clear();
+    heap_.reserve(nodes.size());
+    for (size_t i = 0; i < nodes.size(); i++) {
+      const auto *node = nodes[i];
+      size_t begin =
+          range.start.has_value() ? node->LowerBound_(*range.start) : 0;
+      size_t end = range.end.has_value() ? node->LowerBound_(*range.end)
+                                         : node->GetSize();
+      if (begin >= end) {
+        continue;
+      }
+      size_t row_idx = reverse_ ? end - 1 : begin;
+      heap_.push_back(Cursor{.sort_key = node->GetSortKeys_(row_idx),
+                             .node = node,
+                             .node_idx = i,
+                             .row_idx = row_idx,
+                             .begin = begin,
+                             .end = end});
+    }
+    std::make_heap(heap_.begin(), heap_.end(), Compare{reverse_});
+  }
+
+  bool Valid() const noexcept { return !heap_.empty(); }
+
+  /**
+   * @brief
+   * Sort key the stream is positioned at, requires Valid().
+   */
+  property::SortKeysRef GetSortKeys() const noexcept {
+    return heap_.front().sort_key;
+  }
+
+  /**
+   * @brief
+   * Visit all versions of current sort key, then move to the next sort key.
+   * @tparam Visitor
+   * Visitor requires four parameter, first three are the same as
+   * VersionedDeltaNode::Traverse, the last one indicates whether this is the
+   * first version of a sort key. returning false skips the remaining versions.
+   * @param visitor
+   * @return false when visitor has returned false.
+   */
+  template <typename Visitor> bool VisitKey(Visitor &visitor) noexcept {
+    Compare cmp{reverse_};
+    auto sort_key = heap_.front().sort_key;
+    bool is_newest = true;
+    bool stopped = false;
+    auto row_visitor = [&](const property::Row &row, bool is_deleted,
+                           TxnTs write_ts) {
+      if (stopped) {
+        return;
+      }
+      stopped = !visitor(row, is_deleted, write_ts, is_newest);
+      is_newest = false;
+    };
+    while (!heap_.empty() && heap_.front().sort_key == sort_key) {
+      std::pop_heap(heap_.begin(), heap_.end(), cmp);
+      auto &cursor = heap_.back();
+      cursor.node->TraverseRow_(cursor.row_idx, row_visitor, resolve_intents_);
+      bool exhausted = reverse_ ? cursor.row_idx == cursor.begin
+                                : cursor.row_idx + 1 == cursor.end;
+      if (!exhausted) {
+        cursor.row_idx = reverse_ ? cursor.row_idx - 1 : cursor.row_idx + 1;
+        cursor.sort_key = cursor.node->GetSortKeys_(cursor.row_idx);
+        std::push_heap(heap_.begin(), heap_.end(), cmp);
+      } else {
+        heap_.pop_back();
+      }
+    }
+    return !stopped;
+  }
+
+private:
+  static constexpr size_t kDefaultMergeWay = 16;
+
+  // rows of cursor are [begin, end) of the node, forward cursor moves
+  // row_idx from begin to end, reverse cursor moves from end - 1 to begin.
+  struct Cursor {
+    property::SortKeysRef sort_key;
+    const VersionedDeltaNode *node;
+    size_t node_idx;
+    size_t row_idx;
+    size_t begin;
+    size_t end;
+  };
+
+  // std heap is max heap, so cursor which should be visited first, i.e.
+  // with smaller(larger when reverse) sort key or newer node, should be
+  // "greater".
+  struct Compare {
+    bool reverse;
+    bool operator()(const Cursor &lhs, const Cursor &rhs) const noexcept {
+      if (lhs.sort_key != rhs.sort_key) {
+        return reverse ? lhs.sort_key < rhs.sort_key
+                       : rhs.sort_key < lhs.sort_key;
+      }
+      return lhs.node_idx > rhs.node_idx;
+    }
+  };
+
+  bool reverse_{false};
+  bool resolve_intents_{true};
+  absl::InlinedVector<Cursor, kDefaultMergeWay> heap_;
+};
+
+/**
+ * @brief
+ * K-way merge over delta nodes, see VersionedDeltaNodeStream.
+ * Delta nodes should be added from the newest to the oldest.
+ */
+class VersionedDeltaNodeMerger {
+public:
+  VersionedDeltaNodeMerger() = default;
+
+  void AddDeltaNode(const VersionedDeltaNode *node) noexcept {
+    if (node->GetSize() != 0) {
+      nodes_.push_back(node);
+    }
+  }
+
+  size_t GetDeltaCount() const noexcept { return nodes_.size(); }
+
+  /**
+   * @brief
+   * Merge the delta nodes.
+   * @tparam Visitor
+   * Visitor requires four parameter, first three are the same as
+   * VersionedDeltaNode::Traverse, the last one indicates whether this is the
+   * first version of a sort key.
+   * @param visitor
+   * @param should_lock lock all nodes during merging, so that the returned lsn
+   * covers all timestamps we have visited.
+   * @param resolve_intents intents are passed as is when false, which is
+   * required when the merged versions replace the delta nodes, so that each
+   * intent is written back exactly once.
+   * @return log_store::LsnType maximum lsn of the delta nodes.
+   */
+  template <typename Visitor>
+  log_store::LsnType Merge(Visitor visitor, bool should_lock = false,
+                           bool resolve_intents = true) const noexcept {
+    return MergeImpl_(
+        DeltaScanRange{},
+        [&](const property::Row &row, bool is_deleted, TxnTs write_ts,
+            bool is_newest) {
+          visitor(row, is_deleted, write_ts, is_newest);
+          return true;
+        },
+        should_lock, resolve_intents);
+  }
+
+  /**
+   * @brief
+   * Merge the rows within range.
+   * @tparam Visitor
+   * Same as Merge, except that visitor returns bool, and returning false
+   * stops the scan immediately.
+   * @param range
+   * @param visitor
+   */
+  template <typename Visitor>
+  void Scan(const DeltaScanRange &range, Visitor visitor) const noexcept {
+    MergeImpl_(range, visitor, false, true);
+  }
+
+private:
+  template <typename Visitor>
+  log_store::LsnType MergeImpl_(const DeltaScanRange &range, Visitor visitor,
+                                bool should_lock,
+                                bool resolve_intents) const noexcept {
+    log_store::LsnType lsn{};
+    for (const auto *node : nodes_) {
+      if (unlikely(should_lock)) {
+        node->lock_.Lock();
+      }
+      lsn = std::max(lsn, node->lsn_.load());
+    }
+
+    VersionedDeltaNodeStream stream;
+    stream.Init(nodes_, range, resolve_intents);
+    while (stream.Valid() && stream.VisitKey(visitor)) {
+    }
+
+    if (unlikely(should_lock)) {
+      for (const auto *node : nodes_) {
+        node->lock_.Unlock();
+      }
+    }
+    return lsn;
+  }
+
+  std::vector<const VersionedDeltaNode *> nodes_;
+};
+
+/**
+ * @brief
+ * Decide which versions could be dropped according to the low watermark.
+ * Readers always read at a ts no smaller than the low watermark, so for each
+ * row, only versions newer than the watermark and the newest version below the
+ * watermark are visible. Aborted versions are never visible.
+ * Versions should be fed in the merge order, i.e. from the newest version to
+ * the oldest version of each row.
+ */
+class VersionPruner {
+public:
+  /**
+   * @brief
+   * @param low_watermark 0 indicates only aborted versions could be dropped.
+   * @param drop_tombstone whether tombstone below the watermark could be
+   * dropped, which requires that there is no older version outside of the
+   * merged delta nodes, i.e. the merge reaches the end of delta chain.
+   */
+  VersionPruner(TxnTs low_watermark, bool drop_tombstone) noexcept
+      : low_watermark_(low_watermark), drop_tombstone_(drop_tombstone) {}
+
+  bool ShouldKeep(bool is_deleted, TxnTs write_ts, bool is_newest) noexcept {
+    if (is_newest) {
+      below_watermark_ = false;
+    }
+    if (write_ts == kAbortedTxnTs || below_watermark_) {
+      return false;
+    }
+    // intents are always kept.
+    if (IsLocked(write_ts) || write_ts > low_watermark_) {
+      return true;
+    }
+    // newest version below the watermark.
+    below_watermark_ = true;
+    return !(is_deleted && drop_tombstone_);
+  }
+
+private:
+  const TxnTs low_watermark_;
+  const bool drop_tombstone_;
+  bool below_watermark_{false};
+};
+
 class VersionedDeltaNodeBuilder {
   friend class VersionedBwTreePage;
 
 public:
   VersionedDeltaNodeBuilder() = default;
 
-  void AddDeltaNode(const VersionedDeltaNode *node) noexcept;
+  /**
+   * @brief
+   * Add delta node to builder, delta nodes should be added from the newest to
+   * the oldest. node should outlive the builder.
+   * @param node
+   */
+  void AddDeltaNode(const VersionedDeltaNode *node) noexcept {
+    merger_.AddDeltaNode(node);
+    row_cnt_ += node->GetSize();
+  }
+
+  /**
+   * @brief
+   * Drop versions that are invisible to all readers while generating.
+   * @param low_watermark
+   * @param drop_tombstone
+   */
+  void SetLowWatermark(TxnTs low_watermark, bool drop_tombstone) noexcept {
+    low_watermark_ = low_watermark;
+    drop_tombstone_ = drop_tombstone;
+  }
 
   std::shared_ptr<VersionedDeltaNode> GenerateDeltaNode() noexcept;
 
-  size_t GetRowSize() const noexcept { return map_.size(); }
+  /**
+   * @brief
+   * Get the upper bound of row count, rows in different delta nodes might
+   * share the same sort key.
+   * @return size_t
+   */
+  size_t GetRowSize() const noexcept { return row_cnt_; }
 
-  size_t GetDeltaCount() const noexcept { return delta_cnt_; }
+  size_t GetDeltaCount() const noexcept { return merger_.GetDeltaCount(); }
 
 private:
   struct BuildEntry {
@@ -327,7 +1068,7 @@ private:
                         const BuildEntry &build_entry) noexcept {
     VersionedDeltaNode::Entry entry;
     entry.control_bit = writer->Offset();
-    entry.write_ts.store(build_entry.write_ts, std::memory_order_relaxed);
+    entry.write_ts = build_entry.write_ts;
     if (build_entry.is_deleted) {
       VersionedDeltaNode::MarkDeleted(&entry);
     }
@@ -335,8 +1076,10 @@ private:
     container.emplace_back(entry);
   }
 
-  std::map<property::SortKeysRef, std::vector<BuildEntry>> map_;
-  size_t delta_cnt_;
+  VersionedDeltaNodeMerger merger_;
+  size_t row_cnt_{};
+  TxnTs low_watermark_{0};
+  bool drop_tombstone_{false};
 };
 
 } // namespace btree
@@ -10,8 +10,11 @@
  */
 
 #include "btree/sub_table.h"
+#include "bthread/bthread.h"
 #include "cache/buffer_pool.h"
+#include "common/config.h"
 #include "common/logger.h"
+#include "wal/btree_smo_log_writer.h"
 
 namespace arcanedb {
 namespace btree {
@@ -19,15 +22,321 @@ namespace btree {
 Status SubTable::OpenSubTable(const std::string_view &table_key,
                               const Options &opts,
                               std::unique_ptr<SubTable> *sub_table) noexcept {
-  // root page id is table key
+  // packed pages are indexed by bucket in hot page table, so that page id is
+  // only formatted when the page is not hot.
+  size_t bucket = 0;
+  PageIdHash hot_hash;
+  if (opts.enable_packed_page) {
+    bucket = PackedPage::GetPackedPageBucket(table_key);
+    hot_hash = bucket;
+  } else {
+    hot_hash = cache::BufferPool::HashPageId(table_key);
+  }
+  auto attachment = opts.buffer_pool->TakeHotAttachment(hot_hash);
+  auto *cached = dynamic_cast<SubTable *>(attachment.get());
+  if (cached != nullptr && cached->table_key_ == table_key &&
+      static_cast<bool>(cached->packed_page_) == opts.enable_packed_page) {
+    attachment.release();
+    sub_table->reset(cached);
+    return Status::Ok();
+  }
   cache::BufferPool::PageHolder page_holder;
-  auto s = opts.buffer_pool->GetPage(table_key, &page_holder);
+  if (opts.enable_packed_page) {
+    // subtable is routed to its own page lazily once it's promoted.
+    auto s = opts.buffer_pool->GetHotPage(PackedPage::GetPackedPageId(bucket),
+                                          hot_hash, &page_holder);
+    if (!s.ok()) {
+      return s;
+    }
+    *sub_table = std::make_unique<SubTable>(table_key, hot_hash,
+                                            std::move(page_holder));
+    return Status::Ok();
+  }
+  // root page id is table key
+  auto s = opts.buffer_pool->GetHotPage(table_key, hot_hash, &page_holder);
   if (!s.ok()) {
     return s;
   }
-  *sub_table = std::make_unique<SubTable>(page_holder);
+  *sub_table = std::make_unique<SubTable>(hot_hash, std::move(page_holder));
   return Status::Ok();
 }
 
+void SubTable::CloseSubTable(cache::BufferPool *buffer_pool,
+                             std::unique_ptr<SubTable> sub_table) noexcept {
+  auto hot_hash = sub_table->hot_hash_;
+  if (!sub_table->packed_page_) {
+    const auto &root_page = sub_table->cluster_index_->GetRootPage();
+    buffer_pool->PutHotAttachment(hot_hash, root_page, std::move(sub_table));
+    return;
+  }
+  // promoted subtable holds its own page, which is not charged by hot page
+  // table.
+  if (sub_table->cluster_index_.has_value()) {
+    return;
+  }
+  // frozen leaf is dropped by packed page, it's routed again on next open.
+  if (sub_table->packed_leaf_ != nullptr &&
+      sub_table->packed_leaf_->IsFrozen()) {
+    sub_table->packed_leaf_.reset();
+  }
+  const auto &packed_page = sub_table->packed_page_;
+  buffer_pool->PutHotAttachment(hot_hash, packed_page, std::move(sub_table));
+}
+
+Status SubTable::SetRow(const property::Row &row, TxnTs write_ts,
+                        const Options &opts, WriteInfo *info,
+                        cache::BufferPool::PageHolder *page) noexcept {
+  while (RoutePacked_(opts, /*create=*/true)) {
+    auto s = WritePacked_(
+        opts, info, [&](VersionedBwTreePage *leaf, const Options &leaf_opts) {
+          return leaf->SetRow(row, write_ts, leaf_opts, info);
+        });
+    if (!s.IsRetry()) {
+      if (s.ok() && page != nullptr) {
+        *page = packed_page_;
+      }
+      return s;
+    }
+  }
+  return cluster_index_->SetRow(row, write_ts, opts, info, page);
+}
+
+Status SubTable::DeleteRow(property::SortKeysRef sort_key, TxnTs write_ts,
+                           const Options &opts, WriteInfo *info,
+                           cache::BufferPool::PageHolder *page) noexcept {
+  while (RoutePacked_(opts, /*create=*/true)) {
+    auto s = WritePacked_(
+        opts, info, [&](VersionedBwTreePage *leaf, const Options &leaf_opts) {
+          return leaf->DeleteRow(sort_key, write_ts, leaf_opts, info);
+        });
+    if (!s.IsRetry()) {
+      if (s.ok() && page != nullptr) {
+        *page = packed_page_;
+      }
+      return s;
+    }
+  }
+  return cluster_index_->DeleteRow(sort_key, write_ts, opts, info, page);
+}
+
+Status SubTable::GetRow(property::SortKeysRef sort_key, TxnTs read_ts,
+                        const Options &opts, RowView *view) const noexcept {
+  while (RoutePacked_(opts, /*create=*/false)) {
+    auto leaf = packed_leaf_;
+    if (leaf == nullptr) {
+      return Status::NotFound();
+    }
+    auto s = leaf->GetRow(sort_key, read_ts, opts, view);
+    // leaf that is not truncated after the read hasn't been promoted.
+    if (!leaf->IsTruncated()) {
+      return s;
+    }
+    view->clear();
+  }
+  return cluster_index_->GetRow(sort_key, read_ts, opts, view);
+}
+
+void SubTable::SetTs(property::SortKeysRef sort_key, TxnTs target_ts,
+                     const Options &opts, WriteInfo *info) noexcept {
+  while (RoutePacked_(opts, /*create=*/true)) {
+    auto s = WritePacked_(
+        opts, info, [&](VersionedBwTreePage *leaf, const Options &leaf_opts) {
+          return leaf->SetTs(sort_key, target_ts, leaf_opts, info);
+        });
+    if (!s.IsRetry()) {
+      DCHECK(s.ok());
+      return;
+    }
+  }
+  cluster_index_->SetTs(sort_key, target_ts, opts, info);
+}
+
+void SubTable::RangeFilter(const Options &opts, const Filter &filter,
+                           TxnTs read_ts, const BtreeScanOpts &scan_opts,
+                           RangeScanRowView *views) const noexcept {
+  while (RoutePacked_(opts, /*create=*/false)) {
+    auto leaf = packed_leaf_;
+    if (leaf == nullptr) {
+      return;
+    }
+    leaf->RangeFilter(opts, filter, read_ts, scan_opts, views);
+    if (!leaf->IsTruncated()) {
+      return;
+    }
+    views->clear();
+  }
+  cluster_index_->RangeFilter(opts, filter, read_ts, scan_opts, views);
+}
+
+RowIterator SubTable::GetRowIterator(const Options &opts) const noexcept {
+  while (RoutePacked_(opts, /*create=*/false)) {
+    auto leaf = packed_leaf_;
+    if (leaf == nullptr) {
+      return RowIterator(nullptr);
+    }
+    auto chain = leaf->GetChain();
+    if (!leaf->IsTruncated()) {
+      return RowIterator(std::move(chain));
+    }
+  }
+  return cluster_index_->GetRowIterator(opts);
+}
+
+ScanCursor SubTable::GetScanCursor(const Options &opts, const Filter &filter,
+                                   TxnTs read_ts) const noexcept {
+  while (RoutePacked_(opts, /*create=*/false)) {
+    auto leaf = packed_leaf_;
+    if (leaf == nullptr) {
+      return ScanCursor();
+    }
+    auto head = leaf->GetChain();
+    if (leaf->IsTruncated()) {
+      continue;
+    }
+    // cursor keeps the leaf alive, and reads the chain taken before the leaf
+    // is truncated by promotion.
+    auto locator = [leaf, head = std::move(head)](std::string_view, bool) {
+      return ScanCursor::LeafLocation{.page = leaf.get(),
+                                      .owner = leaf,
+                                      .head = head,
+                                      .lower = std::string(),
+                                      .upper = std::string()};
+    };
+    return ScanCursor(std::move(locator), opts, filter, read_ts);
+  }
+  return cluster_index_->GetScanCursor(opts, filter, read_ts);
+}
+
+bool SubTable::RoutePacked_(const Options &opts, bool create) const noexcept {
+  if (cluster_index_.has_value()) {
+    return false;
+  }
+  // readers could still read a frozen leaf until it's truncated by
+  // promotion, while writers have to wait for the promoted page.
+  auto routable = [create](const VersionedBwTreePage &leaf) {
+    return create ? !leaf.IsFrozen() : !leaf.IsTruncated();
+  };
+  if (packed_leaf_ != nullptr && routable(*packed_leaf_)) {
+    return true;
+  }
+  while (true) {
+    bool promoted = false;
+    auto leaf = packed_page_->GetPackedPage()->GetLeaf(table_key_, create,
+                                                       &promoted);
+    if (promoted) {
+      cache::BufferPool::PageHolder root_page;
+      auto s = opts.buffer_pool->GetPage(table_key_, &root_page);
+      CHECK(s.ok());
+      cluster_index_.emplace(std::move(root_page));
+      packed_leaf_.reset();
+      return false;
+    }
+    if (leaf == nullptr || routable(*leaf)) {
+      packed_leaf_ = std::move(leaf);
+      return true;
+    }
+    // promotion is in progress.
+    bthread_yield();
+  }
+  UNREACHABLE();
+}
+
+template <typename Func>
+Status SubTable::WritePacked_(const Options &opts, WriteInfo *info,
+                              Func &&func) noexcept {
+  // packed leaves are small, they are compacted inline instead of being
+  // scheduled to buffer pool.
+  Options leaf_opts = opts;
+  leaf_opts.buffer_pool = nullptr;
+  auto leaf = packed_leaf_;
+  auto s = func(leaf.get(), leaf_opts);
+  if (!s.ok()) {
+    return s;
+  }
+  if (info->is_dirty) {
+    packed_page_->MarkDirty(info->lsn);
+    auto charge = packed_page_->GetPackedPage()->UpdateLeafCharge(table_key_);
+    packed_page_.UpdateCharge(charge);
+    if (opts.buffer_pool != nullptr) {
+      opts.buffer_pool->TryInsertDirtyPage(packed_page_);
+    }
+  }
+  if (leaf->GetTotalCharge() > common::Config::kPackedSubTablePromoteSize) {
+    MaybePromote_(opts);
+  }
+  return s;
+}
+
+void SubTable::MaybePromote_(const Options &opts) noexcept {
+  if (opts.buffer_pool == nullptr) {
+    return;
+  }
+  // promotions of the same packed page are serialized.
+  auto lock = packed_page_->TryLockSmo();
+  if (!lock.owns_lock()) {
+    return;
+  }
+  auto leaf = packed_leaf_;
+  if (leaf->IsFrozen()) {
+    return;
+  }
+  // leaf is frozen before promotion is logged, so that writes on leaf always
+  // precede promotion in log.
+  std::string image;
+  leaf->Freeze(&image);
+  auto lsn = log_store::kInvalidLsn;
+  if (opts.log_store != nullptr) {
+    wal::BtreeSmoLogWriter log_writer;
+    log_writer.PackedPromote(
+        wal::PackedPromoteLog{.packed_page_id = packed_page_->GetPageKey(),
+                              .table_key = table_key_});
+    log_store::LogStore::LogResultContainer result;
+    opts.log_store->AppendLogRecord(log_writer.GetLogRecords(), &result);
+    lsn = result[0].end_lsn;
+  }
+  InstallPromote_(opts.buffer_pool, packed_page_, table_key_, image, lsn);
+}
+
+void SubTable::InstallPromote_(cache::BufferPool *buffer_pool,
+                               cache::BufferPool::PageHolder packed_page,
+                               std::string_view table_key,
+                               std::string_view image,
+                               log_store::LsnType lsn) noexcept {
+  cache::BufferPool::PageHolder page;
+  auto s = buffer_pool->GetPage(table_key, &page);
+  CHECK(s.ok());
+  s = page->Deserialize(image);
+  CHECK(s.ok());
+  page->MarkDirty(lsn);
+  page.UpdateCharge(page->GetTotalCharge());
+  buffer_pool->TryInsertDirtyPage(page);
+
+  // subtable is routed to its own page from now on.
+  auto charge = packed_page->GetPackedPage()->Promote(table_key);
+  packed_page->MarkDirty(lsn);
+  packed_page.UpdateCharge(charge);
+  buffer_pool->TryInsertDirtyPage(packed_page);
+}
+
+void SubTable::ReplayPromote(cache::BufferPool *buffer_pool,
+                             const wal::PackedPromoteLog &log) noexcept {
+  cache::BufferPool::PageHolder packed_page;
+  auto s = buffer_pool->GetPage(log.packed_page_id, &packed_page);
+  CHECK(s.ok());
+  auto *packed = packed_page->GetPackedPage();
+  bool promoted = false;
+  auto leaf = packed->GetLeaf(log.table_key, /*create=*/false, &promoted);
+  if (leaf == nullptr) {
+    // either promotion has been flushed, or leaf is empty.
+    auto charge = packed->Promote(log.table_key);
+    packed_page.UpdateCharge(charge);
+    return;
+  }
+  std::string image;
+  leaf->Freeze(&image);
+  InstallPromote_(buffer_pool, packed_page, log.table_key, image,
+                  log_store::kInvalidLsn);
+}
+
 } // namespace btree
-} // namespace arcanedb
\ No newline at end of file
+} // namespace arcanedb
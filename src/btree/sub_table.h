@@ -15,6 +15,8 @@
 #include "btree/write_info.h"
 #include "cache/buffer_pool.h"
 #include "page/versioned_btree_page.h"
+#include "wal/btree_smo_log_reader.h"
+#include <optional>
 
 namespace arcanedb {
 namespace btree {
@@ -23,16 +25,28 @@ namespace btree {
  * @brief
  * Currently just a wrapper for btree.
  * For supporting secondary-index in the future.
+ * When packed page is enabled, small subtable lives in a leaf of packed page
+ * until it's promoted to its own btree, see PackedPage.
+ * SubTable is not thread safe since it's owned by a single txn.
+ * Closed subtable is cached along with its entry page in hot page table,
+ * i.e. root page or packed page, so that following txns on the same worker
+ * could reuse it without allocating or pinning the page again.
  */
-class SubTable {
+class SubTable : public cache::HotPageTable::Attachment {
 public:
-  SubTable(cache::BufferPool::PageHolder root_page) noexcept
-      : cluster_index_(root_page) {}
-
-  std::string_view GetTableKey() noexcept {
-    return cluster_index_.GetRootPageKey();
+  SubTable(PageIdHash hot_hash,
+           cache::BufferPool::PageHolder root_page) noexcept
+      : table_key_(root_page->GetPageKey()), hot_hash_(hot_hash) {
+    cluster_index_.emplace(std::move(root_page));
   }
 
+  SubTable(std::string_view table_key, PageIdHash hot_hash,
+           cache::BufferPool::PageHolder packed_page) noexcept
+      : table_key_(table_key), hot_hash_(hot_hash),
+        packed_page_(std::move(packed_page)) {}
+
+  std::string_view GetTableKey() noexcept { return table_key_; }
+
   /**
    * @brief
    *
@@ -45,6 +59,16 @@ public:
                              const Options &opts,
                              std::unique_ptr<SubTable> *sub_table) noexcept;
 
+  /**
+   * @brief
+   * Cache subtable along with its entry page for following opens, it's
+   * released if the page is no longer hot.
+   * @param buffer_pool
+   * @param sub_table
+   */
+  static void CloseSubTable(cache::BufferPool *buffer_pool,
+                            std::unique_ptr<SubTable> sub_table) noexcept;
+
   /**
    * @brief
    * Insert a row into page.
@@ -54,12 +78,13 @@ public:
    * @param write_ts
    * @param opts
    * @param info
+   * @param page page which has been written, i.e. the leaf page or the packed
+   * page, if not null.
    * @return Status
    */
   Status SetRow(const property::Row &row, TxnTs write_ts, const Options &opts,
-                WriteInfo *info) noexcept {
-    return cluster_index_.SetRow(row, write_ts, opts, info);
-  }
+                WriteInfo *info,
+                cache::BufferPool::PageHolder *page = nullptr) noexcept;
 
   /**
    * @brief
@@ -67,12 +92,12 @@ public:
    * @param sort_key
    * @param write_ts
    * @param opts
+   * @param page see SetRow.
    * @return Status
    */
   Status DeleteRow(property::SortKeysRef sort_key, TxnTs write_ts,
-                   const Options &opts, WriteInfo *info) noexcept {
-    return cluster_index_.DeleteRow(sort_key, write_ts, opts, info);
-  }
+                   const Options &opts, WriteInfo *info,
+                   cache::BufferPool::PageHolder *page = nullptr) noexcept;
 
   /**
    * @brief
@@ -85,9 +110,7 @@ public:
    *                 NotFound.
    */
   Status GetRow(property::SortKeysRef sort_key, TxnTs read_ts,
-                const Options &opts, RowView *view) const noexcept {
-    return cluster_index_.GetRow(sort_key, read_ts, opts, view);
-  }
+                const Options &opts, RowView *view) const noexcept;
 
   /**
    * @brief
@@ -98,40 +121,108 @@ public:
    * @return Status
    */
   void SetTs(property::SortKeysRef sort_key, TxnTs target_ts,
-             const Options &opts, WriteInfo *info) noexcept {
-    cluster_index_.SetTs(sort_key, target_ts, opts, info);
-  }
+             const Options &opts, WriteInfo *info) noexcept;
 
   /**
    * @brief
    * Range scan
    * @param opts
    * @param filter
+   * @param read_ts
    * @param scan_opts
    * @param views
    */
-  void RangeFilter(const Options &opts, const Filter &filter,
+  void RangeFilter(const Options &opts, const Filter &filter, TxnTs read_ts,
                    const BtreeScanOpts &scan_opts,
-                   RangeScanRowView *views) const noexcept {
-    cluster_index_.RangeFilter(opts, filter, scan_opts, views);
-  }
+                   RangeScanRowView *views) const noexcept;
 
   /**
    * @brief
    * Range scan without order
+   * @param opts
    * @return RowIterator
    */
-  RowIterator GetRowIterator() const noexcept {
-    return cluster_index_.GetRowIterator();
-  }
+  RowIterator GetRowIterator(const Options &opts) const noexcept;
+
+  /**
+   * @brief
+   * Ordered range scan which produces rows lazily.
+   * @param opts
+   * @param filter
+   * @param read_ts
+   * @return ScanCursor
+   */
+  ScanCursor GetScanCursor(const Options &opts, const Filter &filter,
+                           TxnTs read_ts) const noexcept;
 
   common::LockTable &GetLockTable() noexcept {
-    return cluster_index_.GetLockTable();
+    // packed subtables always lock on packed page, even after promotion, so
+    // that all txns agree on the lock table. lock keys are prefixed by table
+    // key, so subtables could share lock table.
+    if (packed_page_) {
+      return packed_page_->GetLockTable();
+    }
+    return cluster_index_->GetLockTable();
   }
 
+  /**
+   * @brief
+   * Replay promotion of packed subtable during recovery.
+   * @param buffer_pool
+   * @param log
+   */
+  static void ReplayPromote(cache::BufferPool *buffer_pool,
+                            const wal::PackedPromoteLog &log) noexcept;
+
+  bool TEST_IsPacked() const noexcept { return !cluster_index_.has_value(); }
+
 private:
-  VersionedBtree cluster_index_;
+  /**
+   * @brief
+   * Route to the packed leaf, routing is refreshed once the leaf is frozen
+   * by promotion for writers, or truncated for readers.
+   * @param opts
+   * @param create create the leaf if it doesn't exist.
+   * @return true if subtable is still packed, packed_leaf_ might be nullptr
+   * if it doesn't exist. otherwise cluster_index_ is opened.
+   */
+  bool RoutePacked_(const Options &opts, bool create) const noexcept;
+
+  /**
+   * @brief
+   * Perform write on packed leaf.
+   * @param opts
+   * @param info
+   * @param func write on packed leaf with options.
+   * @return Status: Retry if packed leaf is promoted during the write.
+   */
+  template <typename Func>
+  Status WritePacked_(const Options &opts, WriteInfo *info,
+                      Func &&func) noexcept;
+
+  void MaybePromote_(const Options &opts) noexcept;
+
+  /**
+   * @brief
+   * Move rows of frozen leaf to the page of table key, shared by promotion
+   * and recovery. frozen leaf is dropped by packed page, and it's released
+   * once readers holding it are gone.
+   */
+  static void InstallPromote_(cache::BufferPool *buffer_pool,
+                              cache::BufferPool::PageHolder packed_page,
+                              std::string_view table_key,
+                              std::string_view image,
+                              log_store::LsnType lsn) noexcept;
+
+  const std::string table_key_;
+  // index of entry page in hot page table.
+  const PageIdHash hot_hash_;
+  // following fields are switched lazily once subtable is promoted.
+  mutable std::optional<VersionedBtree> cluster_index_;
+  mutable std::shared_ptr<VersionedBwTreePage> packed_leaf_;
+  // set when subtable is opened in packed mode.
+  cache::BufferPool::PageHolder packed_page_;
 };
 
 } // namespace btree
-} // namespace arcanedb
\ No newline at end of file
+} // namespace arcanedb
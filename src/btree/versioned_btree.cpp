@@ -10,103 +10,679 @@
  */
 
 #include "btree/versioned_btree.h"
+#include "bthread/bthread.h"
 #include "cache/buffer_pool.h"
+#include "common/logger.h"
 #include "common/macros.h"
+#include "util/uuid.h"
+#include "wal/btree_smo_log_writer.h"
+#include <algorithm>
+#include <atomic>
 
 namespace arcanedb {
 namespace btree {
 
-Status VersionedBtree::SetRow(const property::Row &row, TxnTs write_ts,
-                              const Options &opts, WriteInfo *info) noexcept {
-  auto page_type = root_page_->GetPageType();
-  Status s;
-  switch (page_type) {
-  case PageType::LeafPage: {
-    s = root_page_->SetRow(row, write_ts, opts, info);
-    if (s.ok() && info->is_dirty) {
-      opts.buffer_pool->TryInsertDirtyPage(root_page_);
-      root_page_.UpdateCharge(root_page_->GetTotalCharge());
-    }
-    break;
+namespace {
+
+/**
+ * @brief
+ * Repartition rows of adjacent internal pages by sort key, see
+ * VersionedBwTreePage::RepartitionImages.
+ */
+std::vector<std::vector<InternalRow>>
+RepartitionInternalRows(const std::vector<std::string> &images,
+                        const std::vector<std::string_view> &bounds) noexcept {
+  std::vector<InternalRow> rows;
+  for (const auto &image : images) {
+    log_store::LsnType lsn;
+    auto s = InternalRows::Deserialize(image, &rows, &lsn);
+    CHECK(s.ok());
   }
-  case PageType::InternalPage: {
-    NOTIMPLEMENTED();
-    break;
+  std::vector<std::vector<InternalRow>> result(bounds.size());
+  size_t idx = 0;
+  for (auto &row : rows) {
+    while (idx + 1 < bounds.size() &&
+           !(row.sort_key < property::SortKeysRef(bounds[idx + 1]))) {
+      idx += 1;
+    }
+    result[idx].push_back(std::move(row));
   }
+  return result;
+}
+
+} // namespace
+
+Status VersionedBtree::FindLeaf_(const cache::BufferPool::PageHolder &root_page,
+                                 cache::BufferPool *buffer_pool,
+                                 property::SortKeysRef sort_key, bool before,
+                                 LeafPath *path) noexcept {
+  while (true) {
+    auto version = root_page->GetSmoVersion();
+    path->internals.clear();
+    path->lower.clear();
+    path->upper.clear();
+    auto page = root_page;
+    while (page->GetPageType() == PageType::InternalPage) {
+      auto rows = page->GetInternalRows();
+      auto idx = rows->FindChild(sort_key, before);
+      if (idx > 0) {
+        path->lower = rows->GetRow(idx).sort_key.as_slice();
+      }
+      if (idx + 1 < rows->GetSize()) {
+        path->upper = rows->GetRow(idx + 1).sort_key.as_slice();
+      }
+      cache::BufferPool::PageHolder child;
+      auto s = buffer_pool->GetPage(rows->GetRow(idx).page_id, &child);
+      if (unlikely(!s.ok())) {
+        return s;
+      }
+      path->internals.push_back(PathEntry{
+          .page = std::move(page), .rows = std::move(rows), .idx = idx});
+      page = std::move(child);
+    }
+    path->leaf = std::move(page);
+    // pages we have routed through are valid if no SMO is published in the
+    // meantime, since old pages are retired after the version is bumped.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (root_page->GetSmoVersion() == version) {
+      return Status::Ok();
+    }
   }
-  return s;
+  UNREACHABLE();
 }
 
-Status VersionedBtree::DeleteRow(property::SortKeysRef sort_key, TxnTs write_ts,
-                                 const Options &opts,
-                                 WriteInfo *info) noexcept {
-  auto page_type = root_page_->GetPageType();
-  Status s;
-  switch (page_type) {
-  case PageType::LeafPage: {
-    s = root_page_->DeleteRow(sort_key, write_ts, opts, info);
-    if (s.ok() && info->is_dirty) {
-      opts.buffer_pool->TryInsertDirtyPage(root_page_);
-      root_page_.UpdateCharge(root_page_->GetTotalCharge());
+template <typename Func>
+Status VersionedBtree::WriteLeaf_(const Options &opts,
+                                  property::SortKeysRef sort_key,
+                                  WriteInfo *info, Func &&func,
+                                  size_t *leaf_charge,
+                                  cache::BufferPool::PageHolder *leaf) noexcept {
+  if (root_page_->GetPageType() == PageType::LeafPage) {
+    auto s = func(root_page_);
+    if (!s.IsRetry()) {
+      if (s.ok()) {
+        FinishWrite_(opts, &root_page_, *info);
+        *leaf_charge = root_page_->GetTotalCharge();
+        if (leaf != nullptr) {
+          *leaf = root_page_;
+        }
+      }
+      return s;
     }
-    break;
   }
-  case PageType::InternalPage: {
-    NOTIMPLEMENTED();
-    break;
+  while (true) {
+    LeafPath path;
+    auto s = FindLeaf_(root_page_, opts.buffer_pool, sort_key,
+                       /*before=*/false, &path);
+    if (unlikely(!s.ok())) {
+      return s;
+    }
+    s = func(path.leaf);
+    if (!s.IsRetry()) {
+      if (s.ok()) {
+        FinishWrite_(opts, &path.leaf, *info);
+        *leaf_charge = path.leaf->GetTotalCharge();
+        if (leaf != nullptr) {
+          *leaf = std::move(path.leaf);
+        }
+      }
+      return s;
+    }
+    // leaf page has been frozen by SMO, wait for the new pages.
+    bthread_yield();
   }
+  UNREACHABLE();
+}
+
+void VersionedBtree::FinishWrite_(const Options &opts,
+                                  cache::BufferPool::PageHolder *leaf,
+                                  const WriteInfo &info) noexcept {
+  if (info.is_dirty) {
+    opts.buffer_pool->TryInsertDirtyPage(*leaf);
+    leaf->UpdateCharge((*leaf)->GetTotalCharge());
+  }
+  if (info.need_compaction) {
+    opts.buffer_pool->TryScheduleCompaction(*leaf);
+  }
+}
+
+Status VersionedBtree::SetRow(const property::Row &row, TxnTs write_ts,
+                              const Options &opts, WriteInfo *info,
+                              cache::BufferPool::PageHolder *leaf) noexcept {
+  auto sort_key = row.GetSortKeys();
+  size_t leaf_charge = 0;
+  auto s = WriteLeaf_(
+      opts, sort_key, info,
+      [&](const cache::BufferPool::PageHolder &page) {
+        return page->SetRow(row, write_ts, opts, info);
+      },
+      &leaf_charge, leaf);
+  if (s.ok() && leaf_charge > smo_opts_.leaf_split_size) {
+    MaybeSplit_(opts, sort_key);
+  }
+  return s;
+}
+
+Status VersionedBtree::DeleteRow(property::SortKeysRef sort_key, TxnTs write_ts,
+                                 const Options &opts, WriteInfo *info,
+                                 cache::BufferPool::PageHolder *leaf) noexcept {
+  size_t leaf_charge = 0;
+  auto s = WriteLeaf_(
+      opts, sort_key, info,
+      [&](const cache::BufferPool::PageHolder &page) {
+        return page->DeleteRow(sort_key, write_ts, opts, info);
+      },
+      &leaf_charge, leaf);
+  if (s.ok() && leaf_charge < smo_opts_.leaf_merge_size &&
+      root_page_->GetPageType() == PageType::InternalPage) {
+    MaybeMerge_(opts, sort_key);
   }
   return s;
 }
 
 void VersionedBtree::SetTs(property::SortKeysRef sort_key, TxnTs target_ts,
                            const Options &opts, WriteInfo *info) noexcept {
-  auto page_type = root_page_->GetPageType();
-  switch (page_type) {
-  case PageType::LeafPage: {
-    root_page_->SetTs(sort_key, target_ts, opts, info);
-    if (info->is_dirty) {
-      opts.buffer_pool->TryInsertDirtyPage(root_page_);
-    }
-    break;
-  }
-  case PageType::InternalPage: {
-    NOTIMPLEMENTED();
-    break;
-  }
-  }
+  size_t leaf_charge = 0;
+  auto s = WriteLeaf_(
+      opts, sort_key, info,
+      [&](const cache::BufferPool::PageHolder &leaf) {
+        return leaf->SetTs(sort_key, target_ts, opts, info);
+      },
+      &leaf_charge);
+  DCHECK(s.ok());
 }
 
 Status VersionedBtree::GetRow(property::SortKeysRef sort_key, TxnTs read_ts,
                               const Options &opts, RowView *view) const
     noexcept {
-  auto page_type = root_page_->GetPageType();
-  Status s;
-  switch (page_type) {
-  case PageType::LeafPage: {
-    s = root_page_->GetRow(sort_key, read_ts, opts, view);
-    break;
+  if (root_page_->GetPageType() == PageType::LeafPage) {
+    auto s = root_page_->GetRow(sort_key, read_ts, opts, view);
+    if (!s.IsRetry() && !root_page_->IsTruncated()) {
+      return s;
+    }
+    view->clear();
   }
-  case PageType::InternalPage: {
-    s = GetRowMultilevel_(sort_key, read_ts, opts, view);
-    break;
+  while (true) {
+    LeafPath path;
+    auto s = FindLeaf_(root_page_, opts.buffer_pool, sort_key,
+                       /*before=*/false, &path);
+    if (unlikely(!s.ok())) {
+      return s;
+    }
+    s = path.leaf->GetRow(sort_key, read_ts, opts, view);
+    // leaf page that is not truncated after the read hasn't been replaced
+    // yet, rows of a frozen leaf page are still up to date.
+    if (!s.IsRetry() && !path.leaf->IsTruncated()) {
+      return s;
+    }
+    view->clear();
+    bthread_yield();
   }
-  default:
-    UNREACHABLE();
+  UNREACHABLE();
+}
+
+void VersionedBtree::RangeFilter(const Options &opts, const Filter &filter,
+                                 TxnTs read_ts, const BtreeScanOpts &scan_opts,
+                                 RangeScanRowView *views) const noexcept {
+  if (root_page_->GetPageType() == PageType::LeafPage) {
+    auto s = root_page_->RangeFilter(opts, filter, read_ts, scan_opts, views);
+    if (!s.IsRetry() && !root_page_->IsTruncated()) {
+      return;
+    }
+    views->clear();
+  }
+  // leaf pages are scanned in the order of filter.
+  std::string key;
+  if (!filter.reverse && filter.start.has_value()) {
+    key = filter.start->as_slice();
+  } else if (filter.reverse && filter.end.has_value()) {
+    key = filter.end->as_slice();
+  }
+  size_t total_cnt = 0;
+  while (filter.limit == 0 || total_cnt < filter.limit) {
+    size_t limit = filter.limit == 0 ? 0 : filter.limit - total_cnt;
+    size_t row_cnt = 0;
+    std::string next_key;
+    auto s = RangeFilterLeaf_(opts, filter, read_ts, scan_opts, key, limit,
+                              views, &row_cnt, &next_key);
+    if (s.IsRetry()) {
+      bthread_yield();
+      continue;
+    }
+    if (!s.ok()) {
+      ARCANEDB_WARN("Failed to scan btree {}, status {}", GetRootPageKey(),
+                    s.ToString());
+      return;
+    }
+    total_cnt += row_cnt;
+    if (next_key.empty()) {
+      return;
+    }
+    key = std::move(next_key);
   }
-  return s;
 }
 
-Status VersionedBtree::GetRowMultilevel_(property::SortKeysRef sort_key,
-                                         TxnTs read_ts, const Options &opts,
-                                         RowView *view) const noexcept {
-  InternalRowView internal_view;
-  auto s = root_page_->GetPageId(opts, sort_key, &internal_view);
+Status VersionedBtree::RangeFilterLeaf_(
+    const Options &opts, const Filter &filter, TxnTs read_ts,
+    const BtreeScanOpts &scan_opts, std::string_view key, size_t limit,
+    RangeScanRowView *views, size_t *row_cnt,
+    std::string *next_key) const noexcept {
+  LeafPath path;
+  auto s = FindLeaf_(root_page_, opts.buffer_pool, property::SortKeysRef(key),
+                     /*before=*/filter.reverse, &path);
   if (unlikely(!s.ok())) {
     return s;
   }
-  NOTIMPLEMENTED();
+  // intersect filter with the range of leaf page.
+  Filter leaf_filter = filter;
+  leaf_filter.limit = limit;
+  if (!path.lower.empty() &&
+      (!filter.start.has_value() || filter.start->as_slice() < path.lower)) {
+    leaf_filter.start = property::SortKeys(std::string_view(path.lower));
+  }
+  if (!path.upper.empty() &&
+      (!filter.end.has_value() || filter.end->as_slice() > path.upper)) {
+    leaf_filter.end = property::SortKeys(std::string_view(path.upper));
+  }
+  RangeScanRowView leaf_views;
+  s = path.leaf->RangeFilter(opts, leaf_filter, read_ts, scan_opts,
+                             &leaf_views);
+  if (s.IsRetry() || path.leaf->IsTruncated()) {
+    return Status::Retry();
+  }
+  for (const auto &row : leaf_views) {
+    views->PushBackRef(row);
+  }
+  for (const auto &owner : leaf_views.GetContainer()) {
+    views->AddOwnerPointer(owner);
+  }
+  *row_cnt = leaf_views.size();
+
+  // stop once the bound of filter is reached.
+  next_key->clear();
+  if (!filter.reverse && !path.upper.empty() &&
+      !(filter.end.has_value() && filter.end->as_slice() <= path.upper)) {
+    *next_key = std::move(path.upper);
+  }
+  if (filter.reverse && !path.lower.empty() &&
+      !(filter.start.has_value() && filter.start->as_slice() >= path.lower)) {
+    *next_key = std::move(path.lower);
+  }
+  return Status::Ok();
+}
+
+RowIterator VersionedBtree::GetRowIterator(const Options &opts) const
+    noexcept {
+  if (root_page_->GetPageType() == PageType::LeafPage) {
+    auto head = root_page_->GetChain();
+    if (!root_page_->IsTruncated()) {
+      return RowIterator(std::move(head));
+    }
+  }
+  std::vector<std::shared_ptr<VersionedDeltaNode>> chains;
+  std::string key;
+  while (true) {
+    LeafPath path;
+    auto s = FindLeaf_(root_page_, opts.buffer_pool, property::SortKeysRef(key),
+                       /*before=*/false, &path);
+    CHECK(s.ok());
+    auto head = path.leaf->GetChain();
+    if (path.leaf->IsTruncated()) {
+      bthread_yield();
+      continue;
+    }
+    chains.push_back(std::move(head));
+    if (path.upper.empty()) {
+      break;
+    }
+    key = std::move(path.upper);
+  }
+  return RowIterator(std::move(chains));
+}
+
+ScanCursor VersionedBtree::GetScanCursor(const Options &opts,
+                                         const Filter &filter,
+                                         TxnTs read_ts) const noexcept {
+  auto locator = [root_page = root_page_, buffer_pool = opts.buffer_pool](
+                     std::string_view sort_key, bool before) {
+    while (true) {
+      LeafPath path;
+      auto s = FindLeaf_(root_page, buffer_pool,
+                         property::SortKeysRef(sort_key), before, &path);
+      CHECK(s.ok());
+      auto head = path.leaf->GetChain();
+      if (path.leaf->IsTruncated()) {
+        bthread_yield();
+        continue;
+      }
+      const auto *page = path.leaf->GetLeafPage();
+      return ScanCursor::LeafLocation{
+          .page = page,
+          .owner = std::make_shared<cache::BufferPool::PageHolder>(
+              std::move(path.leaf)),
+          .head = std::move(head),
+          .lower = std::move(path.lower),
+          .upper = std::move(path.upper)};
+    }
+  };
+  return ScanCursor(std::move(locator), opts, filter, read_ts);
+}
+
+std::string VersionedBtree::NewPageId_() const noexcept {
+  return fmt::format("{}@{}", GetRootPageKey(), util::GenerateUUID());
+}
+
+void VersionedBtree::MaybeSplit_(const Options &opts,
+                                 property::SortKeysRef sort_key) noexcept {
+  if (opts.buffer_pool == nullptr) {
+    return;
+  }
+  auto smo_lock = root_page_->TryLockSmo();
+  if (!smo_lock.owns_lock()) {
+    // another SMO is in progress, leave it to the following writers.
+    return;
+  }
+  LeafPath path;
+  auto s = FindLeaf_(root_page_, opts.buffer_pool, sort_key,
+                     /*before=*/false, &path);
+  if (!s.ok()) {
+    return;
+  }
+  auto charge = path.leaf->GetTotalCharge();
+  if (charge <= smo_opts_.leaf_split_size) {
+    return;
+  }
+  // freezing serializes the whole page, so page that failed to split is not
+  // retried until it has grown by half of split size.
+  auto failed_charge = path.leaf->GetFailedSplitCharge();
+  if (failed_charge != 0 &&
+      charge < failed_charge + smo_opts_.leaf_split_size / 2) {
+    return;
+  }
+  std::string image;
+  path.leaf->Freeze(&image);
+  std::string separator;
+  if (!VersionedBwTreePage::PickSeparator(image, &separator)) {
+    // page with a single sort key couldn't be split.
+    path.leaf->SetFailedSplitCharge(charge);
+    path.leaf->Unfreeze();
+    return;
+  }
+  auto left_page_id = NewPageId_();
+  auto right_page_id = NewPageId_();
+  wal::BtreeSmoLog log;
+  log.is_leaf = true;
+  log.old_page_ids.push_back(path.leaf->GetPageKey());
+  // root page grows by one level when it's split.
+  log.parent_page_id = path.internals.empty()
+                           ? path.leaf->GetPageKey()
+                           : path.internals.back().page->GetPageKey();
+  log.new_children.emplace_back(path.lower, left_page_id);
+  log.new_children.emplace_back(separator, right_page_id);
+  PerformSmo_(opts, log, {std::move(image)});
+
+  SplitInternal_(opts, path);
+}
+
+void VersionedBtree::SplitInternal_(const Options &opts,
+                                    const LeafPath &path) noexcept {
+  // children are split before their parent.
+  for (size_t level = path.internals.size(); level-- > 0;) {
+    const auto &page = path.internals[level].page;
+    auto rows = page->GetInternalRows();
+    if (rows->GetSize() <= smo_opts_.internal_max_fanout) {
+      return;
+    }
+    std::string image;
+    page->Freeze(&image);
+    auto left_page_id = NewPageId_();
+    auto right_page_id = NewPageId_();
+    wal::BtreeSmoLog log;
+    log.is_leaf = false;
+    log.old_page_ids.push_back(page->GetPageKey());
+    std::string_view lower;
+    if (level == 0) {
+      log.parent_page_id = page->GetPageKey();
+    } else {
+      const auto &parent = path.internals[level - 1];
+      log.parent_page_id = parent.page->GetPageKey();
+      lower = parent.rows->GetRow(parent.idx).sort_key.as_slice();
+    }
+    log.new_children.emplace_back(lower, left_page_id);
+    log.new_children.emplace_back(
+        rows->GetRow(rows->GetSize() / 2).sort_key.as_slice(), right_page_id);
+    PerformSmo_(opts, log, {std::move(image)});
+  }
+}
+
+void VersionedBtree::MaybeMerge_(const Options &opts,
+                                 property::SortKeysRef sort_key) noexcept {
+  if (opts.buffer_pool == nullptr) {
+    return;
+  }
+  auto smo_lock = root_page_->TryLockSmo();
+  if (!smo_lock.owns_lock()) {
+    return;
+  }
+  LeafPath path;
+  auto s = FindLeaf_(root_page_, opts.buffer_pool, sort_key,
+                     /*before=*/false, &path);
+  if (!s.ok() || path.internals.empty() ||
+      path.leaf->GetTotalCharge() >= smo_opts_.leaf_merge_size) {
+    return;
+  }
+  const auto &parent = path.internals.back();
+  if (parent.rows->GetSize() < 2) {
+    return;
+  }
+  // merge with the right sibling, or the left sibling for the last child.
+  size_t left = parent.idx + 1 < parent.rows->GetSize() ? parent.idx
+                                                        : parent.idx - 1;
+  std::vector<cache::BufferPool::PageHolder> pages(2);
+  size_t total_charge = 0;
+  for (size_t i = 0; i < pages.size(); i++) {
+    s = opts.buffer_pool->GetPage(parent.rows->GetRow(left + i).page_id,
+                                  &pages[i]);
+    if (!s.ok()) {
+      return;
+    }
+    total_charge += pages[i]->GetTotalCharge();
+  }
+  // merged page shouldn't be split again soon.
+  if (total_charge > smo_opts_.leaf_split_size / 2) {
+    return;
+  }
+  std::vector<std::string> images(pages.size());
+  for (size_t i = 0; i < pages.size(); i++) {
+    pages[i]->Freeze(&images[i]);
+  }
+  auto page_id = NewPageId_();
+  wal::BtreeSmoLog log;
+  log.is_leaf = true;
+  log.parent_page_id = parent.page->GetPageKey();
+  for (const auto &page : pages) {
+    log.old_page_ids.push_back(page->GetPageKey());
+  }
+  log.new_children.emplace_back(
+      parent.rows->GetRow(left).sort_key.as_slice(), page_id);
+  PerformSmo_(opts, log, images);
+}
+
+void VersionedBtree::PerformSmo_(
+    const Options &opts, const wal::BtreeSmoLog &log,
+    const std::vector<std::string> &images) noexcept {
+  auto lsn = log_store::kInvalidLsn;
+  if (opts.log_store != nullptr) {
+    // old pages are frozen before SMO is logged, so that writes on old pages
+    // always precede SMO in log.
+    wal::BtreeSmoLogWriter log_writer;
+    log_writer.Smo(log);
+    log_store::LogStore::LogResultContainer result;
+    opts.log_store->AppendLogRecord(log_writer.GetLogRecords(), &result);
+    lsn = result[0].end_lsn;
+  }
+  InstallSmo_(opts.buffer_pool, log, images, lsn);
+  // readers that routed through old pages will retry from now on.
+  root_page_->BumpSmoVersion();
+  // SMO lock is released without waiting for SMO to be persisted, flusher
+  // keeps old pages until then.
+  RetireSmo_(opts.buffer_pool, log, opts.log_store, lsn);
+}
+
+void VersionedBtree::InstallSmo_(cache::BufferPool *buffer_pool,
+                                 const wal::BtreeSmoLog &log,
+                                 const std::vector<std::string> &images,
+                                 log_store::LsnType lsn) noexcept {
+  std::vector<std::string_view> bounds;
+  for (const auto &child : log.new_children) {
+    bounds.push_back(child.first);
+  }
+  std::vector<std::string> leaf_images;
+  std::vector<std::vector<InternalRow>> internal_rows;
+  if (log.is_leaf) {
+    leaf_images = VersionedBwTreePage::RepartitionImages(images, bounds);
+  } else {
+    internal_rows = RepartitionInternalRows(images, bounds);
+  }
+
+  // build new pages
+  std::vector<InternalRow> new_rows;
+  for (size_t i = 0; i < log.new_children.size(); i++) {
+    const auto &[lower, page_id] = log.new_children[i];
+    cache::BufferPool::PageHolder page;
+    auto s = buffer_pool->GetPage(page_id, &page);
+    CHECK(s.ok());
+    if (log.is_leaf) {
+      s = page->Deserialize(leaf_images[i]);
+      CHECK(s.ok());
+      page.UpdateCharge(page->GetTotalCharge());
+    } else {
+      page->InitInternal(std::move(internal_rows[i]));
+    }
+    page->MarkDirty(lsn);
+    buffer_pool->TryInsertDirtyPage(page);
+    new_rows.push_back(InternalRow{.sort_key = property::SortKeys(lower),
+                                   .page_id = PageIdType(page_id)});
+  }
+
+  // publish new pages. rows of old leaf pages have been moved to the new
+  // pages, and they are truncated before new pages become writable, so that
+  // readers of old pages never miss the writes on new pages.
+  if (log.is_leaf) {
+    for (const auto &page_id : log.old_page_ids) {
+      cache::BufferPool::PageHolder page;
+      auto s = buffer_pool->GetPage(page_id, &page);
+      CHECK(s.ok());
+      page->Truncate();
+    }
+  }
+  cache::BufferPool::PageHolder parent;
+  auto s = buffer_pool->GetPage(log.parent_page_id, &parent);
+  CHECK(s.ok());
+  if (log.old_page_ids.size() == 1 &&
+      log.old_page_ids[0] == log.parent_page_id) {
+    parent->InitInternal(std::move(new_rows));
+  } else {
+    s = parent->ReplaceChildren(Options(), log.old_page_ids,
+                                std::move(new_rows));
+    CHECK(s.ok());
+  }
+  parent->MarkDirty(lsn);
+  buffer_pool->TryInsertDirtyPage(parent);
+}
+
+void VersionedBtree::RetireSmo_(cache::BufferPool *buffer_pool,
+                                const wal::BtreeSmoLog &log,
+                                log_store::LogStore *log_store,
+                                log_store::LsnType lsn) noexcept {
+  // old pages are kept in page store until new pages and parent are flushed.
+  auto successors = std::make_shared<cache::BufferPool::SmoSuccessors>();
+  auto add_successor = [&](std::string_view page_id) {
+    cache::BufferPool::PageHolder page;
+    auto s = buffer_pool->GetPage(page_id, &page);
+    CHECK(s.ok());
+    auto version = page->GetWriteVersion();
+    successors->emplace_back(std::move(page), version);
+  };
+  for (const auto &child : log.new_children) {
+    add_successor(child.second);
+  }
+  add_successor(log.parent_page_id);
+  for (const auto &page_id : log.old_page_ids) {
+    cache::BufferPool::PageHolder page;
+    auto s = buffer_pool->GetPage(page_id, &page);
+    CHECK(s.ok());
+    // root page is kept, since it's the entry of btree.
+    if (page_id != log.parent_page_id) {
+      buffer_pool->RetirePage(page, successors, log_store, lsn);
+    }
+  }
+}
+
+void VersionedBtree::ReplaySmo(cache::BufferPool *buffer_pool,
+                               const wal::BtreeSmoLog &log) noexcept {
+  bool grow = log.old_page_ids.size() == 1 &&
+              log.old_page_ids[0] == log.parent_page_id;
+  if (!grow) {
+    cache::BufferPool::PageHolder parent;
+    auto s = buffer_pool->GetPage(log.parent_page_id, &parent);
+    CHECK(s.ok());
+    if (parent->GetPageType() != PageType::InternalPage) {
+      return;
+    }
+    // parent has been flushed after this SMO.
+    const auto &rows = parent->GetInternalRows()->GetRows();
+    for (const auto &page_id : log.old_page_ids) {
+      auto it = std::find_if(rows.begin(), rows.end(), [&](const auto &row) {
+        return row.page_id == page_id;
+      });
+      if (it == rows.end()) {
+        return;
+      }
+    }
+  }
+  std::vector<cache::BufferPool::PageHolder> pages(log.old_page_ids.size());
+  for (size_t i = 0; i < pages.size(); i++) {
+    auto s = buffer_pool->GetPage(log.old_page_ids[i], &pages[i]);
+    CHECK(s.ok());
+    auto page_type =
+        log.is_leaf ? PageType::LeafPage : PageType::InternalPage;
+    if (pages[i]->GetPageType() != page_type) {
+      // root page has grown and been flushed after this SMO.
+      return;
+    }
+  }
+  std::vector<std::string> images(pages.size());
+  for (size_t i = 0; i < pages.size(); i++) {
+    pages[i]->Freeze(&images[i]);
+  }
+  InstallSmo_(buffer_pool, log, images, log_store::kInvalidLsn);
+  RetireSmo_(buffer_pool, log, /*log_store=*/nullptr, log_store::kInvalidLsn);
+}
+
+size_t VersionedBtree::TEST_GetHeight(const Options &opts) const noexcept {
+  LeafPath path;
+  auto s = FindLeaf_(root_page_, opts.buffer_pool, property::SortKeysRef(),
+                     /*before=*/false, &path);
+  CHECK(s.ok());
+  return path.internals.size() + 1;
+}
+
+size_t VersionedBtree::TEST_GetLeafCount(const Options &opts) const noexcept {
+  size_t count = 0;
+  std::string key;
+  while (true) {
+    LeafPath path;
+    auto s = FindLeaf_(root_page_, opts.buffer_pool,
+                       property::SortKeysRef(key), /*before=*/false, &path);
+    CHECK(s.ok());
+    count += 1;
+    if (path.upper.empty()) {
+      return count;
+    }
+    key = std::move(path.upper);
+  }
 }
 
 } // namespace btree
-} // namespace arcanedb
\ No newline at end of file
+} // namespace arcanedb
@@ -15,15 +15,41 @@
 #include "btree/write_info.h"
 #include "cache/buffer_pool.h"
 #include "common/btree_scan_opts.h"
+#include "common/config.h"
 #include "common/filter.h"
+#include "wal/btree_smo_log_reader.h"
 
 namespace arcanedb {
 namespace btree {
 
+/**
+ * @brief
+ * Thresholds of btree SMO.
+ */
+struct BtreeSmoOpts {
+  size_t leaf_split_size{common::Config::kBtreeLeafSplitSize};
+  size_t leaf_merge_size{common::Config::kBtreeLeafMergeSize};
+  size_t internal_max_fanout{common::Config::kBtreeInternalMaxFanout};
+};
+
+/**
+ * @brief
+ * Multi-level btree, page id of root page is the key of btree.
+ * Leaf pages are split once they are too large and merged with their
+ * sibling once they are too small, internal pages are split once they have
+ * too many children. SMOs are serialized by root page and are redo only:
+ * old pages are frozen so that writers on them retry on the new pages, new
+ * pages with fresh page ids are built from the images of old pages, and they
+ * are published to parent before the old pages are retired. Readers never
+ * block on SMO, they validate the pages they have routed through against
+ * the SMO version of root page.
+ * Internal pages are never merged, and btree never shrinks.
+ */
 class VersionedBtree {
 public:
-  explicit VersionedBtree(cache::BufferPool::PageHolder root_page) noexcept
-      : root_page_(std::move(root_page)) {}
+  explicit VersionedBtree(cache::BufferPool::PageHolder root_page,
+                          BtreeSmoOpts smo_opts = BtreeSmoOpts()) noexcept
+      : root_page_(std::move(root_page)), smo_opts_(smo_opts) {}
 
   ~VersionedBtree() = default;
 
@@ -36,10 +62,12 @@ public:
    * @param write_ts
    * @param opts
    * @param info
+   * @param leaf leaf page which has been written, if not null.
    * @return Status
    */
   Status SetRow(const property::Row &row, TxnTs write_ts, const Options &opts,
-                WriteInfo *info) noexcept;
+                WriteInfo *info,
+                cache::BufferPool::PageHolder *leaf = nullptr) noexcept;
 
   /**
    * @brief
@@ -48,10 +76,12 @@ public:
    * @param write_ts
    * @param opts
    * @param info
+   * @param leaf leaf page which has been written, if not null.
    * @return Status
    */
   Status DeleteRow(property::SortKeysRef sort_key, TxnTs write_ts,
-                   const Options &opts, WriteInfo *info) noexcept;
+                   const Options &opts, WriteInfo *info,
+                   cache::BufferPool::PageHolder *leaf = nullptr) noexcept;
 
   /**
    * @brief
@@ -79,42 +109,181 @@ public:
 
   /**
    * @brief
-   * Range scan
+   * Range scan, leaf pages are scanned one after another.
    * @param opts
    * @param filter
+   * @param read_ts
    * @param scan_opts
    * @param views
    */
-  void RangeFilter(const Options &opts, const Filter &filter,
+  void RangeFilter(const Options &opts, const Filter &filter, TxnTs read_ts,
                    const BtreeScanOpts &scan_opts,
-                   RangeScanRowView *views) const noexcept {
-    root_page_->RangeFilter(opts, filter, scan_opts, views);
-  }
+                   RangeScanRowView *views) const noexcept;
 
   /**
    * @brief
    * Range scan without order
+   * @param opts
    * @return RowIterator
    */
-  RowIterator GetRowIterator() const noexcept {
-    return root_page_->GetRowIterator();
-  }
+  RowIterator GetRowIterator(const Options &opts) const noexcept;
+
+  /**
+   * @brief
+   * Ordered range scan which produces rows lazily.
+   * cursor must not outlive the buffer pool of opts.
+   * @param opts
+   * @param filter
+   * @param read_ts
+   * @return ScanCursor
+   */
+  ScanCursor GetScanCursor(const Options &opts, const Filter &filter,
+                           TxnTs read_ts) const noexcept;
 
   std::string_view GetRootPageKey() const noexcept {
     return root_page_->GetPageKey();
   }
 
-  // TODO(sheep): support SMO interface
+  const cache::BufferPool::PageHolder &GetRootPage() const noexcept {
+    return root_page_;
+  }
 
   common::LockTable &GetLockTable() noexcept {
     return root_page_->GetLockTable();
   }
 
+  /**
+   * @brief
+   * Replay SMO log during recovery.
+   * @param buffer_pool
+   * @param log
+   */
+  static void ReplaySmo(cache::BufferPool *buffer_pool,
+                        const wal::BtreeSmoLog &log) noexcept;
+
+  size_t TEST_GetHeight(const Options &opts) const noexcept;
+
+  size_t TEST_GetLeafCount(const Options &opts) const noexcept;
+
 private:
-  Status GetRowMultilevel_(property::SortKeysRef sort_key, TxnTs read_ts,
-                           const Options &opts, RowView *view) const noexcept;
+  struct PathEntry {
+    cache::BufferPool::PageHolder page;
+    std::shared_ptr<const InternalRows> rows;
+    // index of the child we have routed to.
+    size_t idx;
+  };
+
+  struct LeafPath {
+    // internal pages from root to the parent of leaf.
+    std::vector<PathEntry> internals;
+    cache::BufferPool::PageHolder leaf;
+    // key range of leaf, empty means unbounded.
+    std::string lower;
+    std::string upper;
+  };
+
+  /**
+   * @brief
+   * Route to the leaf page containing sort_key, see InternalRows::FindChild
+   * for the meaning of before. routing is retried until no SMO is published
+   * during it.
+   * @param root_page
+   * @param buffer_pool
+   * @param sort_key
+   * @param before
+   * @param path
+   * @return Status
+   */
+  static Status FindLeaf_(const cache::BufferPool::PageHolder &root_page,
+                          cache::BufferPool *buffer_pool,
+                          property::SortKeysRef sort_key, bool before,
+                          LeafPath *path) noexcept;
+
+  /**
+   * @brief
+   * Perform write on leaf page, writes on the frozen leaf page are retried
+   * on the new pages.
+   * @param opts
+   * @param sort_key
+   * @param func write on leaf page
+   * @param leaf_charge charge of leaf page which has been written
+   * @param leaf leaf page which has been written, if not null.
+   * @return Status
+   */
+  template <typename Func>
+  Status WriteLeaf_(const Options &opts, property::SortKeysRef sort_key,
+                    WriteInfo *info, Func &&func, size_t *leaf_charge,
+                    cache::BufferPool::PageHolder *leaf = nullptr) noexcept;
+
+  // bookkeeping of buffer pool after writing leaf page.
+  void FinishWrite_(const Options &opts, cache::BufferPool::PageHolder *leaf,
+                    const WriteInfo &info) noexcept;
+
+  /**
+   * @brief
+   * Scan the leaf page containing key, rows are appended to views.
+   * @param key
+   * @param limit remaining limit of filter.
+   * @param row_cnt number of rows appended.
+   * @param next_key key of the next leaf page, empty when scan is done.
+   * @return Status: Retry if leaf page is frozen during the scan.
+   */
+  Status RangeFilterLeaf_(const Options &opts, const Filter &filter,
+                          TxnTs read_ts, const BtreeScanOpts &scan_opts,
+                          std::string_view key, size_t limit,
+                          RangeScanRowView *views, size_t *row_cnt,
+                          std::string *next_key) const noexcept;
+
+  void MaybeSplit_(const Options &opts,
+                   property::SortKeysRef sort_key) noexcept;
+
+  void MaybeMerge_(const Options &opts,
+                   property::SortKeysRef sort_key) noexcept;
+
+  /**
+   * @brief
+   * Split internal pages on the path from bottom up, requires SMO lock.
+   * @param opts
+   * @param path path of the leaf page which has been split.
+   */
+  void SplitInternal_(const Options &opts, const LeafPath &path) noexcept;
+
+  /**
+   * @brief
+   * Log and apply SMO, old pages should have been frozen with images.
+   * requires SMO lock.
+   * @param opts
+   * @param log
+   * @param images
+   */
+  void PerformSmo_(const Options &opts, const wal::BtreeSmoLog &log,
+                   const std::vector<std::string> &images) noexcept;
+
+  /**
+   * @brief
+   * Build new pages from images of old pages and publish them to parent.
+   * shared by SMO and recovery.
+   */
+  static void InstallSmo_(cache::BufferPool *buffer_pool,
+                          const wal::BtreeSmoLog &log,
+                          const std::vector<std::string> &images,
+                          log_store::LsnType lsn) noexcept;
+
+  /**
+   * @brief
+   * Retire old pages after they are unlinked. old pages are deleted from
+   * page store once new pages and parent are flushed, and SMO logged at lsn
+   * is persisted.
+   */
+  static void RetireSmo_(cache::BufferPool *buffer_pool,
+                         const wal::BtreeSmoLog &log,
+                         log_store::LogStore *log_store,
+                         log_store::LsnType lsn) noexcept;
+
+  std::string NewPageId_() const noexcept;
 
   cache::BufferPool::PageHolder root_page_;
+  const BtreeSmoOpts smo_opts_;
 };
 
 } // namespace btree
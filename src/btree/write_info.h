@@ -12,6 +12,7 @@
 #pragma once
 
 #include "log_store/log_store.h"
+#include <cstddef>
 
 namespace arcanedb {
 namespace btree {
@@ -24,6 +25,11 @@ namespace btree {
 struct WriteInfo {
   log_store::LsnType lsn{log_store::kInvalidLsn};
   bool is_dirty{false};
+  // delta chain is too long and page should be compacted in background.
+  bool need_compaction{false};
+  // slot of wait table where readers blocked by the written row park, so
+  // that writer could wake them once the intent is resolved elsewhere.
+  size_t wait_hash{0};
 };
 
 } // namespace btree
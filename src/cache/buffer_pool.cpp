@@ -10,25 +10,64 @@
  */
 
 #include "cache/buffer_pool.h"
+#include "cache/clock_cache.h"
+#include "cache/compaction_scheduler.h"
 #include "cache/flusher.h"
+#include "cache/s3fifo_cache.h"
+#include "absl/hash/hash.h"
+#include "common/logger.h"
+#include "util/bthread_util.h"
 #include <cassert>
 
 namespace arcanedb {
 namespace cache {
 
-BufferPool::BufferPool(
-    std::shared_ptr<page_store::PageStore> page_store) noexcept
-    : cache_(NewLRUCache<bthread::Mutex>(common::Config::kCacheCapacity,
-                                         common::Config::kCacheShardNumBits)) {
+namespace {
+
+std::unique_ptr<Cache> NewCache(CachePolicy policy) noexcept {
+  switch (policy) {
+  case CachePolicy::kLRU:
+    return NewLRUCache<bthread::Mutex>(common::Config::kCacheCapacity,
+                                       common::Config::kCacheShardNumBits);
+  case CachePolicy::kS3FIFO:
+    return NewS3FifoCache<bthread::Mutex>(common::Config::kCacheCapacity,
+                                          common::Config::kCacheShardNumBits);
+  case CachePolicy::kClock:
+    return NewClockCache<bthread::Mutex>(common::Config::kCacheCapacity,
+                                         common::Config::kCacheShardNumBits);
+  default:
+    UNREACHABLE();
+  }
+}
+
+} // namespace
+
+BufferPool::BufferPool(std::shared_ptr<page_store::PageStore> page_store,
+                       CachePolicy policy) noexcept
+    : cache_(NewCache(policy)),
+      compaction_scheduler_(std::make_shared<CompactionScheduler>(
+          common::Config::kCompactionWorkerNum)) {
+  compaction_scheduler_->Start();
   if (page_store) {
     page_store_ = std::move(page_store);
     flusher_ = std::make_shared<Flusher>(common::Config::kFlusherShardNum,
                                          page_store_);
     flusher_->Start();
   }
+  Cache::EvictionHooks hooks;
+  hooks.can_evict = [](void *value) {
+    return static_cast<btree::VersionedBtreePage *>(value)->IsEvictable();
+  };
+  hooks.on_refused = [this](Cache::HandleHolder handle_holder) {
+    // page is evictable once it's flushed.
+    TryInsertDirtyPage(PageHolder(std::move(handle_holder)));
+  };
+  cache_->SetEvictionHooks(std::move(hooks));
 }
 
 BufferPool::~BufferPool() noexcept {
+  prefetch_wg_.Wait();
+  compaction_scheduler_->Stop();
   if (flusher_) {
     flusher_->Stop();
   }
@@ -36,48 +75,154 @@ BufferPool::~BufferPool() noexcept {
 
 Status BufferPool::GetPage(const std::string_view &page_id,
                            PageHolder *page_handle) noexcept {
-  auto handle_holder = cache_->Lookup(page_id);
-  if (handle_holder) {
+  Cache::HandleHolder handle_holder;
+  if (LookupPage_(page_id, &handle_holder)) {
     *page_handle = PageHolder(std::move(handle_holder));
     return Status::Ok();
   }
   auto s = load_group_.Do(
       page_id, &handle_holder,
       [&](const std::string_view &key, Cache::HandleHolder *val) {
-        auto page = std::make_unique<btree::VersionedBtreePage>(key);
-
-        if (page_store_) {
-          page_store::ReadOptions read_opts;
-          std::vector<page_store::PageStore::RawPage> pages;
-          auto s =
-              page_store_->ReadPage(page->GetPageKeyRef(), read_opts, &pages);
-
-          if (s.ok()) {
-            assert(pages.size() == 1);
-            s = page->Deserialize(pages[0].binary);
-          }
-          if (!s.ok() && !s.IsNotFound()) {
-            return s;
-          }
-        }
-
-        auto handle = cache_->Insert(
-            key, page.get(), sizeof(btree::VersionedBtreePage), &PageDeleter);
-        *val = std::move(handle);
-        page.release();
-        return Status::Ok();
+        return LoadPage_(key, val);
       });
 
   *page_handle = PageHolder(std::move(handle_holder));
   return s;
 }
 
+Status BufferPool::GetHotPage(const std::string_view &page_id,
+                              PageIdHash hash,
+                              PageHolder *page_handle) noexcept {
+  auto pin = hot_pages_.Lookup(hash);
+  if (pin &&
+      pin->TValue<btree::VersionedBtreePage>()->GetPageKey() == page_id) {
+    *page_handle = PageHolder(std::move(pin));
+    return Status::Ok();
+  }
+  auto s = GetPage(page_id, page_handle);
+  if (s.ok()) {
+    hot_pages_.Insert(hash, page_handle->handle_holder_,
+                      (*page_handle)->GetTotalCharge());
+  }
+  return s;
+}
+
+void BufferPool::Prefetch(absl::Span<const PageIdView> page_ids) noexcept {
+  for (auto page_id : page_ids) {
+    Cache::HandleHolder handle_holder;
+    if (LookupPage_(page_id, &handle_holder)) {
+      continue;
+    }
+    prefetch_wg_.Add(1);
+    util::LaunchAsync([this, page_id = std::string(page_id)]() {
+      PageHolder page_holder;
+      auto s = GetPage(page_id, &page_holder);
+      if (!s.ok()) {
+        ARCANEDB_WARN("Failed to prefetch page {}, status {}", page_id,
+                      s.ToString());
+      }
+      prefetch_wg_.Done();
+    });
+  }
+}
+
+void BufferPool::GetPages(absl::Span<const PageIdView> page_ids,
+                          std::vector<PageHolder> *pages,
+                          std::vector<Status> *status,
+                          util::WaitGroup *wg) noexcept {
+  pages->clear();
+  pages->resize(page_ids.size());
+  status->assign(page_ids.size(), Status::Ok());
+  wg->Add(page_ids.size());
+  for (size_t i = 0; i < page_ids.size(); i++) {
+    // cached pages are served inline, only missing pages are loaded in
+    // background.
+    Cache::HandleHolder handle_holder;
+    if (LookupPage_(page_ids[i], &handle_holder)) {
+      (*pages)[i] = PageHolder(std::move(handle_holder));
+      wg->Done();
+      continue;
+    }
+    util::LaunchAsync([this, page_id = page_ids[i], page = &(*pages)[i],
+                       s = &(*status)[i], wg]() {
+      *s = GetPage(page_id, page);
+      wg->Done();
+    });
+  }
+}
+
+bool BufferPool::LookupPage_(PageIdView page_id,
+                             Cache::HandleHolder *handle_holder) noexcept {
+  *handle_holder = cache_->Lookup(page_id);
+  return static_cast<bool>(*handle_holder);
+}
+
+PageIdHash BufferPool::HashPageId(PageIdView page_id) noexcept {
+  return absl::Hash<PageIdView>()(page_id);
+}
+
+size_t
+BufferPool::GetPageCharge_(const Cache::HandleHolder &handle_holder) noexcept {
+  return handle_holder.TValue<btree::VersionedBtreePage>()->GetTotalCharge();
+}
+
+Status BufferPool::LoadPage_(PageIdView page_id,
+                             Cache::HandleHolder *handle_holder) noexcept {
+  // page might be loaded by previous flight, flights of the same page never
+  // overlap, so the page couldn't be installed after this check.
+  if (LookupPage_(page_id, handle_holder)) {
+    return Status::Ok();
+  }
+  auto page = std::make_unique<btree::VersionedBtreePage>(page_id);
+  auto s = ReadPage_(page.get());
+  if (!s.ok()) {
+    return s;
+  }
+  auto charge = page->GetTotalCharge();
+  *handle_holder = cache_->Insert(page_id, page.get(), charge, &PageDeleter);
+  page.release();
+  return Status::Ok();
+}
+
+Status BufferPool::ReadPage_(btree::VersionedBtreePage *page) noexcept {
+  if (!page_store_) {
+    return Status::Ok();
+  }
+  page_store::ReadOptions read_opts;
+  std::vector<page_store::PageStore::RawPage> pages;
+  auto s = page_store_->ReadPage(page->GetPageKeyRef(), read_opts, &pages);
+  // base page is followed by deltas in order, only packed pages are flushed
+  // as delta, see PackedPage::Serialize.
+  for (size_t i = 0; s.ok() && i < pages.size(); i++) {
+    assert(i == 0 || page->GetPageType() == btree::PageType::PackedPage);
+    s = page->Deserialize(pages[i].binary);
+  }
+  if (!s.ok() && !s.IsNotFound()) {
+    return s;
+  }
+  return Status::Ok();
+}
+
 void BufferPool::TryInsertDirtyPage(const PageHolder &page_holder) noexcept {
   if (flusher_) {
     flusher_->TryInsertDirtyPage(page_holder);
   }
 }
 
+void BufferPool::RetirePage(const PageHolder &page_holder,
+                            std::shared_ptr<const SmoSuccessors> successors,
+                            log_store::LogStore *log_store,
+                            log_store::LsnType lsn) noexcept {
+  page_holder->Retire();
+  if (flusher_) {
+    flusher_->RetirePage(page_holder, std::move(successors), log_store, lsn);
+  }
+}
+
+void BufferPool::TryScheduleCompaction(const PageHolder &page_holder) noexcept {
+  compaction_scheduler_->TrySchedule(page_holder);
+}
+
 void BufferPool::ForceFlushAllPages() noexcept {
   if (flusher_) {
     flusher_->ForceFlushAllPages();
@@ -13,12 +13,17 @@
 
 #include "btree/page/versioned_btree_page.h"
 #include "cache/cache.h"
+#include "cache/hot_page_table.h"
 #include "cache/lru_cache.h"
 #include "common/config.h"
 #include "common/status.h"
 #include "common/type.h"
+#include "log_store/log_store.h"
 #include "util/singleflight.h"
+#include "util/wait_group.h"
+#include "absl/types/span.h"
 #include <type_traits>
+#include <vector>
 
 namespace arcanedb {
 namespace page_store {
@@ -28,6 +33,15 @@ class PageStore;
 namespace cache {
 
 class Flusher;
+class CompactionScheduler;
+
+enum class CachePolicy : uint8_t {
+  kLRU,
+  // scan-resistant, see S3FifoCache.
+  kS3FIFO,
+  // hits are served without acquiring mutex, see ClockCache.
+  kClock,
+};
 
 /**
  * @brief
@@ -36,7 +50,8 @@ class Flusher;
 class BufferPool {
 public:
   // page_store == nullptr indicates that we don't needs to flush dirty pages
-  BufferPool(std::shared_ptr<page_store::PageStore> page_store) noexcept;
+  BufferPool(std::shared_ptr<page_store::PageStore> page_store,
+             CachePolicy policy = CachePolicy::kLRU) noexcept;
 
   ~BufferPool() noexcept;
 
@@ -44,22 +59,42 @@ public:
   class PageHolder {
   public:
     btree::VersionedBtreePage *operator->() const noexcept {
+      if (pin_) {
+        return pin_->TValue<btree::VersionedBtreePage>();
+      }
       return handle_holder_.TValue<btree::VersionedBtreePage>();
     }
 
     explicit PageHolder(Cache::HandleHolder handle_holder) noexcept
         : handle_holder_(std::move(handle_holder)) {}
 
+    // share the pin of hot page, see HotPageTable.
+    explicit PageHolder(HotPageTable::Pin pin) noexcept
+        : pin_(std::move(pin)) {}
+
     PageHolder() = default;
     PageHolder(const PageHolder &) = default;
     PageHolder &operator=(const PageHolder &) = default;
     PageHolder(PageHolder &&) = default;
     PageHolder &operator=(PageHolder &&) = default;
 
-    void UpdateCharge(size_t charge) { handle_holder_.UpdateCharge(charge); }
+    void UpdateCharge(size_t charge) {
+      if (pin_) {
+        pin_->UpdateCharge(charge);
+        return;
+      }
+      handle_holder_.UpdateCharge(charge);
+    }
+
+    explicit operator bool() const noexcept {
+      return pin_ != nullptr || static_cast<bool>(handle_holder_);
+    }
 
   private:
+    friend class BufferPool;
+
     Cache::HandleHolder handle_holder_{};
+    HotPageTable::Pin pin_{};
   };
 
   /**
@@ -72,9 +107,127 @@ public:
   Status GetPage(const std::string_view &page_id,
                  PageHolder *page_handle) noexcept;
 
+  /**
+   * @brief
+   * Get page through the hot page table of current worker, pages are pinned
+   * in the table once they are loaded, so that repeated access to hot pages
+   * won't probe the cache. used for the entry pages of subtables.
+   * pinned pages take at most 1/kHotPageCapacityRatio of capacity.
+   * @param page_id
+   * @param page_handle
+   * @return Status
+   */
+  Status GetHotPage(const std::string_view &page_id,
+                    PageHolder *page_handle) noexcept {
+    return GetHotPage(page_id, HashPageId(page_id), page_handle);
+  }
+
+  /**
+   * @brief
+   * Same as above, but page is indexed by hash given by caller, which should
+   * be stable for the page.
+   * @param page_id
+   * @param hash
+   * @param page_handle
+   * @return Status
+   */
+  Status GetHotPage(const std::string_view &page_id, PageIdHash hash,
+                    PageHolder *page_handle) noexcept;
+
+  /**
+   * @brief
+   * Take the object cached along with hot page, see HotPageTable.
+   * @param hash
+   * @return std::unique_ptr<HotPageTable::Attachment>
+   */
+  std::unique_ptr<HotPageTable::Attachment>
+  TakeHotAttachment(PageIdHash hash) noexcept {
+    return hot_pages_.TakeAttachment(hash);
+  }
+
+  /**
+   * @brief
+   * Cache attachment along with hot page, it's released if page is no longer
+   * pinned.
+   * @param hash
+   * @param page page which attachment is built on.
+   * @param attachment
+   */
+  void PutHotAttachment(
+      PageIdHash hash, const PageHolder &page,
+      std::unique_ptr<HotPageTable::Attachment> attachment) noexcept {
+    hot_pages_.PutAttachment(hash, page.operator->(), std::move(attachment));
+  }
+
+  static PageIdHash HashPageId(PageIdView page_id) noexcept;
+
+  /**
+   * @brief
+   * Load missing pages in background, so that following GetPage could hit
+   * the cache. loads are fanned out across bthreads, and deduplicated with
+   * concurrent loads of the same page by singleflight.
+   * @param page_ids
+   */
+  void Prefetch(absl::Span<const PageIdView> page_ids) noexcept;
+
+  /**
+   * @brief
+   * Async version of GetPage, missing pages are loaded concurrently.
+   * pages and status are filled in the order of page_ids, and wg is done
+   * once all pages are loaded. page_ids, pages and status should outlive wg.
+   * @param page_ids
+   * @param pages
+   * @param status
+   * @param wg
+   */
+  void GetPages(absl::Span<const PageIdView> page_ids,
+                std::vector<PageHolder> *pages, std::vector<Status> *status,
+                util::WaitGroup *wg) noexcept;
+
   void TryInsertDirtyPage(const PageHolder &page_holder) noexcept;
 
-  void Prune() noexcept { cache_->Prune(); }
+  // pages written by SMO, along with the write version covering SMO.
+  using SmoSuccessors = std::vector<std::pair<PageHolder, uint64_t>>;
+
+  /**
+   * @brief
+   * Retire page which has been unlinked by SMO. retired page is deleted from
+   * page store once its successors are flushed and SMO is persisted, so that
+   * its rows survive crash. retired page stays in cache until it's evicted,
+   * since readers might still be holding it.
+   * @param page_holder
+   * @param successors
+   * @param log_store nullptr if SMO is not logged.
+   * @param lsn lsn of SMO.
+   */
+  void RetirePage(const PageHolder &page_holder,
+                  std::shared_ptr<const SmoSuccessors> successors,
+                  log_store::LogStore *log_store,
+                  log_store::LsnType lsn) noexcept;
+
+  /**
+   * @brief
+   * Compact the delta chain of page in background.
+   * @param page_holder
+   */
+  void TryScheduleCompaction(const PageHolder &page_holder) noexcept;
+
+  void Prune() noexcept {
+    hot_pages_.Clear();
+    cache_->Prune();
+  }
+
+  /**
+   * @brief
+   * Change the memory budget of buffer pool. only clean pages are evicted,
+   * and dirty pages chosen as victims are written back first, so pages are
+   * never evicted without page store.
+   * @param capacity
+   */
+  void SetCapacity(size_t capacity) noexcept {
+    hot_pages_.SetCapacity(capacity / common::Config::kHotPageCapacityRatio);
+    cache_->SetCapacity(capacity);
+  }
 
   size_t TotalCharge() noexcept { return cache_->TotalCharge(); }
 
@@ -85,10 +238,42 @@ private:
     delete static_cast<btree::VersionedBtreePage *>(value);
   }
 
+  static size_t
+  GetPageCharge_(const Cache::HandleHolder &handle_holder) noexcept;
+
+  /**
+   * @brief
+   * Find page in cache without loading it.
+   * @param page_id
+   * @param handle_holder
+   * @return true if page is cached.
+   */
+  bool LookupPage_(PageIdView page_id,
+                   Cache::HandleHolder *handle_holder) noexcept;
+
+  /**
+   * @brief
+   * Load page into cache, or return the page loaded by previous flight.
+   * @param page_id
+   * @param handle_holder
+   * @return Status
+   */
+  Status LoadPage_(PageIdView page_id,
+                   Cache::HandleHolder *handle_holder) noexcept;
+
+  Status ReadPage_(btree::VersionedBtreePage *page) noexcept;
+
   std::unique_ptr<Cache> cache_;
   std::shared_ptr<page_store::PageStore> page_store_{};
   std::shared_ptr<Flusher> flusher_{};
+  std::shared_ptr<CompactionScheduler> compaction_scheduler_{};
   util::SingleFlight<Cache::HandleHolder, std::string_view> load_group_;
+  // declared after cache_, so that pinned pages are released first.
+  HotPageTable hot_pages_{common::Config::kCacheCapacity /
+                              common::Config::kHotPageCapacityRatio,
+                          &BufferPool::GetPageCharge_};
+  // in-flight prefetches, waited before buffer pool is destroyed.
+  util::WaitGroup prefetch_wg_;
 };
 
 } // namespace cache
@@ -18,6 +18,7 @@
 #pragma once
 #include "common/macros.h"
 #include <cstdint>
+#include <functional>
 #include <memory>
 #include <string_view>
 #include <utility>
@@ -155,7 +156,32 @@ public:
   // cache.
   virtual size_t TotalCharge() = 0;
 
+  // Change the capacity of the cache, entries are evicted immediately if
+  // usage exceeds the new capacity.
+  // Default implementation of SetCapacity() does nothing.
+  virtual void SetCapacity(size_t capacity) {}
+
+  struct EvictionHooks {
+    // Whether an entry which is not in use could be evicted. it's called
+    // while holding the lock of cache, so it must be cheap.
+    std::function<bool(void *value)> can_evict;
+    // Entries refused by "can_evict" are passed here after the lock of
+    // cache is released, e.g. to write them back so that they could be
+    // evicted later. entry goes back to cache once the handle is released.
+    std::function<void(HandleHolder handle)> on_refused;
+  };
+
+  // Install hooks that decide which entries could be evicted.
+  // REQUIRES: called before the cache is used.
+  // Default implementation of SetEvictionHooks() does nothing.
+  virtual void SetEvictionHooks(EvictionHooks hooks) {}
+
 protected:
+  // Wrap a handle returned by a method on *this into a holder.
+  HandleHolder MakeHolder(Handle *handle) {
+    return HandleHolder(this, handle, Value(handle));
+  }
+
   // Insert a mapping from key->value into the cache and assign it
   // the specified charge against the total cache capacity.
   //
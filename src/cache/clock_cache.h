@@ -0,0 +1,575 @@
+/**
+ * @file clock_cache.h
+ * @author sheep (ysj1173886760@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#include "absl/hash/hash.h"
+#include "cache/cache.h"
+#include "util/epoch.h"
+
+namespace arcanedb {
+namespace cache {
+
+// CLOCK cache implementation
+//
+// Lookup, Fork and Release never acquire the mutex of shard:
+// - entries are kept in an open addressing table of atomic pointers, readers
+//   probe it inside an epoch guard, see util::EpochManager. table and entries
+//   unlinked by writers are retired instead of being freed.
+// - an entry is pinned by incrementing its atomic reference count. pinning
+//   fails once the entry is marked invalid by eviction or erase.
+// - instead of relinking a LRU list, a hit only raises the clock counter of
+//   entry, and only when it's not saturated, so hot entries are read-only.
+// Insert, eviction and resizing are serialized by the mutex of shard. the
+// clock hand sweeps the table, entries with non-zero counter are given
+// another chance by decrementing the counter.
+// Entries refused by "can_evict" are flagged and skipped by the sweep until
+// they are released, e.g. after they are flushed. once a sweep couldn't make
+// room, eviction stalls until a refused entry is released as evictable or
+// capacity is changed, so that writes on a full cache don't sweep it over and over.
+struct ClockHandle {
+  void *value;
+  void (*deleter)(const std::string_view &, void *value);
+  size_t charge; // guarded by mutex of shard.
+  size_t key_length;
+  // number of external references, and the flags below.
+  std::atomic<uint32_t> refs;
+  std::atomic<uint8_t> clock; // CLOCK counter, raised by hits.
+  uint32_t hash;              // Hash of key(); used for fast comparisons.
+  char key_data[1];           // Beginning of key
+
+  // Entry is not in the cache, new references couldn't be acquired.
+  static constexpr uint32_t kInvalid = 1u << 31;
+  // Entry has been passed to deleter.
+  static constexpr uint32_t kDead = 1u << 30;
+  // Entry is refused by "can_evict", and it's pinned by the refused handle.
+  static constexpr uint32_t kRefused = 1u << 29;
+  static constexpr uint32_t kRefMask = kRefused - 1;
+
+  std::string_view key() const { return {key_data, key_length}; }
+};
+
+// A single shard of sharded cache.
+template <typename Mutex> class ClockCache {
+public:
+  ClockCache();
+  ~ClockCache();
+
+  void SetCapacity(size_t capacity, std::vector<ClockHandle *> *refused);
+
+  // Entries that are not in use are evicted only if "can_evict" agrees.
+  // REQUIRES: called before the cache is used.
+  void SetCanEvict(const std::function<bool(void *value)> *can_evict) {
+    can_evict_ = can_evict;
+  }
+
+  // Like Cache methods, but with an extra "hash" parameter.
+  // entries refused by "can_evict_" during eviction are appended to
+  // "refused" with a reference, caller should release them.
+  ClockHandle *Insert(const std::string_view &key, uint32_t hash,
+                      void *value, size_t charge,
+                      void (*deleter)(const std::string_view &key,
+                                      void *value),
+                      std::vector<ClockHandle *> *refused);
+  ClockHandle *Lookup(const std::string_view &key, uint32_t hash);
+  void Fork(ClockHandle *handle) {
+    handle->refs.fetch_add(1, std::memory_order_relaxed);
+  }
+  void Release(ClockHandle *handle) { Unref(handle); }
+  void Prune(std::vector<ClockHandle *> *refused);
+
+  size_t TotalCharge() {
+    std::lock_guard<decltype(mutex_)> lock(mutex_);
+    return usage_;
+  }
+  void UpdateCharge(ClockHandle *handle, size_t new_charge,
+                    std::vector<ClockHandle *> *refused) {
+    std::lock_guard<decltype(mutex_)> lock(mutex_);
+    // caller holds a reference, so entry is in the cache unless it's erased.
+    if (!(handle->refs.load(std::memory_order_relaxed) &
+          ClockHandle::kInvalid)) {
+      usage_ = usage_ - handle->charge + new_charge;
+    }
+    handle->charge = new_charge;
+    Evict(refused);
+  }
+
+private:
+  static constexpr uint8_t kMaxClock = 3;
+  static constexpr size_t kMinTableSize = 16;
+
+  struct Table {
+    explicit Table(size_t size)
+        : mask(size - 1), slots(new std::atomic<ClockHandle *>[size]()) {}
+
+    size_t size() const { return mask + 1; }
+
+    const size_t mask;
+    std::unique_ptr<std::atomic<ClockHandle *>[]> slots;
+  };
+
+  // Erased slots are kept as tombstones, so that probing of readers is not
+  // cut off. they are dropped when table is rebuilt.
+  static ClockHandle *Tombstone() {
+    static ClockHandle tombstone{};
+    return &tombstone;
+  }
+
+  static bool IsEntry(ClockHandle *e) {
+    return e != nullptr && e != Tombstone();
+  }
+
+  void Unref(ClockHandle *e);
+  // Free entry once it's invalid and not referenced. the last one who
+  // observes it wins, since stale readers might pin it temporarily.
+  void TryFree(ClockHandle *e);
+  void Free(ClockHandle *e);
+
+  // Following methods require mutex_.
+  size_t FindSlot(const std::string_view &key, uint32_t hash);
+  void InsertSlot(Table *table, ClockHandle *e);
+  void Erase(size_t slot);
+  // Drop tombstones, and grow the table to hold at least "count" entries.
+  void Rebuild(size_t count);
+  // Return whether entry has been evicted.
+  bool TryEvict(size_t slot, std::vector<ClockHandle *> *refused);
+  // Evict until usage fits capacity, or clock counters are exhausted.
+  void Evict(std::vector<ClockHandle *> *refused);
+
+  // Initialized before use.
+  const std::function<bool(void *value)> *can_evict_{nullptr};
+
+  // table probed by readers.
+  std::atomic<Table *> table_{nullptr};
+
+  // mutex_ protects the following state.
+  Mutex mutex_;
+  size_t capacity_{0};
+  size_t usage_{0};
+  // number of entries in table.
+  size_t count_{0};
+  // number of entries and tombstones in table.
+  size_t occupied_{0};
+  size_t clock_hand_{0};
+  // owner of table_.
+  std::shared_ptr<Table> owned_table_;
+  // eviction is stalled until refused_released_ moves past stalled_epoch_.
+  bool stalled_{false};
+  uint64_t stalled_epoch_{0};
+
+  // bumped whenever a refused entry is released and it could be evicted.
+  std::atomic<uint64_t> refused_released_{0};
+};
+
+template <typename Mutex> inline ClockCache<Mutex>::ClockCache() {
+  owned_table_ = std::make_shared<Table>(kMinTableSize);
+  table_.store(owned_table_.get(), std::memory_order_release);
+}
+
+template <typename Mutex> inline ClockCache<Mutex>::~ClockCache() {
+  auto *table = owned_table_.get();
+  for (size_t i = 0; i < table->size(); i++) {
+    auto *e = table->slots[i].load(std::memory_order_relaxed);
+    if (IsEntry(e)) {
+      // Error if caller has an unreleased handle
+      assert(e->refs.load(std::memory_order_relaxed) == 0);
+      (*e->deleter)(e->key(), e->value);
+      free(e);
+    }
+  }
+}
+
+template <typename Mutex>
+inline void ClockCache<Mutex>::Unref(ClockHandle *e) {
+  auto refs = e->refs.fetch_sub(1, std::memory_order_acq_rel);
+  assert((refs & ClockHandle::kRefMask) > 0);
+  if ((refs & ClockHandle::kRefused) &&
+      (refs & ClockHandle::kRefMask) == 1) {
+    // refused entry is released, the flag keeps it alive until it's cleared.
+    // stalled eviction is resumed only if the entry could be evicted now.
+    if (can_evict_ == nullptr || (*can_evict_)(e->value)) {
+      refused_released_.fetch_add(1, std::memory_order_relaxed);
+    }
+    refs = e->refs.fetch_and(~ClockHandle::kRefused,
+                             std::memory_order_acq_rel);
+    if ((refs & ~ClockHandle::kRefused) == ClockHandle::kInvalid) {
+      TryFree(e);
+    }
+    return;
+  }
+  if (refs == (ClockHandle::kInvalid | 1)) {
+    TryFree(e);
+  }
+}
+
+template <typename Mutex>
+inline void ClockCache<Mutex>::TryFree(ClockHandle *e) {
+  uint32_t expected = ClockHandle::kInvalid;
+  if (e->refs.compare_exchange_strong(
+          expected, ClockHandle::kInvalid | ClockHandle::kDead,
+          std::memory_order_acq_rel)) {
+    Free(e);
+  }
+}
+
+template <typename Mutex>
+inline void ClockCache<Mutex>::Free(ClockHandle *e) {
+  (*e->deleter)(e->key(), e->value);
+  // readers might still be comparing the key.
+  util::EpochManager::GetInstance()->Retire(std::shared_ptr<const void>(
+      e, [](const void *e) { free(const_cast<void *>(e)); }));
+}
+
+template <typename Mutex>
+inline ClockHandle *ClockCache<Mutex>::Lookup(const std::string_view &key,
+                                              uint32_t hash) {
+  ClockHandle *found = nullptr;
+  std::vector<ClockHandle *> stale;
+  {
+    util::EpochManager::Guard guard;
+    auto *table = table_.load(std::memory_order_acquire);
+    for (size_t i = hash & table->mask, probe = 0; probe < table->size();
+         i = (i + 1) & table->mask, probe++) {
+      auto *e = table->slots[i].load(std::memory_order_acquire);
+      if (e == nullptr) {
+        break;
+      }
+      if (e == Tombstone() || e->hash != hash || e->key() != key) {
+        continue;
+      }
+      // pin entry, which fails if entry has been evicted or erased.
+      auto refs = e->refs.fetch_add(1, std::memory_order_acquire);
+      if (refs & ClockHandle::kDead) {
+        e->refs.fetch_sub(1, std::memory_order_relaxed);
+        continue;
+      }
+      if (refs & ClockHandle::kInvalid) {
+        // our reference keeps erased entry from being freed, drop it outside
+        // of epoch guard since freeing entry might block.
+        stale.push_back(e);
+        continue;
+      }
+      // avoid writing shared cache line when counter is saturated.
+      if (e->clock.load(std::memory_order_relaxed) < kMaxClock) {
+        e->clock.store(kMaxClock, std::memory_order_relaxed);
+      }
+      found = e;
+      break;
+    }
+  }
+  for (auto *e : stale) {
+    Unref(e);
+  }
+  return found;
+}
+
+template <typename Mutex>
+inline size_t ClockCache<Mutex>::FindSlot(const std::string_view &key,
+                                          uint32_t hash) {
+  auto *table = owned_table_.get();
+  for (size_t i = hash & table->mask;; i = (i + 1) & table->mask) {
+    auto *e = table->slots[i].load(std::memory_order_relaxed);
+    if (e == nullptr) {
+      return table->size();
+    }
+    if (e != Tombstone() && e->hash == hash && e->key() == key) {
+      return i;
+    }
+  }
+}
+
+template <typename Mutex>
+inline void ClockCache<Mutex>::InsertSlot(Table *table, ClockHandle *e) {
+  for (size_t i = e->hash & table->mask;; i = (i + 1) & table->mask) {
+    auto *slot = table->slots[i].load(std::memory_order_relaxed);
+    if (!IsEntry(slot)) {
+      occupied_ += slot == nullptr;
+      table->slots[i].store(e, std::memory_order_release);
+      return;
+    }
+  }
+}
+
+template <typename Mutex> inline void ClockCache<Mutex>::Erase(size_t slot) {
+  auto &s = owned_table_->slots[slot];
+  auto *e = s.load(std::memory_order_relaxed);
+  s.store(Tombstone(), std::memory_order_release);
+  usage_ -= e->charge;
+  count_ -= 1;
+  auto refs =
+      e->refs.fetch_or(ClockHandle::kInvalid, std::memory_order_acq_rel);
+  if ((refs & ClockHandle::kRefMask) == 0) {
+    TryFree(e);
+  }
+}
+
+template <typename Mutex>
+inline void ClockCache<Mutex>::Rebuild(size_t count) {
+  size_t size = kMinTableSize;
+  // keep load factor under 1/2 after rebuilding.
+  while (size < count * 2) {
+    size *= 2;
+  }
+  auto table = std::make_shared<Table>(size);
+  occupied_ = 0;
+  for (size_t i = 0; i < owned_table_->size(); i++) {
+    auto *e = owned_table_->slots[i].load(std::memory_order_relaxed);
+    if (IsEntry(e)) {
+      InsertSlot(table.get(), e);
+    }
+  }
+  table_.store(table.get(), std::memory_order_release);
+  clock_hand_ = 0;
+  util::EpochManager::GetInstance()->Retire(std::move(owned_table_));
+  owned_table_ = std::move(table);
+}
+
+template <typename Mutex>
+inline ClockHandle *ClockCache<Mutex>::Insert(
+    const std::string_view &key, uint32_t hash, void *value, size_t charge,
+    void (*deleter)(const std::string_view &key, void *value),
+    std::vector<ClockHandle *> *refused) {
+  std::lock_guard<decltype(mutex_)> lock(mutex_);
+
+  auto *e = new (malloc(sizeof(ClockHandle) - 1 + key.size())) ClockHandle;
+  e->value = value;
+  e->deleter = deleter;
+  e->charge = charge;
+  e->key_length = key.size();
+  e->hash = hash;
+  e->clock.store(0, std::memory_order_relaxed);
+  std::memcpy(e->key_data, key.data(), key.size());
+
+  if (capacity_ > 0) {
+    e->refs.store(1, std::memory_order_relaxed); // for the returned handle.
+    auto slot = FindSlot(key, hash);
+    if (slot != owned_table_->size()) {
+      Erase(slot);
+    }
+    // keep load factor under 3/4, so that probing always terminates early.
+    if ((occupied_ + 1) * 4 > owned_table_->size() * 3) {
+      Rebuild(count_ + 1);
+    }
+    InsertSlot(owned_table_.get(), e);
+    usage_ += charge;
+    count_ += 1;
+  } else { // don't cache. (capacity_==0 is supported and turns off caching.)
+    e->refs.store(ClockHandle::kInvalid | 1, std::memory_order_relaxed);
+  }
+
+  Evict(refused);
+  return e;
+}
+
+template <typename Mutex>
+inline void
+ClockCache<Mutex>::SetCapacity(size_t capacity,
+                               std::vector<ClockHandle *> *refused) {
+  std::lock_guard<decltype(mutex_)> lock(mutex_);
+  capacity_ = capacity;
+  stalled_ = false;
+  Evict(refused);
+}
+
+template <typename Mutex>
+inline bool ClockCache<Mutex>::TryEvict(size_t slot,
+                                        std::vector<ClockHandle *> *refused) {
+  auto &s = owned_table_->slots[slot];
+  auto *e = s.load(std::memory_order_relaxed);
+  if (e->refs.load(std::memory_order_relaxed) != 0) { // in use or refused
+    return false;
+  }
+  if (can_evict_ != nullptr && !(*can_evict_)(e->value)) {
+    // flag is cleared once the refused handle is released.
+    e->refs.fetch_add(ClockHandle::kRefused | 1, std::memory_order_relaxed);
+    refused->push_back(e);
+    return false;
+  }
+  uint32_t expected = 0;
+  if (!e->refs.compare_exchange_strong(
+          expected, ClockHandle::kInvalid | ClockHandle::kDead,
+          std::memory_order_acq_rel)) {
+    // pinned by a reader concurrently.
+    return false;
+  }
+  s.store(Tombstone(), std::memory_order_release);
+  usage_ -= e->charge;
+  count_ -= 1;
+  Free(e);
+  return true;
+}
+
+template <typename Mutex>
+inline void ClockCache<Mutex>::Evict(std::vector<ClockHandle *> *refused) {
+  if (usage_ <= capacity_) {
+    return;
+  }
+  auto epoch = refused_released_.load(std::memory_order_relaxed);
+  if (stalled_ && epoch == stalled_epoch_) {
+    return;
+  }
+  stalled_ = false;
+  auto *table = owned_table_.get();
+  // every entry is visited at most kMaxClock + 1 times before it's evicted,
+  // which bounds the loop when entries couldn't be evicted.
+  size_t budget = table->size() * (kMaxClock + 1);
+  while (usage_ > capacity_ && count_ > 0 && budget > 0) {
+    budget -= 1;
+    auto slot = clock_hand_;
+    clock_hand_ = (clock_hand_ + 1) & table->mask;
+    auto *e = table->slots[slot].load(std::memory_order_relaxed);
+    if (!IsEntry(e)) {
+      continue;
+    }
+    auto clock = e->clock.load(std::memory_order_relaxed);
+    if (clock > 0) {
+      e->clock.store(clock - 1, std::memory_order_relaxed);
+      continue;
+    }
+    TryEvict(slot, refused);
+  }
+  if (usage_ > capacity_) {
+    stalled_ = true;
+    stalled_epoch_ = epoch;
+  }
+}
+
+template <typename Mutex>
+inline void ClockCache<Mutex>::Prune(std::vector<ClockHandle *> *refused) {
+  std::lock_guard<decltype(mutex_)> lock(mutex_);
+  auto *table = owned_table_.get();
+  for (size_t i = 0; i < table->size(); i++) {
+    if (IsEntry(table->slots[i].load(std::memory_order_relaxed))) {
+      TryEvict(i, refused);
+    }
+  }
+}
+
+template <typename Mutex> class ShardedClockCache : public Cache {
+private:
+  const uint32_t num_shard_bits_;
+  const uint32_t num_shards_;
+  std::vector<ClockCache<Mutex>> shard_;
+  Mutex id_mutex_;
+  uint64_t last_id_;
+  EvictionHooks hooks_;
+
+  static inline uint32_t HashSlice(const std::string_view &s) {
+    return absl::Hash<std::string_view>()(s);
+  }
+
+  // Note, hash >> 32 yields hash in gcc, not the zero we expect!
+  uint32_t Shard(uint32_t hash) {
+    return uint64_t(hash) >> (32 - num_shard_bits_);
+  }
+
+  // Must be called without holding the lock of shards.
+  void HandleRefused(const std::vector<ClockHandle *> &refused) {
+    for (auto *e : refused) {
+      auto holder = MakeHolder(reinterpret_cast<Handle *>(e));
+      if (hooks_.on_refused) {
+        hooks_.on_refused(std::move(holder));
+      }
+    }
+  }
+
+public:
+  explicit ShardedClockCache(size_t capacity, uint32_t num_shard_bits)
+      : num_shard_bits_(num_shard_bits), num_shards_(1 << num_shard_bits_),
+        shard_(num_shards_), last_id_(0) {
+    SetCapacity(capacity);
+  }
+  ~ShardedClockCache() override = default;
+  Handle *DoInsert(const std::string_view &key, void *value, size_t charge,
+                   void (*deleter)(const std::string_view &key,
+                                   void *value)) override {
+    const uint32_t hash = HashSlice(key);
+    std::vector<ClockHandle *> refused;
+    auto *handle = shard_[Shard(hash)].Insert(key, hash, value, charge,
+                                              deleter, &refused);
+    HandleRefused(refused);
+    return reinterpret_cast<Handle *>(handle);
+  }
+  Handle *DoLookup(const std::string_view &key) override {
+    const uint32_t hash = HashSlice(key);
+    return reinterpret_cast<Handle *>(shard_[Shard(hash)].Lookup(key, hash));
+  }
+  void Fork(Handle *handle) override {
+    auto *h = reinterpret_cast<ClockHandle *>(handle);
+    shard_[Shard(h->hash)].Fork(h);
+  }
+  void Release(Handle *handle) override {
+    auto *h = reinterpret_cast<ClockHandle *>(handle);
+    shard_[Shard(h->hash)].Release(h);
+  }
+  void *Value(Handle *handle) override {
+    return reinterpret_cast<ClockHandle *>(handle)->value;
+  }
+  uint64_t NewId() override {
+    std::lock_guard<decltype(id_mutex_)> lock(id_mutex_);
+    return ++(last_id_);
+  }
+  void Prune() override {
+    std::vector<ClockHandle *> refused;
+    for (auto &s : shard_) {
+      s.Prune(&refused);
+    }
+    HandleRefused(refused);
+  }
+  void SetCapacity(size_t capacity) override {
+    const size_t per_shard = (capacity + (num_shards_ - 1)) / num_shards_;
+    std::vector<ClockHandle *> refused;
+    for (auto &s : shard_) {
+      s.SetCapacity(per_shard, &refused);
+    }
+    HandleRefused(refused);
+  }
+  void SetEvictionHooks(EvictionHooks hooks) override {
+    hooks_ = std::move(hooks);
+    for (auto &s : shard_) {
+      s.SetCanEvict(hooks_.can_evict ? &hooks_.can_evict : nullptr);
+    }
+  }
+  size_t TotalCharge() override {
+    size_t total = 0;
+    for (auto &s : shard_) {
+      total += s.TotalCharge();
+    }
+    return total;
+  }
+
+  void UpdateCharge(Handle *handle, size_t charge) override {
+    auto *h = reinterpret_cast<ClockHandle *>(handle);
+    std::vector<ClockHandle *> refused;
+    shard_[Shard(h->hash)].UpdateCharge(h, charge, &refused);
+    HandleRefused(refused);
+  }
+};
+
+template <typename Mutex = std::mutex>
+inline std::unique_ptr<Cache> NewClockCache(size_t capacity,
+                                            uint32_t num_shard_bits = 4) {
+  return std::make_unique<ShardedClockCache<Mutex>>(capacity, num_shard_bits);
+}
+
+} // namespace cache
+} // namespace arcanedb
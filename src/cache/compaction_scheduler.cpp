@@ -0,0 +1,78 @@
+/**
+ * @file compaction_scheduler.cpp
+ * @author sheep (ysj1173886760@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "cache/compaction_scheduler.h"
+#include "util/bthread_util.h"
+
+namespace arcanedb {
+namespace cache {
+
+void CompactionScheduler::Start() noexcept {
+  bool stop = true;
+  if (!stop_.compare_exchange_strong(stop, false)) {
+    return;
+  }
+
+  wg_.Add(worker_num_);
+  for (size_t i = 0; i < worker_num_; i++) {
+    util::LaunchAsync([this]() {
+      this->LoopWork_();
+      wg_.Done();
+    });
+  }
+}
+
+bool CompactionScheduler::Stop() noexcept {
+  bool stop = false;
+  if (!stop_.compare_exchange_strong(stop, true)) {
+    return false;
+  }
+
+  cv_.notify_all();
+  wg_.Wait();
+  return true;
+}
+
+void CompactionScheduler::TrySchedule(
+    const BufferPool::PageHolder &page_holder) noexcept {
+  if (!page_holder->TryMarkCompactionScheduled()) {
+    return;
+  }
+  std::lock_guard<decltype(mu_)> guard(mu_);
+  deque_.emplace_back(page_holder);
+  cv_.notify_one();
+}
+
+void CompactionScheduler::LoopWork_() noexcept {
+  while (!stop_.load(std::memory_order_relaxed)) {
+    BufferPool::PageHolder page_holder;
+    if (PopPage_(&page_holder)) {
+      page_holder->BackgroundCompaction();
+    }
+  }
+}
+
+bool CompactionScheduler::PopPage_(
+    BufferPool::PageHolder *page_holder) noexcept {
+  std::unique_lock<decltype(mu_)> lock(mu_);
+  while (deque_.empty() && !stop_) {
+    cv_.wait(lock);
+  }
+  if (stop_) {
+    return false;
+  }
+  *page_holder = std::move(deque_.front());
+  deque_.pop_front();
+  return true;
+}
+
+} // namespace cache
+} // namespace arcanedb
@@ -0,0 +1,61 @@
+/**
+ * @file compaction_scheduler.h
+ * @author sheep (ysj1173886760@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#pragma once
+
+#include "bthread/condition_variable.h"
+#include "bthread/mutex.h"
+#include "cache/buffer_pool.h"
+#include "util/wait_group.h"
+#include <deque>
+
+namespace arcanedb {
+namespace cache {
+
+/**
+ * @brief
+ * Perform delta chain compaction with a bounded number of bthreads,
+ * so that writers won't pay for the compaction.
+ */
+class CompactionScheduler {
+public:
+  explicit CompactionScheduler(size_t worker_num) noexcept
+      : worker_num_(worker_num) {}
+
+  void Start() noexcept;
+
+  bool Stop() noexcept;
+
+  /**
+   * @brief
+   * Schedule page for background compaction.
+   * Page that has already been scheduled will be ignored.
+   * @param page_holder
+   */
+  void TrySchedule(const BufferPool::PageHolder &page_holder) noexcept;
+
+private:
+  void LoopWork_() noexcept;
+
+  bool PopPage_(BufferPool::PageHolder *page_holder) noexcept;
+
+  const size_t worker_num_;
+
+  std::deque<BufferPool::PageHolder> deque_;
+  bthread::ConditionVariable cv_;
+  bthread::Mutex mu_;
+
+  util::WaitGroup wg_;
+  std::atomic_bool stop_{true};
+};
+
+} // namespace cache
+} // namespace arcanedb
@@ -11,6 +11,7 @@
 
 #include "cache/flusher.h"
 #include "util/bthread_util.h"
+#include <algorithm>
 
 namespace arcanedb {
 namespace cache {
@@ -71,17 +72,32 @@ void FlusherShard::LoopWork_() noexcept {
 }
 
 void FlusherShard::FlushPage(BufferPool::PageHolder *page_holder) noexcept {
+  if ((*page_holder)->IsRetired()) {
+    // page has been unlinked by SMO.
+    return;
+  }
+  auto version = (*page_holder)->BeginFlush();
   auto snapshot = (*page_holder)->GetPageSnapshot();
   auto lsn = snapshot->GetLSN();
   auto binary = snapshot->Serialize();
   // TODO(yangshijiao): wait for log to be persisted according to WAL protocol.
   page_store::WriteOptions opts;
-  auto s = page_store_->UpdateReplacement((*page_holder)->GetPageKeyRef(), opts,
-                                          binary);
-  bool need_flush = (*page_holder)->FinishFlush(s, lsn);
-  if (need_flush) {
+  auto s = snapshot->IsDelta()
+               ? page_store_->UpdateDelta((*page_holder)->GetPageKeyRef(),
+                                          opts, binary)
+               : page_store_->UpdateReplacement(
+                     (*page_holder)->GetPageKeyRef(), opts, binary);
+  bool need_flush = (*page_holder)->FinishFlush(s, lsn, version);
+  if ((*page_holder)->IsDeleted()) {
+    // page is retired and deleted while we are flushing it, delete it again
+    // so that it won't be resurrected.
+    s = page_store_->DeletePage((*page_holder)->GetPageKeyRef(), opts);
+    return;
+  }
+  if (need_flush && !(*page_holder)->IsRetired()) {
     InsertDirtyPage(std::move(*page_holder));
   }
+  flusher_->TryDeleteRetiredPages();
 }
 
 bool FlusherShard::PopDirtyPage(BufferPool::PageHolder *page_holder) noexcept {
@@ -108,6 +124,64 @@ void Flusher::ForceFlushAllPages() noexcept {
   for (int i = 0; i < shards_.size(); i++) {
     shards_[i]->ForceFlushAllPages();
   }
+  TryDeleteRetiredPages();
+}
+
+void Flusher::RetirePage(
+    BufferPool::PageHolder page_holder,
+    std::shared_ptr<const BufferPool::SmoSuccessors> successors,
+    log_store::LogStore *log_store, log_store::LsnType lsn) noexcept {
+  {
+    std::lock_guard<decltype(retired_mu_)> guard(retired_mu_);
+    retired_pages_.push_back(RetiredPage{.page_holder = std::move(page_holder),
+                                         .successors = std::move(successors),
+                                         .log_store = log_store,
+                                         .lsn = lsn});
+    retired_num_.store(retired_pages_.size(), std::memory_order_relaxed);
+  }
+  // successors might have been flushed already.
+  TryDeleteRetiredPages();
+}
+
+void Flusher::TryDeleteRetiredPages() noexcept {
+  if (retired_num_.load(std::memory_order_relaxed) == 0) {
+    return;
+  }
+  std::lock_guard<decltype(retired_mu_)> guard(retired_mu_);
+  // successors might be retired pages which are deleted in this round.
+  bool progress = true;
+  while (progress) {
+    progress = false;
+    for (auto it = retired_pages_.begin(); it != retired_pages_.end();) {
+      // flushed successors are only durable once SMO is persisted.
+      if (it->log_store != nullptr &&
+          it->log_store->GetPersistentLsn() < it->lsn) {
+        ++it;
+        continue;
+      }
+      bool flushed = std::all_of(
+          it->successors->begin(), it->successors->end(),
+          [](const auto &successor) {
+            return successor.first->IsFlushed(successor.second);
+          });
+      if (!flushed) {
+        ++it;
+        continue;
+      }
+      // mark deleted first, so that concurrent flush of the page will delete
+      // it again.
+      it->page_holder->MarkDeleted();
+      page_store::WriteOptions opts;
+      auto s = page_store_->DeletePage(it->page_holder->GetPageKeyRef(), opts);
+      if (!s.ok()) {
+        ARCANEDB_WARN("Failed to delete page {}, status {}",
+                      it->page_holder->GetPageKey(), s.ToString());
+      }
+      it = retired_pages_.erase(it);
+      progress = true;
+    }
+  }
+  retired_num_.store(retired_pages_.size(), std::memory_order_relaxed);
 }
 
 void FlusherShard::ForceFlushAllPages() noexcept {
@@ -20,10 +20,13 @@
 namespace arcanedb {
 namespace cache {
 
+class Flusher;
+
 class FlusherShard {
 public:
-  FlusherShard(std::shared_ptr<page_store::PageStore> page_store) noexcept
-      : page_store_(std::move(page_store)) {}
+  FlusherShard(Flusher *flusher,
+               std::shared_ptr<page_store::PageStore> page_store) noexcept
+      : flusher_(flusher), page_store_(std::move(page_store)) {}
 
   void Start() noexcept;
 
@@ -47,16 +50,18 @@ private:
   util::WaitGroup wg_;
   std::atomic_bool stop_{true};
 
+  Flusher *flusher_;
   std::shared_ptr<page_store::PageStore> page_store_;
 };
 
 class Flusher {
 public:
   Flusher(size_t shard_num,
-          std::shared_ptr<page_store::PageStore> page_store) noexcept {
+          std::shared_ptr<page_store::PageStore> page_store) noexcept
+      : page_store_(page_store) {
     shards_.reserve(shard_num);
     for (int i = 0; i < shard_num; i++) {
-      shards_.emplace_back(std::make_unique<FlusherShard>(page_store));
+      shards_.emplace_back(std::make_unique<FlusherShard>(this, page_store));
     }
   }
 
@@ -68,8 +73,44 @@ public:
 
   void ForceFlushAllPages() noexcept;
 
+  /**
+   * @brief
+   * Delete retired page from page store once its successors are flushed and
+   * SMO is persisted. SMO doesn't wait for persisting, it's checked here
+   * instead.
+   * @param page_holder
+   * @param successors
+   * @param log_store nullptr if SMO is not logged.
+   * @param lsn lsn of SMO.
+   */
+  void RetirePage(BufferPool::PageHolder page_holder,
+                  std::shared_ptr<const BufferPool::SmoSuccessors> successors,
+                  log_store::LogStore *log_store,
+                  log_store::LsnType lsn) noexcept;
+
+  /**
+   * @brief
+   * Delete retired pages whose successors have been flushed, called after
+   * pages are flushed.
+   */
+  void TryDeleteRetiredPages() noexcept;
+
 private:
+  struct RetiredPage {
+    BufferPool::PageHolder page_holder;
+    std::shared_ptr<const BufferPool::SmoSuccessors> successors;
+    log_store::LogStore *log_store;
+    log_store::LsnType lsn;
+  };
+
   std::vector<std::unique_ptr<FlusherShard>> shards_;
+  std::shared_ptr<page_store::PageStore> page_store_;
+
+  bthread::Mutex retired_mu_;
+  // guarded by retired_mu_.
+  std::vector<RetiredPage> retired_pages_;
+  // size of retired_pages_, so that flushers could skip the mutex.
+  std::atomic<size_t> retired_num_{0};
 };
 
 } // namespace cache
@@ -0,0 +1,146 @@
+/**
+ * @file hot_page_table.cpp
+ * @author sheep (ysj1173886760@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "cache/hot_page_table.h"
+#include "bthread/bthread.h"
+#include "common/macros.h"
+#include <utility>
+#include <vector>
+
+namespace arcanedb {
+namespace cache {
+
+HotPageTable::HotPageTable(size_t capacity, ChargeFunc charge_func) noexcept
+    : charge_func_(charge_func),
+      workers_(std::make_unique<Worker[]>(common::Config::kHotPageWorkerNum)),
+      worker_capacity_(capacity / common::Config::kHotPageWorkerNum) {}
+
+size_t HotPageTable::GetWorkerIndex_() noexcept {
+  static std::atomic<size_t> next_index{0};
+  static thread_local size_t index =
+      next_index.fetch_add(1, std::memory_order_relaxed) %
+      common::Config::kHotPageWorkerNum;
+  return index;
+}
+
+HotPageTable::Pin HotPageTable::Lookup(PageIdHash hash) noexcept {
+  auto *worker = &workers_[GetWorkerIndex_()];
+  if (unlikely(!worker->TryLock())) {
+    return {};
+  }
+  Pin pin;
+  // unpinned outside the lock.
+  Pin evicted;
+  std::unique_ptr<Attachment> detached;
+  auto &slot = GetSlot_(worker, hash);
+  if (slot.pin && slot.hash == hash) {
+    pin = slot.pin;
+    auto charge = charge_func_(*pin);
+    worker->charge = worker->charge - slot.charge + charge;
+    slot.charge = charge;
+    if (worker->charge > worker_capacity_.load(std::memory_order_relaxed)) {
+      worker->charge -= slot.charge;
+      slot.charge = 0;
+      evicted = std::move(slot.pin);
+      detached = std::move(slot.attachment);
+    }
+  }
+  worker->Unlock();
+  return pin;
+}
+
+void HotPageTable::Insert(PageIdHash hash, Cache::HandleHolder handle_holder,
+                          size_t charge) noexcept {
+  auto capacity = worker_capacity_.load(std::memory_order_relaxed);
+  if (charge > capacity) {
+    return;
+  }
+  auto *worker = &workers_[GetWorkerIndex_()];
+  // unpinned outside the lock since it might free the page.
+  Pin replaced =
+      std::make_shared<Cache::HandleHolder>(std::move(handle_holder));
+  std::unique_ptr<Attachment> detached;
+  if (unlikely(!worker->TryLock())) {
+    return;
+  }
+  auto &slot = GetSlot_(worker, hash);
+  auto total_charge = worker->charge - slot.charge + charge;
+  if (total_charge <= capacity) {
+    worker->charge = total_charge;
+    slot.hash = hash;
+    slot.charge = charge;
+    std::swap(slot.pin, replaced);
+    detached = std::move(slot.attachment);
+  }
+  worker->Unlock();
+}
+
+std::unique_ptr<HotPageTable::Attachment>
+HotPageTable::TakeAttachment(PageIdHash hash) noexcept {
+  auto *worker = &workers_[GetWorkerIndex_()];
+  if (unlikely(!worker->TryLock())) {
+    return nullptr;
+  }
+  std::unique_ptr<Attachment> attachment;
+  auto &slot = GetSlot_(worker, hash);
+  if (slot.pin && slot.hash == hash) {
+    attachment = std::move(slot.attachment);
+  }
+  worker->Unlock();
+  return attachment;
+}
+
+void HotPageTable::PutAttachment(
+    PageIdHash hash, const void *page,
+    std::unique_ptr<Attachment> attachment) noexcept {
+  auto *worker = &workers_[GetWorkerIndex_()];
+  // attachment is released outside the lock since it might hold pages.
+  if (unlikely(!worker->TryLock())) {
+    return;
+  }
+  auto &slot = GetSlot_(worker, hash);
+  if (slot.pin && slot.hash == hash && slot.pin->TValue<void>() == page &&
+      slot.attachment == nullptr) {
+    slot.attachment = std::move(attachment);
+  }
+  worker->Unlock();
+}
+
+void HotPageTable::SetCapacity(size_t capacity) noexcept {
+  worker_capacity_.store(capacity / common::Config::kHotPageWorkerNum,
+                         std::memory_order_relaxed);
+  Clear();
+}
+
+void HotPageTable::Clear() noexcept {
+  for (size_t i = 0; i < common::Config::kHotPageWorkerNum; i++) {
+    auto *worker = &workers_[i];
+    while (!worker->TryLock()) {
+      bthread_yield();
+    }
+    std::vector<Pin> unpinned;
+    std::vector<std::unique_ptr<Attachment>> detached;
+    for (auto &slot : worker->slots) {
+      if (slot.pin) {
+        unpinned.push_back(std::move(slot.pin));
+      }
+      if (slot.attachment) {
+        detached.push_back(std::move(slot.attachment));
+      }
+      slot.charge = 0;
+    }
+    worker->charge = 0;
+    worker->Unlock();
+  }
+}
+
+} // namespace cache
+} // namespace arcanedb
@@ -0,0 +1,153 @@
+/**
+ * @file hot_page_table.h
+ * @author sheep (ysj1173886760@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#pragma once
+
+#include "butil/macros.h"
+#include "cache/cache.h"
+#include "common/config.h"
+#include "common/defines.h"
+#include "common/type.h"
+#include <atomic>
+#include <memory>
+
+namespace arcanedb {
+namespace cache {
+
+/**
+ * @brief
+ * Per-worker direct mapped table of pinned pages, so that repeated access
+ * to hot pages is served by the slot of current worker instead of probing
+ * the shared cache.
+ * Each slot keeps a pin, i.e. a cache handle shared by the holders handed
+ * out from this slot, so a hit only bumps the reference count of the pin
+ * instead of going through the cache. pinned pages couldn't be evicted
+ * until they are replaced or the table is cleared, so each worker pins at
+ * most its share of capacity. pages keep growing while they are pinned, so
+ * the charge of slot is refreshed on every hit, and the slot is unpinned
+ * once its worker outgrows the capacity.
+ * Slots are indexed by the hash of page id, and callers should verify the
+ * page id on hit since hashes might collide.
+ * Slot could also cache an attachment built on the pinned page, e.g. the
+ * subtable opened on it, which is released once the page is unpinned.
+ * attachment is checked out by a single caller at a time.
+ * Workers are protected by a try-lock which is only contended when pthreads
+ * share the same worker, lookup and insert just give up in that case.
+ */
+class HotPageTable {
+public:
+  using Pin = std::shared_ptr<Cache::HandleHolder>;
+
+  // object cached along with the pinned page.
+  class Attachment {
+  public:
+    virtual ~Attachment() = default;
+  };
+
+  // current charge of pinned page.
+  using ChargeFunc = size_t (*)(const Cache::HandleHolder &handle_holder);
+
+  HotPageTable(size_t capacity, ChargeFunc charge_func) noexcept;
+
+  ~HotPageTable() noexcept { Clear(); }
+
+  /**
+   * @brief
+   * Find page by hash in the slot of current worker.
+   * page is unpinned from the slot if the worker exceeds its capacity after
+   * refreshing the charge, the returned pin is still valid in that case.
+   * @param hash
+   * @return Pin empty if page is not found.
+   */
+  Pin Lookup(PageIdHash hash) noexcept;
+
+  /**
+   * @brief
+   * Pin page in the slot of current worker, page previously in the slot is
+   * unpinned. page is not pinned if the worker would exceed its capacity.
+   * @param hash
+   * @param handle_holder
+   * @param charge
+   */
+  void Insert(PageIdHash hash, Cache::HandleHolder handle_holder,
+              size_t charge) noexcept;
+
+  /**
+   * @brief
+   * Take the attachment out of the slot of current worker, so that it's
+   * owned by the caller until it's put back. callers should verify the
+   * attachment since hashes might collide.
+   * @param hash
+   * @return std::unique_ptr<Attachment> nullptr if there is no attachment.
+   */
+  std::unique_ptr<Attachment> TakeAttachment(PageIdHash hash) noexcept;
+
+  /**
+   * @brief
+   * Cache attachment in the slot of current worker, attachment is released
+   * if page is no longer pinned in the slot, or the slot already has one.
+   * @param hash
+   * @param page value of the pinned page which attachment is built on.
+   * @param attachment
+   */
+  void PutAttachment(PageIdHash hash, const void *page,
+                     std::unique_ptr<Attachment> attachment) noexcept;
+
+  /**
+   * @brief
+   * Change the total charge of pinned pages, pages pinned before are
+   * unpinned.
+   * @param capacity
+   */
+  void SetCapacity(size_t capacity) noexcept;
+
+  /**
+   * @brief
+   * Unpin all pages.
+   */
+  void Clear() noexcept;
+
+private:
+  struct Slot {
+    PageIdHash hash{};
+    size_t charge{};
+    Pin pin{};
+    std::unique_ptr<Attachment> attachment{};
+  };
+
+  struct alignas(ARCANEDB_CACHE_LINE_SIZE) Worker {
+    std::atomic<bool> busy{false};
+    // total charge of pinned pages.
+    size_t charge{};
+    Slot slots[common::Config::kHotPageSlotNum];
+
+    bool TryLock() noexcept {
+      return !busy.load(std::memory_order_relaxed) &&
+             !busy.exchange(true, std::memory_order_acquire);
+    }
+
+    void Unlock() noexcept { busy.store(false, std::memory_order_release); }
+  };
+
+  static size_t GetWorkerIndex_() noexcept;
+
+  static Slot &GetSlot_(Worker *worker, PageIdHash hash) noexcept {
+    return worker->slots[hash % common::Config::kHotPageSlotNum];
+  }
+
+  const ChargeFunc charge_func_;
+  std::unique_ptr<Worker[]> workers_;
+  // capacity of each worker.
+  std::atomic<size_t> worker_capacity_;
+};
+
+} // namespace cache
+} // namespace arcanedb
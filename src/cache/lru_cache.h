@@ -6,6 +6,7 @@
 #include <cassert>
 #include <cstdint>
 #include <cstring>
+#include <functional>
 #include <memory>
 #include <mutex>
 #include <vector>
@@ -31,6 +32,10 @@ namespace cache {
 //   removed the check, elements that would otherwise be on this list could be
 //   left as disconnected singleton lists.)
 // - LRU:  contains the items not currently referenced by clients, in LRU order
+// - refused:  contains the items refused by "can_evict" which are not
+//   currently referenced by clients. they are never visited by eviction, and
+//   go back to the oldest end of LRU list once they are released while
+//   "can_evict" agrees, e.g. after they are flushed.
 // Elements are moved between these lists by the Ref() and Unref() methods,
 // when they detect an element in the cache acquiring or losing its only
 // external reference.
@@ -46,6 +51,7 @@ struct LRUHandle {
   size_t charge; // TODO(opt): Only allow uint32_t?
   size_t key_length;
   bool in_cache;    // Whether entry is in the cache.
+  bool refused;     // Whether entry is refused by "can_evict".
   uint32_t refs;    // References, including cache reference, if present.
   uint32_t hash;    // Hash of key(); used for fast sharding and comparisons
   char key_data[1]; // Beginning of key
@@ -64,18 +70,19 @@ struct LRUHandle {
 // table implementations in some of the compiler/runtime combinations
 // we have tested.  E.g., readrandom speeds up by ~5% over the g++
 // 4.4.3's builtin hashtable.
-class HandleTable {
+// HandleType should provide "next_hash", "hash" and "key()" like LRUHandle.
+template <typename HandleType = LRUHandle> class HandleTable {
 public:
   HandleTable() { Resize(); }
   ~HandleTable() { delete[] list_; }
 
-  LRUHandle *Lookup(const std::string_view &key, uint32_t hash) {
+  HandleType *Lookup(const std::string_view &key, uint32_t hash) {
     return *FindPointer(key, hash);
   }
 
-  LRUHandle *Insert(LRUHandle *h) {
-    LRUHandle **ptr = FindPointer(h->key(), h->hash);
-    LRUHandle *old = *ptr;
+  HandleType *Insert(HandleType *h) {
+    HandleType **ptr = FindPointer(h->key(), h->hash);
+    HandleType *old = *ptr;
     h->next_hash = (old == nullptr ? nullptr : old->next_hash);
     *ptr = h;
     if (old == nullptr) {
@@ -89,9 +96,9 @@ public:
     return old;
   }
 
-  LRUHandle *Remove(const std::string_view &key, uint32_t hash) {
-    LRUHandle **ptr = FindPointer(key, hash);
-    LRUHandle *result = *ptr;
+  HandleType *Remove(const std::string_view &key, uint32_t hash) {
+    HandleType **ptr = FindPointer(key, hash);
+    HandleType *result = *ptr;
     if (result != nullptr) {
       *ptr = result->next_hash;
       --elems_;
@@ -104,13 +111,13 @@ private:
   // a linked list of cache entries that hash into the bucket.
   uint32_t length_{0};
   uint32_t elems_{0};
-  LRUHandle **list_{nullptr};
+  HandleType **list_{nullptr};
 
   // Return a pointer to slot that points to a cache entry that
   // matches key/hash.  If there is no such cache entry, return a
   // pointer to the trailing slot in the corresponding linked list.
-  LRUHandle **FindPointer(const std::string_view &key, uint32_t hash) {
-    LRUHandle **ptr = &list_[hash & (length_ - 1)];
+  HandleType **FindPointer(const std::string_view &key, uint32_t hash) {
+    HandleType **ptr = &list_[hash & (length_ - 1)];
     while (*ptr != nullptr && ((*ptr)->hash != hash || key != (*ptr)->key())) {
       ptr = &(*ptr)->next_hash;
     }
@@ -122,13 +129,13 @@ private:
     while (new_length < elems_) {
       new_length *= 2;
     }
-    auto *new_list = new LRUHandle *[new_length];
+    auto *new_list = new HandleType *[new_length];
     memset(new_list, 0, sizeof(new_list[0]) * new_length);
     uint32_t count = 0;
     for (uint32_t i = 0; i < length_; i++) {
-      LRUHandle *h = list_[i];
+      HandleType *h = list_[i];
       while (h != nullptr) {
-        LRUHandle *next = h->next_hash;
+        HandleType *next = h->next_hash;
         uint32_t hash = h->hash;
         auto *ptr = &new_list[hash & (new_length - 1)];
         h->next_hash = *ptr;
@@ -151,26 +158,39 @@ public:
   ~LRUCache();
 
   // Separate from constructor so caller can easily make an array of LRUCache
-  void SetCapacity(size_t capacity) { capacity_ = capacity; }
+  void SetCapacity(size_t capacity, std::vector<LRUHandle *> *refused);
+
+  // Entries that are not in use are evicted only if "can_evict" agrees.
+  // REQUIRES: called before the cache is used.
+  void SetCanEvict(const std::function<bool(void *value)> *can_evict) {
+    can_evict_ = can_evict;
+  }
 
   // Like Cache methods, but with an extra "hash" parameter.
+  // entries refused by "can_evict_" during eviction are appended to
+  // "refused" with a reference, caller should release them.
   LRUHandle *Insert(const std::string_view &key, uint32_t hash, void *value,
                     size_t charge,
-                    void (*deleter)(const std::string_view &key, void *value));
+                    void (*deleter)(const std::string_view &key, void *value),
+                    std::vector<LRUHandle *> *refused);
   LRUHandle *Lookup(const std::string_view &key, uint32_t hash);
   void Ref(LRUHandle *e);
   void Fork(LRUHandle *handle);
   void Release(LRUHandle *handle);
-  void Prune();
+  void Prune(std::vector<LRUHandle *> *refused);
 
   size_t TotalCharge() {
     std::lock_guard<decltype(mutex_)> lock(mutex_);
     return usage_;
   }
-  void UpdateCharge(LRUHandle *handle, size_t new_charge) {
+  void UpdateCharge(LRUHandle *handle, size_t new_charge,
+                    std::vector<LRUHandle *> *refused) {
     std::lock_guard<decltype(mutex_)> lock(mutex_);
     usage_ = usage_ - handle->charge + new_charge;
     handle->charge = new_charge;
+    if (usage_ > capacity_) {
+      DoPrune([&]() { return usage_ <= capacity_; }, refused);
+    }
   }
 
 private:
@@ -178,9 +198,15 @@ private:
   void LRU_Append(LRUHandle *list, LRUHandle *e);
   void Unref(LRUHandle *e);
   bool FinishErase(LRUHandle *e);
-  template <class StopFunc> void DoPrune(StopFunc &&stop_func);
+  template <class StopFunc>
+  void DoPrune(StopFunc &&stop_func, std::vector<LRUHandle *> *refused);
+  // Move parked entries back to lru_ so that they are reconsidered.
+  void UnparkRefused();
 
   // Initialized before use.
+  const std::function<bool(void *value)> *can_evict_{nullptr};
+
+  // mutex_ protects capacity_ after initialization.
   size_t capacity_{0};
 
   // mutex_ protects the following state.
@@ -196,7 +222,11 @@ private:
   // Entries are in use by clients, and have refs >= 2 and in_cache==true.
   LRUHandle in_use_{};
 
-  HandleTable table_{};
+  // Dummy head of refused list.
+  // Entries have refs==1, in_cache==true and refused==true.
+  LRUHandle refused_{};
+
+  HandleTable<> table_{};
 };
 
 template <typename Mutex> inline LRUCache<Mutex>::LRUCache() {
@@ -205,22 +235,27 @@ template <typename Mutex> inline LRUCache<Mutex>::LRUCache() {
   lru_.prev = &lru_;
   in_use_.next = &in_use_;
   in_use_.prev = &in_use_;
+  refused_.next = &refused_;
+  refused_.prev = &refused_;
 }
 
 template <typename Mutex> inline LRUCache<Mutex>::~LRUCache() {
   assert(in_use_.next == &in_use_); // Error if caller has an unreleased handle
-  for (LRUHandle *e = lru_.next; e != &lru_;) {
-    LRUHandle *next = e->next;
-    assert(e->in_cache);
-    e->in_cache = false;
-    assert(e->refs == 1); // Invariant of lru_ list.
-    Unref(e);
-    e = next;
+  for (auto *list : {&lru_, &refused_}) {
+    for (LRUHandle *e = list->next; e != list;) {
+      LRUHandle *next = e->next;
+      assert(e->in_cache);
+      e->in_cache = false;
+      assert(e->refs == 1); // Invariant of lru_ and refused_ list.
+      Unref(e);
+      e = next;
+    }
   }
 }
 
 template <typename Mutex> inline void LRUCache<Mutex>::Ref(LRUHandle *e) {
-  if (e->refs == 1 && e->in_cache) { // If on lru_ list, move to in_use_ list.
+  // If on lru_ or refused_ list, move to in_use_ list.
+  if (e->refs == 1 && e->in_cache) {
     LRU_Remove(e);
     LRU_Append(&in_use_, e);
   }
@@ -235,9 +270,18 @@ template <typename Mutex> inline void LRUCache<Mutex>::Unref(LRUHandle *e) {
     (*e->deleter)(e->key(), e->value);
     free(e);
   } else if (e->in_cache && e->refs == 1) {
-    // No longer in use; move to lru_ list.
     LRU_Remove(e);
-    LRU_Append(&lru_, e);
+    if (!e->refused) {
+      // No longer in use; move to lru_ list.
+      LRU_Append(&lru_, e);
+    } else if (can_evict_ == nullptr || (*can_evict_)(e->value)) {
+      // Refused entry becomes evictable, it's still the oldest one.
+      e->refused = false;
+      LRU_Append(lru_.next, e);
+    } else {
+      // Park it until it's released again, e.g. by the flusher.
+      LRU_Append(&refused_, e);
+    }
   }
 }
 
@@ -281,7 +325,8 @@ template <typename Mutex> inline void LRUCache<Mutex>::Fork(LRUHandle *handle) {
 template <typename Mutex>
 inline LRUHandle *LRUCache<Mutex>::Insert(
     const std::string_view &key, uint32_t hash, void *value, size_t charge,
-    void (*deleter)(const std::string_view &key, void *value)) {
+    void (*deleter)(const std::string_view &key, void *value),
+    std::vector<LRUHandle *> *refused) {
   std::lock_guard<decltype(mutex_)> lock(mutex_);
 
   auto *e =
@@ -292,6 +337,7 @@ inline LRUHandle *LRUCache<Mutex>::Insert(
   e->key_length = key.size();
   e->hash = hash;
   e->in_cache = false;
+  e->refused = false;
   e->refs = 1; // for the returned handle.
   std::memcpy(e->key_data, key.data(), key.size());
 
@@ -307,12 +353,23 @@ inline LRUHandle *LRUCache<Mutex>::Insert(
   }
 
   if (usage_ > capacity_) {
-    DoPrune([&]() { return usage_ <= capacity_; });
+    DoPrune([&]() { return usage_ <= capacity_; }, refused);
   }
 
   return e;
 }
 
+template <typename Mutex>
+inline void LRUCache<Mutex>::SetCapacity(size_t capacity,
+                                         std::vector<LRUHandle *> *refused) {
+  std::lock_guard<decltype(mutex_)> lock(mutex_);
+  capacity_ = capacity;
+  if (usage_ > capacity_) {
+    UnparkRefused();
+    DoPrune([&]() { return usage_ <= capacity_; }, refused);
+  }
+}
+
 // If e != nullptr, finish removing *e from the cache; it has already been
 // removed from the hash table.  Return whether e != nullptr.
 template <typename Mutex>
@@ -327,17 +384,38 @@ inline bool LRUCache<Mutex>::FinishErase(LRUHandle *e) {
   return e != nullptr;
 }
 
-template <typename Mutex> inline void LRUCache<Mutex>::Prune() {
+template <typename Mutex>
+inline void LRUCache<Mutex>::Prune(std::vector<LRUHandle *> *refused) {
   std::lock_guard<decltype(mutex_)> lock(mutex_);
-  return DoPrune([]() { return false; });
+  // Explicit prune reconsiders parked entries as well.
+  UnparkRefused();
+  return DoPrune([]() { return false; }, refused);
+}
+
+template <typename Mutex> inline void LRUCache<Mutex>::UnparkRefused() {
+  while (refused_.next != &refused_) {
+    LRUHandle *e = refused_.next;
+    e->refused = false;
+    LRU_Remove(e);
+    LRU_Append(&lru_, e);
+  }
 }
 
 template <typename Mutex>
 template <class StopFunc>
-inline void LRUCache<Mutex>::DoPrune(StopFunc &&stop_func) {
+inline void LRUCache<Mutex>::DoPrune(StopFunc &&stop_func,
+                                     std::vector<LRUHandle *> *refused) {
   while (lru_.next != &lru_) {
     LRUHandle *e = lru_.next;
     assert(e->refs == 1);
+    if (can_evict_ != nullptr && !(*can_evict_)(e->value)) {
+      // moved to in-use list, and parked in refused list once it's
+      // released, so that it won't be visited again until it's evictable.
+      e->refused = true;
+      Ref(e);
+      refused->push_back(e);
+      continue;
+    }
     bool erased = FinishErase(table_.Remove(e->key(), e->hash));
     if (!erased) { // to avoid unused variable when compiled NDEBUG
       assert(erased);
@@ -356,6 +434,7 @@ private:
   std::vector<LRUCache<Mutex>> shard_;
   Mutex id_mutex_;
   uint64_t last_id_;
+  EvictionHooks hooks_;
 
   static inline uint32_t HashSlice(const std::string_view &s) {
     return absl::Hash<std::string_view>()(s);
@@ -366,22 +445,32 @@ private:
     return uint64_t(hash) >> (32 - num_shard_bits_);
   }
 
+  // Must be called without holding the lock of shards.
+  void HandleRefused(const std::vector<LRUHandle *> &refused) {
+    for (auto *e : refused) {
+      auto holder = MakeHolder(reinterpret_cast<Handle *>(e));
+      if (hooks_.on_refused) {
+        hooks_.on_refused(std::move(holder));
+      }
+    }
+  }
+
 public:
   explicit ShardedLRUCache(size_t capacity, uint32_t num_shard_bits)
       : num_shard_bits_(num_shard_bits), num_shards_(1 << num_shard_bits_),
         shard_(num_shards_), last_id_(0) {
-    const size_t per_shard = (capacity + (num_shards_ - 1)) / num_shards_;
-    for (auto &s : shard_) {
-      s.SetCapacity(per_shard);
-    }
+    SetCapacity(capacity);
   }
   ~ShardedLRUCache() override = default;
   Handle *DoInsert(const std::string_view &key, void *value, size_t charge,
                    void (*deleter)(const std::string_view &key,
                                    void *value)) override {
     const uint32_t hash = HashSlice(key);
-    return reinterpret_cast<Handle *>(
-        shard_[Shard(hash)].Insert(key, hash, value, charge, deleter));
+    std::vector<LRUHandle *> refused;
+    auto *handle = shard_[Shard(hash)].Insert(key, hash, value, charge,
+                                              deleter, &refused);
+    HandleRefused(refused);
+    return reinterpret_cast<Handle *>(handle);
   }
   Handle *DoLookup(const std::string_view &key) override {
     const uint32_t hash = HashSlice(key);
@@ -403,8 +492,24 @@ public:
     return ++(last_id_);
   }
   void Prune() override {
+    std::vector<LRUHandle *> refused;
+    for (auto &s : shard_) {
+      s.Prune(&refused);
+    }
+    HandleRefused(refused);
+  }
+  void SetCapacity(size_t capacity) override {
+    const size_t per_shard = (capacity + (num_shards_ - 1)) / num_shards_;
+    std::vector<LRUHandle *> refused;
+    for (auto &s : shard_) {
+      s.SetCapacity(per_shard, &refused);
+    }
+    HandleRefused(refused);
+  }
+  void SetEvictionHooks(EvictionHooks hooks) override {
+    hooks_ = std::move(hooks);
     for (auto &s : shard_) {
-      s.Prune();
+      s.SetCanEvict(hooks_.can_evict ? &hooks_.can_evict : nullptr);
     }
   }
   size_t TotalCharge() override {
@@ -417,8 +522,9 @@ public:
 
   void UpdateCharge(Handle *handle, size_t charge) override {
     auto *h = reinterpret_cast<LRUHandle *>(handle);
-    shard_[Shard(h->hash)].UpdateCharge(reinterpret_cast<LRUHandle *>(handle),
-                                        charge);
+    std::vector<LRUHandle *> refused;
+    shard_[Shard(h->hash)].UpdateCharge(h, charge, &refused);
+    HandleRefused(refused);
   }
 };
 
@@ -0,0 +1,549 @@
+/**
+ * @file s3fifo_cache.h
+ * @author sheep (ysj1173886760@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/hash/hash.h"
+#include "cache/cache.h"
+#include "cache/lru_cache.h"
+
+namespace arcanedb {
+namespace cache {
+
+// S3-FIFO cache implementation
+//
+// Entries are kept in two FIFO queues:
+// - small: newly inserted entries, which takes about 10% of the capacity.
+// - main: entries that have been accessed again while they are in small
+//   queue, or that are re-inserted shortly after being evicted.
+// A ghost queue remembers the hashes of entries evicted from small queue, so
+// that entries evicted too early are inserted into main queue directly.
+// Each entry has a small saturating access counter. entries in main queue
+// with a non-zero counter are reinserted instead of being evicted, which is
+// CLOCK with more than one bit.
+// One-hit wonders, e.g. entries touched by a single full scan, are evicted
+// from small queue quickly without polluting main queue, which makes the
+// cache scan-resistant.
+//
+// Unlike LRUCache, entries stay in their queue while they are in use, and
+// they are skipped by eviction until they are released.
+// Entries refused by "can_evict" are parked in a separate list which is never
+// visited by eviction, they go back to the oldest end of their queue once
+// they are released while "can_evict" agrees, e.g. after they are flushed.
+struct S3FifoHandle {
+  void *value;
+  void (*deleter)(const std::string_view &, void *value);
+  S3FifoHandle *next_hash;
+  S3FifoHandle *next;
+  S3FifoHandle *prev;
+  size_t charge;
+  size_t key_length;
+  bool in_cache;    // Whether entry is in the cache.
+  bool in_main;     // Whether entry is in main queue.
+  bool refused;     // Whether entry is parked in refused list.
+  uint8_t freq;     // Saturating access counter.
+  uint32_t refs;    // References, including cache reference, if present.
+  uint32_t hash;    // Hash of key(); used for fast sharding and comparisons
+  char key_data[1]; // Beginning of key
+
+  std::string_view key() const {
+    // next is only equal to this if the handle is the list head of an
+    // empty list. List heads never have meaningful keys.
+    assert(next != this);
+
+    return {key_data, key_length};
+  }
+};
+
+// A single shard of sharded cache.
+template <typename Mutex> class S3FifoCache {
+public:
+  S3FifoCache();
+  ~S3FifoCache();
+
+  void SetCapacity(size_t capacity, std::vector<S3FifoHandle *> *refused);
+
+  // Entries that are not in use are evicted only if "can_evict" agrees.
+  // REQUIRES: called before the cache is used.
+  void SetCanEvict(const std::function<bool(void *value)> *can_evict) {
+    can_evict_ = can_evict;
+  }
+
+  // Like Cache methods, but with an extra "hash" parameter.
+  // entries refused by "can_evict_" during eviction are appended to
+  // "refused" with a reference, caller should release them.
+  S3FifoHandle *
+  Insert(const std::string_view &key, uint32_t hash, void *value,
+         size_t charge,
+         void (*deleter)(const std::string_view &key, void *value),
+         std::vector<S3FifoHandle *> *refused);
+  S3FifoHandle *Lookup(const std::string_view &key, uint32_t hash);
+  void Fork(S3FifoHandle *handle);
+  void Release(S3FifoHandle *handle);
+  void Prune(std::vector<S3FifoHandle *> *refused);
+
+  size_t TotalCharge() {
+    std::lock_guard<decltype(mutex_)> lock(mutex_);
+    return usage_;
+  }
+  void UpdateCharge(S3FifoHandle *handle, size_t new_charge,
+                    std::vector<S3FifoHandle *> *refused) {
+    std::lock_guard<decltype(mutex_)> lock(mutex_);
+    if (handle->in_cache) {
+      usage_ = usage_ - handle->charge + new_charge;
+      if (!handle->in_main) {
+        small_usage_ = small_usage_ - handle->charge + new_charge;
+      }
+    }
+    handle->charge = new_charge;
+    Evict(refused);
+  }
+
+private:
+  static constexpr uint8_t kMaxFreq = 3;
+  // percentage of capacity taken by small queue.
+  static constexpr size_t kSmallQueueRatio = 10;
+  // ghost queue remembers at least this many hashes.
+  static constexpr size_t kMinGhostSize = 16;
+
+  void Ref(S3FifoHandle *e) { e->refs++; }
+  void Unref(S3FifoHandle *e);
+  void List_Remove(S3FifoHandle *e);
+  void List_Append(S3FifoHandle *list, S3FifoHandle *e);
+  bool FinishErase(S3FifoHandle *e);
+  // Evict until usage fits capacity, or every entry has been visited.
+  void Evict(std::vector<S3FifoHandle *> *refused);
+  void EvictSmall(std::vector<S3FifoHandle *> *refused);
+  // Move parked entries back to their queues so that they are reconsidered.
+  void UnparkRefused();
+  void EvictMain(std::vector<S3FifoHandle *> *refused);
+  // Return whether e has been evicted.
+  bool TryEvict(S3FifoHandle *e, std::vector<S3FifoHandle *> *refused);
+  void AddGhost(uint32_t hash);
+
+  // Initialized before use.
+  const std::function<bool(void *value)> *can_evict_{nullptr};
+
+  // mutex_ protects the following state.
+  Mutex mutex_;
+  size_t capacity_{0};
+  size_t usage_{0};
+  size_t small_usage_{0};
+  size_t count_{0};
+
+  // Dummy heads of FIFO queues.
+  // head.prev is newest entry, head.next is oldest entry.
+  S3FifoHandle small_{};
+  S3FifoHandle main_{};
+  // Dummy head of refused list, entries are still accounted by the queue
+  // they come from.
+  S3FifoHandle refused_{};
+
+  std::deque<uint32_t> ghost_;
+  // number of occurrences of hash in ghost_.
+  absl::flat_hash_map<uint32_t, uint32_t> ghost_count_;
+
+  HandleTable<S3FifoHandle> table_{};
+};
+
+template <typename Mutex> inline S3FifoCache<Mutex>::S3FifoCache() {
+  // Make empty circular linked lists.
+  small_.next = &small_;
+  small_.prev = &small_;
+  main_.next = &main_;
+  main_.prev = &main_;
+  refused_.next = &refused_;
+  refused_.prev = &refused_;
+}
+
+template <typename Mutex> inline S3FifoCache<Mutex>::~S3FifoCache() {
+  for (auto *list : {&small_, &main_, &refused_}) {
+    for (S3FifoHandle *e = list->next; e != list;) {
+      S3FifoHandle *next = e->next;
+      assert(e->in_cache);
+      e->in_cache = false;
+      assert(e->refs == 1); // Error if caller has an unreleased handle
+      Unref(e);
+      e = next;
+    }
+  }
+}
+
+template <typename Mutex>
+inline void S3FifoCache<Mutex>::Unref(S3FifoHandle *e) {
+  assert(e->refs > 0);
+  e->refs--;
+  if (e->refs == 0) { // Deallocate.
+    assert(!e->in_cache);
+    (*e->deleter)(e->key(), e->value);
+    free(e);
+  } else if (e->in_cache && e->refs == 1 && e->refused &&
+             (can_evict_ == nullptr || (*can_evict_)(e->value))) {
+    // Refused entry becomes evictable, it's still the oldest one.
+    e->refused = false;
+    List_Remove(e);
+    auto *queue = e->in_main ? &main_ : &small_;
+    List_Append(queue->next, e);
+  }
+}
+
+template <typename Mutex>
+inline void S3FifoCache<Mutex>::List_Remove(S3FifoHandle *e) {
+  e->next->prev = e->prev;
+  e->prev->next = e->next;
+}
+
+template <typename Mutex>
+inline void S3FifoCache<Mutex>::List_Append(S3FifoHandle *list,
+                                            S3FifoHandle *e) {
+  // Make "e" newest entry by inserting just before *list
+  e->next = list;
+  e->prev = list->prev;
+  e->prev->next = e;
+  e->next->prev = e;
+}
+
+template <typename Mutex>
+inline S3FifoHandle *S3FifoCache<Mutex>::Lookup(const std::string_view &key,
+                                                uint32_t hash) {
+  std::lock_guard<decltype(mutex_)> lock(mutex_);
+  S3FifoHandle *e = table_.Lookup(key, hash);
+  if (e != nullptr) {
+    Ref(e);
+    e->freq = std::min<uint8_t>(e->freq + 1, kMaxFreq);
+  }
+  return e;
+}
+
+template <typename Mutex>
+inline void S3FifoCache<Mutex>::Release(S3FifoHandle *handle) {
+  std::lock_guard<decltype(mutex_)> lock(mutex_);
+  Unref(handle);
+}
+
+template <typename Mutex>
+inline void S3FifoCache<Mutex>::Fork(S3FifoHandle *handle) {
+  std::lock_guard<decltype(mutex_)> lock(mutex_);
+  Ref(handle);
+}
+
+template <typename Mutex>
+inline S3FifoHandle *S3FifoCache<Mutex>::Insert(
+    const std::string_view &key, uint32_t hash, void *value, size_t charge,
+    void (*deleter)(const std::string_view &key, void *value),
+    std::vector<S3FifoHandle *> *refused) {
+  std::lock_guard<decltype(mutex_)> lock(mutex_);
+
+  auto *e = reinterpret_cast<S3FifoHandle *>(
+      malloc(sizeof(S3FifoHandle) - 1 + key.size()));
+  e->value = value;
+  e->deleter = deleter;
+  e->charge = charge;
+  e->key_length = key.size();
+  e->hash = hash;
+  e->in_cache = false;
+  e->in_main = false;
+  e->refused = false;
+  e->freq = 0;
+  e->refs = 1; // for the returned handle.
+  std::memcpy(e->key_data, key.data(), key.size());
+
+  if (capacity_ > 0) {
+    e->refs++; // for the cache's reference.
+    e->in_cache = true;
+    // entry evicted recently is likely to be hot.
+    e->in_main = ghost_count_.contains(hash);
+    if (e->in_main) {
+      List_Append(&main_, e);
+    } else {
+      List_Append(&small_, e);
+      small_usage_ += charge;
+    }
+    usage_ += charge;
+    count_ += 1;
+    FinishErase(table_.Insert(e));
+  } else { // don't cache. (capacity_==0 is supported and turns off caching.)
+    // next is read by key() in an assert, so it must be initialized
+    e->next = nullptr;
+  }
+
+  Evict(refused);
+  return e;
+}
+
+template <typename Mutex>
+inline void
+S3FifoCache<Mutex>::SetCapacity(size_t capacity,
+                                std::vector<S3FifoHandle *> *refused) {
+  std::lock_guard<decltype(mutex_)> lock(mutex_);
+  capacity_ = capacity;
+  if (usage_ > capacity_) {
+    UnparkRefused();
+  }
+  Evict(refused);
+}
+
+template <typename Mutex> inline void S3FifoCache<Mutex>::UnparkRefused() {
+  while (refused_.next != &refused_) {
+    S3FifoHandle *e = refused_.next;
+    e->refused = false;
+    List_Remove(e);
+    auto *queue = e->in_main ? &main_ : &small_;
+    List_Append(queue->next, e);
+  }
+}
+
+// If e != nullptr, finish removing *e from the cache; it has already been
+// removed from the hash table.  Return whether e != nullptr.
+template <typename Mutex>
+inline bool S3FifoCache<Mutex>::FinishErase(S3FifoHandle *e) {
+  if (e != nullptr) {
+    assert(e->in_cache);
+    List_Remove(e);
+    e->in_cache = false;
+    usage_ -= e->charge;
+    if (!e->in_main) {
+      small_usage_ -= e->charge;
+    }
+    count_ -= 1;
+    Unref(e);
+  }
+  return e != nullptr;
+}
+
+template <typename Mutex>
+inline bool S3FifoCache<Mutex>::TryEvict(S3FifoHandle *e,
+                                         std::vector<S3FifoHandle *> *refused) {
+  if (e->refs > 1) { // in use
+    return false;
+  }
+  if (can_evict_ != nullptr && !(*can_evict_)(e->value)) {
+    // parked until it's evictable, so that it won't be visited again.
+    if (!e->refused) {
+      e->refused = true;
+      List_Remove(e);
+      List_Append(&refused_, e);
+    }
+    Ref(e);
+    refused->push_back(e);
+    return false;
+  }
+  bool erased = FinishErase(table_.Remove(e->key(), e->hash));
+  if (!erased) { // to avoid unused variable when compiled NDEBUG
+    assert(erased);
+  }
+  return true;
+}
+
+template <typename Mutex>
+inline void S3FifoCache<Mutex>::EvictSmall(
+    std::vector<S3FifoHandle *> *refused) {
+  S3FifoHandle *e = small_.next;
+  List_Remove(e);
+  if (e->freq > 0) {
+    // accessed again while it's in small queue, promote to main queue.
+    e->in_main = true;
+    e->freq = 0;
+    small_usage_ -= e->charge;
+    List_Append(&main_, e);
+    return;
+  }
+  // put it back, so that it could be unlinked by FinishErase.
+  List_Append(&small_, e);
+  auto hash = e->hash;
+  if (TryEvict(e, refused)) {
+    AddGhost(hash);
+  }
+}
+
+template <typename Mutex>
+inline void S3FifoCache<Mutex>::EvictMain(
+    std::vector<S3FifoHandle *> *refused) {
+  S3FifoHandle *e = main_.next;
+  List_Remove(e);
+  List_Append(&main_, e);
+  if (e->freq > 0) {
+    e->freq -= 1;
+    return;
+  }
+  TryEvict(e, refused);
+}
+
+template <typename Mutex>
+inline void S3FifoCache<Mutex>::Evict(std::vector<S3FifoHandle *> *refused) {
+  // every entry is visited at most kMaxFreq + 2 times before it's evicted,
+  // which bounds the loop when entries couldn't be evicted.
+  size_t budget = count_ * (kMaxFreq + 2);
+  while (usage_ > capacity_ && budget > 0) {
+    budget -= 1;
+    bool small_empty = small_.next == &small_;
+    bool main_empty = main_.next == &main_;
+    if (small_empty && main_empty) {
+      return;
+    }
+    if (!small_empty &&
+        (main_empty || small_usage_ * 100 >= capacity_ * kSmallQueueRatio)) {
+      EvictSmall(refused);
+    } else {
+      EvictMain(refused);
+    }
+  }
+}
+
+template <typename Mutex>
+inline void S3FifoCache<Mutex>::AddGhost(uint32_t hash) {
+  ghost_.push_back(hash);
+  ghost_count_[hash] += 1;
+  // ghost queue remembers about as many entries as the cache holds.
+  while (ghost_.size() > std::max(count_, kMinGhostSize)) {
+    auto it = ghost_count_.find(ghost_.front());
+    assert(it != ghost_count_.end());
+    if (--it->second == 0) {
+      ghost_count_.erase(it);
+    }
+    ghost_.pop_front();
+  }
+}
+
+template <typename Mutex>
+inline void S3FifoCache<Mutex>::Prune(std::vector<S3FifoHandle *> *refused) {
+  std::lock_guard<decltype(mutex_)> lock(mutex_);
+  // Explicit prune reconsiders parked entries as well.
+  for (auto *list : {&small_, &main_, &refused_}) {
+    for (S3FifoHandle *e = list->next; e != list;) {
+      S3FifoHandle *next = e->next;
+      TryEvict(e, refused);
+      e = next;
+    }
+  }
+}
+
+template <typename Mutex> class ShardedS3FifoCache : public Cache {
+private:
+  const uint32_t num_shard_bits_;
+  const uint32_t num_shards_;
+  std::vector<S3FifoCache<Mutex>> shard_;
+  Mutex id_mutex_;
+  uint64_t last_id_;
+  EvictionHooks hooks_;
+
+  static inline uint32_t HashSlice(const std::string_view &s) {
+    return absl::Hash<std::string_view>()(s);
+  }
+
+  // Note, hash >> 32 yields hash in gcc, not the zero we expect!
+  uint32_t Shard(uint32_t hash) {
+    return uint64_t(hash) >> (32 - num_shard_bits_);
+  }
+
+  // Must be called without holding the lock of shards.
+  void HandleRefused(const std::vector<S3FifoHandle *> &refused) {
+    for (auto *e : refused) {
+      auto holder = MakeHolder(reinterpret_cast<Handle *>(e));
+      if (hooks_.on_refused) {
+        hooks_.on_refused(std::move(holder));
+      }
+    }
+  }
+
+public:
+  explicit ShardedS3FifoCache(size_t capacity, uint32_t num_shard_bits)
+      : num_shard_bits_(num_shard_bits), num_shards_(1 << num_shard_bits_),
+        shard_(num_shards_), last_id_(0) {
+    SetCapacity(capacity);
+  }
+  ~ShardedS3FifoCache() override = default;
+  Handle *DoInsert(const std::string_view &key, void *value, size_t charge,
+                   void (*deleter)(const std::string_view &key,
+                                   void *value)) override {
+    const uint32_t hash = HashSlice(key);
+    std::vector<S3FifoHandle *> refused;
+    auto *handle = shard_[Shard(hash)].Insert(key, hash, value, charge,
+                                              deleter, &refused);
+    HandleRefused(refused);
+    return reinterpret_cast<Handle *>(handle);
+  }
+  Handle *DoLookup(const std::string_view &key) override {
+    const uint32_t hash = HashSlice(key);
+    return reinterpret_cast<Handle *>(shard_[Shard(hash)].Lookup(key, hash));
+  }
+  void Fork(Handle *handle) override {
+    auto *h = reinterpret_cast<S3FifoHandle *>(handle);
+    shard_[Shard(h->hash)].Fork(h);
+  }
+  void Release(Handle *handle) override {
+    auto *h = reinterpret_cast<S3FifoHandle *>(handle);
+    shard_[Shard(h->hash)].Release(h);
+  }
+  void *Value(Handle *handle) override {
+    return reinterpret_cast<S3FifoHandle *>(handle)->value;
+  }
+  uint64_t NewId() override {
+    std::lock_guard<decltype(id_mutex_)> lock(id_mutex_);
+    return ++(last_id_);
+  }
+  void Prune() override {
+    std::vector<S3FifoHandle *> refused;
+    for (auto &s : shard_) {
+      s.Prune(&refused);
+    }
+    HandleRefused(refused);
+  }
+  void SetCapacity(size_t capacity) override {
+    const size_t per_shard = (capacity + (num_shards_ - 1)) / num_shards_;
+    std::vector<S3FifoHandle *> refused;
+    for (auto &s : shard_) {
+      s.SetCapacity(per_shard, &refused);
+    }
+    HandleRefused(refused);
+  }
+  void SetEvictionHooks(EvictionHooks hooks) override {
+    hooks_ = std::move(hooks);
+    for (auto &s : shard_) {
+      s.SetCanEvict(hooks_.can_evict ? &hooks_.can_evict : nullptr);
+    }
+  }
+  size_t TotalCharge() override {
+    size_t total = 0;
+    for (auto &s : shard_) {
+      total += s.TotalCharge();
+    }
+    return total;
+  }
+
+  void UpdateCharge(Handle *handle, size_t charge) override {
+    auto *h = reinterpret_cast<S3FifoHandle *>(handle);
+    std::vector<S3FifoHandle *> refused;
+    shard_[Shard(h->hash)].UpdateCharge(h, charge, &refused);
+    HandleRefused(refused);
+  }
+};
+
+template <typename Mutex = std::mutex>
+inline std::unique_ptr<Cache> NewS3FifoCache(size_t capacity,
+                                             uint32_t num_shard_bits = 4) {
+  return std::make_unique<ShardedS3FifoCache<Mutex>>(capacity,
+                                                     num_shard_bits);
+}
+
+} // namespace cache
+} // namespace arcanedb
@@ -13,8 +13,8 @@
 
 namespace arcanedb {
 
-struct BtreeScanOpts {
-  bool remove_duplicate{false};
-};
+// range scan always emits at most one visible version for each sort key, so
+// there is no need to remove duplicated rows.
+struct BtreeScanOpts {};
 
 } // namespace arcanedb
\ No newline at end of file
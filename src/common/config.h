@@ -25,12 +25,63 @@ public:
   static constexpr size_t kLogSegmentDefaultSize = 4 << 20;
   static constexpr size_t kLogStoreFlushInterval = 50 * util::MicroSec;
 
+  // initial threshold of delta chain length, the threshold of each page will
+  // be adjusted within [kBwTreeMinDeltaChainLength, kBwTreeMaxDeltaChainLength]
+  // according to the workload of that page.
   static constexpr size_t kBwTreeDeltaChainLength = 16;
+  static constexpr size_t kBwTreeMinDeltaChainLength = 4;
+  static constexpr size_t kBwTreeMaxDeltaChainLength = 64;
+  // writers will perform compaction by themselves once delta chain exceeds
+  // this limit, i.e. background compaction couldn't keep up.
+  static constexpr size_t kBwTreeHardDeltaChainLength = 256;
+  // re-derive compaction threshold every 1024 operations on a page.
+  static constexpr size_t kBwTreeAdaptiveWindow = 1024;
+  // readers only record statistics once every 16 reads.
+  static constexpr size_t kBwTreeReadSampleRate = 16;
   static constexpr size_t kBwTreeCompactionFactor = 2;
+  // maximum number of writes that could be committed in one group.
+  static constexpr size_t kBwTreeGroupCommitMaxBatchSize = 64;
+  // delta nodes with at least 2 rows carry a bloom filter of sort keys, so
+  // that point lookups could skip them.
+  static constexpr size_t kBwTreeDeltaBloomMinRows = 2;
+  static constexpr size_t kBwTreeDeltaBloomBitsPerKey = 10;
+  // delta nodes with at least 16 rows keep normalized key prefixes, or
+  // decoded keys when sort key is a single int64, for binary search.
+  static constexpr size_t kBwTreeDeltaPrefixMinRows = 16;
+  // single row deltas store rows no longer than 64 bytes inline, so that
+  // they are built with a single pooled allocation.
+  static constexpr size_t kBwTreeInlineRowSize = 64;
+  // readers blocked by an intent are woken when the intent is resolved, and
+  // recheck after this timeout in case the wake up is lost.
+  static constexpr int64_t kBwTreeIntentWaitTimeoutUs = 1 * util::MillSec;
+
+  // leaf pages larger than 1MB are split into two pages.
+  static constexpr size_t kBtreeLeafSplitSize = 1 << 20;
+  // leaf pages smaller than 64KB are merged with their sibling, as long as
+  // the merged page is not larger than half of kBtreeLeafSplitSize.
+  static constexpr size_t kBtreeLeafMergeSize = 64 << 10;
+  // internal pages with more than 256 children are split into two pages.
+  static constexpr size_t kBtreeInternalMaxFanout = 256;
+
+  // small subtables are hashed into 65536 packed pages.
+  static constexpr size_t kPackedPageNum = 1 << 16;
+  // packed subtables larger than 16KB are promoted to their own pages.
+  static constexpr size_t kPackedSubTablePromoteSize = 16 << 10;
+  // promoted table keys of each packed page are remembered by a bloom
+  // filter sized for 256 keys, see PackedPage.
+  static constexpr size_t kPackedPromotedFilterKeyNum = 256;
+  static constexpr size_t kPackedPromotedFilterBitsPerKey = 10;
+  // packed page is flushed as a whole after 8 delta flushes.
+  static constexpr size_t kPackedPageMaxDeltaNum = 8;
 
   // 8 bit indicates 256 shard
   static constexpr size_t kCacheShardNumBits = 8;
-  // 16G capacity
+  // each worker pins at most 128 hot pages, see HotPageTable.
+  static constexpr size_t kHotPageWorkerNum = 32;
+  static constexpr size_t kHotPageSlotNum = 128;
+  // pinned hot pages take at most 1/16 of cache capacity.
+  static constexpr size_t kHotPageCapacityRatio = 16;
+  // 16G capacity by default, see BufferPool::SetCapacity.
   static constexpr size_t kCacheCapacity = 16ul << 30;
 
   static constexpr int64_t kLockTimeoutUs = 150 * util::MillSec;
@@ -39,6 +90,8 @@ public:
 
   static constexpr size_t kLockTableShardNum = 64;
 
+  static constexpr size_t kTxnStatusTableShardNum = 64;
+
   // txn ts is 4 byte
   // 4 mb link buf
   static constexpr size_t kLinkBufSnapshotManagerSize = 1 << 20;
@@ -47,8 +100,22 @@ public:
 
   // 32 shard
   static constexpr size_t kFlusherShardNum = 256;
+  static constexpr size_t kLowWatermarkShardNum = 16;
+  // compaction reads the watermark cached within this interval.
+  static constexpr int64_t kLowWatermarkRefreshIntervalUs = 1 * util::MillSec;
+
+  // number of bthreads performing background compaction.
+  static constexpr size_t kCompactionWorkerNum = 4;
 
   static constexpr size_t kLogPartitionNum = 32;
+
+  // maximum number of threads that could enter epoch concurrently.
+  static constexpr size_t kEpochMaxSlotNum = 1024;
+  static constexpr size_t kEpochRetireShardNum = 16;
+  // try to reclaim retired pointers every 64 retires.
+  static constexpr size_t kEpochReclaimInterval = 64;
+
+  static constexpr size_t kWaitTableSlotNum = 1024;
 };
 
 } // namespace common
@@ -0,0 +1,64 @@
+/**
+ * @file filter.cpp
+ * @author sheep (ysj1173886760@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "common/filter.h"
+#include "common/macros.h"
+#include "property/row/row.h"
+
+namespace arcanedb {
+
+namespace {
+
+template <typename T>
+bool Compare(const T &lhs, const T &rhs, Filter::CompareOp op) noexcept {
+  switch (op) {
+  case Filter::CompareOp::kEqual:
+    return lhs == rhs;
+  case Filter::CompareOp::kNotEqual:
+    return lhs != rhs;
+  case Filter::CompareOp::kLess:
+    return lhs < rhs;
+  case Filter::CompareOp::kLessEqual:
+    return lhs <= rhs;
+  case Filter::CompareOp::kGreater:
+    return lhs > rhs;
+  case Filter::CompareOp::kGreaterEqual:
+    return lhs >= rhs;
+  }
+  UNREACHABLE();
+}
+
+} // namespace
+
+bool Filter::Match(const property::Row &row,
+                   const property::Schema *schema) const noexcept {
+  for (const auto &predicate : predicates) {
+    property::ValueResult res;
+    if (!row.GetProp(predicate.column_id, &res, schema).ok()) {
+      return false;
+    }
+    if (res.value.index() != predicate.value.index()) {
+      return false;
+    }
+    bool matched = std::visit(
+        [&](const auto &lhs) {
+          using Type = std::decay_t<decltype(lhs)>;
+          return Compare(lhs, std::get<Type>(predicate.value), predicate.op);
+        },
+        res.value);
+    if (!matched) {
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace arcanedb
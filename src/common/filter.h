@@ -11,8 +11,62 @@
 
 #pragma once
 
+#include "property/property_type.h"
+#include "property/sort_key/sort_key.h"
+#include <optional>
+#include <vector>
+
 namespace arcanedb {
 
-struct Filter {};
+namespace property {
+class Row;
+class Schema;
+} // namespace property
+
+/**
+ * @brief
+ * Filter of range scan. all conditions are evaluated inside the page while
+ * rows are merged, so rows that are filtered out are never materialized.
+ */
+struct Filter {
+  enum class CompareOp : uint8_t {
+    kEqual = 0,
+    kNotEqual = 1,
+    kLess = 2,
+    kLessEqual = 3,
+    kGreater = 4,
+    kGreaterEqual = 5,
+  };
+
+  struct Predicate {
+    property::ColumnId column_id;
+    CompareOp op;
+    property::Value value;
+  };
+
+  // scan range is [start, end), nullopt means unbounded.
+  std::optional<property::SortKeys> start{};
+  std::optional<property::SortKeys> end{};
+  // maximum number of rows to return, 0 means unlimited.
+  size_t limit{0};
+  // return rows in descending order of sort key.
+  bool reverse{false};
+  // predicates are conjunctive.
+  std::vector<Predicate> predicates{};
+
+  bool HasPredicate() const noexcept { return !predicates.empty(); }
+
+  /**
+   * @brief
+   * Check whether row satisfies all predicates.
+   * predicate over a non-existing column or with mismatched type is treated as
+   * not satisfied.
+   * @param row
+   * @param schema
+   * @return true when row passes the filter.
+   */
+  bool Match(const property::Row &row, const property::Schema *schema) const
+      noexcept;
+};
 
-} // namespace arcanedb
\ No newline at end of file
+} // namespace arcanedb
@@ -31,6 +31,8 @@ class Schema;
  */
 struct Options {
   const property::Schema *schema{};
+  // compaction will be performed by buffer pool in background
+  // when buffer pool is provided.
   cache::BufferPool *buffer_pool{};
   log_store::LogStore *log_store{};
   // we will skip the lock when lock ts is the same as
@@ -42,6 +44,10 @@ struct Options {
   bool force_compaction{false};
   bool check_intent_locked{false};
   bool sync_commit{false};
+  // small subtables are packed into shared pages, see btree::PackedPage.
+  // it should never be changed during the lifetime of db, otherwise packed
+  // subtables can't be found.
+  bool enable_packed_page{false};
 };
 
 } // namespace arcanedb
\ No newline at end of file
@@ -20,6 +20,8 @@ namespace arcanedb {
 
 using PageIdType = std::string;
 using PageIdView = std::string_view;
+// hash of page id, see HotPageTable.
+using PageIdHash = uint64_t;
 
 // using ArcanedbLock = util::ArcaneMutex<bthread::Mutex>;
 // template <typename Mutex>
@@ -39,21 +39,25 @@ static const property::Schema kWeightedGraphSchema(kWeightedGraphRawSchema);
 WeightedGraphDB::VertexId WeightedGraphDB::EdgeIterator::OutVertexId() const
     noexcept {
   property::ValueResult res;
-  auto s =
-      views.at(current_idx)
-          .GetProp(kWeightedGraphVertexIdColumn, &res, &kWeightedGraphSchema);
+  auto s = cursor->GetRow().GetProp(kWeightedGraphVertexIdColumn, &res,
+                                    &kWeightedGraphSchema);
   CHECK(s.ok());
   return std::get<int64_t>(res.value);
 }
 
 std::string_view WeightedGraphDB::EdgeIterator::EdgeValue() const noexcept {
   property::ValueResult res;
-  auto s = views.at(current_idx)
-               .GetProp(kWeightedGraphValueColumn, &res, &kWeightedGraphSchema);
+  auto s = cursor->GetRow().GetProp(kWeightedGraphValueColumn, &res,
+                                    &kWeightedGraphSchema);
   CHECK(s.ok());
   return std::get<std::string_view>(res.value);
 }
 
+void WeightedGraphDB::EdgeIterator::Seek(VertexId dst) noexcept {
+  auto sort_key = property::SortKeys(property::Value(dst));
+  cursor->Seek(sort_key.as_ref());
+}
+
 WeightedGraphDB::VertexId
 WeightedGraphDB::UnsortedEdgeIterator::OutVertexId() const noexcept {
   property::ValueResult res;
@@ -73,14 +77,21 @@ std::string_view WeightedGraphDB::UnsortedEdgeIterator::EdgeValue() const
 }
 
 void WeightedGraphDB::Transaction::GetEdgeIterator(
-    VertexId src, EdgeIterator *iterator) noexcept {
-  btree::RangeScanRowView views;
-  Filter filter;
-  BtreeScanOpts scan_opts;
-  txn_context_->RangeFilter(EdgeEncoding(src), opts_, filter, scan_opts,
-                            &views);
-  iterator->current_idx = 0;
-  iterator->views = std::move(views);
+    VertexId src, EdgeIterator *iterator,
+    std::string_view resume_token) noexcept {
+  GetEdgeIterator(src, Filter{}, iterator, resume_token);
+}
+
+void WeightedGraphDB::Transaction::GetEdgeIterator(
+    VertexId src, const Filter &filter, EdgeIterator *iterator,
+    std::string_view resume_token) noexcept {
+  // cursor is positioned once, at the resume point.
+  auto scan_filter = filter;
+  btree::ScanCursor::ApplyResumeToken(resume_token, &scan_filter);
+  auto opts = opts_;
+  opts.schema = &kWeightedGraphSchema;
+  iterator->cursor.emplace(
+      txn_context_->GetScanCursor(EdgeEncoding(src), opts, scan_filter));
 }
 
 WeightedGraphDB::UnsortedEdgeIterator
@@ -124,7 +135,10 @@ Status WeightedGraphDB::Open(const std::string &db_name,
     }
   }
 
-  res->buffer_pool_ = std::make_unique<cache::BufferPool>(page_store);
+  res->buffer_pool_ =
+      std::make_unique<cache::BufferPool>(page_store, opts.cache_policy);
+  res->buffer_pool_->SetCapacity(opts.cache_capacity);
+  res->enable_packed_page_ = opts.enable_packed_page;
   res->txn_manager_ =
       std::make_unique<txn::TxnManagerOCC>(opts.lock_manager_type);
   *db = std::move(res);
@@ -235,6 +249,7 @@ WeightedGraphDB::BeginRoTxn(const Options &opts) noexcept {
   txn->opts_.log_store = log_stores_[0].get();
   txn->opts_.buffer_pool = buffer_pool_.get();
   txn->opts_.ignore_lock = true;
+  txn->opts_.enable_packed_page = enable_packed_page_;
   txn->txn_context_ = txn_manager_->BeginRoTxn(opts);
   return txn;
 }
@@ -245,6 +260,7 @@ WeightedGraphDB::BeginRwTxn(const Options &opts,
   auto txn = std::make_unique<WeightedGraphDB::Transaction>();
   txn->opts_ = opts;
   txn->opts_.buffer_pool = buffer_pool_.get();
+  txn->opts_.enable_packed_page = enable_packed_page_;
   txn->txn_context_ = txn_manager_->BeginRwTxn(opts);
   if (only_single_edge_txn_) {
     txn->opts_.log_store =
@@ -25,6 +25,11 @@ struct WeightedGraphOptions {
   bool sync_log{true};
   bool only_single_edge_txn{true};
   txn::LockManagerType lock_manager_type{txn::LockManagerType::kCentralized};
+  // pack edges of low-degree vertices into shared pages, see btree::PackedPage
+  bool enable_packed_page{false};
+  // memory budget of buffer pool, pages are evicted only if enable_flush.
+  size_t cache_capacity{common::Config::kCacheCapacity};
+  cache::CachePolicy cache_policy{cache::CachePolicy::kLRU};
 };
 
 /**
@@ -45,16 +50,33 @@ public:
   static Status Destroy(const std::string &db_name) noexcept;
 
   struct EdgeIterator {
-    bool Valid() const noexcept { return current_idx < views.size(); }
+    bool Valid() const noexcept {
+      return cursor.has_value() && cursor->Valid();
+    }
 
-    void Next() noexcept { current_idx += 1; }
+    void Next() noexcept { cursor->Next(); }
+
+    /**
+     * @brief
+     * Position at the first edge whose dst is not less than dst.
+     * @param dst
+     */
+    void Seek(VertexId dst) noexcept;
+
+    /**
+     * @brief
+     * Opaque token for continuing the iteration after current edge.
+     * @return std::string
+     */
+    std::string GetResumeToken() const noexcept {
+      return cursor->GetResumeToken();
+    }
 
     VertexId OutVertexId() const noexcept;
 
     std::string_view EdgeValue() const noexcept;
 
-    size_t current_idx{};
-    btree::RangeScanRowView views;
+    std::optional<btree::ScanCursor> cursor;
   };
 
   struct UnsortedEdgeIterator {
@@ -128,11 +150,29 @@ public:
 
     /**
      * @brief Read all out edges within the same start vertex.
+     * edges are produced lazily in the order of dst.
+     *
+     * @param src
+     * @param iterator
+     * @param resume_token continue from the edge where token is taken, empty
+     * token means starting from the first edge.
+     */
+    void GetEdgeIterator(VertexId src, EdgeIterator *iterator,
+                         std::string_view resume_token = {}) noexcept;
+
+    /**
+     * @brief Read out edges of src which pass the filter.
+     * bounds of filter are dst vertex ids, and predicates are evaluated over
+     * the columns of edge, i.e. dst vertex id and edge value.
      *
      * @param src
+     * @param filter
      * @param iterator
+     * @param resume_token token taken from an iterator with the same filter.
      */
-    void GetEdgeIterator(VertexId src, EdgeIterator *iterator) noexcept;
+    void GetEdgeIterator(VertexId src, const Filter &filter,
+                         EdgeIterator *iterator,
+                         std::string_view resume_token = {}) noexcept;
 
     /**
      * @brief Get unsorted edge iterator
@@ -173,6 +213,7 @@ private:
              common::Config::kLogPartitionNum>
       log_stores_;
   bool only_single_edge_txn_;
+  bool enable_packed_page_{false};
 };
 
 } // namespace graph
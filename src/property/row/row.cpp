@@ -94,8 +94,11 @@ Status Row::Serialize(const ValueRefVec &value_ref_vec,
   return Status::Ok();
 }
 
-void Row::SerializeOnlySortKey(SortKeysRef sort_key,
-                               util::BufWriter *buf_writer) noexcept {
+namespace {
+
+template <typename Writer>
+void SerializeOnlySortKeyImpl(SortKeysRef sort_key,
+                              Writer *buf_writer) noexcept {
   uint16_t total_length =
       kRowTotalLengthSize + kRowSortKeyLengthSize + sort_key.as_slice().size();
   buf_writer->WriteBytes(total_length);
@@ -103,6 +106,18 @@ void Row::SerializeOnlySortKey(SortKeysRef sort_key,
   buf_writer->WriteBytes(sort_key.as_slice());
 }
 
+} // namespace
+
+void Row::SerializeOnlySortKey(SortKeysRef sort_key,
+                               util::BufWriter *buf_writer) noexcept {
+  SerializeOnlySortKeyImpl(sort_key, buf_writer);
+}
+
+void Row::SerializeOnlySortKey(
+    SortKeysRef sort_key, util::NonOwnershipBufWriter *buf_writer) noexcept {
+  SerializeOnlySortKeyImpl(sort_key, buf_writer);
+}
+
 Status Row::GetPropNormalValue_(size_t index, ValueResult *value,
                                 const Schema *schema) const noexcept {
   DCHECK(ptr_ != nullptr);
@@ -71,6 +71,15 @@ public:
   static void SerializeOnlySortKey(SortKeysRef sort_key,
                                    util::BufWriter *buf_writer) noexcept;
 
+  static void
+  SerializeOnlySortKey(SortKeysRef sort_key,
+                       util::NonOwnershipBufWriter *buf_writer) noexcept;
+
+  // size of the row serialized by SerializeOnlySortKey.
+  static size_t GetOnlySortKeyRowSize(SortKeysRef sort_key) noexcept {
+    return kRowSortKeyOffset + sort_key.as_slice().size();
+  }
+
 private:
   Status GetPropNormalValue_(size_t index, ValueResult *value,
                              const Schema *schema) const noexcept;
@@ -0,0 +1,118 @@
+/**
+ * @file low_watermark.cpp
+ * @author sheep (ysj1173886760@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "txn/low_watermark.h"
+#include "butil/fast_rand.h"
+#include "butil/time.h"
+#include <algorithm>
+
+namespace arcanedb {
+namespace txn {
+
+void LowWatermark::Pin::Release() noexcept {
+  if (!valid_) {
+    return;
+  }
+  auto &shard = LowWatermark::GetInstance()->shards_[shard_];
+  std::lock_guard<bthread::Mutex> guard(shard.mu);
+  shard.pinned_ts.erase(shard.pinned_ts.find(ts_));
+  valid_ = false;
+}
+
+uint64_t LowWatermark::AddSource(
+    std::function<TxnTs()> get_snapshot_ts) noexcept {
+  std::lock_guard<bthread::Mutex> guard(source_mu_);
+  auto source_id = next_source_id_++;
+  // readers of the new source might read below the cached watermark, lower
+  // it before anyone could read at the new source.
+  auto snapshot_ts = get_snapshot_ts();
+  if (sources_.empty()) {
+    cached_watermark_.store(0, std::memory_order_release);
+  } else if (snapshot_ts < cached_watermark_.load(std::memory_order_relaxed)) {
+    cached_watermark_.store(snapshot_ts, std::memory_order_release);
+  }
+  sources_.emplace(source_id, std::move(get_snapshot_ts));
+  generation_++;
+  refreshed_us_.store(0, std::memory_order_release);
+  return source_id;
+}
+
+void LowWatermark::RemoveSource(uint64_t source_id) noexcept {
+  std::lock_guard<bthread::Mutex> guard(source_mu_);
+  sources_.erase(source_id);
+  generation_++;
+  refreshed_us_.store(0, std::memory_order_release);
+}
+
+TxnTs LowWatermark::AcquireAndPin(const std::function<TxnTs()> &get_read_ts,
+                                  Pin *pin) noexcept {
+  pin->Release();
+  auto shard_idx =
+      butil::fast_rand_less_than(common::Config::kLowWatermarkShardNum);
+  auto &shard = shards_[shard_idx];
+  // ts is acquired inside the lock, if the watermark computation scanned this
+  // shard before us, then it must have read the sources before we acquire the
+  // ts, which implies our ts is no smaller than the watermark.
+  std::lock_guard<bthread::Mutex> guard(shard.mu);
+  auto ts = get_read_ts();
+  shard.pinned_ts.insert(ts);
+  pin->shard_ = shard_idx;
+  pin->ts_ = ts;
+  pin->valid_ = true;
+  return ts;
+}
+
+TxnTs LowWatermark::GetLowWatermark() noexcept {
+  uint64_t generation;
+  return GetLowWatermark_(&generation);
+}
+
+TxnTs LowWatermark::GetLowWatermark_(uint64_t *generation) noexcept {
+  TxnTs watermark = kMaxTxnTs;
+  {
+    // sources must be read before scanning the pinned snapshots.
+    std::lock_guard<bthread::Mutex> guard(source_mu_);
+    *generation = generation_;
+    if (sources_.empty()) {
+      return 0;
+    }
+    for (const auto &[_, get_snapshot_ts] : sources_) {
+      watermark = std::min(watermark, get_snapshot_ts());
+    }
+  }
+  for (auto &shard : shards_) {
+    std::lock_guard<bthread::Mutex> guard(shard.mu);
+    if (!shard.pinned_ts.empty()) {
+      watermark = std::min(watermark, *shard.pinned_ts.begin());
+    }
+  }
+  return watermark;
+}
+
+TxnTs LowWatermark::GetCachedLowWatermark() noexcept {
+  auto now = butil::gettimeofday_us();
+  auto refreshed_us = refreshed_us_.load(std::memory_order_acquire);
+  // only one refresher per interval, others just read the previous value.
+  if (now - refreshed_us >= common::Config::kLowWatermarkRefreshIntervalUs &&
+      refreshed_us_.compare_exchange_strong(refreshed_us, now)) {
+    uint64_t generation;
+    auto watermark = GetLowWatermark_(&generation);
+    std::lock_guard<bthread::Mutex> guard(source_mu_);
+    // sources changed during computation, the new source might be missed.
+    if (generation == generation_) {
+      cached_watermark_.store(watermark, std::memory_order_release);
+    }
+  }
+  return cached_watermark_.load(std::memory_order_acquire);
+}
+
+} // namespace txn
+} // namespace arcanedb
@@ -0,0 +1,145 @@
+/**
+ * @file low_watermark.h
+ * @author sheep (ysj1173886760@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#pragma once
+
+#include "absl/container/flat_hash_map.h"
+#include "bthread/mutex.h"
+#include "butil/macros.h"
+#include "common/config.h"
+#include "common/defines.h"
+#include "common/type.h"
+#include <atomic>
+#include <functional>
+#include <set>
+
+namespace arcanedb {
+namespace txn {
+
+/**
+ * @brief
+ * Low watermark of snapshots for MVCC garbage collection.
+ * Every reader will read at a ts which is no smaller than the low watermark,
+ * so for each row, versions older than the newest version below the watermark
+ * could be dropped.
+ * Watermark is derived from two kinds of input:
+ * 1. sources, e.g. snapshot manager, new readers will read at a ts that is no
+ * smaller than the current ts of sources.
+ * 2. pinned snapshots, i.e. read ts of the active txns.
+ */
+class LowWatermark {
+public:
+  static LowWatermark *GetInstance() noexcept {
+    static LowWatermark watermark;
+    return &watermark;
+  }
+
+  /**
+   * @brief
+   * RAII handle of a pinned snapshot.
+   */
+  class Pin {
+  public:
+    Pin() = default;
+
+    ~Pin() noexcept { Release(); }
+
+    Pin(Pin &&rhs) noexcept { *this = std::move(rhs); }
+
+    Pin &operator=(Pin &&rhs) noexcept {
+      if (this != &rhs) {
+        Release();
+        shard_ = rhs.shard_;
+        ts_ = rhs.ts_;
+        valid_ = rhs.valid_;
+        rhs.valid_ = false;
+      }
+      return *this;
+    }
+
+    void Release() noexcept;
+
+    DISALLOW_COPY_AND_ASSIGN(Pin);
+
+  private:
+    friend class LowWatermark;
+
+    size_t shard_{};
+    TxnTs ts_{};
+    bool valid_{false};
+  };
+
+  /**
+   * @brief
+   * Register a source of snapshot.
+   * @param get_snapshot_ts returns the minimum ts new readers will read at.
+   * @return uint64_t id of the source.
+   */
+  uint64_t AddSource(std::function<TxnTs()> get_snapshot_ts) noexcept;
+
+  void RemoveSource(uint64_t source_id) noexcept;
+
+  /**
+   * @brief
+   * Acquire a read ts and pin it atomically, so that watermark computed
+   * concurrently will never exceed the acquired ts.
+   * @param get_read_ts
+   * @param pin
+   * @return TxnTs acquired read ts.
+   */
+  TxnTs AcquireAndPin(const std::function<TxnTs()> &get_read_ts,
+                      Pin *pin) noexcept;
+
+  /**
+   * @brief
+   * Get the low watermark.
+   * @return TxnTs 0 when there is no source, i.e. nothing could be collected.
+   */
+  TxnTs GetLowWatermark() noexcept;
+
+  /**
+   * @brief
+   * Get the watermark computed within kLowWatermarkRefreshIntervalUs, so
+   * that hot paths like compaction won't scan all shards. cached watermark
+   * is never larger than the current one, since watermark only grows, and
+   * new sources lower the cached watermark when they are added.
+   * @return TxnTs
+   */
+  TxnTs GetCachedLowWatermark() noexcept;
+
+private:
+  LowWatermark() = default;
+
+  TxnTs GetLowWatermark_(uint64_t *generation) noexcept;
+
+  struct alignas(ARCANEDB_CACHE_LINE_SIZE) Shard {
+    bthread::Mutex mu;
+    std::multiset<TxnTs> pinned_ts; // guarded by mu
+  };
+
+  bthread::Mutex source_mu_;
+  // following fields are guarded by source_mu_
+  uint64_t next_source_id_{0};
+  absl::flat_hash_map<uint64_t, std::function<TxnTs()>> sources_;
+  // bumped whenever sources are changed, watermark computed with previous
+  // sources is never published.
+  uint64_t generation_{0};
+
+  Shard shards_[common::Config::kLowWatermarkShardNum];
+
+  // time of the last refresh, 0 indicates that cache is invalid.
+  std::atomic<int64_t> refreshed_us_{0};
+  // stored under source_mu_.
+  std::atomic<TxnTs> cached_watermark_{0};
+};
+
+} // namespace txn
+} // namespace arcanedb
@@ -10,8 +10,13 @@
  */
 
 #include "txn/occ_recovery.h"
+#include "btree/page/packed_page.h"
 #include "btree/page/versioned_btree_page.h"
+#include "btree/sub_table.h"
+#include "btree/versioned_btree.h"
 #include "cache/buffer_pool.h"
+#include "txn/txn_status_table.h"
+#include "wal/btree_smo_log_reader.h"
 #include "wal/bwtree_log_reader.h"
 #include "wal/log_type.h"
 #include "wal/occ_log_reader.h"
@@ -38,6 +43,14 @@ void OccRecovery::Recover() noexcept {
       BwTreeDeleteRow_(log_data);
       break;
     }
+    case wal::LogType::kBtreeSmo: {
+      BtreeSmo_(log_data);
+      break;
+    }
+    case wal::LogType::kPackedPromote: {
+      PackedPromote_(log_data);
+      break;
+    }
     case wal::LogType::kOccBegin: {
       OccBegin_(log_data);
       break;
@@ -56,14 +69,41 @@ void OccRecovery::Recover() noexcept {
   }
 
   ARCANEDB_INFO("Recover done. txn map size: {}", txn_map_.size());
-  for (const auto &[txn_id, cnt] : txn_map_) {
-    ARCANEDB_INFO("TxnId: {}, Cnt: {}", txn_id, cnt);
+  for (const auto &[txn_id, entry] : txn_map_) {
+    ARCANEDB_INFO("TxnId: {}, Cnt: {}", txn_id, entry.cnt);
   }
 
-  // TODO(sheep): implement finialize phase and undo phase.
-  // 1. find all txns that commits but havn't finish set ts, we help to set ts.
-  // 2. find all txns that failed to commit, we help to abort the txn
-  // note that abort phase could be optimized by using
+  Finalize_();
+
+  // TODO(sheep): implement undo phase.
+  // find all txns that failed to commit, we help to abort the txn
+}
+
+void OccRecovery::Finalize_() noexcept {
+  // txns that commit but haven't finished set ts, we help to set ts so that
+  // their entries in txn status table could be erased.
+  for (auto it = txn_map_.begin(); it != txn_map_.end();) {
+    auto &entry = it->second;
+    if (!entry.commit_ts.has_value()) {
+      ++it;
+      continue;
+    }
+    for (const auto &[table_key, sort_key] : entry.intents) {
+      // intents might be moved by smo, so locate them from the subtable.
+      Options opts;
+      opts.buffer_pool = buffer_pool_;
+      opts.owner_ts = entry.begin_ts;
+      opts.enable_packed_page = entry.packed;
+      std::unique_ptr<btree::SubTable> sub_table;
+      auto s = btree::SubTable::OpenSubTable(table_key, opts, &sub_table);
+      CHECK(s.ok());
+      btree::WriteInfo info;
+      sub_table->SetTs(property::SortKeysRef(sort_key), *entry.commit_ts, opts,
+                       &info);
+    }
+    TxnStatusTable::GetInstance()->Erase(entry.begin_ts);
+    it = txn_map_.erase(it);
+  }
 }
 
 cache::BufferPool::PageHolder
@@ -75,50 +115,90 @@ GetPage_(cache::BufferPool *buffer_pool,
   return page;
 }
 
+template <typename Func>
+void OccRecovery::ApplyBwTree_(std::string_view page_id,
+                               Func &&func) noexcept {
+  std::string_view packed_page_id;
+  std::string_view table_key;
+  if (!btree::PackedPage::ParseLeafId(page_id, &packed_page_id,
+                                      &table_key)) {
+    auto page = GetPage_(buffer_pool_, page_id);
+    func(page.operator->());
+    return;
+  }
+  auto packed_page = GetPage_(buffer_pool_, packed_page_id);
+  auto *packed = packed_page->GetPackedPage();
+  bool promoted = false;
+  auto leaf = packed->GetLeaf(table_key, /*create=*/true, &promoted);
+  if (promoted) {
+    // promotion has been flushed with packed page, apply on the promoted page.
+    auto page = GetPage_(buffer_pool_, table_key);
+    func(page.operator->());
+    return;
+  }
+  func(leaf.get());
+  packed_page->MarkDirty(log_store::kInvalidLsn);
+  packed_page.UpdateCharge(packed->UpdateLeafCharge(table_key));
+}
+
 // TODO(sheep): recovery should carry the lsn.
 void OccRecovery::BwTreeSetRow_(const std::string_view &data) noexcept {
   auto log = wal::DeserializeSetRowLog(data);
 
-  auto page = GetPage_(buffer_pool_, log.page_id);
+  ApplyBwTree_(log.page_id, [&](auto *page) {
+    Options opts;
+    btree::WriteInfo info;
+    auto s = page->SetRow(log.row, log.write_ts, opts, &info);
+    CHECK(s.ok());
+  });
 
-  Options opts;
-  btree::WriteInfo info;
-  auto s = page->SetRow(log.row, log.write_ts, opts, &info);
-  CHECK(s.ok());
-
-  AddPrepare_(log.txn_id);
+  AddPrepare_(log.txn_id, log.page_id, log.row.GetSortKeys());
 }
 
 void OccRecovery::BwTreeDeleteRow_(const std::string_view &data) noexcept {
   auto log = wal::DeserializeDeleteRowLog(data);
 
-  auto page = GetPage_(buffer_pool_, log.page_id);
-
-  Options opts;
-  btree::WriteInfo info;
-  auto s = page->DeleteRow(log.sort_key, log.write_ts, opts, &info);
-  CHECK(s.ok());
+  ApplyBwTree_(log.page_id, [&](auto *page) {
+    Options opts;
+    btree::WriteInfo info;
+    auto s = page->DeleteRow(log.sort_key, log.write_ts, opts, &info);
+    CHECK(s.ok());
+  });
 
-  AddPrepare_(log.txn_id);
+  AddPrepare_(log.txn_id, log.page_id, log.sort_key);
 }
 
 void OccRecovery::BwTreeSetTs_(const std::string_view &data) noexcept {
   auto log = wal::DeserializeSetTsLog(data);
 
-  auto page = GetPage_(buffer_pool_, log.page_id);
-
   Options opts;
-  btree::WriteInfo info;
-  page->SetTs(log.sort_key, log.commit_ts, opts, &info);
+  auto it = txn_map_.find(log.txn_id);
+  CHECK(it != txn_map_.end());
+  opts.owner_ts = it->second.begin_ts;
+  ApplyBwTree_(log.page_id, [&](auto *page) {
+    btree::WriteInfo info;
+    page->SetTs(log.sort_key, log.commit_ts, opts, &info);
+  });
 
-  AddCommit_(log.txn_id);
+  AddCommit_(log.txn_id, log.page_id, log.sort_key);
+}
+
+void OccRecovery::BtreeSmo_(const std::string_view &data) noexcept {
+  auto log = wal::DeserializeBtreeSmoLog(data);
+  btree::VersionedBtree::ReplaySmo(buffer_pool_, log);
+}
+
+void OccRecovery::PackedPromote_(const std::string_view &data) noexcept {
+  auto log = wal::DeserializePackedPromoteLog(data);
+  btree::SubTable::ReplayPromote(buffer_pool_, log);
 }
 
 void OccRecovery::OccBegin_(const std::string_view &data) noexcept {
   auto log = wal::DeserializeBeginLog(data);
   auto it = txn_map_.find(log.txn_id);
   CHECK(it == txn_map_.end());
-  txn_map_.emplace(log.txn_id, 0);
+  txn_map_.emplace(log.txn_id,
+                   TxnEntry{.cnt = 0, .begin_ts = log.begin_ts});
 }
 
 void OccRecovery::OccAbort_(const std::string_view &data) noexcept {
@@ -131,19 +211,49 @@ void OccRecovery::OccCommit_(const std::string_view &data) noexcept {
   auto log = wal::DeserializeCommitLog(data);
   auto it = txn_map_.find(log.txn_id);
   CHECK(it != txn_map_.end());
+  if (it->second.cnt != 0) {
+    // intents become visible before they are finalized.
+    TxnStatusTable::GetInstance()->Commit(it->second.begin_ts, log.commit_ts);
+    it->second.commit_ts = log.commit_ts;
+  }
+}
+
+std::string_view OccRecovery::GetTableKey_(std::string_view page_id,
+                                          bool *packed) noexcept {
+  std::string_view packed_page_id;
+  std::string_view table_key;
+  *packed =
+      btree::PackedPage::ParseLeafId(page_id, &packed_page_id, &table_key);
+  if (*packed) {
+    return table_key;
+  }
+  // page id of splitted pages is root page key followed by '@'.
+  return page_id.substr(0, page_id.find('@'));
 }
 
-void OccRecovery::AddPrepare_(TxnId txn_id) noexcept {
+void OccRecovery::AddPrepare_(TxnId txn_id, std::string_view page_id,
+                              property::SortKeysRef sort_key) noexcept {
   auto it = txn_map_.find(txn_id);
   CHECK(it != txn_map_.end());
-  it->second += 1;
+  bool packed = false;
+  auto table_key = GetTableKey_(page_id, &packed);
+  it->second.packed |= packed;
+  it->second.intents.emplace(std::string(table_key),
+                             std::string(sort_key.as_slice()));
+  it->second.cnt += 1;
 }
 
-void OccRecovery::AddCommit_(TxnId txn_id) noexcept {
+void OccRecovery::AddCommit_(TxnId txn_id, std::string_view page_id,
+                             property::SortKeysRef sort_key) noexcept {
   auto it = txn_map_.find(txn_id);
   CHECK(it != txn_map_.end());
-  it->second -= 1;
-  if (it->second == 0) {
+  bool packed = false;
+  auto table_key = GetTableKey_(page_id, &packed);
+  it->second.intents.erase(
+      {std::string(table_key), std::string(sort_key.as_slice())});
+  it->second.cnt -= 1;
+  if (it->second.cnt == 0) {
+    TxnStatusTable::GetInstance()->Erase(it->second.begin_ts);
     txn_map_.erase(it);
   }
 }
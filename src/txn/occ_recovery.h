@@ -13,6 +13,9 @@
 
 #include "cache/buffer_pool.h"
 #include "log_store/log_store.h"
+#include "property/sort_key/sort_key.h"
+#include <optional>
+#include <set>
 
 namespace arcanedb {
 namespace txn {
@@ -29,17 +32,56 @@ private:
   void BwTreeSetRow_(const std::string_view &data) noexcept;
   void BwTreeDeleteRow_(const std::string_view &data) noexcept;
   void BwTreeSetTs_(const std::string_view &data) noexcept;
+  void BtreeSmo_(const std::string_view &data) noexcept;
+  void PackedPromote_(const std::string_view &data) noexcept;
   void OccBegin_(const std::string_view &data) noexcept;
   void OccAbort_(const std::string_view &data) noexcept;
   void OccCommit_(const std::string_view &data) noexcept;
 
-  void AddPrepare_(TxnId txn_id) noexcept;
-  void AddCommit_(TxnId txn_id) noexcept;
+  /**
+   * @brief
+   * Apply bwtree log on page_id, which might be a leaf of packed page.
+   * @param page_id
+   * @param func apply log on VersionedBtreePage or VersionedBwTreePage.
+   */
+  template <typename Func>
+  void ApplyBwTree_(std::string_view page_id, Func &&func) noexcept;
+
+  /**
+   * @brief
+   * Finalize intents of txns which commit but haven't finished set ts before
+   * crash, and erase them from txn status table.
+   */
+  void Finalize_() noexcept;
+
+  /**
+   * @brief
+   * Get the table key of page_id, which might be a leaf of packed page.
+   */
+  static std::string_view GetTableKey_(std::string_view page_id,
+                                       bool *packed) noexcept;
+
+  void AddPrepare_(TxnId txn_id, std::string_view page_id,
+                   property::SortKeysRef sort_key) noexcept;
+  void AddCommit_(TxnId txn_id, std::string_view page_id,
+                  property::SortKeysRef sort_key) noexcept;
 
   cache::BufferPool *buffer_pool_{};
   log_store::LogReader *log_reader_{};
 
-  std::unordered_map<TxnId, uint32_t> txn_map_;
+  struct TxnEntry {
+    // number of intents that haven't been finalized.
+    uint32_t cnt{0};
+    TxnTs begin_ts{};
+    // set once commit log is replayed while some intents are pending.
+    std::optional<TxnTs> commit_ts;
+    // whether any intent is written in packed pages.
+    bool packed{false};
+    // pending intents, i.e. (table key, sort key).
+    std::set<std::pair<std::string, std::string>> intents;
+  };
+
+  std::unordered_map<TxnId, TxnEntry> txn_map_;
 };
 
 } // namespace txn
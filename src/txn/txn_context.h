@@ -91,6 +91,19 @@ public:
   virtual btree::RowIterator GetRowIterator(const std::string &sub_table_key,
                                             const Options &opts) noexcept = 0;
 
+  /**
+   * @brief
+   * Ordered range scan which produces rows lazily.
+   * cursor must not outlive the txn.
+   * @param sub_table_key
+   * @param opts
+   * @param filter
+   * @return ScanCursor
+   */
+  virtual btree::ScanCursor GetScanCursor(const std::string &sub_table_key,
+                                          const Options &opts,
+                                          const Filter &filter) noexcept = 0;
+
   /**
    * @brief
    * Commit or abort current txn.
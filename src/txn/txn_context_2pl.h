@@ -97,6 +97,12 @@ public:
     NOTIMPLEMENTED();
   }
 
+  btree::ScanCursor GetScanCursor(const std::string &sub_table_key,
+                                  const Options &opts,
+                                  const Filter &filter) noexcept override {
+    NOTIMPLEMENTED();
+  }
+
 private:
   btree::SubTable *GetSubTable_(const std::string &sub_table_key,
                                 const Options &opts) noexcept;
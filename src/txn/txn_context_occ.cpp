@@ -14,15 +14,23 @@
 #include "bthread/bthread.h"
 #include "btree/write_info.h"
 #include "txn/txn_manager_occ.h"
+#include "txn/txn_status_table.h"
 #include "txn_type.h"
 #include "util/monitor.h"
 #include "util/port.h"
+#include "util/wait_table.h"
 #include "wal/occ_log_writer.h"
 #include <optional>
 
 namespace arcanedb {
 namespace txn {
 
+TxnContextOCC::~TxnContextOCC() noexcept {
+  for (auto &[_, table] : tables_) {
+    btree::SubTable::CloseSubTable(buffer_pool_, std::move(table));
+  }
+}
+
 Status TxnContextOCC::SetRow(const std::string &sub_table_key,
                              const property::Row &row,
                              const Options &opts) noexcept {
@@ -96,7 +104,7 @@ void TxnContextOCC::RangeFilter(const std::string &sub_table_key,
     UNREACHABLE();
   }
   auto sub_table = GetSubTable_(sub_table_key, opts);
-  sub_table->RangeFilter(opts, filter, scan_opts, rows_view);
+  sub_table->RangeFilter(opts, filter, read_ts_, scan_opts, rows_view);
 }
 
 btree::RowIterator
@@ -106,7 +114,17 @@ TxnContextOCC::GetRowIterator(const std::string &sub_table_key,
     UNREACHABLE();
   }
   auto sub_table = GetSubTable_(sub_table_key, opts);
-  return sub_table->GetRowIterator();
+  return sub_table->GetRowIterator(opts);
+}
+
+btree::ScanCursor TxnContextOCC::GetScanCursor(const std::string &sub_table_key,
+                                               const Options &opts,
+                                               const Filter &filter) noexcept {
+  if (txn_type_ != TxnType::ReadOnlyTxn) {
+    UNREACHABLE();
+  }
+  auto sub_table = GetSubTable_(sub_table_key, opts);
+  return sub_table->GetScanCursor(opts, filter, read_ts_);
 }
 
 Status TxnContextOCC::CommitOrAbort(const Options &opts) noexcept {
@@ -147,7 +165,12 @@ Status TxnContextOCC::CommitOrAbort(const Options &opts) noexcept {
   }
 
   Commit_(commit_opts.log_store);
-  CommitIntents_(commit_opts);
+  if (!write_set_.empty()) {
+    CommitInStatusTable_(commit_opts);
+  }
+  // writers waiting for our locks append their commit logs after ours, so
+  // locks could be released before our commit log is persisted.
+  std::move(defer).Invoke();
 
   // wait for persistent
   if (commit_opts.log_store != nullptr && commit_opts.sync_commit) {
@@ -159,6 +182,36 @@ Status TxnContextOCC::CommitOrAbort(const Options &opts) noexcept {
   return Status::Commit();
 }
 
+void TxnContextOCC::CommitInStatusTable_(const Options &opts) noexcept {
+  auto *status_table = TxnStatusTable::GetInstance();
+  if (lock_manager_type_ == LockManagerType::kInlined) {
+    // intents are the locks themselves, finalize them before returning.
+    status_table->Commit(read_ts_, commit_ts_);
+    NotifyIntentWaiters_();
+    CommitIntents_(opts);
+    status_table->Erase(read_ts_);
+    return;
+  }
+  // intents become visible at commit ts from now on, and are written back by
+  // flush or by the writers overwriting them, the entry is erased after
+  // that.
+  status_table->Commit(read_ts_, commit_ts_, write_set_.size());
+  NotifyIntentWaiters_();
+  // pages might have been flushed with our intents before commit, flush
+  // them again so that the intents are written back.
+  for (const auto &[page_key, page] : intent_pages_) {
+    page->MarkDirty(log_store::kInvalidLsn);
+    opts.buffer_pool->TryInsertDirtyPage(page);
+  }
+}
+
+void TxnContextOCC::NotifyIntentWaiters_() noexcept {
+  // readers parked on our intents could read them as committed now.
+  for (auto wait_hash : wait_hashes_) {
+    util::WaitTable::GetInstance()->NotifyAll(wait_hash);
+  }
+}
+
 void TxnContextOCC::WaitForCommit_(log_store::LogStore *log_store) noexcept {
   util::Timer timer;
 
@@ -198,12 +251,15 @@ Status TxnContextOCC::WriteIntents_(const Options &opts) noexcept {
   std::vector<std::pair<std::string_view, property::SortKeysRef>> undo_list;
   for (const auto &[k, v] : write_set_) {
     btree::WriteInfo info;
+    cache::BufferPool::PageHolder page;
     auto sub_table = GetSubTable_(k.first, opts);
     Status s;
     if (v.has_value()) {
-      s = sub_table->SetRow(v.value(), MarkLocked(read_ts_), opts, &info);
+      s = sub_table->SetRow(v.value(), MarkLocked(read_ts_), opts, &info,
+                            &page);
     } else {
-      s = sub_table->DeleteRow(k.second, MarkLocked(read_ts_), opts, &info);
+      s = sub_table->DeleteRow(k.second, MarkLocked(read_ts_), opts, &info,
+                               &page);
     }
     // update lsn
     lsn_ = std::max(lsn_, info.lsn);
@@ -213,6 +269,12 @@ Status TxnContextOCC::WriteIntents_(const Options &opts) noexcept {
       return s;
     }
     undo_list.push_back({k.first, k.second});
+    wait_hashes_.insert(info.wait_hash);
+    if (lock_manager_type_ != LockManagerType::kInlined) {
+      // page key is owned by the page, which is pinned by holder.
+      auto page_key = page->GetPageKey();
+      intent_pages_.try_emplace(page_key, std::move(page));
+    }
   }
   return Status::Ok();
 }
@@ -337,6 +399,7 @@ TxnContextOCC::GetSubTable_(const std::string_view &sub_table_key,
   std::unique_ptr<btree::SubTable> table;
   auto s = btree::SubTable::OpenSubTable(sub_table_key, opts, &table);
   CHECK(s.ok());
+  buffer_pool_ = opts.buffer_pool;
   auto [new_it, succeed] =
       tables_.emplace(table->GetTableKey(), std::move(table));
   CHECK(succeed);
@@ -13,6 +13,7 @@
 
 #include "btree/sub_table.h"
 #include "common/lock_table.h"
+#include "txn/low_watermark.h"
 #include "txn/txn_context.h"
 
 namespace arcanedb {
@@ -29,12 +30,14 @@ public:
   TxnContextOCC(const Options &opts, TxnId txn_id, TxnTs txn_ts,
                 TxnType txn_type, common::ShardedLockTable *lock_table,
                 const TxnManagerOCC *txn_manager,
-                LockManagerType lock_manager_type) noexcept
+                LockManagerType lock_manager_type,
+                LowWatermark::Pin snapshot_pin = {}) noexcept
       : txn_id_(txn_id), read_ts_(txn_ts), txn_type_(txn_type),
         lock_table_(lock_table), txn_manager_(txn_manager),
-        lock_manager_type_(lock_manager_type) {}
+        lock_manager_type_(lock_manager_type),
+        snapshot_pin_(std::move(snapshot_pin)) {}
 
-  ~TxnContextOCC() noexcept override = default;
+  ~TxnContextOCC() noexcept override;
 
   /**
    * @brief
@@ -93,6 +96,10 @@ public:
   btree::RowIterator GetRowIterator(const std::string &sub_table_key,
                                     const Options &opts) noexcept override;
 
+  btree::ScanCursor GetScanCursor(const std::string &sub_table_key,
+                                  const Options &opts,
+                                  const Filter &filter) noexcept override;
+
 private:
   btree::SubTable *GetSubTable_(const std::string_view &sub_table_key,
                                 const Options &opts) noexcept;
@@ -106,6 +113,17 @@ private:
 
   void CommitIntents_(const Options &opts) noexcept;
 
+  /**
+   * @brief
+   * Make intents visible at commit ts through txn status table. commit ts is
+   * written back lazily, except for inlined locks, which are released by
+   * writing back the intents.
+   * @param opts
+   */
+  void CommitInStatusTable_(const Options &opts) noexcept;
+
+  void NotifyIntentWaiters_() noexcept;
+
   void AbortIntents_(const Options &opts) noexcept;
 
   void ReleaseLock_(const Options &opts) noexcept;
@@ -151,6 +169,9 @@ private:
   TxnType txn_type_;
   common::ShardedLockTable *lock_table_;
   const TxnManagerOCC *txn_manager_;
+  // buffer pool which subtables are opened from, they are handed back once
+  // txn is done.
+  cache::BufferPool *buffer_pool_{};
   absl::flat_hash_set<std::string> lock_set_;
   absl::flat_hash_map<std::string_view, std::unique_ptr<btree::SubTable>>
       tables_;
@@ -163,10 +184,17 @@ private:
                       std::optional<TxnTs>, ReadSetHash>
       read_set_;
   absl::flat_hash_set<std::unique_ptr<std::string>> row_owners_;
+  // wait table slots of the pages our intents are written to.
+  absl::flat_hash_set<size_t> wait_hashes_;
+  // pages our intents are written to, keyed by page key.
+  absl::flat_hash_map<std::string_view, cache::BufferPool::PageHolder>
+      intent_pages_;
 
   LockManagerType lock_manager_type_;
 
   log_store::LsnType lsn_{};
+  // prevent versions visible to read_ts_ from being collected.
+  LowWatermark::Pin snapshot_pin_;
 };
 
 } // namespace txn
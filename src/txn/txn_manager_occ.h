@@ -13,6 +13,7 @@
 
 #include "common/config.h"
 #include "common/lock_table.h"
+#include "txn/low_watermark.h"
 #include "txn/snapshot_manager.h"
 #include "txn/tso.h"
 #include "txn/txn_context_occ.h"
@@ -26,34 +27,53 @@ class TxnManagerOCC : public TxnManager {
 public:
   TxnManagerOCC(LockManagerType type) noexcept
       : snapshot_manager_{}, lock_table_(common::Config::kLockTableShardNum),
-        lock_manager_type_(type) {}
+        lock_manager_type_(type) {
+    watermark_source_id_ = LowWatermark::GetInstance()->AddSource(
+        [this]() { return snapshot_manager_.GetSnapshotTs(); });
+  }
+
+  ~TxnManagerOCC() noexcept override {
+    LowWatermark::GetInstance()->RemoveSource(watermark_source_id_);
+  }
 
   std::unique_ptr<TxnContext> BeginRoTxn(const Options &opts) const
       noexcept override {
     auto txn_id = util::GenerateUUID();
-    auto read_ts = snapshot_manager_.GetSnapshotTs();
-    return std::make_unique<TxnContextOCC>(opts, txn_id, read_ts,
-                                           TxnType::ReadOnlyTxn, &lock_table_,
-                                           this, lock_manager_type_);
+    LowWatermark::Pin pin;
+    auto read_ts = LowWatermark::GetInstance()->AcquireAndPin(
+        [this]() { return snapshot_manager_.GetSnapshotTs(); }, &pin);
+    return std::make_unique<TxnContextOCC>(
+        opts, txn_id, read_ts, TxnType::ReadOnlyTxn, &lock_table_, this,
+        lock_manager_type_, std::move(pin));
   }
 
+  /**
+   * @brief
+   * Begin read-only txn with specified ts.
+   * versions visible to ts might have been collected if ts is smaller than
+   * the current snapshot ts.
+   */
   std::unique_ptr<TxnContext> BeginRoTxnWithTs(const Options &opts,
                                                TxnTs ts) const noexcept {
     auto txn_id = util::GenerateUUID();
-    return std::make_unique<TxnContextOCC>(opts, txn_id, ts,
-                                           TxnType::ReadOnlyTxn, &lock_table_,
-                                           this, lock_manager_type_);
+    LowWatermark::Pin pin;
+    LowWatermark::GetInstance()->AcquireAndPin([ts]() { return ts; }, &pin);
+    return std::make_unique<TxnContextOCC>(
+        opts, txn_id, ts, TxnType::ReadOnlyTxn, &lock_table_, this,
+        lock_manager_type_, std::move(pin));
   }
 
   std::unique_ptr<TxnContext> BeginRwTxn(const Options &opts) const
       noexcept override {
     auto txn_id = util::GenerateUUID();
-    auto read_ts = tso_.RequestTs();
+    LowWatermark::Pin pin;
+    auto read_ts = LowWatermark::GetInstance()->AcquireAndPin(
+        [this]() { return tso_.RequestTs(); }, &pin);
     // commit this read ts immediately.
     snapshot_manager_.CommitTs(read_ts);
-    return std::make_unique<TxnContextOCC>(opts, txn_id, read_ts,
-                                           TxnType::ReadWriteTxn, &lock_table_,
-                                           this, lock_manager_type_);
+    return std::make_unique<TxnContextOCC>(
+        opts, txn_id, read_ts, TxnType::ReadWriteTxn, &lock_table_, this,
+        lock_manager_type_, std::move(pin));
   }
 
   TxnTs RequestTs() const noexcept { return tso_.RequestTs(); }
@@ -71,6 +91,7 @@ private:
   mutable common::ShardedLockTable lock_table_;
   mutable Tso tso_;
   const LockManagerType lock_manager_type_;
+  uint64_t watermark_source_id_{};
 };
 
 } // namespace txn
@@ -0,0 +1,73 @@
+/**
+ * @file txn_status_table.cpp
+ * @author sheep (ysj1173886760@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "txn/txn_status_table.h"
+#include "util/epoch.h"
+
+namespace arcanedb {
+namespace txn {
+
+void TxnStatusTable::Commit(TxnTs owner_ts, TxnTs commit_ts,
+                            size_t intent_cnt) noexcept {
+  auto &shard = GetShard_(owner_ts);
+  absl::base_internal::SpinLockHolder guard(&shard.lock);
+  shard.map[owner_ts] = Entry{.commit_ts = commit_ts, .pending = intent_cnt};
+}
+
+void TxnStatusTable::WriteBack(TxnTs owner_ts) noexcept {
+  auto &shard = GetShard_(owner_ts);
+  {
+    absl::base_internal::SpinLockHolder guard(&shard.lock);
+    auto it = shard.map.find(owner_ts);
+    // untracked entry is erased by its owner.
+    if (it == shard.map.end() || it->second.pending == 0 ||
+        --it->second.pending != 0) {
+      return;
+    }
+  }
+  // readers might have loaded an intent before it's written back and are
+  // about to resolve it. reclamation might erase inline, so retire outside
+  // of the shard lock.
+  util::EpochManager::GetInstance()->Retire(std::shared_ptr<const void>(
+      this, [owner_ts](const void *table) {
+        const_cast<TxnStatusTable *>(static_cast<const TxnStatusTable *>(table))
+            ->Erase(owner_ts);
+      }));
+}
+
+void TxnStatusTable::Erase(TxnTs owner_ts) noexcept {
+  auto &shard = GetShard_(owner_ts);
+  absl::base_internal::SpinLockHolder guard(&shard.lock);
+  shard.map.erase(owner_ts);
+}
+
+TxnTs TxnStatusTable::ResolveIntent_(TxnTs write_ts) const noexcept {
+  auto owner_ts = GetTs(write_ts);
+  const auto &shard = GetShard_(owner_ts);
+  absl::base_internal::SpinLockHolder guard(&shard.lock);
+  auto it = shard.map.find(owner_ts);
+  if (it == shard.map.end()) {
+    return write_ts;
+  }
+  return it->second.commit_ts;
+}
+
+size_t TxnStatusTable::TEST_Size() const noexcept {
+  size_t size = 0;
+  for (const auto &shard : shards_) {
+    absl::base_internal::SpinLockHolder guard(&shard.lock);
+    size += shard.map.size();
+  }
+  return size;
+}
+
+} // namespace txn
+} // namespace arcanedb
@@ -0,0 +1,119 @@
+/**
+ * @file txn_status_table.h
+ * @author sheep (ysj1173886760@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#pragma once
+
+#include "absl/base/internal/spinlock.h"
+#include "absl/container/flat_hash_map.h"
+#include "butil/macros.h"
+#include "common/config.h"
+#include "common/defines.h"
+#include "common/macros.h"
+#include "common/type.h"
+
+namespace arcanedb {
+namespace txn {
+
+/**
+ * @brief
+ * In-memory status of committed txns whose intents haven't been finalized.
+ * Intents are marked with the read ts of their owner, so committing a txn
+ * only needs to record owner -> commit ts here. Readers resolve intents
+ * through this table, and the commit ts is written back to the intents
+ * lazily, i.e. by flush or by the writer overwriting the intent. Entry of
+ * txn counts the intents that haven't been written back, and is erased once
+ * the count drops to zero.
+ * Txns that are absent in this table are still running, their intents
+ * remain locked.
+ * Readers might be holding epoch guard, so the table is protected by spin
+ * lock instead of bthread mutex.
+ */
+class TxnStatusTable {
+public:
+  static TxnStatusTable *GetInstance() noexcept {
+    static TxnStatusTable table;
+    return &table;
+  }
+
+  /**
+   * @brief
+   * Make intents of txn visible at commit_ts.
+   * @param owner_ts read ts of the txn, which is stored in its intents.
+   * @param commit_ts
+   * @param intent_cnt number of intents to be written back by WriteBack.
+   * 0 indicates entry is erased by the caller instead.
+   */
+  void Commit(TxnTs owner_ts, TxnTs commit_ts, size_t intent_cnt = 0) noexcept;
+
+  /**
+   * @brief
+   * One intent of txn has been written back in place. entry is erased after
+   * all intents have been written back, once readers that might have loaded
+   * the intents before are gone.
+   * @param owner_ts
+   */
+  void WriteBack(TxnTs owner_ts) noexcept;
+
+  /**
+   * @brief
+   * Erase txn once all of its intents have been finalized.
+   * @param owner_ts
+   */
+  void Erase(TxnTs owner_ts) noexcept;
+
+  /**
+   * @brief
+   * Resolve the write ts of a version.
+   * @param write_ts
+   * @return TxnTs commit ts if write_ts is an intent of committed txn,
+   * otherwise write_ts itself.
+   */
+  TxnTs Resolve(TxnTs write_ts) const noexcept {
+    if (likely(!IsLocked(write_ts))) {
+      return write_ts;
+    }
+    return ResolveIntent_(write_ts);
+  }
+
+  size_t TEST_Size() const noexcept;
+
+  DISALLOW_COPY_AND_ASSIGN(TxnStatusTable);
+
+private:
+  TxnStatusTable() = default;
+
+  TxnTs ResolveIntent_(TxnTs write_ts) const noexcept;
+
+  struct Entry {
+    TxnTs commit_ts;
+    // intents that haven't been written back, 0 if untracked.
+    size_t pending;
+  };
+
+  struct alignas(ARCANEDB_CACHE_LINE_SIZE) Shard {
+    mutable absl::base_internal::SpinLock lock;
+    // owner ts -> entry
+    absl::flat_hash_map<TxnTs, Entry> map;
+  };
+
+  Shard &GetShard_(TxnTs owner_ts) noexcept {
+    return shards_[owner_ts % common::Config::kTxnStatusTableShardNum];
+  }
+
+  const Shard &GetShard_(TxnTs owner_ts) const noexcept {
+    return shards_[owner_ts % common::Config::kTxnStatusTableShardNum];
+  }
+
+  Shard shards_[common::Config::kTxnStatusTableShardNum];
+};
+
+} // namespace txn
+} // namespace arcanedb
@@ -0,0 +1,126 @@
+/**
+ * @file bloom_filter.h
+ * @author sheep (ysj1173886760@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#pragma once
+
+#include "absl/hash/hash.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+namespace arcanedb {
+namespace util {
+
+/**
+ * @brief
+ * In-memory bloom filter with double hashing.
+ * hash value is not stable across processes, so it should never be persisted,
+ * unless keys are added by hashes which are stable, see AddHash.
+ */
+class BloomFilter {
+public:
+  BloomFilter() = default;
+
+  /**
+   * @brief
+   * @param key_num expected number of keys.
+   * @param bits_per_key ~1% false positive rate when bits_per_key is 10.
+   */
+  BloomFilter(size_t key_num, size_t bits_per_key) noexcept {
+    // k = ln(2) * bits_per_key
+    probe_num_ = std::clamp<size_t>(bits_per_key * 69 / 100, 1, 30);
+    size_t bits = std::max<size_t>(key_num * bits_per_key, 64);
+    bits_.resize((bits + 63) / 64);
+  }
+
+  bool empty() const noexcept { return bits_.empty(); }
+
+  void Add(std::string_view key) noexcept {
+    AddHash(absl::Hash<std::string_view>()(key));
+  }
+
+  /**
+   * @brief
+   * Add key by hash given by caller.
+   * @param hash low 32 bits and high 32 bits are used as two hashes.
+   */
+  void AddHash(uint64_t hash) noexcept {
+    uint32_t h = static_cast<uint32_t>(hash);
+    uint32_t delta = static_cast<uint32_t>(hash >> 32) | 1;
+    size_t bit_num = bits_.size() * 64;
+    for (size_t i = 0; i < probe_num_; i++) {
+      size_t pos = h % bit_num;
+      bits_[pos / 64] |= (1ull << (pos % 64));
+      h += delta;
+    }
+  }
+
+  /**
+   * @brief
+   * Empty filter contains everything.
+   * @param key
+   * @return false when key is definitely absent.
+   */
+  bool MayContain(std::string_view key) const noexcept {
+    return MayContainHash(absl::Hash<std::string_view>()(key));
+  }
+
+  bool MayContainHash(uint64_t hash) const noexcept {
+    if (bits_.empty()) {
+      return true;
+    }
+    uint32_t h = static_cast<uint32_t>(hash);
+    uint32_t delta = static_cast<uint32_t>(hash >> 32) | 1;
+    size_t bit_num = bits_.size() * 64;
+    for (size_t i = 0; i < probe_num_; i++) {
+      size_t pos = h % bit_num;
+      if ((bits_[pos / 64] & (1ull << (pos % 64))) == 0) {
+        return false;
+      }
+      h += delta;
+    }
+    return true;
+  }
+
+  size_t GetCharge() const noexcept { return bits_.capacity() * 8; }
+
+  /**
+   * @brief
+   * Raw bits of filter, which could be persisted if keys are added by stable
+   * hashes.
+   */
+  std::string_view GetData() const noexcept {
+    return {reinterpret_cast<const char *>(bits_.data()), bits_.size() * 8};
+  }
+
+  /**
+   * @brief
+   * Restore bits from GetData of a filter built with the same parameters.
+   * @param data
+   * @return false if size of data doesn't match.
+   */
+  bool SetData(std::string_view data) noexcept {
+    if (data.size() != bits_.size() * 8) {
+      return false;
+    }
+    memcpy(bits_.data(), data.data(), data.size());
+    return true;
+  }
+
+private:
+  std::vector<uint64_t> bits_;
+  size_t probe_num_{0};
+};
+
+} // namespace util
+} // namespace arcanedb
@@ -129,7 +129,7 @@ public:
   template <typename T> void WriteBytesAtPos(size_t pos, T val) noexcept {
     static_assert(std::is_pod_v<T>, "expect POD");
     auto size = sizeof(T);
-    CHECK(pos + size < write_offset_);
+    CHECK(pos + size <= write_offset_);
     memcpy(&buffer_[pos], &val, size);
   }
 
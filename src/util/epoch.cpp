@@ -0,0 +1,140 @@
+/**
+ * @file epoch.cpp
+ * @author sheep (ysj1173886760@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-15
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "util/epoch.h"
+#include "common/logger.h"
+#include "common/macros.h"
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+namespace arcanedb {
+namespace util {
+
+EpochManager::LocalSlot::~LocalSlot() noexcept {
+  if (index < 0) {
+    return;
+  }
+  auto &slot = EpochManager::GetInstance()->slots_[index];
+  slot.epoch.store(kIdleEpoch, std::memory_order_release);
+  slot.in_use.store(false, std::memory_order_release);
+}
+
+EpochManager::LocalSlot *EpochManager::GetLocalSlot_() noexcept {
+  static thread_local LocalSlot local;
+  if (likely(local.index >= 0)) {
+    return &local;
+  }
+  for (size_t i = 0; i < common::Config::kEpochMaxSlotNum; i++) {
+    bool in_use = false;
+    if (slots_[i].in_use.compare_exchange_strong(in_use, true)) {
+      local.index = static_cast<int32_t>(i);
+      auto hwm = slot_high_watermark_.load(std::memory_order_relaxed);
+      while (hwm < i + 1 && !slot_high_watermark_.compare_exchange_weak(
+                                hwm, i + 1, std::memory_order_relaxed)) {
+      }
+      return &local;
+    }
+  }
+  FATAL("Epoch slots exhausted, max slot num {}",
+        common::Config::kEpochMaxSlotNum);
+  UNREACHABLE();
+}
+
+void EpochManager::Enter_() noexcept {
+  auto *local = GetLocalSlot_();
+  if (local->depth++ != 0) {
+    return;
+  }
+  auto &slot = slots_[local->index];
+  slot.epoch.store(global_epoch_.load(std::memory_order_relaxed),
+                   std::memory_order_relaxed);
+  // announcement must be visible before we read any shared pointer.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+void EpochManager::Exit_() noexcept {
+  auto *local = GetLocalSlot_();
+  assert(local->depth > 0);
+  if (--local->depth != 0) {
+    return;
+  }
+  slots_[local->index].epoch.store(kIdleEpoch, std::memory_order_release);
+}
+
+uint64_t EpochManager::GetMinActiveEpoch_() noexcept {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  uint64_t min_epoch = kIdleEpoch;
+  auto hwm = slot_high_watermark_.load(std::memory_order_acquire);
+  for (size_t i = 0; i < hwm; i++) {
+    min_epoch =
+        std::min(min_epoch, slots_[i].epoch.load(std::memory_order_acquire));
+  }
+  return min_epoch;
+}
+
+void EpochManager::Retire(std::shared_ptr<const void> ptr) noexcept {
+  if (ptr == nullptr) {
+    return;
+  }
+  // readers entered after the increment won't see ptr, since ptr is unlinked
+  // before retiring.
+  auto epoch = global_epoch_.fetch_add(1, std::memory_order_seq_cst);
+  auto *local = GetLocalSlot_();
+  auto &shard = shards_[local->index % common::Config::kEpochRetireShardNum];
+  bool should_reclaim = false;
+  {
+    std::lock_guard<bthread::Mutex> guard(shard.mu);
+    shard.retired.push_back(RetiredPtr{.epoch = epoch, .ptr = std::move(ptr)});
+    should_reclaim =
+        shard.retired.size() % common::Config::kEpochReclaimInterval == 0;
+  }
+  if (should_reclaim) {
+    ReclaimShard_(&shard);
+  }
+}
+
+void EpochManager::ReclaimShard_(RetireShard *shard) noexcept {
+  auto min_epoch = GetMinActiveEpoch_();
+  std::vector<std::shared_ptr<const void>> reclaimed;
+  {
+    std::lock_guard<bthread::Mutex> guard(shard->mu);
+    auto &retired = shard->retired;
+    auto it = std::partition(
+        retired.begin(), retired.end(),
+        [&](const RetiredPtr &entry) { return entry.epoch >= min_epoch; });
+    for (auto iter = it; iter != retired.end(); ++iter) {
+      reclaimed.emplace_back(std::move(iter->ptr));
+    }
+    retired.erase(it, retired.end());
+  }
+  // release the memory outside the lock, since destroying a delta chain might
+  // be expensive.
+  reclaimed.clear();
+}
+
+void EpochManager::TryReclaim() noexcept {
+  for (auto &shard : shards_) {
+    ReclaimShard_(&shard);
+  }
+}
+
+size_t EpochManager::TEST_RetiredCount() noexcept {
+  size_t count = 0;
+  for (auto &shard : shards_) {
+    std::lock_guard<bthread::Mutex> guard(shard.mu);
+    count += shard.retired.size();
+  }
+  return count;
+}
+
+} // namespace util
+} // namespace arcanedb
@@ -0,0 +1,118 @@
+/**
+ * @file epoch.h
+ * @author sheep (ysj1173886760@gmail.com)
+ * @brief epoch based memory reclamation.
+ * @version 0.1
+ * @date 2026-10-15
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#pragma once
+
+#include "bthread/mutex.h"
+#include "butil/macros.h"
+#include "common/config.h"
+#include "common/defines.h"
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+namespace arcanedb {
+namespace util {
+
+/**
+ * @brief
+ * Epoch based reclamation.
+ * Readers announce the global epoch they observed in a per-thread slot before
+ * touching shared data, writers retire the memory they unlinked instead of
+ * freeing it. Retired memory is only dropped when every active reader has
+ * announced an epoch which is newer than the retired one.
+ * Readers never write shared cache line, they only write to their own slot.
+ * !! guard must not be held across a yield point (e.g. bthread_usleep or
+ * bthread::Mutex), since slots are owned by pthread instead of bthread.
+ */
+class EpochManager {
+public:
+  static EpochManager *GetInstance() noexcept {
+    static EpochManager manager;
+    return &manager;
+  }
+
+  class Guard {
+  public:
+    Guard() noexcept : manager_(EpochManager::GetInstance()) {
+      manager_->Enter_();
+    }
+
+    ~Guard() noexcept { manager_->Exit_(); }
+
+    DISALLOW_COPY_AND_ASSIGN(Guard);
+
+  private:
+    EpochManager *manager_;
+  };
+
+  /**
+   * @brief
+   * Retire a pointer that has already been unlinked from shared structure.
+   * The reference will be dropped once no reader could observe it.
+   * @param ptr
+   */
+  void Retire(std::shared_ptr<const void> ptr) noexcept;
+
+  /**
+   * @brief
+   * Drop all retired pointers that are not visible to any reader.
+   */
+  void TryReclaim() noexcept;
+
+  size_t TEST_RetiredCount() noexcept;
+
+private:
+  EpochManager() = default;
+
+  static constexpr uint64_t kIdleEpoch = std::numeric_limits<uint64_t>::max();
+
+  struct alignas(ARCANEDB_CACHE_LINE_SIZE) Slot {
+    std::atomic<uint64_t> epoch{kIdleEpoch};
+    std::atomic<bool> in_use{false};
+  };
+
+  struct RetiredPtr {
+    uint64_t epoch;
+    std::shared_ptr<const void> ptr;
+  };
+
+  struct alignas(ARCANEDB_CACHE_LINE_SIZE) RetireShard {
+    bthread::Mutex mu;
+    std::vector<RetiredPtr> retired; // guarded by mu
+  };
+
+  struct LocalSlot {
+    int32_t index{-1};
+    uint32_t depth{0};
+    ~LocalSlot() noexcept;
+  };
+
+  void Enter_() noexcept;
+
+  void Exit_() noexcept;
+
+  LocalSlot *GetLocalSlot_() noexcept;
+
+  uint64_t GetMinActiveEpoch_() noexcept;
+
+  void ReclaimShard_(RetireShard *shard) noexcept;
+
+  std::atomic<uint64_t> global_epoch_{1};
+  std::atomic<size_t> slot_high_watermark_{0};
+  Slot slots_[common::Config::kEpochMaxSlotNum];
+  RetireShard shards_[common::Config::kEpochRetireShardNum];
+};
+
+} // namespace util
+} // namespace arcanedb
@@ -29,7 +29,11 @@ namespace util {
   ARCANEDB_X(IoLatency)                                                        \
   ARCANEDB_X(WaitCommitLatency)                                                \
   ARCANEDB_X(WritePageCache)                                                   \
-  ARCANEDB_X(Fsync)
+  ARCANEDB_X(Fsync)                                                            \
+  ARCANEDB_X(BwTreeCompactionThreshold)                                        \
+  ARCANEDB_X(BwTreeReadAmplification)                                          \
+  ARCANEDB_X(BwTreeWriteAmplification)                                         \
+  ARCANEDB_X(BwTreeDeltaSkipRate)
 
 class Monitor {
 public:
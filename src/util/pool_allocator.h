@@ -0,0 +1,70 @@
+/**
+ * @file pool_allocator.h
+ * @author sheep (ysj1173886760@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#pragma once
+
+#include "butil/object_pool.h"
+#include <cstddef>
+#include <memory>
+
+namespace arcanedb {
+namespace util {
+
+/**
+ * @brief
+ * Allocator that serves single object allocation from butil object pool.
+ * Object pool keeps thread local slabs of fixed size blocks, so the hot path
+ * neither calls malloc nor touches shared cache line, and blocks carry no
+ * malloc header. Memory is recycled by the pool instead of being returned to
+ * the system.
+ * Mainly used with std::allocate_shared, so that object and control block
+ * live in a single pooled block.
+ * @tparam T
+ */
+template <typename T> class PoolAllocator {
+public:
+  using value_type = T;
+
+  PoolAllocator() noexcept = default;
+
+  template <typename U> PoolAllocator(const PoolAllocator<U> &) noexcept {}
+
+  T *allocate(size_t n) {
+    if (n == 1) {
+      return reinterpret_cast<T *>(butil::get_object<Block>());
+    }
+    return std::allocator<T>().allocate(n);
+  }
+
+  void deallocate(T *ptr, size_t n) noexcept {
+    if (n == 1) {
+      butil::return_object(reinterpret_cast<Block *>(ptr));
+      return;
+    }
+    std::allocator<T>().deallocate(ptr, n);
+  }
+
+  template <typename U> bool operator==(const PoolAllocator<U> &) const {
+    return true;
+  }
+
+  template <typename U> bool operator!=(const PoolAllocator<U> &) const {
+    return false;
+  }
+
+private:
+  struct Block {
+    alignas(T) char data[sizeof(T)];
+  };
+};
+
+} // namespace util
+} // namespace arcanedb
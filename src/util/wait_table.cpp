@@ -0,0 +1,52 @@
+/**
+ * @file wait_table.cpp
+ * @author sheep (ysj1173886760@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "util/wait_table.h"
+#include "bthread/butex.h"
+#include "butil/time.h"
+
+namespace arcanedb {
+namespace util {
+
+WaitTable::WaitTable() noexcept {
+  for (auto &slot : slots_) {
+    slot.butex = reinterpret_cast<std::atomic<int32_t> *>(
+        bthread::butex_create_checked<int32_t>());
+    slot.butex->store(0, std::memory_order_relaxed);
+  }
+}
+
+WaitTable::~WaitTable() noexcept {
+  for (auto &slot : slots_) {
+    bthread::butex_destroy(slot.butex);
+  }
+}
+
+void WaitTable::Wait(size_t hash, int32_t token, int64_t timeout_us) noexcept {
+  auto &slot = GetSlot_(hash);
+  // announce before checking the butex value, pairs with NotifyAll.
+  slot.waiters.fetch_add(1, std::memory_order_seq_cst);
+  auto abstime = butil::microseconds_from_now(timeout_us);
+  bthread::butex_wait(slot.butex, token, &abstime);
+  slot.waiters.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void WaitTable::NotifyAll(size_t hash) noexcept {
+  auto &slot = GetSlot_(hash);
+  slot.butex->fetch_add(1, std::memory_order_seq_cst);
+  // either we observe the waiter, or the waiter observes the new value.
+  if (slot.waiters.load(std::memory_order_seq_cst) > 0) {
+    bthread::butex_wake_all(slot.butex);
+  }
+}
+
+} // namespace util
+} // namespace arcanedb
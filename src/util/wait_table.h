@@ -0,0 +1,87 @@
+/**
+ * @file wait_table.h
+ * @author sheep (ysj1173886760@gmail.com)
+ * @brief butex based wait table.
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#pragma once
+
+#include "butil/macros.h"
+#include "common/config.h"
+#include "common/defines.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace arcanedb {
+namespace util {
+
+/**
+ * @brief
+ * Sharded table of butex, used to park bthreads waiting for an event that is
+ * identified by hash, e.g. resolution of row intents within a page.
+ * Different events might share the same slot, so wake up could be spurious
+ * and waiter should always recheck its condition.
+ * Usage:
+ *   auto token = table->Prepare(hash);
+ *   if (!condition) table->Wait(hash, token, timeout);
+ * token must be taken before checking the condition, so that notification
+ * happened in between won't be lost.
+ */
+class WaitTable {
+public:
+  static WaitTable *GetInstance() noexcept {
+    static WaitTable table;
+    return &table;
+  }
+
+  ~WaitTable() noexcept;
+
+  int32_t Prepare(size_t hash) noexcept {
+    return GetSlot_(hash).butex->load(std::memory_order_seq_cst);
+  }
+
+  /**
+   * @brief
+   * Park until slot is notified after token is taken, or timeout.
+   * @param hash
+   * @param token
+   * @param timeout_us fallback for lost wake up.
+   */
+  void Wait(size_t hash, int32_t token, int64_t timeout_us) noexcept;
+
+  /**
+   * @brief
+   * Wake all waiters of the slot. butex value is always bumped, since a
+   * waiter might have taken its token without announcing itself yet, and
+   * butex is only woken when somebody is waiting. so every call costs one
+   * atomic increment on the shared slot, callers should notify each slot
+   * once per event.
+   * @param hash
+   */
+  void NotifyAll(size_t hash) noexcept;
+
+  DISALLOW_COPY_AND_ASSIGN(WaitTable);
+
+private:
+  WaitTable() noexcept;
+
+  struct alignas(ARCANEDB_CACHE_LINE_SIZE) Slot {
+    std::atomic<int32_t> *butex{};
+    std::atomic<int32_t> waiters{0};
+  };
+
+  Slot &GetSlot_(size_t hash) noexcept {
+    return slots_[hash % common::Config::kWaitTableSlotNum];
+  }
+
+  Slot slots_[common::Config::kWaitTableSlotNum];
+};
+
+} // namespace util
+} // namespace arcanedb
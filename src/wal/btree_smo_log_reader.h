@@ -0,0 +1,83 @@
+/**
+ * @file btree_smo_log_reader.h
+ * @author sheep (ysj1173886760@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#pragma once
+
+#include "common/type.h"
+#include "util/codec/buf_reader.h"
+#include "wal/bwtree_log_reader.h"
+#include "wal/log_type.h"
+#include <string>
+#include <vector>
+
+namespace arcanedb {
+namespace wal {
+
+/**
+ * @brief
+ * Redo log of btree SMO. adjacent children of parent are replaced by new
+ * children, rows of old children are repartitioned into new children by
+ * their lower bounds. when old child is parent itself, parent is the root
+ * page which is overwritten by the new children, i.e. btree grows by one
+ * level.
+ */
+struct BtreeSmoLog {
+  bool is_leaf;
+  std::string_view parent_page_id;
+  std::vector<std::string_view> old_page_ids;
+  // lower bound & page id of new children.
+  std::vector<std::pair<std::string_view, std::string_view>> new_children;
+};
+
+inline BtreeSmoLog
+DeserializeBtreeSmoLog(const std::string_view &data) noexcept {
+  util::BufReader reader(data);
+  BtreeSmoLog log;
+  uint8_t is_leaf;
+  CHECK(reader.ReadBytes(&is_leaf));
+  log.is_leaf = is_leaf != 0;
+  log.parent_page_id = detail::DeserializeString(&reader);
+  uint16_t old_cnt;
+  CHECK(reader.ReadBytes(&old_cnt));
+  for (uint16_t i = 0; i < old_cnt; i++) {
+    log.old_page_ids.push_back(detail::DeserializeString(&reader));
+  }
+  uint16_t new_cnt;
+  CHECK(reader.ReadBytes(&new_cnt));
+  for (uint16_t i = 0; i < new_cnt; i++) {
+    auto lower = detail::DeserializeString(&reader);
+    auto page_id = detail::DeserializeString(&reader);
+    log.new_children.emplace_back(lower, page_id);
+  }
+  return log;
+}
+
+/**
+ * @brief
+ * Redo log of promoting packed subtable to its own page, rows of the packed
+ * leaf are moved to the page whose id is table key.
+ */
+struct PackedPromoteLog {
+  std::string_view packed_page_id;
+  std::string_view table_key;
+};
+
+inline PackedPromoteLog
+DeserializePackedPromoteLog(const std::string_view &data) noexcept {
+  util::BufReader reader(data);
+  PackedPromoteLog log;
+  log.packed_page_id = detail::DeserializeString(&reader);
+  log.table_key = detail::DeserializeString(&reader);
+  return log;
+}
+
+} // namespace wal
+} // namespace arcanedb
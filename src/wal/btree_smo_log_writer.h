@@ -0,0 +1,85 @@
+/**
+ * @file btree_smo_log_writer.h
+ * @author sheep (ysj1173886760@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#pragma once
+
+#include "log_store/log_store.h"
+#include "util/codec/buf_writer.h"
+#include "wal/btree_smo_log_reader.h"
+#include "wal/log_type.h"
+
+namespace arcanedb {
+namespace wal {
+
+/**
+ * @brief
+ * Format:
+ * | type 1byte | is_leaf 1byte | parent page id | old count 2byte |
+ * | old page id | ... | new count 2byte | lower bound | page id | ... |
+ *
+ * PageId & SortKey format:
+ * | total length 2 byte | string varlen |
+ *
+ * unlike other log writers, SMO log is not bounded by a small block, since
+ * it carries the sort keys of new children.
+ */
+class BtreeSmoLogWriter {
+public:
+  void Smo(const BtreeSmoLog &log) noexcept {
+    DCHECK(container_.empty());
+    writer_.WriteBytes(LogType::kBtreeSmo);
+    writer_.WriteBytes(static_cast<uint8_t>(log.is_leaf));
+    SerializeString_(log.parent_page_id);
+    writer_.WriteBytes(static_cast<uint16_t>(log.old_page_ids.size()));
+    for (const auto &page_id : log.old_page_ids) {
+      SerializeString_(page_id);
+    }
+    writer_.WriteBytes(static_cast<uint16_t>(log.new_children.size()));
+    for (const auto &[lower, page_id] : log.new_children) {
+      SerializeString_(lower);
+      SerializeString_(page_id);
+    }
+    buffer_ = writer_.Detach();
+    container_.push_back(buffer_);
+  }
+
+  /**
+   * @brief
+   * Format:
+   * | type 1byte | packed page id | table key |
+   */
+  void PackedPromote(const PackedPromoteLog &log) noexcept {
+    DCHECK(container_.empty());
+    writer_.WriteBytes(LogType::kPackedPromote);
+    SerializeString_(log.packed_page_id);
+    SerializeString_(log.table_key);
+    buffer_ = writer_.Detach();
+    container_.push_back(buffer_);
+  }
+
+  const log_store::LogStore::LogRecordContainer &GetLogRecords() const
+      noexcept {
+    return container_;
+  }
+
+private:
+  void SerializeString_(const std::string_view &str) noexcept {
+    writer_.WriteBytes(static_cast<uint16_t>(str.size()));
+    writer_.WriteBytes(str);
+  }
+
+  util::BufWriter writer_;
+  std::string buffer_;
+  log_store::LogStore::LogRecordContainer container_;
+};
+
+} // namespace wal
+} // namespace arcanedb
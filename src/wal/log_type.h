@@ -27,6 +27,10 @@ enum class LogType : uint8_t {
   kOccBegin = 3,
   kOccCommit = 4,
   kOccAbort = 5,
+
+  // redo log for btree SMO
+  kBtreeSmo = 6,
+  kPackedPromote = 7,
 };
 
 inline LogType ParseLogRecord(std::string_view *data) noexcept {
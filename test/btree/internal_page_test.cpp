@@ -130,6 +130,82 @@ TEST(InternalPageTest, InternalRowTest) {
   }
 }
 
+TEST(InternalPageTest, ReplaceChildrenTest) {
+  InternalRows rows;
+  Options opts;
+  {
+    std::vector<InternalRow> internal_rows;
+    internal_rows.push_back(
+        InternalRow{.sort_key = property::SortKeys(std::string_view()),
+                    .page_id = "a"});
+    internal_rows.push_back(InternalRow{
+        .sort_key = property::SortKeys({123, 456}), .page_id = "b"});
+    EXPECT_TRUE(
+        rows.Split(opts, property::SortKeysRef(""), std::move(internal_rows))
+            .ok());
+  }
+  {
+    // split b
+    std::vector<InternalRow> internal_rows;
+    internal_rows.push_back(InternalRow{
+        .sort_key = property::SortKeys({123, 456}), .page_id = "b0"});
+    internal_rows.push_back(InternalRow{
+        .sort_key = property::SortKeys({200, 0}), .page_id = "b1"});
+    EXPECT_TRUE(rows.ReplaceChildren(opts, {"b"}, std::move(internal_rows))
+                    .ok());
+    EXPECT_EQ(rows.GetSize(), 3);
+    EXPECT_TRUE(rows.TEST_SortKeyAscending());
+  }
+  {
+    auto sk = property::SortKeys({200, 0});
+    EXPECT_EQ(rows.GetRow(rows.FindChild(sk.as_ref(), false)).page_id, "b1");
+    EXPECT_EQ(rows.GetRow(rows.FindChild(sk.as_ref(), true)).page_id, "b0");
+    EXPECT_EQ(rows.GetRow(rows.FindChild(property::SortKeysRef(""), false))
+                  .page_id,
+              "a");
+    EXPECT_EQ(
+        rows.GetRow(rows.FindChild(property::SortKeysRef(""), true)).page_id,
+        "b1");
+  }
+  {
+    // merge a and b0, lower bound of a is kept
+    std::vector<InternalRow> internal_rows;
+    internal_rows.push_back(InternalRow{
+        .sort_key = property::SortKeys({1, 1}), .page_id = "c"});
+    EXPECT_TRUE(
+        rows.ReplaceChildren(opts, {"a", "b0"}, std::move(internal_rows))
+            .ok());
+    EXPECT_EQ(rows.GetSize(), 2);
+    EXPECT_TRUE(rows.GetRow(0).sort_key.as_slice().empty());
+    EXPECT_EQ(rows.GetRow(0).page_id, "c");
+    // children are not adjacent
+    std::vector<InternalRow> invalid_rows;
+    invalid_rows.push_back(InternalRow{
+        .sort_key = property::SortKeys({1, 1}), .page_id = "d"});
+    EXPECT_TRUE(rows.ReplaceChildren(opts, {"b1", "c"}, std::move(invalid_rows))
+                    .IsNotFound());
+  }
+  {
+    // serialize roundtrip
+    auto image = rows.Serialize(10);
+    EXPECT_TRUE(InternalRows::IsInternalImage(image));
+    std::vector<InternalRow> internal_rows;
+    log_store::LsnType lsn;
+    EXPECT_TRUE(InternalRows::Deserialize(image, &internal_rows, &lsn).ok());
+    EXPECT_EQ(lsn, 10);
+    ASSERT_EQ(internal_rows.size(), rows.GetSize());
+    for (size_t i = 0; i < internal_rows.size(); i++) {
+      EXPECT_EQ(internal_rows[i].sort_key.as_slice(),
+                rows.GetRow(i).sort_key.as_slice());
+      EXPECT_EQ(internal_rows[i].page_id, rows.GetRow(i).page_id);
+    }
+    EXPECT_FALSE(
+        InternalRows::Deserialize(image.substr(0, image.size() - 1),
+                                  &internal_rows, &lsn)
+            .ok());
+  }
+}
+
 TEST(InternalPageTest, ConcurrentTest) {
   InternalPage page;
   Options opts;
@@ -179,5 +179,233 @@ TEST_F(SubTableTest, ConcurrentTest) {
   wg.Wait();
 }
 
+TEST_F(SubTableTest, PackedTest) {
+  opts_.enable_packed_page = true;
+  std::vector<std::string> table_keys;
+  for (int i = 0; i < 10; i++) {
+    table_keys.push_back(table_key_ + std::to_string(i));
+  }
+  auto value_list = GenerateValueList(10);
+  TxnTs ts = 1;
+  for (const auto &table_key : table_keys) {
+    std::unique_ptr<SubTable> sub_table;
+    ASSERT_TRUE(SubTable::OpenSubTable(table_key, opts_, &sub_table).ok());
+    for (const auto &value : value_list) {
+      WriteInfo info;
+      EXPECT_TRUE(WriteHelper(value,
+                              [&](const property::Row &row) {
+                                return sub_table->SetRow(row, ts, opts_,
+                                                         &info);
+                              })
+                      .ok());
+    }
+    EXPECT_TRUE(sub_table->TEST_IsPacked());
+  }
+  for (const auto &table_key : table_keys) {
+    std::unique_ptr<SubTable> sub_table;
+    ASSERT_TRUE(SubTable::OpenSubTable(table_key, opts_, &sub_table).ok());
+    EXPECT_TRUE(sub_table->TEST_IsPacked());
+    for (const auto &value : value_list) {
+      SCOPED_TRACE("");
+      TestRead(sub_table.get(), value, ts, false);
+    }
+    size_t count = 0;
+    for (auto it = sub_table->GetRowIterator(opts_); it.Valid(); it.Next()) {
+      count += 1;
+    }
+    EXPECT_EQ(count, value_list.size());
+  }
+  // subtable that has never been written is empty.
+  std::unique_ptr<SubTable> sub_table;
+  ASSERT_TRUE(SubTable::OpenSubTable("empty_table", opts_, &sub_table).ok());
+  TestRead(sub_table.get(), value_list[0], ts, true);
+  EXPECT_FALSE(sub_table->GetRowIterator(opts_).Valid());
+}
+
+TEST_F(SubTableTest, CloseTest) {
+  for (bool packed : {false, true}) {
+    opts_.enable_packed_page = packed;
+    std::unique_ptr<SubTable> sub_table;
+    ASSERT_TRUE(SubTable::OpenSubTable(table_key_, opts_, &sub_table).ok());
+    auto *closed = sub_table.get();
+    SubTable::CloseSubTable(bpm_.get(), std::move(sub_table));
+    // closed subtable is reused by following open on the same worker.
+    ASSERT_TRUE(SubTable::OpenSubTable(table_key_, opts_, &sub_table).ok());
+    EXPECT_EQ(sub_table.get(), closed);
+    EXPECT_EQ(sub_table->TEST_IsPacked(), packed);
+    // subtable of other table is not reused.
+    SubTable::CloseSubTable(bpm_.get(), std::move(sub_table));
+    ASSERT_TRUE(SubTable::OpenSubTable("other_table", opts_, &sub_table).ok());
+    EXPECT_EQ(sub_table->GetTableKey(), "other_table");
+  }
+}
+
+TEST_F(SubTableTest, PromoteTest) {
+  opts_.enable_packed_page = true;
+  std::unique_ptr<SubTable> sub_table;
+  ASSERT_TRUE(SubTable::OpenSubTable(table_key_, opts_, &sub_table).ok());
+  // rows are large enough to trigger promotion.
+  auto value_list = GenerateValueList(100);
+  for (auto &value : value_list) {
+    value.value.append(std::string(512, 'a'));
+  }
+  TxnTs ts = 1;
+  for (const auto &value : value_list) {
+    WriteInfo info;
+    EXPECT_TRUE(WriteHelper(value,
+                            [&](const property::Row &row) {
+                              return sub_table->SetRow(row, ts, opts_, &info);
+                            })
+                    .ok());
+  }
+  for (const auto &value : value_list) {
+    SCOPED_TRACE("");
+    TestRead(sub_table.get(), value, ts, false);
+  }
+  EXPECT_FALSE(sub_table->TEST_IsPacked());
+
+  std::unique_ptr<SubTable> table2;
+  ASSERT_TRUE(SubTable::OpenSubTable(table_key_, opts_, &table2).ok());
+  for (const auto &value : value_list) {
+    SCOPED_TRACE("");
+    TestRead(table2.get(), value, ts, false);
+  }
+  EXPECT_FALSE(table2->TEST_IsPacked());
+  cache::BufferPool::PageHolder packed_page;
+  ASSERT_TRUE(
+      bpm_->GetPage(PackedPage::GetPackedPageId(table_key_), &packed_page)
+          .ok());
+  EXPECT_EQ(packed_page->GetPackedPage()->TEST_GetLeafCount(), 0);
+}
+
+TEST_F(SubTableTest, PackedFlushTest) {
+  opts_.enable_packed_page = true;
+  // table keys hosted by the same packed page.
+  std::vector<std::string> table_keys{table_key_};
+  auto bucket = PackedPage::GetPackedPageBucket(table_key_);
+  for (int i = 0; table_keys.size() < 3; i++) {
+    auto table_key = table_key_ + std::to_string(i);
+    if (PackedPage::GetPackedPageBucket(table_key) == bucket) {
+      table_keys.push_back(table_key);
+    }
+  }
+  auto value_list = GenerateValueList(10);
+  TxnTs ts = 1;
+  auto write = [&](const std::string &table_key, size_t value_size) {
+    std::unique_ptr<SubTable> sub_table;
+    ASSERT_TRUE(SubTable::OpenSubTable(table_key, opts_, &sub_table).ok());
+    for (auto value : value_list) {
+      value.value.append(std::string(value_size, 'a'));
+      WriteInfo info;
+      EXPECT_TRUE(WriteHelper(value,
+                              [&](const property::Row &row) {
+                                return sub_table->SetRow(row, ts, opts_,
+                                                         &info);
+                              })
+                      .ok());
+    }
+  };
+  cache::BufferPool::PageHolder packed_page;
+  ASSERT_TRUE(
+      bpm_->GetPage(PackedPage::GetPackedPageId(bucket), &packed_page).ok());
+  std::vector<std::string> images;
+  auto flush = [&](bool is_delta) {
+    auto snapshot = packed_page->GetPageSnapshot();
+    EXPECT_EQ(snapshot->IsDelta(), is_delta);
+    images.push_back(snapshot->Serialize());
+  };
+
+  // page that has never been flushed is flushed as a whole.
+  write(table_keys[0], 0);
+  write(table_keys[1], 0);
+  flush(/*is_delta=*/false);
+  // only the written leaf is flushed.
+  write(table_keys[2], 0);
+  flush(/*is_delta=*/true);
+  EXPECT_LT(images[1].size(), images[0].size());
+  // promoted leaf is dropped by delta.
+  write(table_keys[0], 2048);
+  flush(/*is_delta=*/true);
+  for (size_t i = images.size(); i <= common::Config::kPackedPageMaxDeltaNum;
+       i++) {
+    flush(/*is_delta=*/true);
+  }
+  flush(/*is_delta=*/false);
+
+  auto check = [&](const std::vector<std::string> &loaded) {
+    VersionedBtreePage page(PackedPage::GetPackedPageId(bucket));
+    for (const auto &image : loaded) {
+      ASSERT_TRUE(page.Deserialize(image).ok());
+    }
+    auto *packed = page.GetPackedPage();
+    EXPECT_EQ(packed->TEST_GetLeafCount(), 2);
+    bool promoted = false;
+    EXPECT_EQ(packed->GetLeaf(table_keys[0], /*create=*/false, &promoted),
+              nullptr);
+    EXPECT_TRUE(promoted);
+    for (size_t i = 1; i < table_keys.size(); i++) {
+      auto leaf = packed->GetLeaf(table_keys[i], /*create=*/false, &promoted);
+      ASSERT_NE(leaf, nullptr);
+      for (const auto &value : value_list) {
+        auto sk = property::SortKeys({value.point_id, value.point_type});
+        RowView view;
+        EXPECT_TRUE(leaf->GetRow(sk.as_ref(), ts, opts_, &view).ok());
+      }
+    }
+  };
+  // base image followed by deltas.
+  {
+    SCOPED_TRACE("");
+    check({images.begin(),
+           images.begin() + common::Config::kPackedPageMaxDeltaNum + 1});
+  }
+  {
+    SCOPED_TRACE("");
+    check({images.back()});
+  }
+}
+
+TEST_F(SubTableTest, ConcurrentPromoteTest) {
+  opts_.enable_packed_page = true;
+  int worker_count = 100;
+  int epoch_cnt = 10;
+  util::WaitGroup wg(worker_count);
+  TxnTs ts = 1;
+  for (int i = 0; i < worker_count; i++) {
+    util::LaunchAsync([&, index = i]() {
+      std::unique_ptr<SubTable> sub_table;
+      ASSERT_TRUE(SubTable::OpenSubTable(table_key_, opts_, &sub_table).ok());
+      ValueStruct value{.point_id = index,
+                        .point_type = 0,
+                        .value = std::string(256, 'a')};
+      for (int j = 0; j < epoch_cnt; j++) {
+        WriteInfo info;
+        EXPECT_TRUE(WriteHelper(value,
+                                [&](const property::Row &row) {
+                                  return sub_table->SetRow(row, ts, opts_,
+                                                           &info);
+                                })
+                        .ok());
+        {
+          SCOPED_TRACE("");
+          TestRead(sub_table.get(), value, ts, false);
+        }
+      }
+      wg.Done();
+    });
+  }
+  wg.Wait();
+  std::unique_ptr<SubTable> sub_table;
+  ASSERT_TRUE(SubTable::OpenSubTable(table_key_, opts_, &sub_table).ok());
+  // subtable is routed lazily, i.e. on the first access.
+  for (int i = 0; i < worker_count; i++) {
+    SCOPED_TRACE("");
+    ValueStruct value{
+        .point_id = i, .point_type = 0, .value = std::string(256, 'a')};
+    TestRead(sub_table.get(), value, ts, false);
+  }
+  EXPECT_FALSE(sub_table->TEST_IsPacked());
+}
+
 } // namespace btree
-} // namespace arcanedb
\ No newline at end of file
+} // namespace arcanedb
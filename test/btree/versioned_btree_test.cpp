@@ -10,11 +10,16 @@
  */
 
 #include "btree/versioned_btree.h"
+#include "log_store/posix_log_store/posix_log_store.h"
 #include "page_store/kv_page_store/kv_page_store.h"
 #include "property/schema.h"
+#include "txn/low_watermark.h"
+#include "txn/occ_recovery.h"
 #include "util/bthread_util.h"
 #include "util/wait_group.h"
+#include "wal/occ_log_writer.h"
 #include <gtest/gtest.h>
+#include <set>
 
 namespace arcanedb {
 namespace btree {
@@ -117,10 +122,24 @@ public:
     read_latency_ = std::make_unique<bvar::LatencyRecorder>();
   }
 
-  void LoadBtree(const std::string &key) noexcept {
+  void LoadBtree(const std::string &key,
+                 BtreeSmoOpts smo_opts = BtreeSmoOpts()) noexcept {
     cache::BufferPool::PageHolder page;
     EXPECT_TRUE(buffer_pool_->GetPage(key, &page).ok());
-    btree_ = std::make_unique<VersionedBtree>(std::move(page));
+    btree_ = std::make_unique<VersionedBtree>(std::move(page), smo_opts);
+  }
+
+  void TestRead(const property::Row &row, const ValueStruct &value) {
+    property::ValueResult res;
+    EXPECT_TRUE(row.GetProp(0, &res, &schema_).ok());
+    EXPECT_EQ(std::get<int64_t>(res.value), value.point_id);
+  }
+
+  // small pages so that SMOs are triggered by a few hundred rows.
+  BtreeSmoOpts MakeSmallSmoOpts() noexcept {
+    return BtreeSmoOpts{.leaf_split_size = 8 << 10,
+                        .leaf_merge_size = 2 << 10,
+                        .internal_max_fanout = 4};
   }
 
   void TearDown() {}
@@ -232,5 +251,212 @@ TEST_F(VersionedBtreeTest, FlushPageTest) {
   }
 }
 
+TEST_F(VersionedBtreeTest, SplitTest) {
+  LoadBtree("test_page", MakeSmallSmoOpts());
+  auto value_list = GenerateValueList(1000);
+  TxnTs ts = 1;
+  WriteInfo info;
+  for (const auto &value : value_list) {
+    EXPECT_TRUE(WriteHelper(value,
+                            [&](const property::Row &row) {
+                              return btree_->SetRow(row, ts, opts_, &info);
+                            })
+                    .ok());
+  }
+  // leaf pages and internal pages are both split
+  EXPECT_GT(btree_->TEST_GetLeafCount(opts_), 4);
+  EXPECT_GT(btree_->TEST_GetHeight(opts_), 2);
+  for (const auto &value : value_list) {
+    SCOPED_TRACE("");
+    TestRead(value, ts, false);
+  }
+  {
+    RangeScanRowView views;
+    btree_->RangeFilter(opts_, {}, ts, {}, &views);
+    ASSERT_EQ(views.size(), value_list.size());
+    for (size_t i = 0; i < value_list.size(); i++) {
+      TestRead(views.at(i), value_list[i]);
+    }
+  }
+  {
+    Filter filter;
+    filter.start = property::SortKeys({int64_t(100), type_});
+    filter.end = property::SortKeys({int64_t(900), type_});
+    filter.reverse = true;
+    filter.limit = 500;
+    RangeScanRowView views;
+    btree_->RangeFilter(opts_, filter, ts, {}, &views);
+    ASSERT_EQ(views.size(), filter.limit);
+    for (size_t i = 0; i < filter.limit; i++) {
+      TestRead(views.at(i), value_list[899 - i]);
+    }
+  }
+  {
+    auto cursor = btree_->GetScanCursor(opts_, {}, ts);
+    for (const auto &value : value_list) {
+      ASSERT_TRUE(cursor.Valid());
+      TestRead(cursor.GetRow(), value);
+      cursor.Next();
+    }
+    EXPECT_FALSE(cursor.Valid());
+  }
+  {
+    Filter filter;
+    filter.reverse = true;
+    auto cursor = btree_->GetScanCursor(opts_, filter, ts);
+    for (int i = value_list.size() - 1; i >= 0; i--) {
+      ASSERT_TRUE(cursor.Valid());
+      TestRead(cursor.GetRow(), value_list[i]);
+      cursor.Next();
+    }
+    EXPECT_FALSE(cursor.Valid());
+  }
+  {
+    std::set<int64_t> point_ids;
+    for (auto iter = btree_->GetRowIterator(opts_); iter.Valid();
+         iter.Next()) {
+      property::ValueResult res;
+      EXPECT_TRUE(iter.GetRow().GetProp(0, &res, &schema_).ok());
+      point_ids.insert(std::get<int64_t>(res.value));
+    }
+    EXPECT_EQ(point_ids.size(), value_list.size());
+  }
+}
+
+TEST_F(VersionedBtreeTest, MergeTest) {
+  LoadBtree("test_page", MakeSmallSmoOpts());
+  auto value_list = GenerateValueList(1000);
+  TxnTs ts = 1;
+  WriteInfo info;
+  for (const auto &value : value_list) {
+    EXPECT_TRUE(WriteHelper(value,
+                            [&](const property::Row &row) {
+                              return btree_->SetRow(row, ts, opts_, &info);
+                            })
+                    .ok());
+  }
+  auto leaf_count = btree_->TEST_GetLeafCount(opts_);
+  // delete all rows but the first ten, and collect deleted rows so that pages
+  // shrink.
+  auto *watermark = txn::LowWatermark::GetInstance();
+  auto source_id = watermark->AddSource([&]() { return ts + 2; });
+  Options opts = opts_;
+  opts.force_compaction = true;
+  for (size_t i = 10; i < value_list.size(); i++) {
+    auto sk = property::SortKeys({value_list[i].point_id, type_});
+    EXPECT_TRUE(btree_->DeleteRow(sk.as_ref(), ts + 1, opts, &info).ok());
+  }
+  watermark->RemoveSource(source_id);
+  EXPECT_LT(btree_->TEST_GetLeafCount(opts_), leaf_count);
+  for (size_t i = 0; i < value_list.size(); i++) {
+    SCOPED_TRACE("");
+    TestRead(value_list[i], kMaxTxnTs, i >= 10);
+  }
+}
+
+TEST_F(VersionedBtreeTest, SmoRecoveryTest) {
+  auto log_store_name = "versioned_btree_smo_log_store";
+  std::shared_ptr<log_store::LogStore> log_store;
+  EXPECT_EQ(log_store::PosixLogStore::Destory(log_store_name), Status::Ok());
+  EXPECT_EQ(log_store::PosixLogStore::Open(log_store_name,
+                                           log_store::Options(), &log_store),
+            Status::Ok());
+  LoadBtree("test_page", MakeSmallSmoOpts());
+  Options opts = opts_;
+  opts.log_store = log_store.get();
+  opts.txn_id = 1;
+  auto value_list = GenerateValueList(1000);
+  TxnTs ts = 1;
+  // rows are written with commit ts directly, so that they are visible once
+  // they are replayed.
+  {
+    wal::OccLogWriter log_writer;
+    log_writer.Begin(opts.txn_id, ts);
+    log_store::LogStore::LogResultContainer result;
+    log_store->AppendLogRecord(log_writer.GetLogRecords(), &result);
+  }
+  WriteInfo info;
+  for (const auto &value : value_list) {
+    EXPECT_TRUE(WriteHelper(value,
+                            [&](const property::Row &row) {
+                              return btree_->SetRow(row, ts, opts, &info);
+                            })
+                    .ok());
+  }
+  auto split_leaf_count = btree_->TEST_GetLeafCount(opts_);
+  EXPECT_GT(split_leaf_count, 4);
+  // shrink pages so that they are merged.
+  auto *watermark = txn::LowWatermark::GetInstance();
+  auto source_id = watermark->AddSource([&]() { return ts + 2; });
+  opts.force_compaction = true;
+  for (size_t i = 10; i < value_list.size(); i++) {
+    auto sk = property::SortKeys({value_list[i].point_id, type_});
+    EXPECT_TRUE(btree_->DeleteRow(sk.as_ref(), ts + 1, opts, &info).ok());
+  }
+  watermark->RemoveSource(source_id);
+  auto leaf_count = btree_->TEST_GetLeafCount(opts_);
+  auto height = btree_->TEST_GetHeight(opts_);
+  EXPECT_LT(leaf_count, split_leaf_count);
+  log_store->WaitForPersist(info.lsn);
+
+  // drop buffer pool without flushing, then replay the log.
+  btree_.reset();
+  buffer_pool_ = std::make_unique<cache::BufferPool>(nullptr);
+  opts_.buffer_pool = buffer_pool_.get();
+  {
+    std::unique_ptr<log_store::LogReader> log_reader;
+    EXPECT_TRUE(log_store->GetLogReader(&log_reader).ok());
+    txn::OccRecovery recovery(buffer_pool_.get(), log_reader.get());
+    recovery.Recover();
+  }
+  LoadBtree("test_page", MakeSmallSmoOpts());
+  EXPECT_EQ(btree_->TEST_GetLeafCount(opts_), leaf_count);
+  EXPECT_EQ(btree_->TEST_GetHeight(opts_), height);
+  for (size_t i = 0; i < value_list.size(); i++) {
+    SCOPED_TRACE("");
+    TestRead(value_list[i], kMaxTxnTs, i >= 10);
+  }
+  RangeScanRowView views;
+  btree_->RangeFilter(opts_, {}, kMaxTxnTs, {}, &views);
+  ASSERT_EQ(views.size(), 10);
+  for (size_t i = 0; i < views.size(); i++) {
+    TestRead(views.at(i), value_list[i]);
+  }
+}
+
+TEST_F(VersionedBtreeTest, ConcurrentSplitTest) {
+  LoadBtree("test_page", MakeSmallSmoOpts());
+  int worker_count = 16;
+  int row_cnt = 100;
+  util::WaitGroup wg(worker_count);
+  TxnTs ts = 1;
+  for (int i = 0; i < worker_count; i++) {
+    util::LaunchAsync([&, index = i]() {
+      for (int j = 0; j < row_cnt; j++) {
+        int64_t point_id = j * worker_count + index;
+        ValueStruct value{.point_id = point_id,
+                          .point_type = 0,
+                          .value = std::to_string(point_id)};
+        WriteInfo info;
+        EXPECT_TRUE(WriteHelper(value,
+                                [&](const property::Row &row) {
+                                  return btree_->SetRow(row, ts, opts_, &info);
+                                })
+                        .ok());
+        {
+          SCOPED_TRACE("");
+          TestRead(value, ts, false);
+        }
+      }
+      wg.Done();
+    });
+  }
+  wg.Wait();
+  EXPECT_GT(btree_->TEST_GetLeafCount(opts_), 1);
+  RangeScanRowView views;
+  btree_->RangeFilter(opts_, {}, ts, {}, &views);
+  EXPECT_EQ(views.size(), worker_count * row_cnt);
+}
+
 } // namespace btree
 } // namespace arcanedb
\ No newline at end of file
@@ -11,7 +11,9 @@
 
 #include "btree/page/versioned_bwtree_page.h"
 #include "bvar/bvar.h"
+#include "cache/buffer_pool.h"
 #include "common/config.h"
+#include "txn/low_watermark.h"
 #include "util/bthread_util.h"
 #include "util/wait_group.h"
 #include <gtest/gtest.h>
@@ -144,7 +146,7 @@ TEST_F(VersionedBwTreePageTest, CompactionTest) {
     EXPECT_TRUE(s.ok());
   }
   EXPECT_LE(page_->TEST_GetDeltaLength(),
-            common::Config::kBwTreeDeltaChainLength);
+            common::Config::kBwTreeMaxDeltaChainLength);
   // test read
   for (const auto &value : value_list) {
     auto sk = property::SortKeys({value.point_id, value.point_type});
@@ -155,6 +157,93 @@ TEST_F(VersionedBwTreePageTest, CompactionTest) {
   }
 }
 
+TEST_F(VersionedBwTreePageTest, AdaptiveCompactionTest) {
+  auto value_list = GenerateValueList(100);
+  Options opts;
+  WriteInfo info;
+  // write-hot page should keep longer delta chain
+  for (int i = 0; i < 2 * common::Config::kBwTreeAdaptiveWindow; i++) {
+    const auto &value = value_list[i % value_list.size()];
+    auto s = WriteHelper(value, [&](const property::Row &row) {
+      return page_->SetRow(row, 1, opts, &info);
+    });
+    EXPECT_TRUE(s.ok());
+  }
+  EXPECT_EQ(page_->TEST_GetCompactionThreshold(),
+            common::Config::kBwTreeMaxDeltaChainLength);
+  // read-hot page should perform compaction more aggressively.
+  for (int i = 0; i < 64 * common::Config::kBwTreeAdaptiveWindow; i++) {
+    const auto &value = value_list[i % value_list.size()];
+    auto sk = property::SortKeys({value.point_id, value.point_type});
+    RowView view;
+    EXPECT_TRUE(page_->GetRow(sk.as_ref(), 1, opts, &view).ok());
+    if (i % 64 == 0) {
+      auto s = WriteHelper(value, [&](const property::Row &row) {
+        return page_->SetRow(row, 1, opts, &info);
+      });
+      EXPECT_TRUE(s.ok());
+    }
+  }
+  EXPECT_LT(page_->TEST_GetCompactionThreshold(),
+            common::Config::kBwTreeDeltaChainLength);
+}
+
+TEST_F(VersionedBwTreePageTest, BackgroundCompactionTest) {
+  cache::BufferPool buffer_pool(nullptr);
+  auto value_list = GenerateValueList(1000);
+  Options opts;
+  opts.buffer_pool = &buffer_pool;
+  bool need_compaction = false;
+  for (const auto &value : value_list) {
+    WriteInfo info;
+    auto s = WriteHelper(value, [&](const property::Row &row) {
+      return page_->SetRow(row, MarkLocked(1), opts, &info);
+    });
+    EXPECT_TRUE(s.ok());
+    need_compaction = need_compaction || info.need_compaction;
+  }
+  // writers only mark the page
+  EXPECT_TRUE(need_compaction);
+  EXPECT_GT(page_->TEST_GetDeltaLength(),
+            common::Config::kBwTreeDeltaChainLength);
+
+  int worker_count = 10;
+  util::WaitGroup wg(worker_count);
+  std::atomic<bool> stop{false};
+  // commit the intents while compacting.
+  for (int i = 0; i < worker_count; i++) {
+    util::LaunchAsync([&, index = i]() {
+      for (int j = index; j < value_list.size(); j += worker_count) {
+        WriteInfo info;
+        auto sk = property::SortKeys(
+            {value_list[j].point_id, value_list[j].point_type});
+        page_->SetTs(sk.as_ref(), 1, opts, &info);
+      }
+      wg.Done();
+    });
+  }
+  util::WaitGroup compaction_wg(1);
+  util::LaunchAsync([&]() {
+    while (!stop.load()) {
+      page_->BackgroundCompaction();
+    }
+    compaction_wg.Done();
+  });
+  wg.Wait();
+  stop.store(true);
+  compaction_wg.Wait();
+  page_->BackgroundCompaction();
+  EXPECT_LE(page_->TEST_GetDeltaLength(),
+            common::Config::kBwTreeDeltaChainLength);
+  for (const auto &value : value_list) {
+    auto sk = property::SortKeys({value.point_id, value.point_type});
+    RowView view;
+    auto s = page_->GetRow(sk.as_ref(), 1, opts_, &view);
+    EXPECT_TRUE(s.ok());
+    TestRead(view.at(0), value);
+  }
+}
+
 TEST_F(VersionedBwTreePageTest, ConcurrentCompactionTest) {
   int worker_count = 100;
   int epoch = 10;
@@ -238,7 +327,7 @@ TEST_F(VersionedBwTreePageTest, ConcurrentCompactionTest) {
   }
   wg.Wait();
   EXPECT_LE(page_->TEST_GetDeltaLength(),
-            common::Config::kBwTreeDeltaChainLength);
+            common::Config::kBwTreeMaxDeltaChainLength);
   ARCANEDB_INFO("read avg latency: {}, max latency: {}", read_latency.latency(),
                 read_latency.max_latency());
   ARCANEDB_INFO("read null avg latency: {}, max latency: {}",
@@ -440,6 +529,51 @@ TEST_F(VersionedBwTreePageTest, SetWhileCheckingLockTest) {
   EXPECT_EQ(view.at(0).GetTs(), ts);
 }
 
+TEST_F(VersionedBwTreePageTest, GroupCommitConflictTest) {
+  int key_count = 16;
+  int contender_count = 8;
+  util::WaitGroup wg(key_count * contender_count);
+  Options opts;
+  opts.check_intent_locked = true;
+  std::vector<std::atomic<int>> success_count(key_count);
+  std::vector<std::atomic<TxnTs>> winner_ts(key_count);
+  for (int i = 0; i < key_count * contender_count; i++) {
+    util::LaunchAsync([&, index = i]() {
+      int key = index % key_count;
+      TxnTs ts = index / key_count + 1;
+      ValueStruct value{.point_id = key,
+                        .point_type = 0,
+                        .value = std::to_string(ts)};
+      WriteInfo info;
+      auto s = WriteHelper(value, [&](const property::Row &row) {
+        return page_->SetRow(row, MarkLocked(ts), opts, &info);
+      });
+      if (s.ok()) {
+        success_count[key].fetch_add(1);
+        winner_ts[key].store(ts);
+      } else {
+        EXPECT_TRUE(s.IsTxnConflict());
+      }
+      wg.Done();
+    });
+  }
+  wg.Wait();
+  // only one of the writers on the same row could acquire the intent.
+  for (int i = 0; i < key_count; i++) {
+    EXPECT_EQ(success_count[i].load(), 1);
+    // commit the intent
+    auto ts = winner_ts[i].load();
+    auto sk = property::SortKeys({static_cast<int64_t>(i), 0});
+    WriteInfo info;
+    page_->SetTs(sk.as_ref(), ts, opts, &info);
+    RowView view;
+    EXPECT_TRUE(page_->GetRow(sk.as_ref(), ts, opts, &view).ok());
+    TestRead(view.at(0), ValueStruct{.point_id = i,
+                                     .point_type = 0,
+                                     .value = std::to_string(ts)});
+  }
+}
+
 TEST_F(VersionedBwTreePageTest, SerializeTest) {
   auto value_list = GenerateValueList(2000);
   WriteInfo info;
@@ -476,6 +610,43 @@ TEST_F(VersionedBwTreePageTest, SerializeTest) {
   }
 }
 
+TEST_F(VersionedBwTreePageTest, SerializeMultiVersionTest) {
+  auto value_list = GenerateValueList(100);
+  Options opts;
+  opts.disable_compaction = true;
+  WriteInfo info;
+  for (TxnTs ts = 1; ts <= 3; ts++) {
+    for (const auto &value : value_list) {
+      if (value.point_id % 3 == ts - 1) {
+        auto sk = property::SortKeys({value.point_id, value.point_type});
+        EXPECT_TRUE(page_->DeleteRow(sk.as_ref(), ts, opts, &info).ok());
+        continue;
+      }
+      auto s = WriteHelper(value, [&](const property::Row &row) {
+        return page_->SetRow(row, ts, opts, &info);
+      });
+      EXPECT_TRUE(s.ok());
+    }
+  }
+  auto snapshot = page_->GetPageSnapshot();
+  auto new_page = std::make_unique<VersionedBwTreePage>("test_page");
+  EXPECT_TRUE(new_page->Deserialize(snapshot->Serialize()).ok());
+  EXPECT_TRUE(page_->TEST_Equal(*new_page));
+  for (TxnTs ts = 1; ts <= 3; ts++) {
+    for (const auto &value : value_list) {
+      auto sk = property::SortKeys({value.point_id, value.point_type});
+      RowView view;
+      auto s = new_page->GetRow(sk.as_ref(), ts, opts_, &view);
+      if (value.point_id % 3 == ts - 1) {
+        EXPECT_TRUE(s.IsNotFound());
+        continue;
+      }
+      EXPECT_TRUE(s.ok());
+      TestRead(view.at(0), value);
+    }
+  }
+}
+
 TEST_F(VersionedBwTreePageTest, RangeFilterTest) {
   auto value_list = GenerateValueList(100);
   for (int i = value_list.size() - 1; i >= 0; i--) {
@@ -487,13 +658,240 @@ TEST_F(VersionedBwTreePageTest, RangeFilterTest) {
     EXPECT_TRUE(s.ok());
   }
   RangeScanRowView view;
-  page_->RangeFilter(opts_, {}, {}, &view);
+  page_->RangeFilter(opts_, {}, kMaxTxnTs, {}, &view);
   EXPECT_EQ(view.size(), value_list.size());
   for (int i = 0; i < value_list.size(); i++) {
     TestRead(view.at(i), value_list[i]);
   }
 }
 
+TEST_F(VersionedBwTreePageTest, RangeFilterMultiVersionTest) {
+  auto value_list = GenerateValueList(100);
+  Options opts;
+  opts.disable_compaction = true;
+  WriteInfo info;
+  for (TxnTs ts = 1; ts <= 3; ts++) {
+    for (const auto &value : value_list) {
+      if (value.point_id % 3 == ts - 1) {
+        auto sk = property::SortKeys({value.point_id, value.point_type});
+        EXPECT_TRUE(page_->DeleteRow(sk.as_ref(), ts, opts, &info).ok());
+        continue;
+      }
+      auto s = WriteHelper(value, [&](const property::Row &row) {
+        return page_->SetRow(row, ts, opts, &info);
+      });
+      EXPECT_TRUE(s.ok());
+    }
+  }
+  for (TxnTs ts = 1; ts <= 3; ts++) {
+    RangeScanRowView view;
+    page_->RangeFilter(opts_, {}, ts, {}, &view);
+    size_t idx = 0;
+    for (const auto &value : value_list) {
+      if (value.point_id % 3 == ts - 1) {
+        continue;
+      }
+      ASSERT_LT(idx, view.size());
+      TestRead(view.at(idx), value);
+      idx += 1;
+    }
+    EXPECT_EQ(idx, view.size());
+  }
+  // nothing is visible before the first write.
+  RangeScanRowView view;
+  page_->RangeFilter(opts_, {}, 0, {}, &view);
+  EXPECT_TRUE(view.empty());
+}
+
+TEST_F(VersionedBwTreePageTest, RangeFilterPushdownTest) {
+  auto value_list = GenerateValueList(100);
+  Options opts;
+  opts.disable_compaction = true;
+  WriteInfo info;
+  for (const auto &value : value_list) {
+    auto s = WriteHelper(value, [&](const property::Row &row) {
+      return page_->SetRow(row, 1, opts, &info);
+    });
+    EXPECT_TRUE(s.ok());
+  }
+  auto read_ids = [&](const Filter &filter) {
+    RangeScanRowView view;
+    page_->RangeFilter(opts_, filter, 1, {}, &view);
+    std::vector<int64_t> ids;
+    for (const auto &row : view) {
+      property::ValueResult res;
+      EXPECT_TRUE(row.GetProp(0, &res, &schema_).ok());
+      ids.push_back(std::get<int64_t>(res.value));
+    }
+    return ids;
+  };
+  auto make_ids = [](int64_t begin, int64_t end, bool reverse) {
+    std::vector<int64_t> ids;
+    for (int64_t i = begin; i < end; i++) {
+      ids.push_back(i);
+    }
+    if (reverse) {
+      std::reverse(ids.begin(), ids.end());
+    }
+    return ids;
+  };
+  Filter filter;
+  filter.start = property::SortKeys({int64_t(10), type_});
+  filter.end = property::SortKeys({int64_t(50), type_});
+  EXPECT_EQ(read_ids(filter), make_ids(10, 50, false));
+  filter.reverse = true;
+  EXPECT_EQ(read_ids(filter), make_ids(10, 50, true));
+  filter.limit = 5;
+  EXPECT_EQ(read_ids(filter), make_ids(45, 50, true));
+  filter.reverse = false;
+  EXPECT_EQ(read_ids(filter), make_ids(10, 15, false));
+  filter.predicates.push_back(Filter::Predicate{
+      .column_id = 0,
+      .op = Filter::CompareOp::kGreater,
+      .value = int64_t(30)});
+  EXPECT_EQ(read_ids(filter), make_ids(31, 36, false));
+  filter.predicates.push_back(Filter::Predicate{
+      .column_id = 2,
+      .op = Filter::CompareOp::kEqual,
+      .value = std::string_view("42")});
+  EXPECT_EQ(read_ids(filter), make_ids(42, 43, false));
+  // type mismatch never matches
+  filter.predicates.back().value = int32_t(42);
+  EXPECT_TRUE(read_ids(filter).empty());
+}
+
+TEST_F(VersionedBwTreePageTest, RangeFilterSingleNodeTest) {
+  // more than one block of rows
+  auto value_list = GenerateValueList(200);
+  Options opts;
+  opts.force_compaction = true;
+  WriteInfo info;
+  for (const auto &value : value_list) {
+    auto s = WriteHelper(value, [&](const property::Row &row) {
+      return page_->SetRow(row, 1, opts, &info);
+    });
+    EXPECT_TRUE(s.ok());
+  }
+  EXPECT_EQ(page_->TEST_GetDeltaLength(), 1);
+  auto read_ids = [&](const Filter &filter, TxnTs read_ts) {
+    RangeScanRowView view;
+    page_->RangeFilter(opts_, filter, read_ts, {}, &view);
+    std::vector<int64_t> ids;
+    for (const auto &row : view) {
+      property::ValueResult res;
+      EXPECT_TRUE(row.GetProp(0, &res, &schema_).ok());
+      ids.push_back(std::get<int64_t>(res.value));
+    }
+    return ids;
+  };
+  auto make_ids = [](int64_t begin, int64_t end, bool reverse) {
+    std::vector<int64_t> ids;
+    for (int64_t i = begin; i < end; i++) {
+      ids.push_back(i);
+    }
+    if (reverse) {
+      std::reverse(ids.begin(), ids.end());
+    }
+    return ids;
+  };
+  Filter filter;
+  EXPECT_TRUE(read_ids(filter, 0).empty());
+  EXPECT_EQ(read_ids(filter, 1), make_ids(0, 200, false));
+  filter.start = property::SortKeys({int64_t(10), type_});
+  filter.end = property::SortKeys({int64_t(150), type_});
+  EXPECT_EQ(read_ids(filter, 1), make_ids(10, 150, false));
+  filter.reverse = true;
+  EXPECT_EQ(read_ids(filter, 1), make_ids(10, 150, true));
+  filter.limit = 70;
+  EXPECT_EQ(read_ids(filter, 1), make_ids(80, 150, true));
+  // foreign intent forces the reader to retry, so read it as the owner.
+  auto sk = property::SortKeys({int64_t(100), type_});
+  EXPECT_TRUE(page_->DeleteRow(sk.as_ref(), MarkLocked(2), opts, &info).ok());
+  Options owner_opts = opts_;
+  owner_opts.owner_ts = 2;
+  RangeScanRowView view;
+  page_->RangeFilter(owner_opts, {}, 1, {}, &view);
+  EXPECT_EQ(view.size(), value_list.size());
+}
+
+TEST_F(VersionedBwTreePageTest, ScanCursorTest) {
+  auto value_list = GenerateValueList(100);
+  Options opts;
+  opts.disable_compaction = true;
+  WriteInfo info;
+  for (TxnTs ts = 1; ts <= 2; ts++) {
+    for (const auto &value : value_list) {
+      if (ts == 2 && value.point_id % 2 == 0) {
+        auto sk = property::SortKeys({value.point_id, value.point_type});
+        EXPECT_TRUE(page_->DeleteRow(sk.as_ref(), ts, opts, &info).ok());
+        continue;
+      }
+      auto s = WriteHelper(value, [&](const property::Row &row) {
+        return page_->SetRow(row, ts, opts, &info);
+      });
+      EXPECT_TRUE(s.ok());
+    }
+  }
+  {
+    // full scan at ts 1
+    auto cursor = page_->GetScanCursor(opts_, {}, 1);
+    for (const auto &value : value_list) {
+      ASSERT_TRUE(cursor.Valid());
+      TestRead(cursor.GetRow(), value);
+      cursor.Next();
+    }
+    EXPECT_FALSE(cursor.Valid());
+  }
+  {
+    // even rows are deleted at ts 2
+    auto cursor = page_->GetScanCursor(opts_, {}, 2);
+    auto sk = property::SortKeys({int64_t(50), type_});
+    cursor.Seek(sk.as_ref());
+    for (int i = 51; i < 100; i += 2) {
+      ASSERT_TRUE(cursor.Valid());
+      TestRead(cursor.GetRow(), value_list[i]);
+      cursor.Next();
+    }
+    EXPECT_FALSE(cursor.Valid());
+  }
+  {
+    // paginate with resume token
+    Filter filter;
+    filter.limit = 7;
+    std::string token;
+    size_t idx = 0;
+    while (true) {
+      auto cursor = page_->GetScanCursor(opts_, filter, 1);
+      cursor.Resume(token);
+      if (!cursor.Valid()) {
+        break;
+      }
+      size_t cnt = 0;
+      for (; cursor.Valid(); cursor.Next()) {
+        TestRead(cursor.GetRow(), value_list[idx++]);
+        cnt += 1;
+      }
+      EXPECT_LE(cnt, filter.limit);
+      token = cursor.GetResumeToken();
+    }
+    EXPECT_EQ(idx, value_list.size());
+  }
+  {
+    // reverse seek
+    Filter filter;
+    filter.reverse = true;
+    auto cursor = page_->GetScanCursor(opts_, filter, 1);
+    auto sk = property::SortKeys({int64_t(10), type_});
+    cursor.Seek(sk.as_ref());
+    for (int i = 10; i >= 0; i--) {
+      ASSERT_TRUE(cursor.Valid());
+      TestRead(cursor.GetRow(), value_list[i]);
+      cursor.Next();
+    }
+    EXPECT_FALSE(cursor.Valid());
+  }
+}
+
 TEST_F(VersionedBwTreePageTest, ForceCompactionTest) {
   auto value_list = GenerateValueList(100);
   Options opts;
@@ -516,6 +914,68 @@ TEST_F(VersionedBwTreePageTest, ForceCompactionTest) {
   }
 }
 
+TEST_F(VersionedBwTreePageTest, VersionGcTest) {
+  auto value_list = GenerateValueList(100);
+  Options opts;
+  opts.disable_compaction = true;
+  WriteInfo info;
+  TxnTs max_ts = 10;
+  for (TxnTs ts = 1; ts <= max_ts; ts++) {
+    for (const auto &value : value_list) {
+      auto s = WriteHelper(value, [&](const property::Row &row) {
+        return page_->SetRow(row, ts, opts, &info);
+      });
+      EXPECT_TRUE(s.ok());
+    }
+  }
+  // delete half of the rows
+  for (const auto &value : value_list) {
+    if (value.point_id % 2 == 0) {
+      auto sk = property::SortKeys({value.point_id, value.point_type});
+      EXPECT_TRUE(page_->DeleteRow(sk.as_ref(), max_ts + 1, opts, &info).ok());
+    }
+  }
+
+  TxnTs low_watermark = max_ts + 1;
+  auto *watermark = txn::LowWatermark::GetInstance();
+  auto source_id = watermark->AddSource([&]() { return low_watermark; });
+  opts.disable_compaction = false;
+  opts.force_compaction = true;
+  auto value = value_list[1];
+  EXPECT_TRUE(WriteHelper(value,
+                          [&](const property::Row &row) {
+                            return page_->SetRow(row, max_ts + 2, opts,
+                                                 &info);
+                          })
+                  .ok());
+  watermark->RemoveSource(source_id);
+
+  for (const auto &value : value_list) {
+    auto sk = property::SortKeys({value.point_id, value.point_type});
+    {
+      // versions below the watermark are collected.
+      RowView view;
+      EXPECT_TRUE(
+          page_->GetRow(sk.as_ref(), max_ts - 1, opts_, &view).IsNotFound());
+    }
+    RowView view;
+    auto s = page_->GetRow(sk.as_ref(), low_watermark, opts_, &view);
+    if (value.point_id % 2 == 0) {
+      EXPECT_TRUE(s.IsNotFound());
+    } else {
+      EXPECT_TRUE(s.ok());
+      TestRead(view.at(0), value);
+    }
+  }
+  // tombstones are dropped as well.
+  size_t row_count = 0;
+  for (auto iter = page_->GetRowIterator(); iter.Valid(); iter.Next()) {
+    row_count += 1;
+  }
+  EXPECT_EQ(row_count, value_list.size() / 2);
+  EXPECT_EQ(page_->TEST_DumpPage().find("del:1"), std::string::npos);
+}
+
 TEST_F(VersionedBwTreePageTest, RowIteratorTest) {
   Options opts;
   opts.disable_compaction = true;
@@ -537,5 +997,57 @@ TEST_F(VersionedBwTreePageTest, RowIteratorTest) {
   EXPECT_FALSE(iterator.Valid());
 }
 
+TEST_F(VersionedBwTreePageTest, FreezeTest) {
+  auto value_list = GenerateValueList(100);
+  for (const auto &value : value_list) {
+    WriteInfo info;
+    auto s = WriteHelper(value, [&](const property::Row &row) {
+      return page_->SetRow(row, 1, opts_, &info);
+    });
+    EXPECT_TRUE(s.ok());
+  }
+  std::string image;
+  page_->Freeze(&image);
+  EXPECT_TRUE(page_->IsFrozen());
+  {
+    // writers should retry on the new pages.
+    WriteInfo info;
+    auto s = WriteHelper(value_list[0], [&](const property::Row &row) {
+      return page_->SetRow(row, 2, opts_, &info);
+    });
+    EXPECT_TRUE(s.IsRetry());
+  }
+  {
+    // readers are served until page is truncated.
+    RowView view;
+    auto sk = property::SortKeys({value_list[0].point_id, type_});
+    EXPECT_TRUE(page_->GetRow(sk.as_ref(), kMaxTxnTs, opts_, &view).ok());
+    TestRead(view.at(0), value_list[0]);
+  }
+  std::string separator;
+  EXPECT_TRUE(VersionedBwTreePage::PickSeparator(image, &separator));
+  auto images = VersionedBwTreePage::RepartitionImages(
+      {image}, {std::string_view(), separator});
+  ASSERT_EQ(images.size(), 2);
+  size_t total = 0;
+  for (size_t i = 0; i < images.size(); i++) {
+    VersionedBwTreePage page("new_page");
+    EXPECT_TRUE(page.Deserialize(images[i]).ok());
+    RangeScanRowView view;
+    EXPECT_TRUE(page.RangeFilter(opts_, {}, kMaxTxnTs, {}, &view).ok());
+    EXPECT_GT(view.size(), 0);
+    for (size_t j = 0; j < view.size(); j++) {
+      TestRead(view.at(j), value_list[total + j]);
+    }
+    total += view.size();
+  }
+  EXPECT_EQ(total, value_list.size());
+  page_->Truncate();
+  EXPECT_TRUE(page_->IsTruncated());
+  RowView view;
+  auto sk = property::SortKeys({value_list[0].point_id, type_});
+  EXPECT_TRUE(page_->GetRow(sk.as_ref(), kMaxTxnTs, opts_, &view).IsNotFound());
+}
+
 } // namespace btree
 } // namespace arcanedb
\ No newline at end of file
@@ -11,8 +11,34 @@
 
 #include "btree/page/versioned_delta_node.h"
 #include "property/schema.h"
+#include <algorithm>
+#include <cstdlib>
 #include <gtest/gtest.h>
+#include <limits>
 #include <memory>
+#include <new>
+
+namespace {
+
+// heap allocations of current thread, counted while enabled.
+thread_local bool count_allocation = false;
+thread_local size_t allocation_cnt = 0;
+
+} // namespace
+
+void *operator new(size_t size) {
+  if (count_allocation) {
+    allocation_cnt += 1;
+  }
+  if (void *ptr = std::malloc(size == 0 ? 1 : size)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+
+void operator delete(void *ptr, size_t) noexcept { std::free(ptr); }
 
 namespace arcanedb {
 namespace btree {
@@ -154,6 +180,94 @@ TEST_F(VersionedDeltaNodeTest, MultiVersionTest) {
   }
 }
 
+TEST_F(VersionedDeltaNodeTest, SparseVersionTest) {
+  // row i has i % 3 old versions.
+  VersionedDeltaNodeBuilder builder;
+  VersionedDeltaNodeBuilder newest_builder;
+  std::vector<std::shared_ptr<VersionedDeltaNode>> deltas;
+  auto make_value = [](int64_t id, TxnTs ts) {
+    return ValueStruct{.point_id = id,
+                       .point_type = 0,
+                       .value = std::to_string(id) + "_" + std::to_string(ts)};
+  };
+  for (TxnTs ts = 3; ts >= 1; ts--) {
+    for (int64_t i = 0; i < 50; i++) {
+      if (ts > i % 3 + 1) {
+        continue;
+      }
+      auto node = MakeDelta(make_value(i, ts), false, ts);
+      deltas.push_back(node);
+      builder.AddDeltaNode(node.get());
+      if (ts == i % 3 + 1) {
+        newest_builder.AddDeltaNode(node.get());
+      }
+    }
+  }
+  auto compacted = builder.GenerateDeltaNode();
+  for (TxnTs ts = 1; ts <= 3; ts++) {
+    for (int64_t i = 0; i < 50; i++) {
+      auto sk = property::SortKeys({i, type_});
+      RowView view;
+      auto s = compacted->GetRow(sk.as_ref(), ts, opts_, &view);
+      ASSERT_TRUE(s.ok());
+      TestRead(&view, make_value(i, std::min<TxnTs>(ts, i % 3 + 1)));
+    }
+  }
+  // old versions are charged.
+  auto newest_only = newest_builder.GenerateDeltaNode();
+  EXPECT_GT(compacted->GetTotalCharge(), newest_only->GetTotalCharge());
+}
+
+TEST_F(VersionedDeltaNodeTest, MultiWayMergeTest) {
+  // build several multi-row delta nodes with interleaved sort keys,
+  // newer delta nodes overwrite part of the rows.
+  int node_count = 4;
+  auto value_list = GenerateValueList(100);
+  std::vector<std::shared_ptr<VersionedDeltaNode>> deltas;
+  std::vector<std::shared_ptr<VersionedDeltaNode>> nodes;
+  for (int i = 0; i < node_count; i++) {
+    VersionedDeltaNodeBuilder builder;
+    for (int j = i; j < value_list.size(); j += (i + 1)) {
+      auto value = value_list[j];
+      value.value = std::to_string(i);
+      auto node = MakeDelta(value, false, i + 1);
+      deltas.push_back(node);
+      builder.AddDeltaNode(node.get());
+    }
+    nodes.push_back(builder.GenerateDeltaNode());
+  }
+  VersionedDeltaNodeBuilder builder;
+  // add from the newest to the oldest
+  for (int i = node_count - 1; i >= 0; i--) {
+    builder.AddDeltaNode(nodes[i].get());
+  }
+  auto compacted = builder.GenerateDeltaNode();
+  for (int j = 0; j < value_list.size(); j++) {
+    auto sk = property::SortKeys(
+        {value_list[j].point_id, value_list[j].point_type});
+    for (int i = 0; i < node_count; i++) {
+      RowView view;
+      auto s = compacted->GetRow(sk.as_ref(), i + 1, opts_, &view);
+      // newest version written before or at ts i + 1
+      int expected = -1;
+      for (int k = i; k >= 0; k--) {
+        if (j >= k && (j - k) % (k + 1) == 0) {
+          expected = k;
+          break;
+        }
+      }
+      if (expected == -1) {
+        EXPECT_TRUE(s.IsNotFound());
+        continue;
+      }
+      ASSERT_TRUE(s.ok());
+      auto value = value_list[j];
+      value.value = std::to_string(expected);
+      TestRead(&view, value);
+    }
+  }
+}
+
 TEST_F(VersionedDeltaNodeTest, PointReadTest) {
   VersionedDeltaNodeBuilder builder;
   auto value_list = GenerateValueList(100);
@@ -245,5 +359,269 @@ TEST_F(VersionedDeltaNodeTest, LockOwnerTest) {
   TestRead(&view, value);
 }
 
+TEST_F(VersionedDeltaNodeTest, CommittedIntentTest) {
+  TxnTs owner_ts = 100;
+  TxnTs commit_ts = 150;
+  ValueStruct value{.point_id = 0, .point_type = 0, .value = "hello"};
+  auto delta = MakeDelta(value, false, MarkLocked(owner_ts));
+  auto sk = property::SortKeys({value.point_id, value.point_type});
+  {
+    RowView view;
+    EXPECT_TRUE(delta->GetRow(sk.as_ref(), 200, opts_, &view).IsRowLocked());
+  }
+  auto *status_table = txn::TxnStatusTable::GetInstance();
+  status_table->Commit(owner_ts, commit_ts);
+  {
+    // intent is visible at commit ts before it's finalized.
+    RowView view;
+    EXPECT_TRUE(delta->GetRow(sk.as_ref(), 200, opts_, &view).ok());
+    EXPECT_EQ(view.at(0).GetTs(), commit_ts);
+    TestRead(&view, value);
+    RowView old_view;
+    EXPECT_TRUE(
+        delta->GetRow(sk.as_ref(), 120, opts_, &old_view).IsNotFound());
+  }
+  // consolidation copies the intent as is.
+  VersionedDeltaNodeBuilder builder;
+  builder.AddDeltaNode(delta.get());
+  auto compacted = builder.GenerateDeltaNode();
+  TxnTs write_ts;
+  EXPECT_TRUE(compacted->GetNewestTs(sk.as_ref(), &write_ts));
+  EXPECT_EQ(write_ts, MarkLocked(owner_ts));
+  // write back the commit ts in place.
+  std::vector<TxnTs> owners;
+  compacted->WriteBackIntents(&owners);
+  EXPECT_EQ(owners, std::vector<TxnTs>{owner_ts});
+  status_table->Erase(owner_ts);
+  EXPECT_TRUE(compacted->GetNewestTs(sk.as_ref(), &write_ts));
+  EXPECT_EQ(write_ts, commit_ts);
+  owners.clear();
+  compacted->WriteBackIntents(&owners);
+  EXPECT_TRUE(owners.empty());
+  RowView view;
+  EXPECT_TRUE(compacted->GetRow(sk.as_ref(), 200, opts_, &view).ok());
+  EXPECT_EQ(view.at(0).GetTs(), commit_ts);
+}
+
+TEST_F(VersionedDeltaNodeTest, SetTsOwnerTest) {
+  TxnTs owner_ts = 1;
+  ValueStruct value{.point_id = 0, .point_type = 0, .value = "hello"};
+  auto delta = MakeDelta(value, false, MarkLocked(owner_ts));
+  auto sk = property::SortKeys({value.point_id, value.point_type});
+  // intent of other txn is left untouched.
+  EXPECT_TRUE(delta->SetTs(sk.as_ref(), 3, 0, 2).ok());
+  TxnTs write_ts;
+  EXPECT_TRUE(delta->GetNewestTs(sk.as_ref(), &write_ts));
+  EXPECT_EQ(write_ts, MarkLocked(owner_ts));
+  EXPECT_TRUE(delta->SetTs(sk.as_ref(), 3, 0, owner_ts).ok());
+  EXPECT_TRUE(delta->GetNewestTs(sk.as_ref(), &write_ts));
+  EXPECT_EQ(write_ts, 3);
+}
+
+TEST_F(VersionedDeltaNodeTest, KeyFilterTest) {
+  VersionedDeltaNodeBuilder builder;
+  auto value_list = GenerateValueList(100);
+  std::vector<std::shared_ptr<VersionedDeltaNode>> deltas;
+  // only even rows
+  for (const auto &value : value_list) {
+    if (value.point_id % 2 == 0) {
+      auto node = MakeDelta(value, false, 1);
+      deltas.push_back(node);
+      builder.AddDeltaNode(node.get());
+    }
+  }
+  auto compacted = builder.GenerateDeltaNode();
+  size_t false_positive = 0;
+  for (const auto &value : value_list) {
+    auto sk = property::SortKeys({value.point_id, value.point_type});
+    if (value.point_id % 2 == 0) {
+      // no false negative
+      EXPECT_TRUE(compacted->MayContain(sk.as_ref()));
+    } else if (compacted->MayContain(sk.as_ref())) {
+      false_positive += 1;
+    }
+  }
+  EXPECT_LT(false_positive, 10);
+  // out of key range
+  auto sk = property::SortKeys({int64_t(100), int32_t(0)});
+  EXPECT_FALSE(compacted->MayContain(sk.as_ref()));
+
+  // single row delta only relies on key range
+  auto &single = deltas[1];
+  auto sk1 = property::SortKeys({int64_t(2), int32_t(0)});
+  auto sk2 = property::SortKeys({int64_t(3), int32_t(0)});
+  EXPECT_TRUE(single->MayContain(sk1.as_ref()));
+  EXPECT_FALSE(single->MayContain(sk2.as_ref()));
+}
+
+TEST_F(VersionedDeltaNodeTest, PrefixSearchTest) {
+  VersionedDeltaNodeBuilder builder;
+  std::vector<std::shared_ptr<VersionedDeltaNode>> deltas;
+  // ids crossing byte boundaries, only even ids are inserted.
+  std::vector<int64_t> ids;
+  for (int64_t i = -300; i < 300; i++) {
+    ids.push_back(i * 257);
+  }
+  for (auto id : ids) {
+    if (id % 2 == 0) {
+      auto node = MakeDelta(
+          ValueStruct{.point_id = id, .point_type = 0, .value = "v"}, false,
+          1);
+      deltas.push_back(node);
+      builder.AddDeltaNode(node.get());
+    }
+  }
+  auto compacted = builder.GenerateDeltaNode();
+  for (auto id : ids) {
+    for (int32_t type = -1; type <= 1; type++) {
+      auto sk = property::SortKeys({id, type});
+      RowView view;
+      auto s = compacted->GetRow(sk.as_ref(), 1, opts_, &view);
+      if (id % 2 == 0 && type == 0) {
+        EXPECT_TRUE(s.ok());
+        TestRead(&view,
+                 ValueStruct{.point_id = id, .point_type = 0, .value = "v"});
+      } else {
+        EXPECT_TRUE(s.IsNotFound());
+      }
+    }
+  }
+}
+
+TEST_F(VersionedDeltaNodeTest, Int64KeyTest) {
+  // single int64 sort key, like adjacency list keyed by destination vertex.
+  property::Column column1{
+      .column_id = 0, .name = "dst", .type = property::ValueType::Int64};
+  property::Column column2{
+      .column_id = 1, .name = "value", .type = property::ValueType::String};
+  property::Schema schema(property::RawSchema{
+      .columns = {column1, column2}, .schema_id = 1, .sort_key_count = 1});
+  VersionedDeltaNodeBuilder builder;
+  std::vector<std::shared_ptr<VersionedDeltaNode>> deltas;
+  std::vector<int64_t> ids;
+  for (int64_t i = -100; i < 100; i++) {
+    ids.push_back(i * 3);
+  }
+  ids.push_back(std::numeric_limits<int64_t>::min());
+  ids.push_back(std::numeric_limits<int64_t>::max());
+  for (auto id : ids) {
+    property::ValueRefVec vec;
+    vec.push_back(id);
+    vec.push_back(std::string_view("v"));
+    util::BufWriter writer;
+    EXPECT_TRUE(property::Row::Serialize(vec, &writer, &schema).ok());
+    auto str = writer.Detach();
+    auto node =
+        std::make_shared<VersionedDeltaNode>(property::Row(str.data()), 1);
+    deltas.push_back(node);
+    builder.AddDeltaNode(node.get());
+  }
+  auto compacted = builder.GenerateDeltaNode();
+  std::sort(ids.begin(), ids.end());
+  for (int64_t id = -310; id < 310; id++) {
+    auto sk = property::SortKeys(property::Value(id));
+    RowView view;
+    auto s = compacted->GetRow(sk.as_ref(), 1, opts_, &view);
+    if (std::binary_search(ids.begin(), ids.end(), id)) {
+      EXPECT_TRUE(s.ok());
+    } else {
+      EXPECT_TRUE(s.IsNotFound());
+    }
+  }
+  auto read_ids = [&](const DeltaScanRange &range) {
+    std::vector<int64_t> result;
+    VersionedDeltaNodeMerger merger;
+    merger.AddDeltaNode(compacted.get());
+    merger.Scan(range, [&](const property::Row &row, bool is_deleted,
+                           TxnTs write_ts, bool is_newest) {
+      property::ValueResult res;
+      EXPECT_TRUE(row.GetProp(0, &res, &schema).ok());
+      result.push_back(std::get<int64_t>(res.value));
+      return true;
+    });
+    return result;
+  };
+  // resume token style bound, key + '\0' is right after key.
+  auto start = property::SortKeys(property::Value(int64_t(3)));
+  std::string start_token(start.as_slice());
+  start_token.push_back('\0');
+  auto end = property::SortKeys(property::Value(int64_t(10)));
+  DeltaScanRange range;
+  range.start = property::SortKeysRef(start_token);
+  range.end = end.as_ref();
+  EXPECT_EQ(read_ids(range), std::vector<int64_t>({6, 9}));
+  // sort key of another type falls back to comparing bytes.
+  auto str_key = property::SortKeys(property::Value(std::string_view("a")));
+  range.start = str_key.as_ref();
+  range.end = std::nullopt;
+  EXPECT_TRUE(read_ids(range).empty());
+  range.start = std::nullopt;
+  EXPECT_EQ(read_ids(range), ids);
+}
+
+TEST_F(VersionedDeltaNodeTest, SingleRowAllocationTest) {
+  auto make_row = [&](const ValueStruct &value, std::string *buffer) {
+    property::ValueRefVec vec;
+    vec.push_back(value.point_id);
+    vec.push_back(value.point_type);
+    vec.push_back(value.value);
+    util::BufWriter writer;
+    EXPECT_TRUE(property::Row::Serialize(vec, &writer, &schema_).ok());
+    *buffer = writer.Detach();
+    return property::Row(buffer->data());
+  };
+  // allocations made by building a single row delta, pool is warmed up by
+  // the first delta.
+  auto count_new = [&](auto &&new_delta) {
+    new_delta();
+    allocation_cnt = 0;
+    count_allocation = true;
+    new_delta();
+    count_allocation = false;
+    return allocation_cnt;
+  };
+  std::string small_buffer;
+  auto small_row =
+      make_row(ValueStruct{.point_id = 1, .point_type = 0, .value = "small"},
+               &small_buffer);
+  std::string large_buffer;
+  auto large_row = make_row(
+      ValueStruct{.point_id = 1,
+                  .point_type = 0,
+                  .value = std::string(common::Config::kBwTreeInlineRowSize,
+                                       'a')},
+      &large_buffer);
+
+  // node, control block and row share one pooled block.
+  EXPECT_EQ(count_new([&]() { VersionedDeltaNode::New(small_row, 1); }), 0);
+  EXPECT_EQ(count_new([&]() {
+              VersionedDeltaNode::New(small_row.GetSortKeys(), 1);
+            }),
+            0);
+  // only large rows take an extra buffer.
+  EXPECT_EQ(count_new([&]() { VersionedDeltaNode::New(large_row, 1); }), 1);
+
+  // only single row deltas with short rows pay for the inline row, base and
+  // merged nodes keep the size they had before rows were inlined.
+  EXPECT_EQ(sizeof(SingleRowDeltaNode) - sizeof(VersionedDeltaNode),
+            SingleRowDeltaNode::kInlineRowSize);
+  // charge of the same row stored in buffer_, i.e. before inlining.
+  auto buffered_charge = [](const property::Row &row) {
+    return std::make_shared<VersionedDeltaNode>(row, 1)->GetTotalCharge() -
+           row.as_slice().size();
+  };
+  EXPECT_EQ(VersionedDeltaNode::New(small_row, 1)->GetTotalCharge(),
+            buffered_charge(small_row) + SingleRowDeltaNode::kInlineRowSize);
+  EXPECT_EQ(VersionedDeltaNode::New(large_row, 1)->GetTotalCharge(),
+            buffered_charge(large_row) + large_row.as_slice().size());
+
+  for (const auto &row : {small_row, large_row}) {
+    auto delta = VersionedDeltaNode::New(row, 1);
+    RowView view;
+    EXPECT_TRUE(delta->GetRow(row.GetSortKeys(), 1, Options{}, &view).ok());
+    EXPECT_EQ(view.at(0).GetRow().as_slice(), row.as_slice());
+  }
+}
+
 } // namespace btree
 } // namespace arcanedb
\ No newline at end of file
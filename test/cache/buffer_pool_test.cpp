@@ -0,0 +1,272 @@
+/**
+ * @file buffer_pool_test.cpp
+ * @author sheep (ysj1173886760@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "cache/buffer_pool.h"
+#include "page_store/kv_page_store/kv_page_store.h"
+#include "page_store/options.h"
+#include "absl/container/flat_hash_map.h"
+#include <gtest/gtest.h>
+#include <mutex>
+
+namespace arcanedb {
+namespace cache {
+
+// counts reads of each page, so that deduplicated loads could be verified.
+class CountingPageStore : public page_store::PageStore {
+public:
+  explicit CountingPageStore(std::shared_ptr<page_store::PageStore> store)
+      : store_(std::move(store)) {}
+
+  Status UpdateReplacement(const PageIdType &page_id,
+                           const page_store::WriteOptions &options,
+                           const std::string_view &data) noexcept override {
+    return store_->UpdateReplacement(page_id, options, data);
+  }
+
+  Status UpdateDelta(const PageIdType &page_id,
+                     const page_store::WriteOptions &options,
+                     const std::string_view &data) noexcept override {
+    return store_->UpdateDelta(page_id, options, data);
+  }
+
+  Status DeletePage(const PageIdType &page_id,
+                    const page_store::WriteOptions &options) noexcept override {
+    return store_->DeletePage(page_id, options);
+  }
+
+  Status ReadPage(const PageIdType &page_id,
+                  const page_store::ReadOptions &options,
+                  std::vector<RawPage> *pages) noexcept override {
+    {
+      std::lock_guard<std::mutex> guard(mu_);
+      read_count_[page_id] += 1;
+    }
+    return store_->ReadPage(page_id, options, pages);
+  }
+
+  int GetReadCount(const PageIdType &page_id) {
+    std::lock_guard<std::mutex> guard(mu_);
+    auto it = read_count_.find(page_id);
+    return it == read_count_.end() ? 0 : it->second;
+  }
+
+  size_t GetReadPageNum() {
+    std::lock_guard<std::mutex> guard(mu_);
+    return read_count_.size();
+  }
+
+  void ResetReadCount() {
+    std::lock_guard<std::mutex> guard(mu_);
+    read_count_.clear();
+  }
+
+private:
+  std::shared_ptr<page_store::PageStore> store_;
+  std::mutex mu_;
+  absl::flat_hash_map<PageIdType, int> read_count_;
+};
+
+class BufferPoolTest : public ::testing::Test {
+public:
+  property::Schema MakeTestSchema() noexcept {
+    property::Column column1{
+        .column_id = 0, .name = "int64", .type = property::ValueType::Int64};
+    property::Column column2{
+        .column_id = 1, .name = "string", .type = property::ValueType::String};
+    property::RawSchema schema{
+        .columns = {column1, column2}, .schema_id = 0, .sort_key_count = 1};
+    return property::Schema(schema);
+  }
+
+  void WritePage(BufferPool *bpm, const std::string &page_id,
+                 int64_t point_id) noexcept {
+    property::ValueRefVec vec;
+    vec.push_back(point_id);
+    vec.push_back(std::string_view(value_));
+    util::BufWriter writer;
+    EXPECT_TRUE(property::Row::Serialize(vec, &writer, &schema_).ok());
+    auto str = writer.Detach();
+    property::Row row(str.data());
+
+    BufferPool::PageHolder page;
+    ASSERT_TRUE(bpm->GetPage(page_id, &page).ok());
+    btree::WriteInfo info;
+    ASSERT_TRUE(page->SetRow(row, /*write_ts=*/1, opts_, &info).ok());
+    bpm->TryInsertDirtyPage(page);
+    page.UpdateCharge(page->GetTotalCharge());
+  }
+
+  void ReadPage(BufferPool *bpm, const std::string &page_id,
+                int64_t point_id) noexcept {
+    BufferPool::PageHolder page;
+    ASSERT_TRUE(bpm->GetPage(page_id, &page).ok());
+    btree::RowView view;
+    auto sk = property::SortKeys(property::Value(point_id));
+    ASSERT_TRUE(page->GetRow(sk.as_ref(), /*read_ts=*/1, opts_, &view).ok());
+    property::ValueResult res;
+    EXPECT_TRUE(view.at(0).GetProp(1, &res, &schema_).ok());
+    EXPECT_EQ(std::get<std::string_view>(res.value), value_);
+  }
+
+  void SetUp() {
+    schema_ = MakeTestSchema();
+    opts_.schema = &schema_;
+    page_store::KvPageStore::Destory(store_name_);
+  }
+
+  void TearDown() { page_store::KvPageStore::Destory(store_name_); }
+
+  Options opts_;
+  property::Schema schema_;
+  std::string value_ = std::string(1024, 'a');
+  std::string store_name_ = "buffer_pool_test";
+};
+
+TEST_F(BufferPoolTest, EvictCleanPageTest) {
+  std::shared_ptr<page_store::PageStore> page_store;
+  page_store::Options store_opts;
+  ASSERT_TRUE(
+      page_store::KvPageStore::Open(store_name_, store_opts, &page_store)
+          .ok());
+  auto bpm = std::make_unique<BufferPool>(page_store);
+  opts_.buffer_pool = bpm.get();
+  int page_count = 100;
+  for (int i = 0; i < page_count; i++) {
+    WritePage(bpm.get(), std::to_string(i), i);
+  }
+  // pages are charged with their memory.
+  EXPECT_GT(bpm->TotalCharge(), page_count * value_.size());
+
+  // dirty pages are flushed before they are evicted.
+  bpm->ForceFlushAllPages();
+  bpm->SetCapacity(1);
+  EXPECT_EQ(bpm->TotalCharge(), 0);
+  bpm->SetCapacity(common::Config::kCacheCapacity);
+  for (int i = 0; i < page_count; i++) {
+    SCOPED_TRACE("");
+    ReadPage(bpm.get(), std::to_string(i), i);
+  }
+
+  // page that is written after flush is dirty again.
+  WritePage(bpm.get(), "0", page_count);
+  bpm->ForceFlushAllPages();
+  bpm->Prune();
+  {
+    SCOPED_TRACE("");
+    ReadPage(bpm.get(), "0", page_count);
+  }
+}
+
+TEST_F(BufferPoolTest, KeepDirtyPageTest) {
+  // pages couldn't be evicted without page store.
+  auto bpm = std::make_unique<BufferPool>(nullptr);
+  opts_.buffer_pool = bpm.get();
+  int page_count = 100;
+  for (int i = 0; i < page_count; i++) {
+    WritePage(bpm.get(), std::to_string(i), i);
+  }
+  auto total_charge = bpm->TotalCharge();
+  bpm->SetCapacity(1);
+  bpm->Prune();
+  EXPECT_EQ(bpm->TotalCharge(), total_charge);
+  for (int i = 0; i < page_count; i++) {
+    SCOPED_TRACE("");
+    ReadPage(bpm.get(), std::to_string(i), i);
+  }
+}
+
+TEST_F(BufferPoolTest, HotPageTest) {
+  auto bpm = std::make_unique<BufferPool>(nullptr);
+  opts_.buffer_pool = bpm.get();
+  int page_count = 12;
+  for (int i = 0; i < page_count; i++) {
+    WritePage(bpm.get(), std::to_string(i), i);
+  }
+  for (int round = 0; round < 2; round++) {
+    for (int i = 0; i < page_count; i++) {
+      BufferPool::PageHolder hot_page;
+      ASSERT_TRUE(bpm->GetHotPage(std::to_string(i), &hot_page).ok());
+      EXPECT_EQ(hot_page->GetPageKey(), std::to_string(i));
+      BufferPool::PageHolder page;
+      ASSERT_TRUE(bpm->GetPage(std::to_string(i), &page).ok());
+      EXPECT_EQ(hot_page.operator->(), page.operator->());
+    }
+  }
+  // pinned pages are released by prune.
+  bpm->Prune();
+  for (int i = 0; i < page_count; i++) {
+    SCOPED_TRACE("");
+    ReadPage(bpm.get(), std::to_string(i), i);
+  }
+}
+
+TEST_F(BufferPoolTest, PrefetchTest) {
+  std::shared_ptr<page_store::PageStore> page_store;
+  page_store::Options store_opts;
+  ASSERT_TRUE(
+      page_store::KvPageStore::Open(store_name_, store_opts, &page_store)
+          .ok());
+  auto counting_store = std::make_shared<CountingPageStore>(page_store);
+  auto bpm = std::make_unique<BufferPool>(counting_store);
+  opts_.buffer_pool = bpm.get();
+  int page_count = 100;
+  std::vector<std::string> page_id_storage;
+  for (int i = 0; i < page_count; i++) {
+    page_id_storage.push_back(std::to_string(i));
+    WritePage(bpm.get(), page_id_storage.back(), i);
+  }
+  // duplicated page ids are loaded once.
+  std::vector<PageIdView> page_ids(page_id_storage.begin(),
+                                   page_id_storage.end());
+  page_ids.push_back(page_ids.front());
+  bpm->ForceFlushAllPages();
+  bpm->Prune();
+  EXPECT_EQ(bpm->TotalCharge(), 0);
+
+  counting_store->ResetReadCount();
+  std::vector<BufferPool::PageHolder> pages;
+  std::vector<Status> status;
+  util::WaitGroup wg;
+  bpm->GetPages(page_ids, &pages, &status, &wg);
+  wg.Wait();
+  ASSERT_EQ(pages.size(), page_ids.size());
+  for (size_t i = 0; i < page_ids.size(); i++) {
+    ASSERT_TRUE(status[i].ok());
+    EXPECT_EQ(pages[i]->GetPageKey(), page_ids[i]);
+  }
+  EXPECT_EQ(pages.front().operator->(), pages.back().operator->());
+  pages.clear();
+  for (int i = 0; i < page_count; i++) {
+    SCOPED_TRACE("");
+    ReadPage(bpm.get(), page_id_storage[i], i);
+  }
+  EXPECT_EQ(counting_store->GetReadPageNum(), static_cast<size_t>(page_count));
+  for (int i = 0; i < page_count; i++) {
+    EXPECT_EQ(counting_store->GetReadCount(page_id_storage[i]), 1);
+  }
+
+  // prefetched pages are loaded in background, and reads racing with
+  // prefetch share the same load.
+  bpm->Prune();
+  counting_store->ResetReadCount();
+  bpm->Prefetch(page_ids);
+  for (int i = 0; i < page_count; i++) {
+    SCOPED_TRACE("");
+    ReadPage(bpm.get(), page_id_storage[i], i);
+  }
+  EXPECT_EQ(counting_store->GetReadPageNum(), static_cast<size_t>(page_count));
+  for (int i = 0; i < page_count; i++) {
+    EXPECT_EQ(counting_store->GetReadCount(page_id_storage[i]), 1);
+  }
+}
+
+} // namespace cache
+} // namespace arcanedb
@@ -10,6 +10,11 @@
  */
 
 #include "cache/cache.h"
+#include "cache/clock_cache.h"
+#include "cache/hot_page_table.h"
+#include "cache/lru_cache.h"
+#include "cache/s3fifo_cache.h"
+#include "common/config.h"
 #include "util/bthread_util.h"
 #include "util/wait_group.h"
 #include <gtest/gtest.h>
@@ -78,5 +83,258 @@ namespace cache {
 //   EXPECT_EQ(counter, 10);
 // }
 
+struct TestOptions {
+  std::function<std::unique_ptr<Cache>(size_t capacity)> new_cache;
+};
+
+class CacheTest : public ::testing::TestWithParam<TestOptions> {};
+
+INSTANTIATE_TEST_SUITE_P(
+    CacheTest, CacheTest,
+    ::testing::Values(TestOptions{.new_cache =
+                                      [](size_t capacity) {
+                                        return NewLRUCache(capacity, 0);
+                                      }},
+                      TestOptions{.new_cache =
+                                      [](size_t capacity) {
+                                        return NewS3FifoCache(capacity, 0);
+                                      }},
+                      TestOptions{.new_cache = [](size_t capacity) {
+                        return NewClockCache(capacity, 0);
+                      }}));
+
+TEST_P(CacheTest, EvictionHooksTest) {
+  auto cache = GetParam().new_cache(/*capacity=*/10);
+  std::vector<bool> evictable(20, true);
+  std::vector<std::string> refused;
+  Cache::EvictionHooks hooks;
+  // value of key i is i + 1, since null value indicates a missing entry.
+  auto to_value = [](uintptr_t i) { return reinterpret_cast<void *>(i + 1); };
+  hooks.can_evict = [&](void *value) {
+    return evictable[reinterpret_cast<uintptr_t>(value) - 1];
+  };
+  hooks.on_refused = [&](Cache::HandleHolder handle) {
+    refused.push_back(std::to_string(
+        reinterpret_cast<uintptr_t>(handle.TValue<void>()) - 1));
+  };
+  cache->SetEvictionHooks(std::move(hooks));
+  auto deleter = [](const std::string_view &, void *) {};
+
+  // even entries couldn't be evicted.
+  for (uintptr_t i = 0; i < 10; i++) {
+    evictable[i] = i % 2 == 1;
+    cache->Insert(std::to_string(i), to_value(i), 1, deleter);
+  }
+  EXPECT_EQ(cache->TotalCharge(), 10);
+  // new entries are pinned, so that odd entries are evicted by any policy.
+  std::vector<Cache::HandleHolder> pinned;
+  for (uintptr_t i = 10; i < 15; i++) {
+    pinned.push_back(
+        cache->Insert(std::to_string(i), to_value(i), 1, deleter));
+  }
+  EXPECT_EQ(cache->TotalCharge(), 10);
+  for (uintptr_t i = 0; i < 10; i++) {
+    auto handle = cache->Lookup(std::to_string(i));
+    EXPECT_EQ(static_cast<bool>(handle), i % 2 == 0);
+  }
+  EXPECT_FALSE(refused.empty());
+  pinned.clear();
+
+  // shrink capacity, only evictable entries are dropped, and entries refused
+  // before are reconsidered.
+  refused.clear();
+  cache->SetCapacity(1);
+  EXPECT_EQ(cache->TotalCharge(), 5);
+  EXPECT_EQ(refused.size(), 5);
+  for (uintptr_t i = 0; i < 10; i += 2) {
+    auto handle = cache->Lookup(std::to_string(i));
+    EXPECT_TRUE(static_cast<bool>(handle));
+    evictable[i] = true;
+  }
+  cache->Prune();
+  EXPECT_EQ(cache->TotalCharge(), 0);
+}
+
+TEST(S3FifoCacheTest, ScanResistanceTest) {
+  size_t capacity = 100;
+  auto lru = NewLRUCache(capacity, 0);
+  auto s3fifo = NewS3FifoCache(capacity, 0);
+  auto deleter = [](const std::string_view &, void *) {};
+  auto access = [&](Cache *cache, const std::string &key) {
+    auto handle = cache->Lookup(key);
+    if (!handle) {
+      cache->Insert(key, reinterpret_cast<void *>(1), 1, deleter);
+    }
+    return static_cast<bool>(handle);
+  };
+  // hot set is accessed repeatedly.
+  for (int epoch = 0; epoch < 3; epoch++) {
+    for (int i = 0; i < 50; i++) {
+      access(lru.get(), "hot" + std::to_string(i));
+      access(s3fifo.get(), "hot" + std::to_string(i));
+    }
+  }
+  // a single pass over cold keys.
+  for (int i = 0; i < 1000; i++) {
+    access(lru.get(), "cold" + std::to_string(i));
+    access(s3fifo.get(), "cold" + std::to_string(i));
+  }
+  size_t lru_hits = 0;
+  size_t s3fifo_hits = 0;
+  for (int i = 0; i < 50; i++) {
+    lru_hits += static_cast<bool>(lru->Lookup("hot" + std::to_string(i)));
+    s3fifo_hits +=
+        static_cast<bool>(s3fifo->Lookup("hot" + std::to_string(i)));
+  }
+  // scan flushes the whole lru cache, while hot set survives in main queue.
+  EXPECT_EQ(lru_hits, 0);
+  EXPECT_EQ(s3fifo_hits, 50);
+  EXPECT_LE(s3fifo->TotalCharge(), capacity);
+}
+
+TEST(ClockCacheTest, BasicTest) {
+  auto cache = NewClockCache(/*capacity=*/10, 0);
+  // value of entry counts how many times it has been deleted.
+  std::vector<int> deleted(30);
+  auto deleter = [](const std::string_view &, void *value) {
+    *static_cast<int *>(value) += 1;
+  };
+  for (int i = 0; i < 10; i++) {
+    cache->Insert(std::to_string(i), &deleted[i], 1, deleter);
+  }
+  for (int i = 0; i < 10; i++) {
+    auto handle = cache->Lookup(std::to_string(i));
+    ASSERT_TRUE(static_cast<bool>(handle));
+    EXPECT_EQ(handle.TValue<int>(), &deleted[i]);
+  }
+
+  // entry replaced is deleted once the last handle is released.
+  {
+    auto handle = cache->Lookup("0");
+    cache->Insert("0", &deleted[10], 1, deleter);
+    EXPECT_EQ(deleted[0], 0);
+    EXPECT_EQ(cache->Lookup("0").TValue<int>(), &deleted[10]);
+    EXPECT_EQ(handle.TValue<int>(), &deleted[0]);
+  }
+  EXPECT_EQ(deleted[0], 1);
+  EXPECT_EQ(cache->TotalCharge(), 10);
+
+  // entries in use are never evicted.
+  {
+    auto handle = cache->Lookup("1");
+    for (int i = 11; i < 30; i++) {
+      cache->Insert(std::to_string(i), &deleted[i], 1, deleter);
+    }
+    EXPECT_EQ(cache->TotalCharge(), 10);
+    EXPECT_EQ(cache->Lookup("1").TValue<int>(), &deleted[1]);
+  }
+  cache->Prune();
+  EXPECT_EQ(cache->TotalCharge(), 0);
+  for (int i = 0; i < 30; i++) {
+    EXPECT_EQ(deleted[i], 1);
+  }
+}
+
+TEST(ClockCacheTest, SecondChanceTest) {
+  size_t capacity = 100;
+  auto cache = NewClockCache(capacity, 0);
+  auto deleter = [](const std::string_view &, void *) {};
+  auto value = reinterpret_cast<void *>(1);
+  for (int i = 0; i < 100; i++) {
+    cache->Insert("hot" + std::to_string(i), value, 1, deleter);
+  }
+  // hot entries are referenced again before cold entries arrive.
+  for (int i = 0; i < 50; i++) {
+    EXPECT_TRUE(static_cast<bool>(cache->Lookup("hot" + std::to_string(i))));
+  }
+  for (int i = 0; i < 50; i++) {
+    cache->Insert("cold" + std::to_string(i), value, 1, deleter);
+  }
+  for (int i = 0; i < 50; i++) {
+    EXPECT_TRUE(static_cast<bool>(cache->Lookup("hot" + std::to_string(i))));
+  }
+  EXPECT_EQ(cache->TotalCharge(), capacity);
+}
+
+TEST(ClockCacheTest, ConcurrentTest) {
+  static std::atomic<int64_t> alive{0};
+  {
+    auto cache = NewClockCache(/*capacity=*/64, 2);
+    auto deleter = [](const std::string_view &key, void *value) {
+      auto *str = static_cast<std::string *>(value);
+      EXPECT_EQ(*str, key);
+      delete str;
+      alive.fetch_sub(1);
+    };
+    int worker_count = 16;
+    int epoch = 10000;
+    int key_count = 256;
+    util::WaitGroup wg(worker_count);
+    for (int i = 0; i < worker_count; i++) {
+      util::LaunchAsync([&, i]() {
+        std::vector<Cache::HandleHolder> holders;
+        for (int j = 0; j < epoch; j++) {
+          auto key = std::to_string((i * epoch + j) * 7 % key_count);
+          auto handle = cache->Lookup(key);
+          if (!handle) {
+            alive.fetch_add(1);
+            handle = cache->Insert(key, new std::string(key), 1, deleter);
+          }
+          EXPECT_EQ(*handle.TValue<std::string>(), key);
+          // hold some handles for a while, so that eviction skips them.
+          holders.push_back(std::move(handle));
+          if (holders.size() > 4) {
+            holders.erase(holders.begin());
+          }
+          if (j % 1000 == 0) {
+            cache->SetCapacity(j % 2000 == 0 ? 16 : 64);
+          }
+        }
+        holders.clear();
+        wg.Done();
+      });
+    }
+    wg.Wait();
+    EXPECT_LE(cache->TotalCharge(), 64);
+  }
+  EXPECT_EQ(alive.load(), 0);
+}
+
+TEST(HotPageTableTest, ChargeTest) {
+  auto cache = NewClockCache(/*capacity=*/100, 0);
+  auto deleter = [](const std::string_view &, void *) {};
+  // value of entry is its current charge.
+  auto charge_func = [](const Cache::HandleHolder &handle_holder) {
+    return *handle_holder.TValue<size_t>();
+  };
+  // each worker pins at most 2 units.
+  HotPageTable table(2 * common::Config::kHotPageWorkerNum, charge_func);
+  size_t charge = 1;
+  table.Insert(/*hash=*/0, cache->Insert("0", &charge, charge, deleter),
+               charge);
+  {
+    auto pin = table.Lookup(/*hash=*/0);
+    ASSERT_TRUE(pin);
+    EXPECT_EQ(pin.use_count(), 2);
+  }
+
+  // page grows beyond the capacity while it's pinned, the hit still returns
+  // the page, but it's unpinned from the slot.
+  charge = 3;
+  {
+    auto pin = table.Lookup(/*hash=*/0);
+    ASSERT_TRUE(pin);
+    EXPECT_EQ(pin.use_count(), 1);
+  }
+  EXPECT_FALSE(table.Lookup(/*hash=*/0));
+
+  // charge of unpinned page is released.
+  size_t other_charge = 2;
+  table.Insert(/*hash=*/1,
+               cache->Insert("1", &other_charge, other_charge, deleter),
+               other_charge);
+  EXPECT_TRUE(table.Lookup(/*hash=*/1));
+}
+
 } // namespace cache
-} // namespace arcanedb
\ No newline at end of file
+} // namespace arcanedb
@@ -153,6 +153,60 @@ TEST_F(WeightedGraphDBTest, EdgeIteratorTest) {
     EXPECT_FALSE(iterator.Valid());
     EXPECT_TRUE(txn->Commit().IsCommit());
   }
+  for (int i = 0; i < 10; i++) {
+    std::string token;
+    {
+      auto txn = db_->BeginRoTxn(opts_);
+      WeightedGraphDB::EdgeIterator iterator;
+      txn->GetEdgeIterator(i, &iterator);
+      iterator.Seek(5);
+      EXPECT_TRUE(iterator.Valid());
+      EXPECT_EQ(iterator.OutVertexId(), 5);
+      token = iterator.GetResumeToken();
+      EXPECT_TRUE(txn->Commit().IsCommit());
+    }
+    auto txn = db_->BeginRoTxn(opts_);
+    WeightedGraphDB::EdgeIterator iterator;
+    txn->GetEdgeIterator(i, &iterator, token);
+    for (int j = 6; j < 10; j++) {
+      EXPECT_TRUE(iterator.Valid());
+      EXPECT_EQ(iterator.OutVertexId(), j);
+      iterator.Next();
+    }
+    EXPECT_FALSE(iterator.Valid());
+    EXPECT_TRUE(txn->Commit().IsCommit());
+  }
+}
+
+TEST_F(WeightedGraphDBTest, FilteredEdgeIteratorTest) {
+  for (int j = 0; j < 10; j++) {
+    auto txn = db_->BeginRwTxn(opts_);
+    EXPECT_TRUE(txn->InsertEdge(0, j, std::to_string(j % 2)).ok());
+    EXPECT_TRUE(txn->Commit().IsCommit());
+  }
+  // odd edges within [2, 8), two at a time.
+  Filter filter;
+  filter.start = property::SortKeys(property::Value(int64_t{2}));
+  filter.end = property::SortKeys(property::Value(int64_t{8}));
+  filter.limit = 2;
+  filter.predicates.push_back(
+      Filter::Predicate{.column_id = 1,
+                        .op = Filter::CompareOp::kEqual,
+                        .value = std::string_view("1")});
+  std::string token;
+  std::vector<WeightedGraphDB::VertexId> dsts;
+  do {
+    auto txn = db_->BeginRoTxn(opts_);
+    WeightedGraphDB::EdgeIterator iterator;
+    txn->GetEdgeIterator(0, filter, &iterator, token);
+    token.clear();
+    for (; iterator.Valid(); iterator.Next()) {
+      dsts.push_back(iterator.OutVertexId());
+      token = iterator.GetResumeToken();
+    }
+    EXPECT_TRUE(txn->Commit().IsCommit());
+  } while (!token.empty());
+  EXPECT_EQ(dsts, (std::vector<WeightedGraphDB::VertexId>{3, 5, 7}));
 }
 
 } // namespace graph
@@ -0,0 +1,88 @@
+/**
+ * @file low_watermark_test.cpp
+ * @author sheep (ysj1173886760@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "txn/low_watermark.h"
+#include "bthread/bthread.h"
+#include "txn/txn_manager_occ.h"
+#include <gtest/gtest.h>
+
+namespace arcanedb {
+namespace txn {
+
+TEST(LowWatermarkTest, BasicTest) {
+  auto *watermark = LowWatermark::GetInstance();
+  // nothing could be collected without source.
+  EXPECT_EQ(watermark->GetLowWatermark(), 0);
+  TxnTs snapshot_ts = 10;
+  auto source_id = watermark->AddSource([&]() { return snapshot_ts; });
+  EXPECT_EQ(watermark->GetLowWatermark(), 10);
+  {
+    LowWatermark::Pin pin;
+    EXPECT_EQ(watermark->AcquireAndPin([&]() { return snapshot_ts; }, &pin),
+              10);
+    snapshot_ts = 20;
+    // pinned snapshot holds the watermark
+    EXPECT_EQ(watermark->GetLowWatermark(), 10);
+    LowWatermark::Pin moved_pin = std::move(pin);
+    EXPECT_EQ(watermark->GetLowWatermark(), 10);
+  }
+  EXPECT_EQ(watermark->GetLowWatermark(), 20);
+  watermark->RemoveSource(source_id);
+  EXPECT_EQ(watermark->GetLowWatermark(), 0);
+}
+
+TEST(LowWatermarkTest, CachedWatermarkTest) {
+  auto *watermark = LowWatermark::GetInstance();
+  TxnTs snapshot_ts = 10;
+  // cache is refreshed once sources are changed.
+  auto source_id = watermark->AddSource([&]() { return snapshot_ts; });
+  EXPECT_EQ(watermark->GetCachedLowWatermark(), 10);
+  // cached watermark lags behind, but never exceeds the current one.
+  snapshot_ts = 20;
+  EXPECT_LE(watermark->GetCachedLowWatermark(), 20);
+  bthread_usleep(common::Config::kLowWatermarkRefreshIntervalUs);
+  EXPECT_EQ(watermark->GetCachedLowWatermark(), 20);
+  watermark->RemoveSource(source_id);
+  EXPECT_EQ(watermark->GetCachedLowWatermark(), 0);
+}
+
+TEST(LowWatermarkTest, AddSourceTest) {
+  auto *watermark = LowWatermark::GetInstance();
+  TxnTs snapshot_ts1 = 20;
+  TxnTs snapshot_ts2 = 5;
+  auto source_id1 = watermark->AddSource([&]() { return snapshot_ts1; });
+  EXPECT_EQ(watermark->GetCachedLowWatermark(), 20);
+  // readers of the new source are protected as soon as it's added, even if
+  // concurrent refreshers computed the watermark without it.
+  auto source_id2 = watermark->AddSource([&]() { return snapshot_ts2; });
+  EXPECT_EQ(watermark->GetCachedLowWatermark(), 5);
+  watermark->RemoveSource(source_id2);
+  EXPECT_EQ(watermark->GetCachedLowWatermark(), 20);
+  watermark->RemoveSource(source_id1);
+  EXPECT_EQ(watermark->GetCachedLowWatermark(), 0);
+}
+
+TEST(LowWatermarkTest, TxnManagerTest) {
+  auto *watermark = LowWatermark::GetInstance();
+  {
+    TxnManagerOCC txn_manager(LockManagerType::kCentralized);
+    Options opts;
+    auto ro_txn = txn_manager.BeginRoTxn(opts);
+    auto rw_txn = txn_manager.BeginRwTxn(opts);
+    EXPECT_LE(watermark->GetLowWatermark(), ro_txn->GetReadTs());
+    ro_txn.reset();
+    EXPECT_LE(watermark->GetLowWatermark(), rw_txn->GetReadTs());
+  }
+  EXPECT_EQ(watermark->GetLowWatermark(), 0);
+}
+
+} // namespace txn
+} // namespace arcanedb
@@ -0,0 +1,64 @@
+/**
+ * @file txn_status_table_test.cpp
+ * @author sheep (ysj1173886760@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "txn/txn_status_table.h"
+#include "util/epoch.h"
+#include <gtest/gtest.h>
+
+namespace arcanedb {
+namespace txn {
+
+TEST(TxnStatusTableTest, BasicTest) {
+  auto *table = TxnStatusTable::GetInstance();
+  auto size = table->TEST_Size();
+  TxnTs owner_ts = 1000;
+  TxnTs commit_ts = 1010;
+  // committed version is not affected
+  EXPECT_EQ(table->Resolve(owner_ts), owner_ts);
+  EXPECT_EQ(table->Resolve(kAbortedTxnTs), kAbortedTxnTs);
+  // running txn
+  EXPECT_EQ(table->Resolve(MarkLocked(owner_ts)), MarkLocked(owner_ts));
+  table->Commit(owner_ts, commit_ts);
+  EXPECT_EQ(table->TEST_Size(), size + 1);
+  EXPECT_EQ(table->Resolve(MarkLocked(owner_ts)), commit_ts);
+  // other txns are still running
+  EXPECT_EQ(table->Resolve(MarkLocked(owner_ts + 1)), MarkLocked(owner_ts + 1));
+  table->Erase(owner_ts);
+  EXPECT_EQ(table->TEST_Size(), size);
+  EXPECT_EQ(table->Resolve(MarkLocked(owner_ts)), MarkLocked(owner_ts));
+}
+
+TEST(TxnStatusTableTest, WriteBackTest) {
+  auto *table = TxnStatusTable::GetInstance();
+  auto size = table->TEST_Size();
+  TxnTs owner_ts = 2000;
+  TxnTs commit_ts = 2010;
+  table->Commit(owner_ts, commit_ts, /*intent_cnt=*/2);
+  table->WriteBack(owner_ts);
+  util::EpochManager::GetInstance()->TryReclaim();
+  EXPECT_EQ(table->Resolve(MarkLocked(owner_ts)), commit_ts);
+  // entry is erased once all intents are written back.
+  table->WriteBack(owner_ts);
+  util::EpochManager::GetInstance()->TryReclaim();
+  EXPECT_EQ(table->TEST_Size(), size);
+  EXPECT_EQ(table->Resolve(MarkLocked(owner_ts)), MarkLocked(owner_ts));
+
+  // untracked entry is left to its owner.
+  table->Commit(owner_ts, commit_ts);
+  table->WriteBack(owner_ts);
+  util::EpochManager::GetInstance()->TryReclaim();
+  EXPECT_EQ(table->Resolve(MarkLocked(owner_ts)), commit_ts);
+  table->Erase(owner_ts);
+  EXPECT_EQ(table->TEST_Size(), size);
+}
+
+} // namespace txn
+} // namespace arcanedb
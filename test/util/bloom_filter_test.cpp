@@ -0,0 +1,45 @@
+/**
+ * @file bloom_filter_test.cpp
+ * @author sheep (ysj1173886760@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "util/bloom_filter.h"
+#include <gtest/gtest.h>
+#include <string>
+
+namespace arcanedb {
+namespace util {
+
+TEST(BloomFilterTest, BasicTest) {
+  size_t key_num = 10000;
+  BloomFilter filter(key_num, 10);
+  for (size_t i = 0; i < key_num; i++) {
+    filter.Add(std::to_string(i));
+  }
+  for (size_t i = 0; i < key_num; i++) {
+    EXPECT_TRUE(filter.MayContain(std::to_string(i)));
+  }
+  size_t false_positive = 0;
+  for (size_t i = key_num; i < key_num * 2; i++) {
+    if (filter.MayContain(std::to_string(i))) {
+      false_positive += 1;
+    }
+  }
+  // ~1% false positive rate
+  EXPECT_LT(false_positive, key_num * 3 / 100);
+}
+
+TEST(BloomFilterTest, EmptyTest) {
+  BloomFilter filter;
+  EXPECT_TRUE(filter.empty());
+  EXPECT_TRUE(filter.MayContain("anything"));
+}
+
+} // namespace util
+} // namespace arcanedb
@@ -0,0 +1,97 @@
+/**
+ * @file epoch_test.cpp
+ * @author sheep (ysj1173886760@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-15
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "util/epoch.h"
+#include "util/bthread_util.h"
+#include "util/wait_group.h"
+#include <gtest/gtest.h>
+
+namespace arcanedb {
+namespace util {
+
+TEST(EpochTest, BasicTest) {
+  auto *manager = EpochManager::GetInstance();
+  manager->TryReclaim();
+  auto ptr = std::make_shared<std::string>("hello");
+  std::weak_ptr<std::string> weak = ptr;
+  {
+    EpochManager::Guard guard;
+    manager->Retire(std::move(ptr));
+    manager->TryReclaim();
+    // reader is still inside the epoch
+    EXPECT_FALSE(weak.expired());
+  }
+  manager->TryReclaim();
+  EXPECT_TRUE(weak.expired());
+  EXPECT_EQ(manager->TEST_RetiredCount(), 0);
+}
+
+TEST(EpochTest, NestedGuardTest) {
+  auto *manager = EpochManager::GetInstance();
+  auto ptr = std::make_shared<std::string>("hello");
+  std::weak_ptr<std::string> weak = ptr;
+  {
+    EpochManager::Guard guard;
+    {
+      EpochManager::Guard inner_guard;
+      manager->Retire(std::move(ptr));
+    }
+    manager->TryReclaim();
+    EXPECT_FALSE(weak.expired());
+  }
+  manager->TryReclaim();
+  EXPECT_TRUE(weak.expired());
+}
+
+TEST(EpochTest, ConcurrentTest) {
+  struct Node {
+    int64_t value;
+  };
+  std::shared_ptr<Node> owner = std::make_shared<Node>(Node{.value = 0});
+  std::atomic<Node *> head{owner.get()};
+  bthread::Mutex mu;
+  int worker_count = 16;
+  int epoch = 1000;
+  WaitGroup wg(worker_count * 2);
+  for (int i = 0; i < worker_count; i++) {
+    // writer
+    LaunchAsync([&]() {
+      for (int j = 0; j < epoch; j++) {
+        auto node = std::make_shared<Node>(Node{.value = j});
+        std::shared_ptr<Node> old_node;
+        {
+          std::lock_guard<bthread::Mutex> guard(mu);
+          old_node = std::move(owner);
+          owner = node;
+          head.store(node.get(), std::memory_order_release);
+        }
+        EpochManager::GetInstance()->Retire(std::move(old_node));
+      }
+      wg.Done();
+    });
+    // reader
+    LaunchAsync([&]() {
+      for (int j = 0; j < epoch; j++) {
+        EpochManager::Guard guard;
+        auto *node = head.load(std::memory_order_acquire);
+        EXPECT_GE(node->value, 0);
+        EXPECT_LT(node->value, epoch);
+      }
+      wg.Done();
+    });
+  }
+  wg.Wait();
+  EpochManager::GetInstance()->TryReclaim();
+  EXPECT_EQ(EpochManager::GetInstance()->TEST_RetiredCount(), 0);
+}
+
+} // namespace util
+} // namespace arcanedb
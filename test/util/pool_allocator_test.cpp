@@ -0,0 +1,49 @@
+/**
+ * @file pool_allocator_test.cpp
+ * @author sheep (ysj1173886760@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "util/pool_allocator.h"
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+namespace arcanedb {
+namespace util {
+
+TEST(PoolAllocatorTest, SharedPtrTest) {
+  std::vector<std::shared_ptr<std::string>> ptrs;
+  for (int i = 0; i < 1000; i++) {
+    ptrs.push_back(std::allocate_shared<std::string>(
+        PoolAllocator<std::string>(), std::to_string(i)));
+  }
+  for (int i = 0; i < 1000; i++) {
+    EXPECT_EQ(*ptrs[i], std::to_string(i));
+  }
+  std::weak_ptr<std::string> weak = ptrs[0];
+  ptrs.clear();
+  EXPECT_TRUE(weak.expired());
+  // freed blocks are reused.
+  auto ptr =
+      std::allocate_shared<std::string>(PoolAllocator<std::string>(), "hello");
+  EXPECT_EQ(*ptr, "hello");
+}
+
+TEST(PoolAllocatorTest, ArrayTest) {
+  std::vector<int64_t, PoolAllocator<int64_t>> vec;
+  for (int64_t i = 0; i < 100; i++) {
+    vec.push_back(i);
+  }
+  for (int64_t i = 0; i < 100; i++) {
+    EXPECT_EQ(vec[i], i);
+  }
+}
+
+} // namespace util
+} // namespace arcanedb
@@ -0,0 +1,65 @@
+/**
+ * @file wait_table_test.cpp
+ * @author sheep (ysj1173886760@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "util/wait_table.h"
+#include "util/bthread_util.h"
+#include "util/time.h"
+#include "util/wait_group.h"
+#include <gtest/gtest.h>
+
+namespace arcanedb {
+namespace util {
+
+TEST(WaitTableTest, StaleTokenTest) {
+  auto *table = WaitTable::GetInstance();
+  auto token = table->Prepare(0);
+  table->NotifyAll(0);
+  // notified after token is taken, should return immediately.
+  Timer timer;
+  table->Wait(0, token, 10 * Second);
+  EXPECT_LT(timer.GetElapsed(), Second);
+}
+
+TEST(WaitTableTest, TimeoutTest) {
+  auto *table = WaitTable::GetInstance();
+  auto token = table->Prepare(1);
+  Timer timer;
+  table->Wait(1, token, 10 * MillSec);
+  EXPECT_GE(timer.GetElapsed(), 10 * MillSec);
+}
+
+TEST(WaitTableTest, NotifyTest) {
+  auto *table = WaitTable::GetInstance();
+  std::atomic<bool> flag{false};
+  size_t waiter_cnt = 8;
+  WaitGroup wg(waiter_cnt);
+  for (size_t i = 0; i < waiter_cnt; i++) {
+    LaunchAsync([&]() {
+      Timer timer;
+      while (true) {
+        auto token = table->Prepare(2);
+        if (flag.load()) {
+          break;
+        }
+        table->Wait(2, token, 10 * Second);
+      }
+      EXPECT_LT(timer.GetElapsed(), 5 * Second);
+      wg.Done();
+    });
+  }
+  bthread_usleep(10 * MillSec);
+  flag.store(true);
+  table->NotifyAll(2);
+  wg.Wait();
+}
+
+} // namespace util
+} // namespace arcanedb